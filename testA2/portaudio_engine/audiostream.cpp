@@ -34,3 +34,24 @@ double AudioStream::getSampleRateDouble() const
 {
     return _samplerated;
 }
+
+bool AudioStream::postCommand(const StreamCommand& cmd)
+{
+    return _commands.push(cmd);
+}
+
+void AudioStream::drainCommands()
+{
+    StreamCommand cmd;
+
+    while(_commands.pop(cmd))
+        onCommand(cmd);
+}
+
+int AudioStream::renderBlock(void *outputBuffer, unsigned long framesPerBuffer,
+                             const PaStreamCallbackTimeInfo* timeInfo,
+                             PaStreamCallbackFlags statusFlags)
+{
+    drainCommands();
+    return audioOut(outputBuffer, framesPerBuffer, timeInfo, statusFlags);
+}
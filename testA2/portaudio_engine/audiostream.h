@@ -1,6 +1,7 @@
 #pragma once
 
 #include "portaudio.h"
+#include "commandqueue.h"
 
 class ScopedPAContext;
 
@@ -16,6 +17,15 @@ protected:
     float               _sampleratef;
     double              _samplerated;
 
+    CommandQueue        _commands;
+
+    /**
+     * @brief Called from the audio thread, once per queued command, right before audioOut. Reimplement it to apply
+     * parameter changes posted with postCommand() or setParameter().
+     * @param cmd       Command posted by the control thread.
+     */
+    virtual void onCommand(const StreamCommand& cmd) {(void) cmd;}
+
 public:
     AudioStream(unsigned int samplerate = 44100,
                 unsigned int channels = 2,
@@ -29,6 +39,34 @@ public:
     unsigned int getChannelAmount() const;
     PaSampleFormat getSampleFormat() const;
 
+    /**
+     * @brief Queues a command for the audio thread. Wait-free, so it's safe to call while the stream is playing.
+     * Only one control thread (usually the GUI one) may post commands to a given stream.
+     * @return  false if the queue was full and the command was dropped.
+     */
+    bool            postCommand(const StreamCommand& cmd);
+
+    /**
+     * @brief Convenience method. Queues a typed parameter change. See postCommand().
+     */
+    template<typename T>
+    bool            setParameter(unsigned int parameter, T value)
+    {
+        return postCommand(StreamCommand(parameter, value));
+    }
+
+    /**
+     * @brief Applies every queued command through onCommand(). Audio thread only.
+     */
+    void            drainCommands();
+
+    /**
+     * @brief Entry point for ScopedPAContext: drains the command queue and then calls audioOut.
+     */
+    int             renderBlock(void *outputBuffer, unsigned long framesPerBuffer,
+                                const PaStreamCallbackTimeInfo* timeInfo,
+                                PaStreamCallbackFlags statusFlags);
+
     virtual int audioOut(void *outputBuffer, unsigned long framesPerBuffer,
                        const PaStreamCallbackTimeInfo* timeInfo,
                        PaStreamCallbackFlags statusFlags) = 0;
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Typed parameter change message, sent from a control thread (like the GUI) to the audio callback.
+ * The meaning of `parameter` is defined by every AudioStream subclass, usually with an enum.
+ */
+struct StreamCommand
+{
+    enum ValueType
+    {
+        Int,
+        Float,
+        Double
+    };
+
+    unsigned int        parameter;
+    ValueType           type;
+
+    union
+    {
+        int             intValue;
+        float           floatValue;
+        double          doubleValue;
+    } value;
+
+    StreamCommand() : parameter(0), type(Int) {value.doubleValue = 0.0;}
+    StreamCommand(unsigned int param, int v) : parameter(param), type(Int) {value.intValue = v;}
+    StreamCommand(unsigned int param, float v) : parameter(param), type(Float) {value.floatValue = v;}
+    StreamCommand(unsigned int param, double v) : parameter(param), type(Double) {value.doubleValue = v;}
+
+    /**
+     * @brief Returns the carried value, converted to the type you ask for.
+     */
+    template<typename T> T get() const
+    {
+        switch(type)
+        {
+            case Int:       return static_cast<T>(value.intValue);
+            case Float:     return static_cast<T>(value.floatValue);
+            default:        return static_cast<T>(value.doubleValue);
+        }
+    }
+};
+
+/**
+ * @brief Wait-free single producer, single consumer ring buffer. One thread may push, one other thread may pop, and
+ * neither of them ever blocks or allocates. Capacity must be a power of two; one slot is kept empty to tell a full
+ * ring from an empty one.
+ *
+ * Head and tail live in different cache lines, so producer and consumer don't keep stealing each other's line.
+ */
+template<typename T, size_t capacity = 256>
+class SPSCQueue
+{
+    static_assert((capacity & (capacity - 1)) == 0 && capacity >= 2, "SPSCQueue capacity must be a power of two.");
+
+private:
+    static const size_t         MASK =  capacity - 1;
+    static const size_t         LINE =  64;
+
+    // Written by the consumer, read by the producer.
+    std::atomic<size_t>         _head;
+    char                        _pad0[LINE - sizeof(std::atomic<size_t>)];
+
+    // Written by the producer, read by the consumer.
+    std::atomic<size_t>         _tail;
+    char                        _pad1[LINE - sizeof(std::atomic<size_t>)];
+
+    T                           _slots[capacity];
+
+public:
+    SPSCQueue() : _head(0), _tail(0) {}
+
+    /**
+     * @brief Producer side. Copies `item` into the ring.
+     * @return  false if the ring was full. The item is dropped in that case.
+     */
+    bool push(const T& item)
+    {
+        const size_t tail =     _tail.load(std::memory_order_relaxed);
+        const size_t next =     (tail + 1) & MASK;
+
+        if(next == _head.load(std::memory_order_acquire))
+            return false;
+
+        _slots[tail] =  item;
+        _tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Consumer side. Moves the oldest item into `item`.
+     * @return  false if the ring was empty.
+     */
+    bool pop(T& item)
+    {
+        const size_t head =     _head.load(std::memory_order_relaxed);
+
+        if(head == _tail.load(std::memory_order_acquire))
+            return false;
+
+        item =  _slots[head];
+        _head.store((head + 1) & MASK, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Approximate amount of queued items. Exact only when called from the producer or the consumer thread.
+     */
+    size_t size() const
+    {
+        return (_tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire)) & MASK;
+    }
+
+    bool empty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    static size_t maxSize()
+    {
+        return capacity - 1;
+    }
+};
+
+typedef SPSCQueue<StreamCommand, 256>   CommandQueue;
@@ -5,6 +5,21 @@ struct StereoAudioOut
     float left, right;
 };
 
+void MetronomeTest::onCommand(const StreamCommand& cmd)
+{
+    switch(cmd.parameter)
+    {
+        case ParamBPM:
+            bpm =       cmd.get<double>();
+        break;
+        case ParamVolume:
+            volume =    cmd.get<float>();
+        break;
+        default:
+        break;
+    }
+}
+
 int MetronomeTest::audioOut(void *outputBuffer, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags)
 {
     float* mono_out =               (float*) outputBuffer;
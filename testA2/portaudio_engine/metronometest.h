@@ -2,6 +2,10 @@
 
 #include "audiostream.h"
 
+/**
+ * @brief Metronome click generator. BPM and volume can be changed from any single control thread while playing,
+ * since changes travel to the audio thread through the stream's command queue.
+ */
 class MetronomeTest : public AudioStream
 {
 private:
@@ -9,12 +13,21 @@ private:
     double bpm;
     float volume;
 
+protected:
+    void onCommand(const StreamCommand& cmd);
+
 public:
+    enum Parameters
+    {
+        ParamBPM,
+        ParamVolume
+    };
+
     MetronomeTest() : t1(0), t2(0), t(0), bpm(120.0), volume(0.5f)
     {}
 
-    void changeBPM(double _bpm){bpm = _bpm;}
-    void changeVolume(float _vol){volume = _vol;}
+    bool changeBPM(double _bpm){return setParameter(ParamBPM, _bpm);}
+    bool changeVolume(float _vol){return setParameter(ParamVolume, _vol);}
 
     int audioOut(void *outputBuffer, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags);
 };
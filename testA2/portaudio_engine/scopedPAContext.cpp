@@ -93,5 +93,5 @@ int ScopedPAContext::apiCallback(const void *inputBuffer, void *outputBuffer, un
     (void) inputBuffer;
 
     // Cast this ScopedPAContext._as as the userData used here.
-    return(current_stream->audioOut(outputBuffer, framesPerBuffer, timeInfo, statusFlags));
+    return(current_stream->renderBlock(outputBuffer, framesPerBuffer, timeInfo, statusFlags));
 }
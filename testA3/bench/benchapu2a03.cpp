@@ -0,0 +1,86 @@
+#include "whimsybench.h"
+#include "../chip_engine/apu2a03.h"
+
+#include <vector>
+
+// Frames per call: a 512 frame callback.
+#define BENCH_APU_FRAMES        512
+
+template<class Channel>
+static void benchChannel(whimsybench::State& state, Channel& channel)
+{
+    std::vector<float> out(BENCH_APU_FRAMES);
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        channel.render(&(out[0]), out.size());
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(BENCH_APU_FRAMES * sizeof(float));
+}
+
+WHIMSY_BENCHMARK(apu2a03_square)
+{
+    Apu2A03Square sq(44100.0f);
+
+    sq.setFrequency(440.0f);
+    benchChannel(state, sq);
+}
+
+WHIMSY_BENCHMARK(apu2a03_triangle)
+{
+    Apu2A03Triangle tri(44100.0f);
+
+    tri.setFrequency(220.0f);
+    benchChannel(state, tri);
+}
+
+// Period index 0, the worst case: the register is clocked about 10 times per sample.
+WHIMSY_BENCHMARK(apu2a03_noise_fastest)
+{
+    Apu2A03Noise noi(44100.0f);
+
+    noi.setPeriodIndex(0);
+    benchChannel(state, noi);
+}
+
+WHIMSY_BENCHMARK(apu2a03_dpcm)
+{
+    std::vector<uint8_t>    sample(4081, 0x5A);
+    Apu2A03DPCM             dpcm(44100.0f);
+
+    dpcm.setSample(&(sample[0]), sample.size());
+    dpcm.setLoop(true);
+    dpcm.play();
+    benchChannel(state, dpcm);
+}
+
+// The five channels of one chip mixed into one block, as a song instance renders them.
+WHIMSY_BENCHMARK(apu2a03_full_chip)
+{
+    std::vector<float>      out(BENCH_APU_FRAMES);
+    std::vector<uint8_t>    sample(4081, 0x5A);
+    Apu2A03Square           sq1(44100.0f), sq2(44100.0f);
+    Apu2A03Triangle         tri(44100.0f);
+    Apu2A03Noise            noi(44100.0f);
+    Apu2A03DPCM             dpcm(44100.0f);
+
+    sq1.setFrequency(440.0f);
+    sq2.setFrequency(554.37f);
+    tri.setFrequency(110.0f);
+    noi.setPeriodIndex(4);
+    dpcm.setSample(&(sample[0]), sample.size());
+    dpcm.setLoop(true);
+    dpcm.play();
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        sq1.render(&(out[0]), out.size());
+        sq2.mix(&(out[0]), out.size());
+        tri.mix(&(out[0]), out.size());
+        noi.mix(&(out[0]), out.size());
+        dpcm.mix(&(out[0]), out.size());
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(BENCH_APU_FRAMES * sizeof(float));
+}
@@ -0,0 +1,60 @@
+#include "whimsybench.h"
+#include "../portaudio_engine/commandqueue.h"
+
+#include <thread>
+
+// One push followed by one pop, on the same thread. Measures the raw cost of both operations.
+WHIMSY_BENCHMARK(commandqueue_push_pop)
+{
+    static CommandQueue queue;
+    StreamCommand       in(1, 0.5f), out;
+
+    for(unsigned long long i = 0; i < state.iterations; i++)
+    {
+        in.value.intValue = (int)i;
+        queue.push(in);
+        queue.pop(out);
+        whimsybench::doNotOptimize(out);
+    }
+    state.setBytesPerIteration(sizeof(StreamCommand));
+}
+
+// A GUI-like burst: fill the queue, then drain it as the audio callback would.
+WHIMSY_BENCHMARK(commandqueue_burst_drain)
+{
+    static CommandQueue queue;
+    StreamCommand       in(1, 120.0), out;
+    const size_t        burst = CommandQueue::maxSize();
+
+    for(unsigned long long i = 0; i < state.iterations; i += burst)
+    {
+        for(size_t j = 0; j < burst; j++)
+            queue.push(in);
+        while(queue.pop(out))
+            whimsybench::doNotOptimize(out);
+    }
+    state.setBytesPerIteration(sizeof(StreamCommand));
+}
+
+// Producer and consumer on different threads. Reports the cost per transferred command, cache line traffic included.
+WHIMSY_BENCHMARK(commandqueue_cross_thread)
+{
+    static CommandQueue     queue;
+    const unsigned long long total = state.iterations;
+
+    std::thread producer([total]()
+    {
+        StreamCommand cmd(0, 1.0f);
+        for(unsigned long long i = 0; i < total; i++)
+            while(!queue.push(cmd))
+                std::this_thread::yield();
+    });
+
+    StreamCommand out;
+    for(unsigned long long i = 0; i < total; i++)
+        while(!queue.pop(out))
+            std::this_thread::yield();
+
+    producer.join();
+    state.setBytesPerIteration(sizeof(StreamCommand));
+}
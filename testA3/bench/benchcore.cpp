@@ -0,0 +1,232 @@
+#include "whimsybench.h"
+#include "../whimsycore.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace whimsycore;
+
+// Read relative to the working directory, testA3's source folder. Without it, variant_parse_music1 is skipped.
+#define BENCH_MUSIC1_FILE       "export_files/music1.json"
+
+// Synthetic document: an array of patch-like objects, about 150KB of JSON.
+#define BENCH_DOCUMENT_ENTRIES  1000
+
+// Blob size of the ByteStream encoders.
+#define BENCH_BLOB_BYTES        4096
+
+// Numbers of the MIDI variable length cases: a spread over the 1 to 4 byte encodings.
+#define BENCH_VARLEN_NUMBERS    1024
+
+static std::string benchMusic1JSON()
+{
+    static std::string  json;
+    static bool         loaded = false;
+
+    if(!loaded)
+    {
+        ByteStream  bs;
+
+        loaded = true;
+        try
+        {
+            bs.readFile(BENCH_MUSIC1_FILE);
+            json.assign(reinterpret_cast<const char*>(bs.begin()), bs.size());
+        }
+        catch(Exception&)
+        {
+            json.clear();
+        }
+    }
+
+    return json;
+}
+
+static const std::string& benchDocumentJSON()
+{
+    static std::string json;
+
+    if(json.empty())
+    {
+        static const char* const    notes[4] = {"C-4", "F#3", "A-5", "==="};
+        char                        entry[256];
+
+        json = "{\"name\": \"Bench\", \"empty\": {}, \"entries\": [";
+        for(unsigned int i = 0; i < BENCH_DOCUMENT_ENTRIES; i++)
+        {
+            std::snprintf(entry, sizeof(entry),
+                          "%s{\"index\": %u, \"name\": \"Entry %u\", \"gain\": %u.%02u, \"loop\": %s, \"note\": \"@%s\","
+                          " \"volume\": [15, 13, 11, %u, 8, 7], \"data\": \"#%02X%02X%02X%02X\", \"extra\": null}",
+                          i > 0 ? ", " : "", i, i, i % 4, i % 100, (i % 2) ? "true" : "false", notes[i % 4], i % 16,
+                          i & 0xFF, (i * 7) & 0xFF, (i * 13) & 0xFF, (i * 31) & 0xFF);
+            json += entry;
+        }
+        json += "]}";
+    }
+
+    return json;
+}
+
+static void benchParse(whimsybench::State& state, const std::string& json)
+{
+    Variant v;
+
+    if(json.empty())
+    {
+        state.skip("export_files/music1.json not found: run from testA3's folder");
+        return;
+    }
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        v.parse(json.c_str());
+        whimsybench::doNotOptimize(v);
+    }
+    state.setBytesPerIteration(json.size());
+}
+
+WHIMSY_BENCHMARK(variant_parse_music1)      {benchParse(state, benchMusic1JSON());}
+WHIMSY_BENCHMARK(variant_parse_document)    {benchParse(state, benchDocumentJSON());}
+
+static void benchToJSON(whimsybench::State& state, bool pretty)
+{
+    Variant         v;
+    std::string     json;
+
+    v.parse(benchDocumentJSON().c_str());
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        json = pretty ? v.toJSONPretty() : v.toJSON();
+        whimsybench::doNotOptimize(json[0]);
+    }
+    state.setBytesPerIteration(json.size());
+}
+
+WHIMSY_BENCHMARK(variant_tojson)            {benchToJSON(state, false);}
+WHIMSY_BENCHMARK(variant_tojson_pretty)     {benchToJSON(state, true);}
+
+static ByteStream benchBlob()
+{
+    ByteStream      blob;
+    unsigned int    x = 12345;
+
+    // Deterministic noise, so the encodings don't get any shortcut.
+    for(unsigned int i = 0; i < BENCH_BLOB_BYTES; i++)
+    {
+        x = x * 1103515245 + 12345;
+        blob.push_back((byte)(x >> 16));
+    }
+    return blob;
+}
+
+WHIMSY_BENCHMARK(bytestream_base64_encode)
+{
+    const ByteStream    blob = benchBlob();
+    std::string         text;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        text = blob.base64Encode();
+        whimsybench::doNotOptimize(text[0]);
+    }
+    state.setBytesPerIteration(BENCH_BLOB_BYTES);
+}
+
+WHIMSY_BENCHMARK(bytestream_base64_decode)
+{
+    const std::string   text = benchBlob().base64Encode();
+    ByteStream          blob;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        blob.clear();
+        blob.base64Decode(text.c_str());
+        whimsybench::doNotOptimize(blob[0]);
+    }
+    state.setBytesPerIteration(BENCH_BLOB_BYTES);
+}
+
+WHIMSY_BENCHMARK(bytestream_hex_encode)
+{
+    const ByteStream    blob = benchBlob();
+    std::string         text;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        text = blob.hexEncode();
+        whimsybench::doNotOptimize(text[0]);
+    }
+    state.setBytesPerIteration(BENCH_BLOB_BYTES);
+}
+
+WHIMSY_BENCHMARK(bytestream_hex_decode)
+{
+    const std::string   text = benchBlob().hexEncode();
+    ByteStream          blob;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        blob.clear();
+        blob.hexDecode(text.c_str());
+        whimsybench::doNotOptimize(blob[0]);
+    }
+    state.setBytesPerIteration(BENCH_BLOB_BYTES);
+}
+
+static unsigned int benchVarLenNumber(unsigned int i)
+{
+    // 1, 2, 3 and 4 byte encodings in turn.
+    static const unsigned int limits[4] = {0x80, 0x4000, 0x200000, 0x10000000};
+
+    return (i * 2654435761u) % limits[i % 4];
+}
+
+WHIMSY_BENCHMARK(midi_varlen_add)
+{
+    ByteStream bs;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        bs.clear();
+        for(unsigned int i = 0; i < BENCH_VARLEN_NUMBERS; i++)
+            bs.addMidiVarLen(benchVarLenNumber(i));
+        whimsybench::doNotOptimize(bs[0]);
+    }
+    state.setBytesPerIteration(bs.size());
+}
+
+WHIMSY_BENCHMARK(midi_varlen_get)
+{
+    ByteStream  bs;
+    int         number = 0;
+
+    for(unsigned int i = 0; i < BENCH_VARLEN_NUMBERS; i++)
+        bs.addMidiVarLen(benchVarLenNumber(i));
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        bs.rewind();
+        for(unsigned int i = 0; i < BENCH_VARLEN_NUMBERS; i++)
+            bs.getMidiVarLen(number);
+        whimsybench::doNotOptimize(number);
+    }
+    state.setBytesPerIteration(bs.size());
+}
+
+WHIMSY_BENCHMARK(noteproto_fromstring)
+{
+    static const char* const    notes[8] = {"C-4", "F#3", "Bb0", "A", "G4", "===", "xxx", "---"};
+    NoteProto                   note;
+
+    // One iteration parses the 8 strings.
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        for(unsigned int i = 0; i < 8; i++)
+        {
+            note.fromString(notes[i]);
+            whimsybench::doNotOptimize(note);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#include "whimsybench.h"
+#include "../portaudio_engine/denormals.h"
+
+#include <vector>
+
+// Frames per call: a 512 frame callback.
+#define BENCH_DENORMAL_FRAMES   512
+
+// A silent highpass like TrackerStream's, whose state starts right above the denormal range and decays into it.
+static void benchDecay(whimsybench::State& state, bool guarded, bool antidenormal)
+{
+    std::vector<float>  out(BENCH_DENORMAL_FRAMES);
+    AntiDenormal        anti;
+    const float         coef = 0.99f;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        float y = 1e-37f;
+
+        if(guarded)
+        {
+            DenormalGuard guard;
+
+            for(unsigned int i = 0; i < out.size(); i++)
+                out[i] = y = coef * y;
+        }
+        else if(antidenormal)
+        {
+            for(unsigned int i = 0; i < out.size(); i++)
+                out[i] = y = coef * y + anti.next();
+        }
+        else
+        {
+            for(unsigned int i = 0; i < out.size(); i++)
+                out[i] = y = coef * y;
+        }
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(BENCH_DENORMAL_FRAMES * sizeof(float));
+}
+
+WHIMSY_BENCHMARK(denormals_decay_unprotected)   {benchDecay(state, false, false);}
+WHIMSY_BENCHMARK(denormals_decay_guard)         {benchDecay(state, true, false);}
+WHIMSY_BENCHMARK(denormals_decay_antidenormal)  {benchDecay(state, false, true);}
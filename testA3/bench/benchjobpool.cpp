@@ -0,0 +1,67 @@
+#include "whimsybench.h"
+#include "../portaudio_engine/jobpool.h"
+#include "../chip_engine/apu2a03.h"
+
+#include <vector>
+
+// 32 pulse channels, as four chips' worth of songs, rendering 512 frames each into their own buffer.
+#define BENCH_JOBS_CHANNELS     32
+#define BENCH_JOBS_FRAMES       512
+
+struct ChannelBlock
+{
+    std::vector<Apu2A03Square>  channels;
+    std::vector<float>          buffers;
+
+    ChannelBlock() :
+        channels(BENCH_JOBS_CHANNELS, Apu2A03Square(44100.0f)),
+        buffers(BENCH_JOBS_CHANNELS * BENCH_JOBS_FRAMES)
+    {
+        for(unsigned int c = 0; c < BENCH_JOBS_CHANNELS; c++)
+            channels[c].setFrequency(110.0f * (float)(c + 1));
+    }
+
+    static void render(void* block, unsigned int c)
+    {
+        ChannelBlock* self = static_cast<ChannelBlock*>(block);
+        self->channels[c].render(&(self->buffers[c * BENCH_JOBS_FRAMES]), BENCH_JOBS_FRAMES);
+    }
+};
+
+WHIMSY_BENCHMARK(jobpool_channels_serial)
+{
+    ChannelBlock block;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        for(unsigned int c = 0; c < BENCH_JOBS_CHANNELS; c++)
+            ChannelBlock::render(&block, c);
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(BENCH_JOBS_CHANNELS * BENCH_JOBS_FRAMES * sizeof(float));
+}
+
+WHIMSY_BENCHMARK(jobpool_channels_parallel)
+{
+    ChannelBlock    block;
+    JobPool         jobs;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        jobs.run(ChannelBlock::render, &block, BENCH_JOBS_CHANNELS);
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(BENCH_JOBS_CHANNELS * BENCH_JOBS_FRAMES * sizeof(float));
+}
+
+static void emptyJob(void*, unsigned int)
+{}
+
+// Handoff cost alone: one empty job per thread.
+WHIMSY_BENCHMARK(jobpool_empty_batch)
+{
+    JobPool jobs;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+        jobs.run(emptyJob, NULL, jobs.concurrency());
+}
@@ -0,0 +1,44 @@
+#include "whimsybench.h"
+#include "../portaudio_engine/levelmeter.h"
+
+#include <cmath>
+#include <vector>
+
+// A 64 frame stereo callback, the smallest block the meters are meant to keep under 1% of.
+#define BENCH_METER_FRAMES      64
+
+WHIMSY_BENCHMARK(levelmeter_float_stereo_64)
+{
+    LevelMeter          meter;
+    std::vector<float>  block(BENCH_METER_FRAMES * 2);
+
+    for(unsigned int i = 0; i < block.size(); i++)
+        block[i] = 0.5f * std::sin(0.05f * (float)i);
+
+    meter.configure(2, 44100.0);
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        meter.processFloat(&(block[0]), BENCH_METER_FRAMES);
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(block.size() * sizeof(float));
+}
+
+WHIMSY_BENCHMARK(levelmeter_int16_stereo_64)
+{
+    LevelMeter          meter;
+    std::vector<short>  block(BENCH_METER_FRAMES * 2);
+
+    for(unsigned int i = 0; i < block.size(); i++)
+        block[i] = (short)(16000.0f * std::sin(0.05f * (float)i));
+
+    meter.configure(2, 44100.0);
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        meter.process(&(block[0]), BENCH_METER_FRAMES, paInt16);
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(block.size() * sizeof(short));
+}
@@ -0,0 +1,189 @@
+#include "whimsybench.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <new>
+
+using namespace whimsybench;
+
+// Wall time each measured repetition should last, in seconds.
+#define BENCH_TARGET_TIME       0.2
+#define BENCH_REPETITIONS       5
+
+std::vector<Case>& whimsybench::registry()
+{
+    static std::vector<Case> cases;
+    return cases;
+}
+
+// The real-time checker replaces operator new itself where it can't interpose malloc (see rtsafety.cpp).
+#if !defined(WHIMSY_RT_CHECK) || defined(__GLIBC__)
+#define BENCH_COUNT_ALLOCATIONS 1
+#endif
+
+#if BENCH_COUNT_ALLOCATIONS
+
+static std::atomic<unsigned long long> allocations(0);
+
+unsigned long long whimsybench::allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+// Counting replacements of the global operator new. Allocations made with malloc directly are not seen.
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    void* p = std::malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) noexcept
+{
+    return operator new(size, nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+#else
+
+unsigned long long whimsybench::allocationCount()
+{
+    return 0;
+}
+
+#endif
+
+static double runOnce(const Case& c, unsigned long long iterations)
+{
+    State state(iterations);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    c.function(state);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    // Usage: whimsy_bench [--csv] [filter]. Only cases whose name contains `filter` are run. --csv prints one line per
+    // case, with the same figures as the table: name, ns/op, bytes/s, allocations/op and iterations.
+    const char*     filter =    "";
+    bool            csv =       false;
+
+    for(int a = 1; a < argc; a++)
+    {
+        if(std::strcmp(argv[a], "--csv") == 0)
+            csv = true;
+        else
+            filter = argv[a];
+    }
+
+    if(csv)
+        std::cout << "benchmark,ns_per_op,bytes_per_second,allocs_per_op,iterations" << std::endl;
+    else
+        std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(16) << "ns/op"
+                  << std::setw(16) << "MB/s" << std::setw(14) << "allocs/op" << std::setw(14) << "iterations"
+                  << std::endl;
+
+    for(std::vector<Case>::const_iterator it = registry().begin(); it != registry().end(); it++)
+    {
+        if(std::strstr(it->name, filter) == NULL)
+            continue;
+
+        // A first run finds out whether the case can run at all.
+        State               probe(1);
+
+        it->function(probe);
+
+        if(probe.skipped != NULL)
+        {
+            if(csv)
+                std::cout << it->name << ",,,," << std::endl;
+            else
+                std::cout << std::left << std::setw(40) << it->name << "skipped: " << probe.skipped << std::endl;
+            continue;
+        }
+
+        // Calibrate: grow the iteration count until a run lasts long enough to be measured.
+        unsigned long long  iterations = 1;
+        double              elapsed;
+
+        while((elapsed = runOnce(*it, iterations)) < BENCH_TARGET_TIME / 20.0)
+            iterations *= 2;
+
+        iterations = (unsigned long long)(iterations * BENCH_TARGET_TIME / elapsed) + 1;
+
+        // Take the fastest repetition. It's the one with the least noise from the rest of the system.
+        // Allocations are averaged over all of them, setup included.
+        double                      best =          1e30;
+        const unsigned long long    allocstart =    allocationCount();
+
+        for(int r = 0; r < BENCH_REPETITIONS; r++)
+        {
+            elapsed = runOnce(*it, iterations);
+            if(elapsed < best)
+                best = elapsed;
+        }
+
+        const double    nsperop =       best * 1e9 / iterations;
+        const double    bytespersec =   probe.bytesPerIteration * iterations / best;
+        const double    allocsperop =   (double)(allocationCount() - allocstart) / (iterations * BENCH_REPETITIONS);
+
+        if(csv)
+        {
+            std::cout << it->name << "," << std::fixed << std::setprecision(2) << nsperop << ",";
+            if(probe.bytesPerIteration > 0)
+                std::cout << std::setprecision(0) << bytespersec;
+            std::cout << "," << std::setprecision(3) << allocsperop << "," << iterations << std::endl;
+            continue;
+        }
+
+        std::cout << std::left << std::setw(40) << it->name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(16) << nsperop;
+
+        if(probe.bytesPerIteration > 0)
+            std::cout << std::setw(16) << (bytespersec / 1e6);
+        else
+            std::cout << std::setw(16) << "-";
+
+        std::cout << std::setw(14) << allocsperop << std::setw(14) << iterations << std::endl;
+    }
+
+    return 0;
+}
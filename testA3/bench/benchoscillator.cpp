@@ -0,0 +1,53 @@
+#include "whimsybench.h"
+#include "../portaudio_engine/oscillator.h"
+
+#include <vector>
+
+// Frames per call: a 512 frame callback.
+#define BENCH_OSCILLATOR_FRAMES     512
+
+// The square loop SquareWaveTest used before Oscillator: one branchy, aliasing sample at a time.
+WHIMSY_BENCHMARK(oscillator_naive_square)
+{
+    std::vector<float>  out(BENCH_OSCILLATOR_FRAMES);
+    const unsigned long period =    (unsigned long)(44100.0f / 440.0f);
+    unsigned long       t =         0;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        for(unsigned int i = 0; i < out.size(); i++, t++)
+        {
+            if(t < period / 2)
+                out[i] = 0.5f;
+            else if(t < period)
+                out[i] = -0.5f;
+            else
+            {
+                t = 0;
+                out[i] = 0.5f;
+            }
+        }
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(BENCH_OSCILLATOR_FRAMES * sizeof(float));
+}
+
+static void benchOscillator(whimsybench::State& state, Oscillator::Waveform waveform)
+{
+    std::vector<float>  out(BENCH_OSCILLATOR_FRAMES);
+    Oscillator          osc(44100.0f, waveform, 440.0f);
+
+    osc.setAmplitude(0.5f);
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        osc.render(&(out[0]), out.size());
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(BENCH_OSCILLATOR_FRAMES * sizeof(float));
+}
+
+WHIMSY_BENCHMARK(oscillator_square)     {benchOscillator(state, Oscillator::Square);}
+WHIMSY_BENCHMARK(oscillator_triangle)   {benchOscillator(state, Oscillator::Triangle);}
+WHIMSY_BENCHMARK(oscillator_saw)        {benchOscillator(state, Oscillator::Saw);}
+WHIMSY_BENCHMARK(oscillator_noise)      {benchOscillator(state, Oscillator::Noise);}
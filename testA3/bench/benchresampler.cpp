@@ -0,0 +1,38 @@
+#include "whimsybench.h"
+#include "../portaudio_engine/resampler.h"
+
+#include <vector>
+
+// Output frames per call: a 512 frame stereo callback.
+#define BENCH_RESAMPLER_FRAMES      512
+#define BENCH_RESAMPLER_CHANNELS    2
+
+static void benchResampler(whimsybench::State& state, Resampler::Quality quality, double inrate, double outrate)
+{
+    Resampler           resampler(BENCH_RESAMPLER_CHANNELS, inrate, outrate, quality, 2048);
+    std::vector<float>  in(2048 * BENCH_RESAMPLER_CHANNELS);
+    std::vector<float>  out(BENCH_RESAMPLER_FRAMES * BENCH_RESAMPLER_CHANNELS);
+
+    for(size_t i = 0; i < in.size(); i++)
+        in[i] = (float)((i * 7919) % 2001) / 1000.0f - 1.0f;
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        resampler.write(&(in[0]), resampler.inputNeeded(BENCH_RESAMPLER_FRAMES));
+        resampler.read(&(out[0]), BENCH_RESAMPLER_FRAMES);
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(out.size() * sizeof(float));
+}
+
+WHIMSY_BENCHMARK(resampler_fast_44k_48k)    {benchResampler(state, Resampler::Fast, 44100.0, 48000.0);}
+WHIMSY_BENCHMARK(resampler_medium_44k_48k)  {benchResampler(state, Resampler::Medium, 44100.0, 48000.0);}
+WHIMSY_BENCHMARK(resampler_high_44k_48k)    {benchResampler(state, Resampler::High, 44100.0, 48000.0);}
+WHIMSY_BENCHMARK(resampler_best_44k_48k)    {benchResampler(state, Resampler::Best, 44100.0, 48000.0);}
+
+// A low rate chip renderer feeding a 96kHz device.
+WHIMSY_BENCHMARK(resampler_fast_11k_96k)    {benchResampler(state, Resampler::Fast, 11025.0, 96000.0);}
+WHIMSY_BENCHMARK(resampler_high_11k_96k)    {benchResampler(state, Resampler::High, 11025.0, 96000.0);}
+
+// Downsampling lengthens the filter.
+WHIMSY_BENCHMARK(resampler_high_96k_44k)    {benchResampler(state, Resampler::High, 96000.0, 44100.0);}
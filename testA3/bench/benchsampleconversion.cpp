@@ -0,0 +1,64 @@
+#include "whimsybench.h"
+#include "../portaudio_engine/sampleconversion.h"
+
+#include <vector>
+
+// Samples per conversion call: a 512 frame stereo callback.
+#define BENCH_CONVERSION_SAMPLES    1024
+
+static void benchFromFloat(whimsybench::State& state, PaSampleFormat format, SampleConversion::InstructionSet iset)
+{
+    std::vector<float>          in(BENCH_CONVERSION_SAMPLES);
+    std::vector<unsigned char>  out(BENCH_CONVERSION_SAMPLES * 4);
+
+    // Includes out of range values, so the clamping path is exercised.
+    for(size_t i = 0; i < in.size(); i++)
+        in[i] = (float)((int)(i % 301) - 150) / 120.0f;
+
+    SampleConversion::InstructionSet previous = SampleConversion::setInstructionSet(iset);
+
+    for(unsigned long long i = 0; i < state.iterations; i++)
+    {
+        SampleConversion::fromFloat(&(in[0]), format, &(out[0]), in.size());
+        whimsybench::clobberMemory();
+    }
+
+    SampleConversion::setInstructionSet(previous);
+    state.setBytesPerIteration(BENCH_CONVERSION_SAMPLES * sizeof(float));
+}
+
+static void benchToFloat(whimsybench::State& state, PaSampleFormat format, SampleConversion::InstructionSet iset)
+{
+    std::vector<unsigned char>  in(BENCH_CONVERSION_SAMPLES * 4);
+    std::vector<float>          out(BENCH_CONVERSION_SAMPLES);
+
+    for(size_t i = 0; i < in.size(); i++)
+        in[i] = (unsigned char)(i * 37);
+
+    SampleConversion::InstructionSet previous = SampleConversion::setInstructionSet(iset);
+
+    for(unsigned long long i = 0; i < state.iterations; i++)
+    {
+        SampleConversion::toFloat(&(in[0]), format, &(out[0]), out.size());
+        whimsybench::clobberMemory();
+    }
+
+    SampleConversion::setInstructionSet(previous);
+    state.setBytesPerIteration(BENCH_CONVERSION_SAMPLES * sizeof(float));
+}
+
+// One case per format, direction and instruction set. Unsupported instruction sets fall back to the best one available.
+#define BENCH_CONVERSION(NAME, FORMAT) \
+    WHIMSY_BENCHMARK(conversion_from_float_##NAME##_scalar) {benchFromFloat(state, FORMAT, SampleConversion::Scalar);} \
+    WHIMSY_BENCHMARK(conversion_from_float_##NAME##_sse2)   {benchFromFloat(state, FORMAT, SampleConversion::SSE2);} \
+    WHIMSY_BENCHMARK(conversion_from_float_##NAME##_avx2)   {benchFromFloat(state, FORMAT, SampleConversion::AVX2);} \
+    WHIMSY_BENCHMARK(conversion_to_float_##NAME##_scalar)   {benchToFloat(state, FORMAT, SampleConversion::Scalar);} \
+    WHIMSY_BENCHMARK(conversion_to_float_##NAME##_sse2)     {benchToFloat(state, FORMAT, SampleConversion::SSE2);} \
+    WHIMSY_BENCHMARK(conversion_to_float_##NAME##_avx2)     {benchToFloat(state, FORMAT, SampleConversion::AVX2);}
+
+BENCH_CONVERSION(float32, paFloat32)
+BENCH_CONVERSION(int32, paInt32)
+BENCH_CONVERSION(int24, paInt24)
+BENCH_CONVERSION(int16, paInt16)
+BENCH_CONVERSION(int8, paInt8)
+BENCH_CONVERSION(uint8, paUInt8)
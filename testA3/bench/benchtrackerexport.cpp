@@ -0,0 +1,86 @@
+#include "whimsybench.h"
+#include "../chip_engine/trackerexport.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace whimsycore;
+
+// A synthetic song: 16 frames of 64 rows on two pulses, the triangle and the noise, about 100 seconds long.
+#define BENCH_EXPORT_FRAMES     16
+#define BENCH_EXPORT_ROWS       64
+
+static std::string benchSongJSON()
+{
+    static const char* const    names[12] = {"C-", "C#", "D-", "D#", "E-", "F-", "F#", "G-", "G#", "A-", "A#", "B-"};
+    std::string                 json;
+    char                        cell[64];
+
+    json =  "{\"patches\": {\"patch\": [{\"index\": 0, \"volume\": [15, 13, 11, 9, 8, 7], \"volume-release\": 5,"
+            " \"dutycycle\": [2, 1], \"dutycycle-loop\": 0}]},"
+            " \"songs\": [{\"name\": \"Bench\", \"tempo\": 150, \"metadata\": {\"basetempo\": 150, \"divider\": 6},"
+            " \"map\": {\"frame-cols\": {\"SQ01\": 0, \"SQ02\": 1, \"TRI\": 2, \"NOI\": 3}, \"frame\": [";
+
+    for(unsigned int f = 0; f < BENCH_EXPORT_FRAMES; f++)
+        json += (f > 0) ? ", [0, 0, 0, 0]" : "[0, 0, 0, 0]";
+
+    json += "]}, \"patterns\": {\"pattern-cols\": {\"SQ01\": {\"NOTE\": 0, \"PAT\": 1, \"VOL\": 2},"
+            " \"SQ02\": {\"NOTE\": 0, \"PAT\": 1, \"VOL\": 2}, \"TRI\": {\"NOTE\": 0}, \"NOI\": {\"FREQ\": 0, \"VOL\": 1}}";
+
+    for(unsigned int c = 0; c < 4; c++)
+    {
+        static const char* const ids[4] = {"SQ01", "SQ02", "TRI", "NOI"};
+
+        json += std::string(", \"") + ids[c] + "\": [[";
+        for(unsigned int r = 0; r < BENCH_EXPORT_ROWS; r++)
+        {
+            const unsigned int n = (r * 7 + c * 5) % 12;
+
+            if(c == 3)
+                std::snprintf(cell, sizeof(cell), "%s[%u, 12]", r > 0 ? ", " : "", (r * 5) % 16);
+            else if(r % 2 == 0)
+                std::snprintf(cell, sizeof(cell), "%s[\"@%s%u\", 0, 12]", r > 0 ? ", " : "", names[n], 3 + c % 2);
+            else
+                std::snprintf(cell, sizeof(cell), "%s[null]", r > 0 ? ", " : "");
+            json += cell;
+        }
+        json += "]]";
+    }
+
+    return json + "}}]}";
+}
+
+static void benchExport(whimsybench::State& state, JobPool* jobs)
+{
+    const std::string   json =  benchSongJSON();
+    Variant             file;
+    TrackerSong         song;
+
+    file.parse(json.c_str());
+    song.compile(file);
+
+    TrackerExporter     exporter(song);
+    std::vector<float>  out;
+    unsigned long long  frames = 0;
+
+    exporter.setCheckpointRows(32);
+    exporter.setJobPool(jobs);
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        frames = exporter.render(out);
+        whimsybench::doNotOptimize(out[0]);
+    }
+    state.setBytesPerIteration(frames * 2 * sizeof(float));
+}
+
+WHIMSY_BENCHMARK(trackerexport_single_thread)
+{
+    benchExport(state, NULL);
+}
+
+WHIMSY_BENCHMARK(trackerexport_job_pool)
+{
+    JobPool jobs;
+    benchExport(state, &jobs);
+}
@@ -0,0 +1,35 @@
+#include "whimsybench.h"
+#include "../chip_engine/trackermacro.h"
+
+#include <vector>
+
+// One tick of 64 voices running all four macros, looping, half of them released.
+WHIMSY_BENCHMARK(trackermacro_advance_64_voices)
+{
+    const unsigned int  voices = 64;
+    std::vector<int8_t> table(MacroCount + 64);
+    TrackerMacroPlayer  player(voices);
+
+    for(unsigned int i = 0; i < table.size(); i++)
+        table[i] = (int8_t)(i & 15);
+
+    player.setTable(&(table[0]));
+
+    for(unsigned int v = 0; v < voices; v++)
+    {
+        for(unsigned int m = 0; m < MacroCount; m++)
+        {
+            const TrackerMacro macro = {(unsigned int)(MacroCount + m * 16), (unsigned short)(8 + (v + m) % 8),
+                                        (short)(v % 4), (short)((v & 1) ? 6 : -1)};
+            player.trigger(v, (TrackerMacroType)m, &macro);
+        }
+        if(v % 4 == 0)
+            player.release(v);
+    }
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        player.advance();
+        whimsybench::clobberMemory();
+    }
+}
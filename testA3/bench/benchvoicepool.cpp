@@ -0,0 +1,53 @@
+#include "whimsybench.h"
+#include "../chip_engine/voicepool.h"
+#include "../whimsycore.h"
+
+#include <vector>
+
+// Frames per call: a 512 frame callback.
+#define BENCH_POOL_FRAMES       512
+
+static void benchVoices(whimsybench::State& state, unsigned int voices)
+{
+    std::vector<float>  out(BENCH_POOL_FRAMES);
+    VoicePool           pool(voices, 44100.0f);
+
+    for(unsigned int v = 0; v < voices; v++)
+        pool.noteOn((uint8_t)WHIMSYNOTE_MACRO(v % 12, 2 + (v / 12) % 4), 12,
+                    (v % 4 == 3) ? VoicePool::Triangle : VoicePool::Pulse, (uint8_t)(v & 3));
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        pool.mix(&(out[0]), out.size());
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(BENCH_POOL_FRAMES * sizeof(float));
+}
+
+WHIMSY_BENCHMARK(voicepool_mix_16)
+{
+    benchVoices(state, 16);
+}
+
+WHIMSY_BENCHMARK(voicepool_mix_256)
+{
+    benchVoices(state, 256);
+}
+
+// A full pool stealing a voice for every note, as a held chord effect would.
+WHIMSY_BENCHMARK(voicepool_steal)
+{
+    const VoicePool::StealMode  modes[3] = {VoicePool::StealOldest, VoicePool::StealQuietest, VoicePool::StealSameNote};
+    VoicePool                   pool(256, 44100.0f);
+    unsigned int                note = 0;
+
+    for(unsigned int v = 0; v < pool.capacity(); v++)
+        pool.noteOn((uint8_t)(24 + v % 48), (uint8_t)(v & 15));
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        pool.setStealMode(modes[n % 3]);
+        pool.noteOn((uint8_t)(24 + (note++ % 48)), 10);
+        whimsybench::clobberMemory();
+    }
+}
@@ -0,0 +1,59 @@
+#include "whimsybench.h"
+#include "../portaudio_engine/waveformoverview.h"
+
+#include <cmath>
+#include <vector>
+
+// A minute of stereo, drawn on a 1920 pixel wide view.
+#define BENCH_WAVEFORM_FRAMES   (60 * 44100)
+#define BENCH_WAVEFORM_COLUMNS  1920
+
+// Built once, so the runner's calibration doesn't keep timing it.
+static const std::vector<float>& benchWaveform()
+{
+    static std::vector<float> frames;
+
+    if(frames.empty())
+    {
+        frames.resize(BENCH_WAVEFORM_FRAMES * 2);
+        for(size_t i = 0; i < frames.size(); i++)
+            frames[i] = std::sin(0.001f * (float)i);
+    }
+    return frames;
+}
+
+static const WaveformOverview& benchOverview()
+{
+    static WaveformOverview overview(2);
+
+    if(overview.frames() == 0)
+        overview.append(&(benchWaveform()[0]), BENCH_WAVEFORM_FRAMES);
+    return overview;
+}
+
+WHIMSY_BENCHMARK(waveform_append_minute)
+{
+    const std::vector<float>&   frames =    benchWaveform();
+    WaveformOverview            overview(2);
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        overview.clear();
+        overview.append(&(frames[0]), BENCH_WAVEFORM_FRAMES);
+        whimsybench::clobberMemory();
+    }
+    state.setBytesPerIteration(frames.size() * sizeof(float));
+}
+
+WHIMSY_BENCHMARK(waveform_summarize_whole)
+{
+    const WaveformOverview&     overview =  benchOverview();
+    std::vector<float>          low(BENCH_WAVEFORM_COLUMNS), high(BENCH_WAVEFORM_COLUMNS);
+
+    for(unsigned long long n = 0; n < state.iterations; n++)
+    {
+        overview.summarize(0, 0.0, (double)BENCH_WAVEFORM_FRAMES / BENCH_WAVEFORM_COLUMNS, BENCH_WAVEFORM_COLUMNS,
+                           &(low[0]), &(high[0]));
+        whimsybench::clobberMemory();
+    }
+}
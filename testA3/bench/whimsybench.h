@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <string>
+
+/**
+ * Minimal microbenchmark harness for the whimsy_bench target.
+ *
+ * ## How to write a benchmark ##
+ * Use the WHIMSY_BENCHMARK macro in any .cpp file of the bench folder, and loop `state.iterations` times over the code
+ * you want to measure. The runner picks the iteration count by itself, so every case runs for a similar wall time.
+ * Call State::setBytesPerIteration if you want a throughput figure too, and State::skip if the case can't run here.
+ *
+ * Every case reports ns/op, bytes/s and allocations (through operator new) per op. `whimsy_bench --csv` prints them as
+ * CSV instead of a table, for tracking them across releases.
+ */
+namespace whimsybench
+{
+
+class State
+{
+public:
+    unsigned long long  iterations;
+    unsigned long long  bytesPerIteration;
+    const char*         skipped;
+
+    State(unsigned long long iter) : iterations(iter), bytesPerIteration(0), skipped(NULL) {}
+
+    void setBytesPerIteration(unsigned long long bytes) {bytesPerIteration = bytes;}
+
+    /**
+     * @brief Marks the case as not runnable, for instance because a file it reads is missing.
+     */
+    void skip(const char* reason) {skipped = reason;}
+};
+
+typedef void (*BenchFunction)(State&);
+
+struct Case
+{
+    const char*         name;
+    BenchFunction       function;
+};
+
+/**
+ * @brief List of every registered benchmark.
+ */
+std::vector<Case>& registry();
+
+struct Registrar
+{
+    Registrar(const char* name, BenchFunction function)
+    {
+        Case c = {name, function};
+        registry().push_back(c);
+    }
+};
+
+/**
+ * @brief Allocations made through the global operator new since the program started, on every thread.
+ * Always 0 if they can't be counted (see benchmain.cpp).
+ */
+unsigned long long allocationCount();
+
+/**
+ * @brief Keeps the compiler from optimizing away a computed value.
+ */
+template<typename T>
+inline void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief Keeps the compiler from optimizing away writes to memory.
+ */
+inline void clobberMemory()
+{
+    asm volatile("" : : : "memory");
+}
+
+}
+
+#define WHIMSY_BENCHMARK(NAME) \
+    static void NAME(whimsybench::State& state); \
+    static whimsybench::Registrar NAME##_registrar(#NAME, NAME); \
+    static void NAME(whimsybench::State& state)
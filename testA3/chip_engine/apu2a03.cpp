@@ -0,0 +1,614 @@
+#include "apu2a03.h"
+
+#include <cmath>
+#include <cstring>
+
+// 16.16 fixed point.
+#define APU2A03_FIXED_SHIFT     16
+
+// Duty sequences, one bit per step, step 0 in bit 0.
+static const uint8_t square_duties[4] = {0x02, 0x06, 0x1E, 0xF9};
+
+static const uint8_t triangle_sequence[32] =
+{
+    15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15
+};
+
+// NTSC periods, in CPU cycles.
+static const uint16_t noise_periods[16] = {4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068};
+static const uint16_t dpcm_rates[16] =    {428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54};
+
+static uint16_t timerPeriod(float frequency, double cyclesperstep)
+{
+    if(frequency <= 0.0f)
+        return 2047;
+
+    const double period = APU2A03_CPU_CLOCK / (cyclesperstep * frequency) - 1.0;
+
+    if(period < 0.0)
+        return 0;
+    if(period > 2047.0)
+        return 2047;
+    return (uint16_t)(period + 0.5);
+}
+
+/**
+ * @brief Pulse render loop, shared by Apu2A03Square and its plain state mixVoice(). Fading, every sample is multiplied
+ * by `gain`, which goes down by `gainstep`; otherwise `gain` is left alone, so channels render exactly as before.
+ */
+template<bool accumulate, bool fading>
+static inline void squareLoop(float* out, unsigned long frames, uint32_t cyclestep, uint32_t period, uint8_t pattern,
+                              float scale, uint32_t& counter, uint32_t& step, float& gain, float gainstep)
+{
+    uint32_t    high =  0u - ((pattern >> step) & 1);   // All ones while the output is high.
+    float       g =     gain;
+
+    for(unsigned long i = 0; i < frames; i++)
+    {
+        uint32_t    remaining = cyclestep;
+        uint32_t    sum =       0;
+
+        while(counter <= remaining)
+        {
+            sum +=          counter & high;
+            remaining -=    counter;
+            step =          (step + 1) & 7;
+            high =          0u - ((pattern >> step) & 1);
+            counter =       period;
+        }
+
+        sum +=      remaining & high;
+        counter -=  remaining;
+
+        float sample = (float)sum * scale;
+        if(fading)
+        {
+            sample *=   g;
+            g -=        gainstep;
+        }
+        out[i] = accumulate ? out[i] + sample : sample;
+    }
+
+    gain = g;
+}
+
+/**
+ * @brief Triangle render loop, shared by Apu2A03Triangle and its mixVoice(). See squareLoop().
+ */
+template<bool accumulate, bool fading>
+static inline void triangleLoop(float* out, unsigned long frames, uint32_t cyclestep, uint32_t period, float scale,
+                                uint32_t& counter, uint32_t& step, float& gain, float gainstep)
+{
+    uint32_t    level = triangle_sequence[step];
+    float       g =     gain;
+
+    for(unsigned long i = 0; i < frames; i++)
+    {
+        uint32_t    remaining = cyclestep;
+        uint32_t    sum =       0;
+
+        while(counter <= remaining)
+        {
+            sum +=          counter * level;
+            remaining -=    counter;
+            step =          (step + 1) & 31;
+            level =         triangle_sequence[step];
+            counter =       period;
+        }
+
+        sum +=      remaining * level;
+        counter -=  remaining;
+
+        float sample = (float)sum * scale;
+        if(fading)
+        {
+            sample *=   g;
+            g -=        gainstep;
+        }
+        out[i] = accumulate ? out[i] + sample : sample;
+    }
+
+    gain = g;
+}
+
+/**
+ * @brief Runs a timer for `cycles` fixed point CPU cycles, as the render loops do one sample at a time.
+ * @return  How many times it expired.
+ */
+static uint64_t runTimer(uint32_t& counter, uint64_t cycles, uint32_t period)
+{
+    if(cycles < counter)
+    {
+        counter -= (uint32_t)cycles;
+        return 0;
+    }
+
+    cycles -= counter;
+    counter = period - (uint32_t)(cycles % period);
+    return 1 + cycles / period;
+}
+
+Apu2A03Channel::Apu2A03Channel(float samplerate, float gain) :
+    _gain(gain)
+{
+    setSampleRate(samplerate);
+}
+
+void Apu2A03Channel::setSampleRate(float samplerate)
+{
+    _cyclestep =    cycleStep(samplerate);
+    _scale =        _gain / (float)_cyclestep;
+}
+
+uint32_t Apu2A03Channel::cycleStep(float samplerate)
+{
+    return (uint32_t)(APU2A03_CPU_CLOCK / samplerate * (double)(1 << APU2A03_FIXED_SHIFT) + 0.5);
+}
+
+// Square
+
+Apu2A03Square::Apu2A03Square(float samplerate) :
+    Apu2A03Channel(samplerate, APU2A03_SQUARE_GAIN),
+    _period(0x1FC),
+    _duty(2),
+    _volume(15),
+    _step(0),
+    _counter(0)
+{
+    restart();
+}
+
+void Apu2A03Square::setPeriod(uint16_t period)
+{
+    _period = period & 0x7FF;
+}
+
+uint16_t Apu2A03Square::getPeriod() const
+{
+    return _period;
+}
+
+void Apu2A03Square::setFrequency(float frequency)
+{
+    setPeriod(periodForFrequency(frequency));
+}
+
+uint16_t Apu2A03Square::periodForFrequency(float frequency)
+{
+    return timerPeriod(frequency, 16.0);
+}
+
+uint32_t Apu2A03Square::stepCycles(uint16_t period)
+{
+    return ((uint32_t)(period & 0x7FF) + 1) << (APU2A03_FIXED_SHIFT + 1);
+}
+
+void Apu2A03Square::setDuty(uint8_t duty)
+{
+    _duty = duty & 3;
+}
+
+void Apu2A03Square::setVolume(uint8_t volume)
+{
+    _volume = volume & 15;
+}
+
+void Apu2A03Square::restart()
+{
+    _step =     0;
+    _counter =  stepCycles(_period);
+}
+
+template<bool accumulate>
+void Apu2A03Square::renderBlock(float* out, unsigned long frames)
+{
+    if(_volume == 0 || _period < 8)
+    {
+        if(!accumulate)
+            std::memset(out, 0, frames * sizeof(float));
+        return;
+    }
+
+    uint32_t    counter =   _counter;
+    uint32_t    step =      _step;
+    float       gain =      1.0f;
+
+    squareLoop<accumulate, false>(out, frames, _cyclestep, stepCycles(_period), square_duties[_duty],
+                                  _scale * (float)_volume, counter, step, gain, 0.0f);
+
+    _counter =  counter;
+    _step =     (uint8_t)step;
+}
+
+void Apu2A03Square::render(float* out, unsigned long frames)
+{
+    renderBlock<false>(out, frames);
+}
+
+void Apu2A03Square::mix(float* out, unsigned long frames)
+{
+    renderBlock<true>(out, frames);
+}
+
+void Apu2A03Square::skip(unsigned long frames)
+{
+    if(_volume == 0 || _period < 8)
+        return;
+
+    _step = (uint8_t)((_step + runTimer(_counter, (uint64_t)frames * _cyclestep, stepCycles(_period))) & 7);
+}
+
+void Apu2A03Square::mixVoice(float* out, unsigned long frames, uint32_t cyclestep, uint32_t stepcycles, uint8_t duty,
+                             float scale, uint32_t& counter, uint8_t& step, float& gain, float gainstep)
+{
+    uint32_t s = step;
+
+    squareLoop<true, true>(out, frames, cyclestep, stepcycles, square_duties[duty & 3], scale, counter, s, gain,
+                           gainstep);
+    step = (uint8_t)s;
+}
+
+// Triangle
+
+Apu2A03Triangle::Apu2A03Triangle(float samplerate) :
+    Apu2A03Channel(samplerate, APU2A03_TRIANGLE_GAIN),
+    _period(0x1FC),
+    _enabled(true),
+    _step(0),
+    _counter(stepCycles(0x1FC))
+{}
+
+void Apu2A03Triangle::setPeriod(uint16_t period)
+{
+    _period = period & 0x7FF;
+}
+
+uint16_t Apu2A03Triangle::getPeriod() const
+{
+    return _period;
+}
+
+void Apu2A03Triangle::setFrequency(float frequency)
+{
+    setPeriod(periodForFrequency(frequency));
+}
+
+uint16_t Apu2A03Triangle::periodForFrequency(float frequency)
+{
+    return timerPeriod(frequency, 32.0);
+}
+
+uint32_t Apu2A03Triangle::stepCycles(uint16_t period)
+{
+    return ((uint32_t)(period & 0x7FF) + 1) << APU2A03_FIXED_SHIFT;
+}
+
+void Apu2A03Triangle::setEnabled(bool enabled)
+{
+    _enabled = enabled;
+}
+
+bool Apu2A03Triangle::isEnabled() const
+{
+    return _enabled;
+}
+
+template<bool accumulate>
+void Apu2A03Triangle::renderBlock(float* out, unsigned long frames)
+{
+    if(!_enabled)
+    {
+        const float sample = (float)triangle_sequence[_step] * _gain;
+
+        for(unsigned long i = 0; i < frames; i++)
+            out[i] = accumulate ? out[i] + sample : sample;
+        return;
+    }
+
+    uint32_t    counter =   _counter;
+    uint32_t    step =      _step;
+    float       gain =      1.0f;
+
+    triangleLoop<accumulate, false>(out, frames, _cyclestep, stepCycles(_period), _scale, counter, step, gain, 0.0f);
+
+    _counter =  counter;
+    _step =     (uint8_t)step;
+}
+
+void Apu2A03Triangle::render(float* out, unsigned long frames)
+{
+    renderBlock<false>(out, frames);
+}
+
+void Apu2A03Triangle::mix(float* out, unsigned long frames)
+{
+    renderBlock<true>(out, frames);
+}
+
+void Apu2A03Triangle::skip(unsigned long frames)
+{
+    if(!_enabled)
+        return;
+
+    _step = (uint8_t)((_step + runTimer(_counter, (uint64_t)frames * _cyclestep, stepCycles(_period))) & 31);
+}
+
+void Apu2A03Triangle::mixVoice(float* out, unsigned long frames, uint32_t cyclestep, uint32_t stepcycles, float scale,
+                               uint32_t& counter, uint8_t& step, float& gain, float gainstep)
+{
+    uint32_t s = step;
+
+    triangleLoop<true, true>(out, frames, cyclestep, stepcycles, scale, counter, s, gain, gainstep);
+    step = (uint8_t)s;
+}
+
+// Noise
+
+Apu2A03Noise::Apu2A03Noise(float samplerate) :
+    Apu2A03Channel(samplerate, APU2A03_NOISE_GAIN),
+    _periodindex(0),
+    _shortmode(false),
+    _volume(15),
+    _lfsr(1),
+    _counter((uint32_t)noise_periods[0] << APU2A03_FIXED_SHIFT)
+{}
+
+void Apu2A03Noise::setPeriodIndex(uint8_t index)
+{
+    _periodindex = index & 15;
+}
+
+uint8_t Apu2A03Noise::getPeriodIndex() const
+{
+    return _periodindex;
+}
+
+void Apu2A03Noise::setShortMode(bool shortmode)
+{
+    _shortmode = shortmode;
+}
+
+void Apu2A03Noise::setVolume(uint8_t volume)
+{
+    _volume = volume & 15;
+}
+
+template<bool accumulate>
+void Apu2A03Noise::renderBlock(float* out, unsigned long frames)
+{
+    if(_volume == 0)
+    {
+        if(!accumulate)
+            std::memset(out, 0, frames * sizeof(float));
+        return;
+    }
+
+    const uint32_t  period =    (uint32_t)noise_periods[_periodindex] << APU2A03_FIXED_SHIFT;
+    const uint32_t  tap =       _shortmode ? 6 : 1;
+    const float     scale =     _scale * (float)_volume;
+    uint32_t        counter =   _counter;
+    uint32_t        lfsr =      _lfsr;
+    uint32_t        high =      (lfsr & 1) - 1;     // All ones while bit 0 is clear.
+
+    for(unsigned long i = 0; i < frames; i++)
+    {
+        uint32_t    remaining = _cyclestep;
+        uint32_t    sum =       0;
+
+        while(counter <= remaining)
+        {
+            sum +=          counter & high;
+            remaining -=    counter;
+            lfsr =          (lfsr >> 1) | (((lfsr ^ (lfsr >> tap)) & 1) << 14);
+            high =          (lfsr & 1) - 1;
+            counter =       period;
+        }
+
+        sum +=      remaining & high;
+        counter -=  remaining;
+
+        const float sample = (float)sum * scale;
+        out[i] = accumulate ? out[i] + sample : sample;
+    }
+
+    _counter =  counter;
+    _lfsr =     (uint16_t)lfsr;
+}
+
+void Apu2A03Noise::render(float* out, unsigned long frames)
+{
+    renderBlock<false>(out, frames);
+}
+
+void Apu2A03Noise::mix(float* out, unsigned long frames)
+{
+    renderBlock<true>(out, frames);
+}
+
+void Apu2A03Noise::skip(unsigned long frames)
+{
+    if(_volume == 0)
+        return;
+
+    const uint32_t  period =    (uint32_t)noise_periods[_periodindex] << APU2A03_FIXED_SHIFT;
+    const uint32_t  tap =       _shortmode ? 6 : 1;
+    uint64_t        clocks =    runTimer(_counter, (uint64_t)frames * _cyclestep, period);
+    uint32_t        lfsr =      _lfsr;
+
+    // Every state lies on a cycle of 32767 steps in long mode, and of 93 or 31 in short mode.
+    clocks %= _shortmode ? 93 : 32767;
+
+    for(uint64_t c = 0; c < clocks; c++)
+        lfsr = (lfsr >> 1) | (((lfsr ^ (lfsr >> tap)) & 1) << 14);
+
+    _lfsr = (uint16_t)lfsr;
+}
+
+// DPCM
+
+Apu2A03DPCM::Apu2A03DPCM(float samplerate) :
+    Apu2A03Channel(samplerate, APU2A03_DPCM_GAIN),
+    _data(NULL),
+    _length(0),
+    _position(0),
+    _rateindex(15),
+    _loop(false),
+    _playing(false),
+    _delta(64),
+    _shift(0),
+    _bits(0),
+    _counter((uint32_t)dpcm_rates[15] << APU2A03_FIXED_SHIFT)
+{}
+
+void Apu2A03DPCM::setSample(const uint8_t* data, size_t length)
+{
+    _data =     data;
+    _length =   (data != NULL) ? length : 0;
+    stop();
+}
+
+void Apu2A03DPCM::setRateIndex(uint8_t index)
+{
+    _rateindex = index & 15;
+}
+
+void Apu2A03DPCM::setLoop(bool loop)
+{
+    _loop = loop;
+}
+
+void Apu2A03DPCM::setDeltaCounter(uint8_t value)
+{
+    _delta = value & 127;
+}
+
+uint8_t Apu2A03DPCM::getDeltaCounter() const
+{
+    return _delta;
+}
+
+void Apu2A03DPCM::play()
+{
+    _position = 0;
+    _bits =     0;
+    _playing =  (_length > 0);
+}
+
+void Apu2A03DPCM::stop()
+{
+    _playing =  false;
+    _bits =     0;
+}
+
+bool Apu2A03DPCM::isPlaying() const
+{
+    return _playing;
+}
+
+void Apu2A03DPCM::clockBit()
+{
+    if(_bits == 0)
+    {
+        if(!_playing)
+            return;
+
+        if(_position >= _length)
+        {
+            if(!_loop)
+            {
+                _playing = false;
+                return;
+            }
+            _position = 0;
+        }
+
+        _shift =    _data[_position++];
+        _bits =     8;
+    }
+
+    if(_shift & 1)
+    {
+        if(_delta <= 125)
+            _delta += 2;
+    }
+    else if(_delta >= 2)
+        _delta -= 2;
+
+    _shift >>= 1;
+    _bits--;
+}
+
+template<bool accumulate>
+void Apu2A03DPCM::renderBlock(float* out, unsigned long frames)
+{
+    // Silent: the counter holds its level, and only the timer runs. The level is scaled as in the loop below, so a
+    // sample ending inside a block sounds the same wherever the blocks are cut.
+    if(!_playing && _bits == 0)
+    {
+        const float sample = (float)(_cyclestep * _delta) * _scale;
+
+        runTimer(_counter, (uint64_t)frames * _cyclestep, (uint32_t)dpcm_rates[_rateindex] << APU2A03_FIXED_SHIFT);
+
+        for(unsigned long i = 0; i < frames; i++)
+            out[i] = accumulate ? out[i] + sample : sample;
+        return;
+    }
+
+    const uint32_t  period =    (uint32_t)dpcm_rates[_rateindex] << APU2A03_FIXED_SHIFT;
+    uint32_t        counter =   _counter;
+
+    for(unsigned long i = 0; i < frames; i++)
+    {
+        uint32_t    remaining = _cyclestep;
+        uint32_t    sum =       0;
+
+        while(counter <= remaining)
+        {
+            sum +=          counter * _delta;
+            remaining -=    counter;
+            clockBit();
+            counter =       period;
+        }
+
+        sum +=      remaining * _delta;
+        counter -=  remaining;
+
+        const float sample = (float)sum * _scale;
+        out[i] = accumulate ? out[i] + sample : sample;
+    }
+
+    _counter = counter;
+}
+
+void Apu2A03DPCM::render(float* out, unsigned long frames)
+{
+    renderBlock<false>(out, frames);
+}
+
+void Apu2A03DPCM::mix(float* out, unsigned long frames)
+{
+    renderBlock<true>(out, frames);
+}
+
+void Apu2A03DPCM::skip(unsigned long frames)
+{
+    const uint32_t  period =    (uint32_t)dpcm_rates[_rateindex] << APU2A03_FIXED_SHIFT;
+    uint64_t        cycles =    (uint64_t)frames * _cyclestep;
+
+    // Bit by bit while the sample plays, then in one step.
+    while(_playing || _bits != 0)
+    {
+        if(cycles < _counter)
+        {
+            _counter -= (uint32_t)cycles;
+            return;
+        }
+
+        cycles -=   _counter;
+        _counter =  period;
+        clockBit();
+    }
+
+    runTimer(_counter, cycles, period);
+}
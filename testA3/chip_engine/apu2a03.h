@@ -0,0 +1,271 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// NTSC 2A03 CPU clock, in Hz. Every APU timer counts CPU cycles (the pulse ones, every other cycle).
+#define APU2A03_CPU_CLOCK       1789773.0
+
+// Linear approximation of the APU mixer: output of one DAC step of every channel.
+#define APU2A03_SQUARE_GAIN     0.00752f
+#define APU2A03_TRIANGLE_GAIN   0.00851f
+#define APU2A03_NOISE_GAIN      0.00494f
+#define APU2A03_DPCM_GAIN       0.00335f
+
+/**
+ * @brief Common part of the 2A03 APU channels: block rendering at any sample rate.
+ *
+ * Channels are emulated at the CPU clock and box-filtered down to the sample rate. Every output sample is the average
+ * of the channel's level along the CPU cycles it covers, computed in 16.16 fixed point by jumping from one timer
+ * expiry to the next, so the cost depends on how often the waveform changes, not on the CPU clock. Between two
+ * expiries nothing is computed.
+ *
+ * Levels are the unipolar DAC values of the real chip (0 to 15, 0 to 127 for DPCM), scaled with the linear
+ * approximation of the APU mixer, so any number of channels can be summed and the full chip peaks below 1.0. The
+ * console AC-couples its output; highpass the mix to remove the DC offset (see TrackerStream).
+ *
+ * Not thread safe: configure a channel from the thread that renders it.
+ */
+class Apu2A03Channel
+{
+protected:
+    uint32_t    _cyclestep;     // CPU cycles per output sample, 16.16 fixed point.
+    float       _gain;          // Mixer weight of one DAC step.
+    float       _scale;         // _gain over _cyclestep, to turn fixed point level sums into samples.
+
+public:
+    Apu2A03Channel(float samplerate, float gain);
+    virtual ~Apu2A03Channel() {}
+
+    void            setSampleRate(float samplerate);
+
+    /**
+     * @brief CPU cycles per output sample, in the 16.16 fixed point the render loops count in.
+     */
+    static uint32_t cycleStep(float samplerate);
+
+    /**
+     * @brief Renders `frames` mono samples into `out`, overwriting it.
+     */
+    virtual void    render(float* out, unsigned long frames) = 0;
+
+    /**
+     * @brief Same as render(), but adds the samples to what `out` already holds.
+     */
+    virtual void    mix(float* out, unsigned long frames) = 0;
+
+    /**
+     * @brief Leaves the channel exactly as render() would, without computing any sample. Timers are advanced in one
+     * step, so this is much cheaper than rendering (the DPCM channel still walks the bits it plays).
+     */
+    virtual void    skip(unsigned long frames) = 0;
+};
+
+/**
+ * @brief Pulse channel ($4000-$4007): an 8 step duty sequencer clocked every 2 * (period + 1) CPU cycles, and a
+ * constant 4 bit volume. Periods below 8 are muted, as the sweep unit of the real chip does.
+ */
+class Apu2A03Square : public Apu2A03Channel
+{
+private:
+    uint16_t    _period;
+    uint8_t     _duty;
+    uint8_t     _volume;
+    uint8_t     _step;
+    uint32_t    _counter;       // Fixed point CPU cycles left in the current step.
+
+    template<bool accumulate> void  renderBlock(float* out, unsigned long frames);
+
+public:
+    Apu2A03Square(float samplerate = 44100.0f);
+
+    /**
+     * @brief Timer period, 11 bits. The tone is CPU_CLOCK / (16 * (period + 1)).
+     */
+    void        setPeriod(uint16_t period);
+    uint16_t    getPeriod() const;
+
+    /**
+     * @brief Sets the nearest timer period for a frequency, in Hz.
+     */
+    void        setFrequency(float frequency);
+
+    /**
+     * @brief Duty cycle, 0 to 3: 12.5%, 25%, 50% and 25% negated.
+     */
+    void        setDuty(uint8_t duty);
+    void        setVolume(uint8_t volume);
+
+    /**
+     * @brief Restarts the duty sequence, as writing $4003 does.
+     */
+    void        restart();
+
+    void    render(float* out, unsigned long frames);
+    void    mix(float* out, unsigned long frames);
+    void    skip(unsigned long frames);
+
+    /**
+     * @brief Timer period setFrequency() sets for a frequency, in Hz. Periods below 8 are muted.
+     */
+    static uint16_t periodForFrequency(float frequency);
+
+    /**
+     * @brief Fixed point CPU cycles of one sequencer step, for a timer period. Also the timer's value after restart().
+     */
+    static uint32_t stepCycles(uint16_t period);
+
+    /**
+     * @brief The render loop on plain state, for voices kept outside of any channel object (VoicePool keeps them as
+     * structure of arrays). Adds `frames` samples to `out`, each one times `gain`, which goes down by `gainstep` after
+     * every sample. It doesn't check the volume nor mute low periods.
+     * @param cyclestep     See cycleStep().
+     * @param stepcycles    See stepCycles().
+     * @param scale         Level of a high output: APU2A03_SQUARE_GAIN * volume / cyclestep.
+     * @param counter       Timer, updated.
+     * @param step          Sequencer step, 0 to 7, updated.
+     */
+    static void     mixVoice(float* out, unsigned long frames, uint32_t cyclestep, uint32_t stepcycles, uint8_t duty,
+                             float scale, uint32_t& counter, uint8_t& step, float& gain, float gainstep);
+};
+
+/**
+ * @brief Triangle channel ($4008-$400B): a 32 step sequencer clocked every period + 1 CPU cycles. It has no volume;
+ * when it's disabled the sequencer stops and holds its level, as the linear counter does on the real chip.
+ */
+class Apu2A03Triangle : public Apu2A03Channel
+{
+private:
+    uint16_t    _period;
+    bool        _enabled;
+    uint8_t     _step;
+    uint32_t    _counter;
+
+    template<bool accumulate> void  renderBlock(float* out, unsigned long frames);
+
+public:
+    Apu2A03Triangle(float samplerate = 44100.0f);
+
+    /**
+     * @brief Timer period, 11 bits. The tone is CPU_CLOCK / (32 * (period + 1)).
+     */
+    void        setPeriod(uint16_t period);
+    uint16_t    getPeriod() const;
+    void        setFrequency(float frequency);
+
+    void        setEnabled(bool enabled);
+    bool        isEnabled() const;
+
+    void    render(float* out, unsigned long frames);
+    void    mix(float* out, unsigned long frames);
+    void    skip(unsigned long frames);
+
+    /**
+     * @brief Timer period setFrequency() sets for a frequency, in Hz.
+     */
+    static uint16_t periodForFrequency(float frequency);
+
+    /**
+     * @brief Fixed point CPU cycles of one sequencer step, for a timer period.
+     */
+    static uint32_t stepCycles(uint16_t period);
+
+    /**
+     * @brief Same as Apu2A03Square::mixVoice(), for an enabled triangle. `scale` is APU2A03_TRIANGLE_GAIN / cyclestep;
+     * `step` goes from 0 to 31.
+     */
+    static void     mixVoice(float* out, unsigned long frames, uint32_t cyclestep, uint32_t stepcycles, float scale,
+                             uint32_t& counter, uint8_t& step, float& gain, float gainstep);
+};
+
+/**
+ * @brief Noise channel ($400C-$400F): a 15 bit linear feedback shift register clocked by one of 16 periods. In long
+ * mode the feedback is bit 0 xor bit 1 (32767 step sequence); in short mode it's bit 0 xor bit 6 (93 or 31 steps),
+ * which sounds metallic. The channel outputs its volume while bit 0 is clear.
+ */
+class Apu2A03Noise : public Apu2A03Channel
+{
+private:
+    uint8_t     _periodindex;
+    bool        _shortmode;
+    uint8_t     _volume;
+    uint16_t    _lfsr;
+    uint32_t    _counter;
+
+    template<bool accumulate> void  renderBlock(float* out, unsigned long frames);
+
+public:
+    Apu2A03Noise(float samplerate = 44100.0f);
+
+    /**
+     * @brief Index in the NTSC period table, 0 to 15. 0 is the highest pitch.
+     */
+    void        setPeriodIndex(uint8_t index);
+    uint8_t     getPeriodIndex() const;
+
+    void        setShortMode(bool shortmode);
+    void        setVolume(uint8_t volume);
+
+    void    render(float* out, unsigned long frames);
+    void    mix(float* out, unsigned long frames);
+    void    skip(unsigned long frames);
+};
+
+/**
+ * @brief Delta modulation channel ($4010-$4013). Sample bytes are read LSB first; every bit moves the 7 bit delta
+ * counter 2 steps up (1) or down (0), unless that would take it out of 0..127. Bits are clocked by one of 16 rates.
+ *
+ * When the sample ends, the channel restarts it if looping, or falls silent holding the last counter value; its timer
+ * keeps running, as on the chip, so the next sample starts in step whatever the block sizes were. The
+ * sample data is not copied and must outlive the channel (or the next setSample() call).
+ */
+class Apu2A03DPCM : public Apu2A03Channel
+{
+private:
+    const uint8_t*  _data;
+    size_t          _length;
+    size_t          _position;
+
+    uint8_t         _rateindex;
+    bool            _loop;
+    bool            _playing;
+    uint8_t         _delta;
+    uint8_t         _shift;
+    uint8_t         _bits;
+    uint32_t        _counter;
+
+    void    clockBit();
+    template<bool accumulate> void  renderBlock(float* out, unsigned long frames);
+
+public:
+    Apu2A03DPCM(float samplerate = 44100.0f);
+
+    /**
+     * @brief Sets the 1 bit delta encoded sample to play. Real DPCM samples are 16 * n + 1 bytes long, but any length
+     * is accepted.
+     */
+    void        setSample(const uint8_t* data, size_t length);
+
+    /**
+     * @brief Index in the NTSC rate table, 0 to 15. 15 is the fastest, 33.1kHz.
+     */
+    void        setRateIndex(uint8_t index);
+    void        setLoop(bool loop);
+
+    /**
+     * @brief Loads the delta counter directly, as writing $4011 does. 0 to 127.
+     */
+    void        setDeltaCounter(uint8_t value);
+    uint8_t     getDeltaCounter() const;
+
+    /**
+     * @brief Starts the sample from its beginning.
+     */
+    void        play();
+    void        stop();
+    bool        isPlaying() const;
+
+    void    render(float* out, unsigned long frames);
+    void    mix(float* out, unsigned long frames);
+    void    skip(unsigned long frames);
+};
@@ -0,0 +1,280 @@
+#include "samplebank.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Disk cache file header: magic, format version.
+#define SAMPLEBANK_CACHE_MAGIC      0x504D5357u     // "WSMP"
+#define SAMPLEBANK_CACHE_VERSION    1u
+
+// PCM alignment, in floats.
+#define SAMPLEBANK_ALIGN_FLOATS     4
+
+using namespace whimsycore;
+
+DecodedSample::DecodedSample() :
+    _hash(0),
+    _pcm(NULL),
+    _pcmlength(0)
+{}
+
+void DecodedSample::allocatePCM(size_t length)
+{
+    const size_t padded = (length + SAMPLEBANK_ALIGN_FLOATS - 1) & ~(size_t)(SAMPLEBANK_ALIGN_FLOATS - 1);
+
+    // Room to slide the start up to the next 16 byte boundary.
+    _pcmstorage.assign(padded + SAMPLEBANK_ALIGN_FLOATS, 0.0f);
+
+    const uintptr_t base = (uintptr_t)&(_pcmstorage[0]);
+    _pcm =          (float*)((base + 15) & ~(uintptr_t)15);
+    _pcmlength =    length;
+}
+
+size_t DecodedSample::decodedLength(const std::string& type, size_t rawsize)
+{
+    // NES-DPCM holds one delta per bit, anything else one signed 8 bit sample per byte.
+    return (type == "NES-DPCM") ? rawsize * 8 : rawsize;
+}
+
+void DecodedSample::decode()
+{
+    if(_type == "NES-DPCM")
+    {
+        int level = 64;
+
+        allocatePCM(decodedLength(_type, _raw.size()));
+
+        for(size_t i = 0; i < _raw.size(); i++)
+        {
+            for(int b = 0; b < 8; b++)
+            {
+                if((_raw[i] >> b) & 1)
+                {
+                    if(level <= 125)
+                        level += 2;
+                }
+                else if(level >= 2)
+                    level -= 2;
+
+                _pcm[i * 8 + b] = (float)(level - 64) / 64.0f;
+            }
+        }
+    }
+    else
+    {
+        allocatePCM(decodedLength(_type, _raw.size()));
+
+        for(size_t i = 0; i < _raw.size(); i++)
+            _pcm[i] = (float)(int8_t)_raw[i] / 128.0f;
+    }
+}
+
+SampleBank::SampleBank() :
+    _decoded(0),
+    _cachehits(0)
+{}
+
+void SampleBank::setCacheDirectory(const std::string& directory)
+{
+    _cachedir = directory;
+}
+
+uint64_t SampleBank::contentHash(const void* data, size_t length, uint64_t seed)
+{
+    const uint8_t*  bytes = (const uint8_t*)data;
+    uint64_t        hash =  seed;
+
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+std::string SampleBank::cachePath(uint64_t hash) const
+{
+    char name[32];
+
+    std::snprintf(name, sizeof(name), "%016llx.wsmp", (unsigned long long)hash);
+    return _cachedir + "/" + name;
+}
+
+bool SampleBank::readCache(DecodedSample& sample) const
+{
+    uint32_t    header[2];
+    uint64_t    sizes[3];
+    long        filesize;
+    bool        ok;
+
+    std::FILE* fhandler = std::fopen(cachePath(sample._hash).c_str(), "rb");
+    if(!fhandler)
+        return false;
+
+    std::fseek(fhandler, 0, SEEK_END);
+    filesize = std::ftell(fhandler);
+    std::fseek(fhandler, 0, SEEK_SET);
+
+    ok =    std::fread(header, sizeof(header), 1, fhandler) == 1 && std::fread(sizes, sizeof(sizes), 1, fhandler) == 1 &&
+            header[0] == SAMPLEBANK_CACHE_MAGIC && header[1] == SAMPLEBANK_CACHE_VERSION && sizes[0] == sample._hash;
+
+    // A truncated or corrupted file must not make us allocate, or hand out, whatever its counts say: they must match
+    // what decoding the bytes would give, and the file must be exactly that long. Otherwise, the sample is decoded
+    // again.
+    ok =    ok && filesize >= 0 && sizes[1] <= (uint64_t)filesize &&
+            sizes[2] == DecodedSample::decodedLength(sample._type, (size_t)sizes[1]) &&
+            (uint64_t)filesize == sizeof(header) + sizeof(sizes) + sizes[1] + sizes[2] * sizeof(float);
+
+    if(ok)
+    {
+        sample._raw.resize((size_t)sizes[1]);
+        sample.allocatePCM((size_t)sizes[2]);
+
+        ok =    (sample._raw.empty() || std::fread(&(sample._raw[0]), sample._raw.size(), 1, fhandler) == 1) &&
+                (sample._pcmlength == 0 || std::fread(sample._pcm, sample._pcmlength * sizeof(float), 1, fhandler) == 1);
+    }
+
+    std::fclose(fhandler);
+
+    if(!ok)
+    {
+        sample._raw.clear();
+        sample.allocatePCM(0);
+    }
+    return ok;
+}
+
+void SampleBank::writeCache(const DecodedSample& sample) const
+{
+    const uint32_t  header[2] = {SAMPLEBANK_CACHE_MAGIC, SAMPLEBANK_CACHE_VERSION};
+    const uint64_t  sizes[3] =  {sample._hash, sample._raw.size(), sample._pcmlength};
+
+    // The cache is an optimization: failing to write it is not an error.
+    std::FILE* fhandler = std::fopen(cachePath(sample._hash).c_str(), "wb");
+    if(!fhandler)
+        return;
+
+    std::fwrite(header, sizeof(header), 1, fhandler);
+    std::fwrite(sizes, sizeof(sizes), 1, fhandler);
+    if(!sample._raw.empty())
+        std::fwrite(&(sample._raw[0]), sample._raw.size(), 1, fhandler);
+    if(sample._pcmlength > 0)
+        std::fwrite(sample._pcm, sample._pcmlength * sizeof(float), 1, fhandler);
+
+    std::fclose(fhandler);
+}
+
+void SampleBank::load(const Variant& file)
+{
+    std::vector<SamplePointer>  byindex;
+    const Variant*              list =  NULL;
+
+    if(file.keyExists("samples") && file.hashtableReference().at("samples").keyExists("sample"))
+        list = &(file.hashtableReference().at("samples").hashtableReference().at("sample"));
+
+    for(size_t i = 0; list != NULL && list->typeID() == Variant::VariantArray && i < list->size(); i++)
+    {
+        const Variant& entry = list->arrayReference()[i];
+        if(!entry.keyExists("index") || !entry.keyExists("data"))
+            throw Exception(NULL, Exception::FieldDoesNotExist, "Sample without index or data.");
+
+        const std::map<std::string, Variant>&   fields =    entry.hashtableReference();
+        const Variant&                          data =      fields.at("data");
+        const int                               index =     fields.at("index").intValue();
+        const std::string                       type =      entry.keyExists("type") ? fields.at("type").stringValue() : std::string();
+        const uint8_t*                          stored;
+        size_t                                  storedsize;
+
+        // Blobs were decoded by the parser already. Strings still hold their hex ("#") or base64 ("=") text.
+        if(data.typeID() == Variant::BinaryBlob)
+        {
+            storedsize =    data.binaryblobReference().size();
+            stored =        (storedsize > 0) ? data.binaryblobReference().begin() : NULL;
+        }
+        else if(data.typeID() == Variant::String)
+        {
+            stored =        (const uint8_t*)data.stringReference().c_str();
+            storedsize =    data.stringReference().size();
+        }
+        else
+            throw Exception(NULL, Exception::InvalidConversion, "Sample data is not binary nor a string.");
+
+        if(index < 0)
+            throw Exception(NULL, Exception::ArrayOutOfBounds, "Negative sample index.");
+
+        const uint64_t hash = contentHash(stored, storedsize, contentHash(type.c_str(), type.size() + 1));
+        SamplePointer& shared = _byhash[hash];
+
+        if(!shared)
+        {
+            DecodedSample* sample = new DecodedSample();
+            SamplePointer  owner(sample);
+
+            sample->_name = entry.keyExists("name") ? fields.at("name").stringValue() : std::string();
+            sample->_type = type;
+            sample->_hash = hash;
+
+            if(!_cachedir.empty() && readCache(*sample))
+                _cachehits++;
+            else
+            {
+                if(data.typeID() == Variant::BinaryBlob)
+                    sample->_raw.assign(stored, stored + storedsize);
+                else
+                {
+                    const char* text = data.stringReference().c_str();
+
+                    if(text[0] == '#' || text[0] == '=')
+                    {
+                        ByteStream decoded;
+
+                        if(text[0] == '#')
+                            decoded.hexDecode(text + 1);
+                        else
+                            decoded.base64Decode(text + 1);
+
+                        if(decoded.size() > 0)
+                            sample->_raw.assign(decoded.begin(), decoded.end());
+                    }
+                    else
+                        sample->_raw.assign(stored, stored + storedsize);
+                }
+
+                sample->decode();
+                _decoded++;
+
+                if(!_cachedir.empty())
+                    writeCache(*sample);
+            }
+
+            shared = owner;
+        }
+
+        if((size_t)index >= byindex.size())
+            byindex.resize(index + 1);
+        byindex[index] = shared;
+    }
+
+    _byindex.swap(byindex);
+}
+
+unsigned int SampleBank::size() const
+{
+    return (unsigned int)_byindex.size();
+}
+
+unsigned int SampleBank::uniqueCount() const
+{
+    return (unsigned int)_byhash.size();
+}
+
+unsigned int SampleBank::decodedCount() const
+{
+    return _decoded;
+}
+
+unsigned int SampleBank::cacheHits() const
+{
+    return _cachehits;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "../whimsycore.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * @brief A sample of a song file, decoded once. Holds both the bytes as stored in the song (which the 2A03 DPCM
+ * channel plays bit by bit) and their PCM decoding, in a 16 byte aligned float array.
+ *
+ * NES-DPCM samples decode to one PCM sample per bit, from -1.0 to 1.0, as the delta counter would output them
+ * starting from its middle value. Any other type is read as signed 8 bit PCM.
+ *
+ * Instances are immutable once built and are shared: voices keep plain pointers to them, which stay valid as long
+ * as the SampleBank that made them.
+ */
+class DecodedSample
+{
+    friend class SampleBank;
+
+private:
+    std::string             _name;
+    std::string             _type;
+    uint64_t                _hash;
+
+    std::vector<uint8_t>    _raw;
+    std::vector<float>      _pcmstorage;
+    float*                  _pcm;
+    size_t                  _pcmlength;
+
+    DecodedSample(const DecodedSample&);
+    DecodedSample& operator=(const DecodedSample&);
+
+    void    allocatePCM(size_t length);
+    void    decode();
+
+    /**
+     * @brief PCM frames that decode() makes of `rawsize` bytes of a sample of type `type`.
+     */
+    static size_t   decodedLength(const std::string& type, size_t rawsize);
+
+public:
+    DecodedSample();
+
+    const std::string&  name() const {return _name;}
+    const std::string&  type() const {return _type;}
+
+    /**
+     * @brief Hash of the type and the stored bytes. Equal samples share one DecodedSample.
+     */
+    uint64_t            hash() const {return _hash;}
+
+    const uint8_t*      data() const {return _raw.empty() ? NULL : &(_raw[0]);}
+    size_t              size() const {return _raw.size();}
+
+    /**
+     * @brief Decoded PCM. 16 byte aligned, and padded with silence up to a multiple of 4 samples.
+     */
+    const float*        pcm() const {return _pcm;}
+    size_t              pcmLength() const {return _pcmlength;}
+};
+
+/**
+ * @brief Decodes the "samples" section of a song file, once, and hands out shared read-only samples by index.
+ *
+ * Samples are deduplicated by content hash, so several indices holding the same data share one decoding. With a
+ * cache directory, every decoded sample is also written there, named after its hash; loading a file whose samples
+ * are already cached reads them back instead of decoding them (including the hex or base64 text of samples stored
+ * as plain strings).
+ *
+ * Loading is meant for setup code. Reading samples (sample(), and the DecodedSample getters) never allocates.
+ */
+class SampleBank
+{
+private:
+    typedef std::shared_ptr<const DecodedSample>    SamplePointer;
+
+    std::vector<SamplePointer>              _byindex;
+    std::map<uint64_t, SamplePointer>       _byhash;
+    std::string                             _cachedir;
+
+    unsigned int                            _decoded, _cachehits;
+
+    std::string     cachePath(uint64_t hash) const;
+    bool            readCache(DecodedSample& sample) const;
+    void            writeCache(const DecodedSample& sample) const;
+
+public:
+    SampleBank();
+
+    /**
+     * @brief Directory for the disk cache. It must exist. An empty path (the default) disables the cache.
+     */
+    void    setCacheDirectory(const std::string& directory);
+
+    /**
+     * @brief Decodes every sample of a parsed song file (its "samples"/"sample" array), replacing the previous
+     * contents of the bank. Samples already decoded by a previous load() are kept as they are.
+     */
+    void    load(const whimsycore::Variant& file);
+
+    /**
+     * @brief Sample with the given "index", or NULL if there's none.
+     */
+    const DecodedSample*    sample(unsigned int index) const
+    {
+        return (index < _byindex.size()) ? _byindex[index].get() : NULL;
+    }
+
+    /**
+     * @brief One past the highest sample index.
+     */
+    unsigned int    size() const;
+
+    /**
+     * @brief Distinct samples held.
+     */
+    unsigned int    uniqueCount() const;
+
+    /**
+     * @brief Samples decoded, and samples read from the disk cache instead, since the bank was created.
+     */
+    unsigned int    decodedCount() const;
+    unsigned int    cacheHits() const;
+
+    /**
+     * @brief 64 bit FNV-1a hash, chained through `seed`.
+     */
+    static uint64_t contentHash(const void* data, size_t length, uint64_t seed = 14695981039346656037ULL);
+};
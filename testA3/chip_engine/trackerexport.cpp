@@ -0,0 +1,135 @@
+#include "trackerexport.h"
+#include "../portaudio_engine/offlinerendercontext.h"
+#include "../portaudio_engine/denormals.h"
+
+#include <cstdio>
+
+using namespace whimsycore;
+
+TrackerExporter::TrackerExporter(const TrackerSong& song, const SampleBank* samples,
+                                 unsigned int samplerate, unsigned int channels) :
+    _song(&song),
+    _samples(samples),
+    _samplerate(samplerate),
+    _channels(channels > 0 ? channels : 1),
+    _checkpointrows(64),
+    _jobs(NULL),
+    _totalframes(0)
+{}
+
+void TrackerExporter::setCheckpointRows(unsigned int rows)
+{
+    _checkpointrows = (rows > 0) ? rows : 1;
+}
+
+unsigned int TrackerExporter::checkpointRows() const
+{
+    return _checkpointrows;
+}
+
+void TrackerExporter::setJobPool(JobPool* jobs)
+{
+    _jobs = jobs;
+}
+
+size_t TrackerExporter::checkpointCount() const
+{
+    return _checkpoints.size();
+}
+
+void TrackerExporter::controlPass(unsigned long long maxframes)
+{
+    TrackerStream   control(*_song, _samples, _samplerate, _channels);
+    unsigned int    rows = 0;
+
+    control.setLoop(false);
+    control.drainCommands();
+
+    _checkpoints.clear();
+
+    // Tick by tick. A checkpoint is taken right before the first tick of a row is processed.
+    while(control.framePosition() < maxframes)
+    {
+        if(control.framesToNextTick() == 0 && control.sequencer().rowStarts() && rows++ % _checkpointrows == 0)
+            _checkpoints.push_back(control.saveState());
+
+        const unsigned long long    left =  maxframes - control.framePosition();
+        unsigned long               step =  control.framesToNextTick();
+
+        if(step == 0)
+            step = 1;
+        if(step > left)
+            step = (unsigned long)left;
+
+        if(control.skip(step) < step)
+            break;
+    }
+
+    _totalframes = control.framePosition();
+}
+
+void TrackerExporter::renderSegmentJob(void* exporter, unsigned int segment)
+{
+    TrackerExporter*            self =  static_cast<TrackerExporter*>(exporter);
+    const TrackerStream::State& start = self->_checkpoints[segment];
+    const unsigned long long    end =   (segment + 1 < self->_checkpoints.size()) ?
+                                        self->_checkpoints[segment + 1].frame : self->_totalframes;
+    TrackerStream               stream(*self->_song, self->_samples, self->_samplerate, self->_channels);
+
+    stream.restoreState(start);
+
+    for(unsigned long long f = start.frame; f < end; )
+    {
+        const unsigned long block = (end - f > 65536) ? 65536 : (unsigned long)(end - f);
+
+        stream.renderMix(&(self->_mix[f]), block);
+        f += block;
+    }
+}
+
+unsigned long long TrackerExporter::render(std::vector<float>& out, double maxseconds)
+{
+    // Same mode as the audio thread, or the export wouldn't be the samples a TrackerStream plays.
+    DenormalGuard denormalguard;
+
+    controlPass((unsigned long long)(maxseconds * _samplerate));
+
+    _mix.assign(_totalframes, 0.0f);
+
+    if(_jobs != NULL)
+        _jobs->run(renderSegmentJob, this, (unsigned int)_checkpoints.size());
+    else
+    {
+        for(unsigned int s = 0; s < _checkpoints.size(); s++)
+            renderSegmentJob(this, s);
+    }
+
+    // A stream that never rendered has the output stage of one that starts the song.
+    TrackerStream output(*_song, _samples, _samplerate, _channels);
+
+    out.resize(_totalframes * _channels);
+    if(_totalframes > 0)
+        output.finishMix(&(_mix[0]), &(out[0]), (unsigned long)_totalframes);
+
+    std::vector<float>().swap(_mix);
+    return _totalframes;
+}
+
+unsigned long long TrackerExporter::renderToWav(const char* filepath, double maxseconds)
+{
+    std::vector<float>          samples;
+    const unsigned long long    frames =    render(samples, maxseconds);
+    ByteStream                  header =    OfflineRenderContext::wavHeader(_samplerate, _channels, paFloat32,
+                                                                            (unsigned long)(samples.size() * sizeof(float)));
+
+    std::FILE* fhandler = std::fopen(filepath, "wb");
+    if(!fhandler)
+        throw Exception(NULL, Exception::CouldNotOpenFileForWriting, filepath);
+
+    std::fwrite(header.lowLevelData(), header.size(), 1, fhandler);
+    if(!samples.empty())
+        std::fwrite(&(samples[0]), sizeof(float), samples.size(), fhandler);
+    std::fclose(fhandler);
+
+    return frames;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "trackerstream.h"
+
+#include <vector>
+
+/**
+ * @brief Renders a whole song offline, on several threads, with exactly the samples a TrackerStream would play.
+ *
+ * Export goes in three passes:
+ *   1. A control pass plays the song with TrackerStream::skip(), which runs the sequencer, rows and macros but
+ *      renders no audio, and saves a TrackerStream::State every setCheckpointRows() rows.
+ *   2. Every stretch between two checkpoints is rendered by its own TrackerStream, restored from the first one, as a
+ *      mono mix before the output highpass. Stretches are spread over a JobPool.
+ *   3. The mixes, laid end to end, go through the output stage in one go.
+ * The highpass is the only state that depends on the audio itself, so the stitched result is bit for bit the one of
+ * a single stream playing the song from the start.
+ *
+ *     JobPool             jobs;
+ *     TrackerExporter     exporter(song, &samples);
+ *     exporter.setJobPool(&jobs);
+ *     exporter.renderToWav("song.wav");
+ */
+class TrackerExporter
+{
+private:
+    const TrackerSong*  _song;
+    const SampleBank*   _samples;
+    unsigned int        _samplerate, _channels;
+    unsigned int        _checkpointrows;
+    JobPool*            _jobs;
+
+    // Current export, for the segment jobs.
+    std::vector<TrackerStream::State>   _checkpoints;
+    std::vector<float>                  _mix;
+    unsigned long long                  _totalframes;
+
+    void        controlPass(unsigned long long maxframes);
+    static void renderSegmentJob(void* exporter, unsigned int segment);
+
+public:
+    /**
+     * @brief Creates an exporter. The song, and the sample bank if any, must outlive it.
+     */
+    TrackerExporter(const TrackerSong& song, const SampleBank* samples = NULL,
+                    unsigned int samplerate = 44100, unsigned int channels = 2);
+
+    /**
+     * @brief Rows between two checkpoints, and so the length of the stretches rendered in parallel. 64 by default.
+     */
+    void            setCheckpointRows(unsigned int rows);
+    unsigned int    checkpointRows() const;
+
+    /**
+     * @brief Pool the stretches are rendered on. NULL (the default) renders them one after the other.
+     */
+    void            setJobPool(JobPool* jobs);
+
+    /**
+     * @brief Renders the song, without looping, into interleaved float frames.
+     * @param maxseconds    Songs that jump back forever are cut here.
+     * @return              Frames rendered.
+     */
+    unsigned long long  render(std::vector<float>& out, double maxseconds = 600.0);
+
+    /**
+     * @brief Same as render(), into a 32 bit float WAV file. Throws a whimsycore::Exception if it can't be written.
+     */
+    unsigned long long  renderToWav(const char* filepath, double maxseconds = 600.0);
+
+    /**
+     * @brief Checkpoints taken by the last export.
+     */
+    size_t          checkpointCount() const;
+};
@@ -0,0 +1,138 @@
+#include "trackermacro.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TRACKERMACRO_SSE2   1
+#else
+#define TRACKERMACRO_SSE2   0
+#endif
+
+TrackerMacroPlayer::TrackerMacroPlayer(unsigned int voices) :
+    _table(NULL),
+    _voices(voices),
+    _pos(voices * MacroCount),
+    _limit(voices * MacroCount),
+    _wrap(voices * MacroCount),
+    _after(voices * MacroCount),
+    _end(voices * MacroCount),
+    _endwrap(voices * MacroCount),
+    _value(voices * MacroCount),
+    _active(voices * MacroCount)
+{
+    for(unsigned int s = 0; s < _pos.size(); s++)
+        park(s);
+}
+
+void TrackerMacroPlayer::park(unsigned int slot)
+{
+    const int32_t neutral = (int32_t)(slot % MacroCount);
+
+    _pos[slot] =        neutral;
+    _limit[slot] =      neutral + 1;
+    _wrap[slot] =       neutral;
+    _after[slot] =      -1;
+    _end[slot] =        neutral + 1;
+    _endwrap[slot] =    neutral;
+    _value[slot] =      (_table != NULL) ? _table[neutral] : 0;
+    _active[slot] =     0;
+}
+
+void TrackerMacroPlayer::setTable(const int8_t* table)
+{
+    _table = table;
+
+    for(unsigned int s = 0; s < _pos.size(); s++)
+        park(s);
+}
+
+void TrackerMacroPlayer::trigger(unsigned int voice, TrackerMacroType type, const TrackerMacro* macro)
+{
+    const unsigned int slot = voice * MacroCount + type;
+
+    if(macro == NULL || macro->length == 0 || _table == NULL)
+    {
+        park(slot);
+        return;
+    }
+
+    const int32_t   first =     (int32_t)macro->offset;
+    const int32_t   last =      first + macro->length - 1;
+    const int32_t   loop =      (macro->loop >= 0 && macro->loop < macro->length) ? first + macro->loop : -1;
+    const int32_t   release =   (macro->release >= 0 && macro->release < macro->length) ? first + macro->release : -1;
+
+    _pos[slot] =    first;
+    _active[slot] = 1;
+
+    // Once released, or if it never is: to the end, then back to a loop past the release point or hold.
+    _end[slot] =        last + 1;
+    _endwrap[slot] =    (loop > release) ? loop : last;
+
+    if(release >= 0)
+    {
+        _limit[slot] =  release + 1;
+        _wrap[slot] =   (loop >= 0 && loop <= release) ? loop : release;
+        _after[slot] =  (release < last) ? release + 1 : last;
+    }
+    else
+    {
+        _limit[slot] =  _end[slot];
+        _wrap[slot] =   _endwrap[slot];
+        _after[slot] =  -1;
+    }
+}
+
+void TrackerMacroPlayer::release(unsigned int voice)
+{
+    for(unsigned int slot = voice * MacroCount; slot < (voice + 1) * MacroCount; slot++)
+    {
+        if(_after[slot] < 0)
+            continue;
+
+        if(_pos[slot] < _after[slot])
+            _pos[slot] = _after[slot];
+
+        _limit[slot] =  _end[slot];
+        _wrap[slot] =   _endwrap[slot];
+        _after[slot] =  -1;
+    }
+}
+
+void TrackerMacroPlayer::stop(unsigned int voice)
+{
+    for(unsigned int slot = voice * MacroCount; slot < (voice + 1) * MacroCount; slot++)
+        park(slot);
+}
+
+void TrackerMacroPlayer::advance()
+{
+    if(_table == NULL || _pos.empty())
+        return;
+
+    const unsigned int  slots = (unsigned int)_pos.size();
+    int32_t*            pos =   &(_pos[0]);
+    const int32_t*      limit = &(_limit[0]);
+    const int32_t*      wrap =  &(_wrap[0]);
+
+    for(unsigned int s = 0; s < slots; s++)
+        _value[s] = _table[pos[s]];
+
+    // pos = (pos + 1 < limit) ? pos + 1 : wrap. MacroCount is 4, so slots always come in groups of four.
+#if TRACKERMACRO_SSE2
+    const __m128i one = _mm_set1_epi32(1);
+
+    for(unsigned int s = 0; s < slots; s += 4)
+    {
+        const __m128i next =    _mm_add_epi32(_mm_loadu_si128((const __m128i*)(pos + s)), one);
+        const __m128i inside =  _mm_cmplt_epi32(next, _mm_loadu_si128((const __m128i*)(limit + s)));
+        const __m128i w =       _mm_loadu_si128((const __m128i*)(wrap + s));
+
+        _mm_storeu_si128((__m128i*)(pos + s), _mm_or_si128(_mm_and_si128(inside, next), _mm_andnot_si128(inside, w)));
+    }
+#else
+    for(unsigned int s = 0; s < slots; s++)
+    {
+        const int32_t next = pos[s] + 1;
+        pos[s] = (next < limit[s]) ? next : wrap[s];
+    }
+#endif
+}
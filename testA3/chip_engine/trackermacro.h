@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Macros a patch can carry, as named in the song file ("volume", "pitch", "finepitch", "dutycycle").
+ */
+enum TrackerMacroType
+{
+    MacroVolume,        // 0 to 15, scales the volume column.
+    MacroPitch,         // Semitones added to the note.
+    MacroFinePitch,     // Timer periods subtracted every tick, accumulating: positive values bend up.
+    MacroDuty,          // Duty of pulses, mode of the noise.
+
+    MacroCount
+};
+
+/**
+ * @brief A compiled macro: `length` values stored from `offset` of the song's macro table.
+ *
+ * Without a release point, the macro plays to its end and then repeats from `loop`, or holds its last value if
+ * there's no loop. With one, it stops at `release` (looping back to `loop` if that comes before it) until the note is
+ * released, and then plays the rest.
+ */
+struct TrackerMacro
+{
+    unsigned int    offset;
+    unsigned short  length;
+    short           loop;       // -1 if none.
+    short           release;    // -1 if none.
+};
+
+/**
+ * @brief Runs the macros of a fixed number of voices, one value per tick.
+ *
+ * Each voice has a cursor per macro type. Cursors are kept as structure of arrays of absolute table positions, along
+ * with where each one wraps and what it wraps to; those two only change when a macro is triggered or released. So
+ * advance() steps every cursor of every voice in one branchless pass, four at a time with SSE2 when available, and
+ * the only per-value work left is reading the table.
+ *
+ * The player holds a pointer to the table (see TrackerSong::macroTable()), whose first MacroCount values are the
+ * neutral ones of every type: idle cursors stay parked on them.
+ */
+class TrackerMacroPlayer
+{
+private:
+    const int8_t*           _table;
+    unsigned int            _voices;
+
+    // voices * MacroCount slots, voice by voice.
+    std::vector<int32_t>    _pos;
+    std::vector<int32_t>    _limit;     // Cursors reaching this go back to _wrap.
+    std::vector<int32_t>    _wrap;
+    std::vector<int32_t>    _after;     // First position after the release point, or -1.
+    std::vector<int32_t>    _end;       // Limit and wrap once released.
+    std::vector<int32_t>    _endwrap;
+    std::vector<int8_t>     _value;
+    std::vector<uint8_t>    _active;
+
+    void    park(unsigned int slot);
+
+public:
+    TrackerMacroPlayer(unsigned int voices);
+
+    /**
+     * @brief Sets the table the macros index. Idles every voice.
+     */
+    void    setTable(const int8_t* table);
+
+    /**
+     * @brief Starts a macro on a voice, from its first value. NULL stops the voice's macro of that type.
+     */
+    void    trigger(unsigned int voice, TrackerMacroType type, const TrackerMacro* macro);
+
+    /**
+     * @brief Lets the voice's macros play past their release points.
+     */
+    void    release(unsigned int voice);
+
+    /**
+     * @brief Stops every macro of a voice.
+     */
+    void    stop(unsigned int voice);
+
+    /**
+     * @brief Reads the current value of every cursor, then steps them all. Call once per tick.
+     */
+    void    advance();
+
+    /**
+     * @brief Value read by the last advance(). Neutral for idle macros.
+     */
+    int     value(unsigned int voice, TrackerMacroType type) const {return _value[voice * MacroCount + type];}
+
+    bool    isActive(unsigned int voice, TrackerMacroType type) const {return _active[voice * MacroCount + type] != 0;}
+
+    /**
+     * @brief Whether any macro of the voice is running.
+     */
+    bool    isActive(unsigned int voice) const
+    {
+        const uint8_t* a = &(_active[voice * MacroCount]);
+        return (a[0] | a[1] | a[2] | a[3]) != 0;
+    }
+};
@@ -0,0 +1,167 @@
+#include "trackersequencer.h"
+
+// Driver tick rate at the base tempo. NTSC vertical blank.
+#define TRACKER_TICK_HZ         60.0
+
+TrackerSequencer::TrackerSequencer(const TrackerSong& song) :
+    _song(&song),
+    _loop(true)
+{
+    reset();
+}
+
+void TrackerSequencer::reset(unsigned int frame)
+{
+    _frame =        frame;
+    _row =          0;
+    _tick =         0;
+    _speed =        _song->speed();
+    _tempo =        _song->tempo();
+    _finished =     (frame >= _song->frameCount());
+    _jumpframe =    -1;
+    _skiprow =      -1;
+    _halt =         false;
+}
+
+void TrackerSequencer::setLoop(bool loop)
+{
+    _loop = loop;
+}
+
+bool TrackerSequencer::loops() const
+{
+    return _loop;
+}
+
+void TrackerSequencer::readEffects()
+{
+    const unsigned int channels = _song->channelCount();
+
+    for(unsigned int c = 0; c < channels; c++)
+    {
+        const TrackerRow* r = row(c);
+        if(r == NULL)
+            continue;
+
+        for(unsigned int e = 0; e < r->effectcount; e++)
+        {
+            const unsigned char param = r->effects[e].param;
+
+            switch(r->effects[e].command)
+            {
+                case 'B':
+                    _jumpframe =    param;
+                break;
+                case 'C':
+                    _halt =         true;
+                break;
+                case 'D':
+                    _skiprow =      param;
+                break;
+                case 'F':
+                    if(param == 0)
+                        break;
+                    if(param < 0x20)
+                        _speed =    param;
+                    else
+                        _tempo =    param;
+                break;
+                default:
+                break;
+            }
+        }
+    }
+}
+
+void TrackerSequencer::nextRow()
+{
+    unsigned int frame, row;
+
+    if(_halt)
+    {
+        _finished = true;
+        return;
+    }
+
+    if(_jumpframe >= 0 || _skiprow >= 0)
+    {
+        frame = (_jumpframe >= 0) ? (unsigned int)_jumpframe : _frame + 1;
+        row =   (_skiprow >= 0) ? (unsigned int)_skiprow : 0;
+
+        _jumpframe =    -1;
+        _skiprow =      -1;
+    }
+    else if(_row + 1 < _song->frameLength(_frame))
+    {
+        _row++;
+        return;
+    }
+    else
+    {
+        frame = _frame + 1;
+        row =   0;
+    }
+
+    if(frame >= _song->frameCount())
+    {
+        if(!_loop)
+        {
+            _finished = true;
+            return;
+        }
+        frame = 0;
+    }
+
+    _frame =    frame;
+    _row =      (row < _song->frameLength(frame)) ? row : 0;
+}
+
+void TrackerSequencer::advance()
+{
+    if(_finished)
+        return;
+
+    if(_tick == 0)
+        readEffects();
+
+    if(++_tick < _speed)
+        return;
+
+    _tick = 0;
+    nextRow();
+}
+
+double TrackerSequencer::tickRate() const
+{
+    return TRACKER_TICK_HZ * (double)_tempo / (double)_song->baseTempo();
+}
+
+bool TrackerSequencer::finished() const
+{
+    return _finished;
+}
+
+unsigned int TrackerSequencer::currentFrame() const
+{
+    return _frame;
+}
+
+unsigned int TrackerSequencer::currentRow() const
+{
+    return _row;
+}
+
+unsigned int TrackerSequencer::currentTick() const
+{
+    return _tick;
+}
+
+unsigned int TrackerSequencer::speed() const
+{
+    return _speed;
+}
+
+unsigned int TrackerSequencer::tempo() const
+{
+    return _tempo;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "trackersong.h"
+
+/**
+ * @brief Steps through a compiled TrackerSong, one driver tick at a time. It only keeps a handful of integers, so it
+ * can be copied to save or restore a playback position.
+ *
+ * At the first tick of every row, read the rows of the channels with row(). Flow effects are handled here, once the
+ * row has been read: Bxx jumps to frame xx, Dxx skips to row xx of the next frame, Cxx halts the song, and Fxx sets
+ * the speed (below 0x20) or the tempo.
+ */
+class TrackerSequencer
+{
+private:
+    const TrackerSong*  _song;
+
+    unsigned int        _frame, _row, _tick;
+    unsigned int        _speed, _tempo;
+    bool                _loop, _finished;
+
+    // Flow changes requested by the effects of the current row, applied when it ends.
+    int                 _jumpframe, _skiprow;
+    bool                _halt;
+
+    void    readEffects();
+    void    nextRow();
+
+public:
+    TrackerSequencer(const TrackerSong& song);
+
+    /**
+     * @brief Goes back to the first row of a frame, with the song's initial speed and tempo.
+     */
+    void    reset(unsigned int frame = 0);
+
+    /**
+     * @brief Whether the song goes back to the first frame after the last one. Enabled by default.
+     */
+    void    setLoop(bool loop);
+    bool    loops() const;
+
+    /**
+     * @brief Whether the current tick is the first one of a row, so the rows should be applied.
+     */
+    bool    rowStarts() const {return _tick == 0 && !_finished;}
+
+    /**
+     * @brief Current row of a channel, or NULL if it plays nothing.
+     */
+    const TrackerRow*   row(unsigned int channel) const {return _song->row(_frame, channel, _row);}
+
+    /**
+     * @brief Moves to the next tick.
+     */
+    void    advance();
+
+    /**
+     * @brief Ticks per second, at the current tempo.
+     */
+    double  tickRate() const;
+
+    /**
+     * @brief Whether the song reached its end (or a Cxx effect) with looping disabled.
+     */
+    bool    finished() const;
+
+    unsigned int    currentFrame() const;
+    unsigned int    currentRow() const;
+    unsigned int    currentTick() const;
+    unsigned int    speed() const;
+    unsigned int    tempo() const;
+};
@@ -0,0 +1,429 @@
+#include "trackersong.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <map>
+
+using namespace whimsycore;
+
+typedef std::map<std::string, Variant> VariantMap;
+
+// Const lookups. Variant::at() and operator[] are not const, and the latter inserts missing keys.
+static const Variant& member(const Variant& v, const char* key)
+{
+    if(v.typeID() != Variant::HashTable)
+        return Variant::null;
+
+    const VariantMap&           map =   v.hashtableReference();
+    VariantMap::const_iterator  it =    map.find(key);
+
+    return (it != map.end()) ? it->second : Variant::null;
+}
+
+static const Variant& element(const Variant& v, size_t index)
+{
+    if(v.typeID() != Variant::VariantArray || index >= v.size())
+        return Variant::null;
+
+    return v.arrayReference()[index];
+}
+
+TrackerSong::TrackerSong() :
+    _tempo(150),
+    _basetempo(150),
+    _speed(6)
+{}
+
+TrackerChannelType TrackerSong::channelTypeFromString(const std::string& type)
+{
+    if(type == "synth-square")
+        return ChannelSquare;
+    if(type == "synth-triangle")
+        return ChannelTriangle;
+    if(type == "synth-noise")
+        return ChannelNoise;
+    if(type == "sampled-dpcm")
+        return ChannelDPCM;
+
+    return ChannelUnknown;
+}
+
+TrackerChannelType TrackerSong::channelTypeFromId(const std::string& id)
+{
+    if(id.compare(0, 2, "SQ") == 0)
+        return ChannelSquare;
+    if(id.compare(0, 3, "TRI") == 0)
+        return ChannelTriangle;
+    if(id.compare(0, 3, "NOI") == 0)
+        return ChannelNoise;
+    if(id.compare(0, 4, "DPCM") == 0)
+        return ChannelDPCM;
+
+    return ChannelUnknown;
+}
+
+int TrackerSong::columnFromString(const std::string& column)
+{
+    static const char* names[ColumnCount] = {"NOTE", "PAT", "VOL", "DC", "FREQ", "MODE", "FX"};
+
+    for(int i = 0; i < ColumnCount; i++)
+    {
+        if(column == names[i])
+            return i;
+    }
+
+    return -1;
+}
+
+void TrackerSong::parseEffects(const std::string& fx, TrackerRow& row)
+{
+    size_t pos = 0;
+
+    // Effects are a command letter followed by hexadecimal digits, separated by commas or whitespace ("G0,B02").
+    // Anything else, like a "00" placeholder, is skipped.
+    while(pos < fx.size())
+    {
+        while(pos < fx.size() && !std::isalnum((unsigned char)fx[pos]))
+            pos++;
+
+        size_t end = pos;
+        while(end < fx.size() && std::isalnum((unsigned char)fx[end]))
+            end++;
+
+        if(end > pos && std::isalpha((unsigned char)fx[pos]) && row.effectcount < TRACKER_MAX_EFFECTS)
+        {
+            TrackerEffect& effect = row.effects[row.effectcount++];
+
+            effect.command =    (char)std::toupper((unsigned char)fx[pos]);
+            effect.param =      (unsigned char)std::strtol(fx.substr(pos + 1, end - pos - 1).c_str(), NULL, 16);
+        }
+
+        pos = end;
+    }
+}
+
+void TrackerSong::compileCell(const Variant& cell, TrackerColumn column, TrackerRow& row)
+{
+    if(cell.isNull())
+        return;
+
+    switch(column)
+    {
+        case ColumnNote:
+        {
+            unsigned char note = WHIMSYNOTE_NULL;
+
+            if(cell.typeID() == Variant::Note)
+                note = cell.noteValue().value();
+            else if(cell.typeID() == Variant::String)
+                note = Note(cell.stringReference()).value();
+
+            if(note == WHIMSYNOTE_NULL)
+                return;
+            row.note = note;
+        }
+        break;
+
+        case ColumnEffects:
+            if(cell.typeID() == Variant::String)
+                parseEffects(cell.stringReference(), row);
+            if(row.effectcount == 0)
+                return;
+        break;
+
+        default:
+            if(!Variant::typeIsNumeric(cell.typeID()))
+                throw Exception(NULL, Exception::InvalidConversion, "Pattern cell is not a number.");
+            row.values[column] = (short)cell.intValue();
+        break;
+    }
+
+    row.mask |= (1 << column);
+}
+
+short TrackerSong::compileMacro(const Variant& entry, const char* name)
+{
+    const Variant&      values =    member(entry, name);
+    const std::string   key =       name;
+
+    if(values.typeID() != Variant::VariantArray || values.size() == 0)
+        return -1;
+    if(values.size() > 0xFFFF)
+        throw Exception(NULL, Exception::InvalidConversion, "Patch macro is too long.");
+
+    const Variant& loop =       member(entry, (key + "-loop").c_str());
+    const Variant& release =    member(entry, (key + "-release").c_str());
+
+    TrackerMacro macro;
+    macro.offset =  (unsigned int)_macrotable.size();
+    macro.length =  (unsigned short)values.size();
+    macro.loop =    loop.isNull() ? -1 : (short)loop.intValue();
+    macro.release = release.isNull() ? -1 : (short)release.intValue();
+
+    for(size_t i = 0; i < values.size(); i++)
+    {
+        const Variant& v = element(values, i);
+
+        if(!Variant::typeIsNumeric(v.typeID()))
+            throw Exception(NULL, Exception::InvalidConversion, "Patch macro value is not a number.");
+
+        const int value = v.intValue();
+        _macrotable.push_back((int8_t)(value < -128 ? -128 : (value > 127 ? 127 : value)));
+    }
+
+    _macros.push_back(macro);
+    return (short)(_macros.size() - 1);
+}
+
+void TrackerSong::compilePatches(const Variant& file)
+{
+    static const char* const    macronames[MacroCount] =    {"volume", "pitch", "finepitch", "dutycycle"};
+    static const int8_t         neutral[MacroCount] =       {15, 0, 0, 0};
+
+    const Variant& list = member(member(file, "patches"), "patch");
+
+    _patches.clear();
+    _macros.clear();
+    _macrotable.assign(neutral, neutral + MacroCount);
+
+    for(size_t i = 0; i < list.size() && list.typeID() == Variant::VariantArray; i++)
+    {
+        const Variant&  entry = element(list, i);
+        const int       index = member(entry, "index").intValue();
+
+        if(member(entry, "index").isNull() || index < 0)
+            throw Exception(NULL, Exception::FieldDoesNotExist, "Patch without a valid index.");
+
+        if((size_t)index >= _patches.size())
+        {
+            TrackerPatch none = {-1, 15, false, {-1, -1, -1, -1}};
+            _patches.resize(index + 1, none);
+        }
+
+        TrackerPatch& patch = _patches[index];
+
+        patch.sample =  member(entry, "sample").isNull() ? -1 : member(entry, "sample").intValue();
+        patch.rate =    member(entry, "rate").isNull() ? 15 : (unsigned char)(member(entry, "rate").intValue() & 15);
+        patch.loop =    member(entry, "loop").boolValue();
+
+        for(unsigned int m = 0; m < MacroCount; m++)
+            patch.macros[m] = compileMacro(entry, macronames[m]);
+    }
+}
+
+void TrackerSong::compile(const Variant& file, unsigned int songindex, const Variant& preset)
+{
+    const Variant& song = element(member(file, "songs"), songindex);
+    if(song.typeID() != Variant::HashTable)
+        throw Exception(NULL, Exception::IncompleteSongSelector, "Song index out of range.");
+
+    const Variant& map =        member(song, "map");
+    const Variant& framecols =  member(map, "frame-cols");
+    const Variant& frametable = member(map, "frame");
+    const Variant& patterns =   member(song, "patterns");
+    const Variant& patterncols = member(patterns, "pattern-cols");
+
+    if(framecols.typeID() != Variant::HashTable || frametable.typeID() != Variant::VariantArray)
+        throw Exception(NULL, Exception::IncompleteSongSelector, "Song has no frame map.");
+
+    // Channel types, by id, from the preset.
+    std::map<std::string, TrackerChannelType>   presettypes;
+    const Variant&                              presetchannels = member(preset, "channels");
+
+    for(size_t i = 0; i < presetchannels.size() && presetchannels.typeID() == Variant::VariantArray; i++)
+    {
+        const Variant& ch = element(presetchannels, i);
+        if(member(ch, "id").typeID() == Variant::String)
+            presettypes[member(ch, "id").stringValue()] = channelTypeFromString(member(ch, "type").stringValue());
+    }
+
+    // Channels are ordered by their frame column.
+    std::vector<TrackerChannel> channels(framecols.size());
+
+    for(VariantMap::const_iterator it = framecols.hashtableReference().begin(); it != framecols.hashtableReference().end(); it++)
+    {
+        const int col = it->second.intValue();
+        if(col < 0 || (size_t)col >= channels.size() || !channels[col].id.empty())
+            throw Exception(NULL, Exception::ChannelDoesNotExist, "Frame column out of range or repeated.");
+
+        TrackerChannel& ch = channels[col];
+
+        ch.id =     it->first;
+        ch.type =   presettypes.count(ch.id) ? presettypes[ch.id] : channelTypeFromId(ch.id);
+    }
+
+    for(size_t c = 0; c < channels.size(); c++)
+    {
+        TrackerChannel&     ch =        channels[c];
+        const Variant&      chpatterns = member(patterns, ch.id.c_str());
+        const Variant&      chcols =    member(patterncols, ch.id.c_str());
+        int                 colmap[ColumnCount];
+        size_t              rowcount =  0;
+
+        if(chpatterns.isNull())
+            continue;
+        if(chpatterns.typeID() != Variant::VariantArray || chcols.typeID() != Variant::HashTable)
+            throw Exception(NULL, Exception::ChannelDoesNotExist, "Channel patterns without a pattern-cols entry.");
+
+        // Position of every known column in the row arrays of this channel.
+        for(int i = 0; i < ColumnCount; i++)
+            colmap[i] = -1;
+
+        for(VariantMap::const_iterator it = chcols.hashtableReference().begin(); it != chcols.hashtableReference().end(); it++)
+        {
+            const int column = columnFromString(it->first);
+            if(column < 0)
+                throw Exception(NULL, Exception::FieldDoesNotExist, "Unknown pattern column.");
+            colmap[column] = it->second.intValue();
+        }
+
+        for(size_t p = 0; p < chpatterns.size(); p++)
+            rowcount += element(chpatterns, p).size();
+
+        ch.rows.reserve(rowcount);
+        ch.patternstart.resize(chpatterns.size());
+        ch.patternlength.resize(chpatterns.size());
+
+        for(size_t p = 0; p < chpatterns.size(); p++)
+        {
+            const Variant& pattern = element(chpatterns, p);
+
+            ch.patternstart[p] =    (unsigned int)ch.rows.size();
+            ch.patternlength[p] =   (unsigned int)pattern.size();
+
+            for(size_t r = 0; r < pattern.size(); r++)
+            {
+                const Variant&  cells = element(pattern, r);
+                TrackerRow      row =   TrackerRow();
+
+                row.note = WHIMSYNOTE_NULL;
+
+                for(int i = 0; i < ColumnCount; i++)
+                {
+                    if(colmap[i] >= 0)
+                        compileCell(element(cells, colmap[i]), (TrackerColumn)i, row);
+                }
+
+                ch.rows.push_back(row);
+            }
+        }
+    }
+
+    // Frame table, flattened. Pattern indices are checked here, so playback doesn't have to.
+    const size_t    channelcount =  channels.size();
+    const size_t    framecount =    frametable.size();
+
+    std::vector<int>            frames(framecount * channelcount, -1);
+    std::vector<unsigned int>   framelength(framecount, 0);
+
+    for(size_t f = 0; f < framecount; f++)
+    {
+        const Variant& frame = element(frametable, f);
+
+        for(size_t c = 0; c < channelcount; c++)
+        {
+            const Variant& index = element(frame, c);
+            if(index.isNull())
+                continue;
+
+            const int pattern = index.intValue();
+            if(pattern < 0 || (size_t)pattern >= channels[c].patternstart.size())
+                throw Exception(NULL, Exception::NotFound, "Frame refers to a pattern that does not exist.");
+
+            frames[f * channelcount + c] = pattern;
+            if(channels[c].patternlength[pattern] > framelength[f])
+                framelength[f] = channels[c].patternlength[pattern];
+        }
+
+        if(framelength[f] == 0)
+            framelength[f] = TRACKER_DEFAULT_ROWS;
+    }
+
+    // Patches are compiled aside too: nothing of this song changes until everything has been checked.
+    TrackerSong compiled;
+    compiled.compilePatches(file);
+
+    const Variant&      metadata =  member(song, "metadata");
+    const std::string   name =      member(song, "name").isNull() ? std::string() : member(song, "name").stringValue();
+    const int           tempo =     member(song, "tempo").isNull() ? 150 : member(song, "tempo").intValue();
+    const int           basetempo = member(metadata, "basetempo").isNull() ? 150 : member(metadata, "basetempo").intValue();
+    const int           speed =     member(metadata, "divider").isNull() ? 6 : member(metadata, "divider").intValue();
+
+    if(tempo <= 0 || basetempo <= 0 || speed <= 0)
+        throw Exception(NULL, Exception::InvalidConversion, "Song tempo, base tempo and divider must be positive.");
+
+    _channels.swap(channels);
+    _frames.swap(frames);
+    _framelength.swap(framelength);
+    _patches.swap(compiled._patches);
+    _macros.swap(compiled._macros);
+    _macrotable.swap(compiled._macrotable);
+
+    _name =         name;
+    _tempo =        (unsigned int)tempo;
+    _basetempo =    (unsigned int)basetempo;
+    _speed =        (unsigned int)speed;
+}
+
+Variant TrackerSong::readJSON(const char* filepath)
+{
+    ByteStream  bs;
+    Variant     retval;
+
+    bs.readFile(filepath);
+    bs.push_back('\0');
+
+    retval.parse((const char*)&(bs[0]));
+    return retval;
+}
+
+const std::string& TrackerSong::name() const
+{
+    return _name;
+}
+
+unsigned int TrackerSong::channelCount() const
+{
+    return (unsigned int)_channels.size();
+}
+
+const TrackerChannel& TrackerSong::channel(unsigned int index) const
+{
+    return _channels[index];
+}
+
+int TrackerSong::channelIndex(const std::string& id) const
+{
+    for(size_t c = 0; c < _channels.size(); c++)
+    {
+        if(_channels[c].id == id)
+            return (int)c;
+    }
+
+    return -1;
+}
+
+unsigned int TrackerSong::frameCount() const
+{
+    return (unsigned int)_framelength.size();
+}
+
+unsigned int TrackerSong::frameLength(unsigned int frame) const
+{
+    return _framelength[frame];
+}
+
+unsigned int TrackerSong::tempo() const
+{
+    return _tempo;
+}
+
+unsigned int TrackerSong::baseTempo() const
+{
+    return _basetempo;
+}
+
+unsigned int TrackerSong::speed() const
+{
+    return _speed;
+}
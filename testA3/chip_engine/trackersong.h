@@ -0,0 +1,205 @@
+#pragma once
+
+#include "../whimsycore.h"
+#include "trackermacro.h"
+
+#include <string>
+#include <vector>
+
+// Effects kept per row. Extra ones are ignored when compiling.
+#define TRACKER_MAX_EFFECTS     4
+
+// Length of a frame whose channels play no pattern at all.
+#define TRACKER_DEFAULT_ROWS    64
+
+/**
+ * @brief Pattern columns, as named in "pattern-cols" ("NOTE", "PAT", "VOL"...). Compiled rows store them by index.
+ */
+enum TrackerColumn
+{
+    ColumnNote,         // NOTE
+    ColumnPatch,        // PAT
+    ColumnVolume,       // VOL
+    ColumnDuty,         // DC
+    ColumnFrequency,    // FREQ
+    ColumnMode,         // MODE
+    ColumnEffects,      // FX
+
+    ColumnCount
+};
+
+/**
+ * @brief Channel kinds of the chip presets. Given by the channel "type" of the preset ("synth-square"...), or guessed
+ * from the channel id when there's no preset.
+ */
+enum TrackerChannelType
+{
+    ChannelSquare,
+    ChannelTriangle,
+    ChannelNoise,
+    ChannelDPCM,
+    ChannelUnknown
+};
+
+/**
+ * @brief One effect of the FX column. "B02" is command 'B' with parameter 0x02.
+ */
+struct TrackerEffect
+{
+    char            command;
+    unsigned char   param;
+};
+
+/**
+ * @brief A pre-parsed pattern row of one channel. Only the columns flagged in `mask` (bit `1 << TrackerColumn`) were
+ * written in the song; the rest keep whatever the channel was doing.
+ */
+struct TrackerRow
+{
+    unsigned char   note;       // WHIMSYNOTE_MACRO value, or WHIMSYNOTE_NULL / _STOP / _RELEASE.
+    unsigned char   mask;
+    unsigned char   effectcount;
+    short           values[ColumnCount];
+    TrackerEffect   effects[TRACKER_MAX_EFFECTS];
+
+    bool    has(TrackerColumn column) const {return (mask & (1 << column)) != 0;}
+};
+
+/**
+ * @brief Rows of every pattern of a channel, stored back to back. Pattern `p` starts at `rows[patternstart[p]]`.
+ */
+struct TrackerChannel
+{
+    std::string                 id;
+    TrackerChannelType          type;
+
+    std::vector<TrackerRow>     rows;
+    std::vector<unsigned int>   patternstart;
+    std::vector<unsigned int>   patternlength;
+};
+
+/**
+ * @brief What the tracker needs of an instrument ("patches"/"patch" in the song file). Patches playing samples give
+ * the index of their sample in the SampleBank, and optionally a DPCM "rate" (0 to 15) and "loop" flag.
+ *
+ * Patches of the other channels may carry "volume", "pitch", "finepitch" and "dutycycle" macros: arrays of values,
+ * one per tick, with optional loop and release points given as "volume-loop", "volume-release"...
+ */
+struct TrackerPatch
+{
+    int             sample;     // -1 if the patch plays no sample.
+    unsigned char   rate;
+    bool            loop;
+    short           macros[MacroCount];     // Index in TrackerSong::macro(), -1 if none.
+};
+
+/**
+ * @brief A song of the tracker JSON format (see export_files/music1.json), compiled into flat arrays.
+ *
+ * The song Variant is walked once, when compiling: channel ids ("SQ01") and column names ("NOTE", "VOL") become
+ * integer indices, notes are parsed and effects are split. Playback then only indexes plain arrays, so it never looks
+ * up a string nor allocates, however many patterns the song has.
+ *
+ * Timing follows the song's "tempo" and "metadata": the engine ticks at 60Hz * tempo / basetempo, and each row lasts
+ * "divider" ticks.
+ */
+class TrackerSong
+{
+private:
+    std::vector<TrackerChannel>     _channels;
+    std::vector<int>                _frames;        // frameCount() * channelCount() pattern indices, -1 if none.
+    std::vector<unsigned int>       _framelength;
+    std::vector<TrackerPatch>       _patches;       // By patch index.
+    std::vector<TrackerMacro>       _macros;
+    std::vector<int8_t>             _macrotable;    // Values of every macro, after the neutral one of every type.
+
+    std::string                     _name;
+    unsigned int                    _tempo;
+    unsigned int                    _basetempo;
+    unsigned int                    _speed;
+
+    static TrackerChannelType   channelTypeFromString(const std::string& type);
+    static TrackerChannelType   channelTypeFromId(const std::string& id);
+    static int                  columnFromString(const std::string& column);
+    static void                 parseEffects(const std::string& fx, TrackerRow& row);
+    static void                 compileCell(const whimsycore::Variant& cell, TrackerColumn column, TrackerRow& row);
+    void                        compilePatches(const whimsycore::Variant& file);
+    short                       compileMacro(const whimsycore::Variant& entry, const char* name);
+
+public:
+    TrackerSong();
+
+    /**
+     * @brief Compiles a song of a tracker file. Throws a whimsycore::Exception if the song is malformed, in which case
+     * the previously compiled song is left as it was.
+     * @param file      Whole parsed file, with its "songs" array.
+     * @param songindex Song to compile.
+     * @param preset    Parsed chip preset (see export_files/nes_2a03.json). It gives the channel types; without it,
+     *                  they are guessed from the channel ids.
+     */
+    void    compile(const whimsycore::Variant& file, unsigned int songindex = 0,
+                    const whimsycore::Variant& preset = whimsycore::Variant::null);
+
+    /**
+     * @brief Reads and parses a JSON file. Throws a whimsycore::Exception if it can't be opened or parsed.
+     */
+    static whimsycore::Variant  readJSON(const char* filepath);
+
+    const std::string&  name() const;
+
+    unsigned int        channelCount() const;
+    const TrackerChannel&   channel(unsigned int index) const;
+
+    /**
+     * @brief Index of the channel with the given id, or -1. Meant for setup code, not for the audio thread.
+     */
+    int                 channelIndex(const std::string& id) const;
+
+    unsigned int        frameCount() const;
+
+    /**
+     * @brief Rows of a frame: those of its longest pattern.
+     */
+    unsigned int        frameLength(unsigned int frame) const;
+
+    /**
+     * @brief Row `row` of frame `frame` in channel `channel`, or NULL if the channel plays no pattern there or its
+     * pattern is shorter.
+     */
+    const TrackerRow*   row(unsigned int frame, unsigned int channel, unsigned int row) const
+    {
+        const int pattern = _frames[frame * _channels.size() + channel];
+
+        if(pattern < 0)
+            return NULL;
+
+        const TrackerChannel& ch = _channels[channel];
+        if(row >= ch.patternlength[pattern])
+            return NULL;
+
+        return &(ch.rows[ch.patternstart[pattern] + row]);
+    }
+
+    /**
+     * @brief Patch with the given index, or NULL.
+     */
+    const TrackerPatch* patch(unsigned int index) const
+    {
+        return (index < _patches.size()) ? &(_patches[index]) : NULL;
+    }
+
+    const TrackerMacro& macro(unsigned int index) const {return _macros[index];}
+
+    /**
+     * @brief Packed values of every macro, for TrackerMacroPlayer.
+     */
+    const int8_t*       macroTable() const {return _macrotable.empty() ? NULL : &(_macrotable[0]);}
+
+    unsigned int        tempo() const;
+    unsigned int        baseTempo() const;
+
+    /**
+     * @brief Ticks per row at the start of the song.
+     */
+    unsigned int        speed() const;
+};
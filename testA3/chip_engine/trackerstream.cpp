@@ -0,0 +1,482 @@
+#include "trackerstream.h"
+#include "../portaudio_engine/audiomixer.h"
+#include "../portaudio_engine/oscillator.h"
+
+#include <cmath>
+#include <cstring>
+
+// Frames mixed at once.
+#define TRACKER_MIX_FRAMES      512
+
+// Cutoff of the output highpass, in Hz.
+#define TRACKER_HIGHPASS_HZ     90.0
+#define TRACKER_TWO_PI          6.283185307179586
+
+TrackerStream::TrackerStream(const TrackerSong& song, const SampleBank* samples,
+                             unsigned int samplerate, unsigned int channels) :
+    FloatAudioStream(samplerate, channels),
+    _song(&song),
+    _samples(samples),
+    _sequencer(song),
+    _voices(song.channelCount()),
+    _macros(song.channelCount()),
+    _mix(TRACKER_MIX_FRAMES),
+    _jobs(NULL),
+    _channelmix(song.channelCount() * TRACKER_MIX_FRAMES),
+    _rendered(song.channelCount(), 0),
+    _spanframes(0),
+    _frame(0),
+    _nexttick(0.0),
+    _gain(1.0f),
+    _hpcoef((float)std::exp(-TRACKER_TWO_PI * TRACKER_HIGHPASS_HZ / (double)samplerate)),
+    _hpin(0.0f),
+    _hpout(0.0f)
+{
+    unsigned int counts[ChannelUnknown + 1] = {0, 0, 0, 0, 0};
+
+    for(unsigned int c = 0; c < _voices.size(); c++)
+        counts[song.channel(c).type]++;
+
+    // Sized before taking any pointer, so they never move.
+    _squares.assign(counts[ChannelSquare], Apu2A03Square((float)samplerate));
+    _triangles.assign(counts[ChannelTriangle], Apu2A03Triangle((float)samplerate));
+    _noises.assign(counts[ChannelNoise], Apu2A03Noise((float)samplerate));
+    _dpcms.assign(counts[ChannelDPCM], Apu2A03DPCM((float)samplerate));
+
+    for(unsigned int t = 0; t <= ChannelUnknown; t++)
+        counts[t] = 0;
+
+    for(unsigned int c = 0; c < _voices.size(); c++)
+    {
+        Voice& v = _voices[c];
+
+        v.type =    song.channel(c).type;
+        v.active =  false;
+        v.note =    0;
+        v.volume =  15;
+        v.patch =   -1;
+        v.bend =    0;
+
+        switch(v.type)
+        {
+            case ChannelSquare:     v.channel = &(_squares[counts[v.type]++]);      break;
+            case ChannelTriangle:   v.channel = &(_triangles[counts[v.type]++]);    break;
+            case ChannelNoise:      v.channel = &(_noises[counts[v.type]++]);       break;
+            case ChannelDPCM:       v.channel = &(_dpcms[counts[v.type]++]);        break;
+            default:                v.channel = NULL;                               break;
+        }
+
+        // Silent until its first note.
+        if(v.type == ChannelTriangle)
+            static_cast<Apu2A03Triangle*>(v.channel)->setEnabled(false);
+    }
+
+    _macros.setTable(song.macroTable());
+}
+
+void TrackerStream::onCommand(const StreamCommand& cmd)
+{
+    switch(cmd.parameter)
+    {
+        case ParamVolume:
+            _gain = cmd.get<float>();
+        break;
+        case ParamLoop:
+            _sequencer.setLoop(cmd.get<int>() != 0);
+        break;
+        case ParamPosition:
+            _sequencer.reset((unsigned int)cmd.get<int>());
+            for(unsigned int c = 0; c < _voices.size(); c++)
+            {
+                _voices[c].active = false;
+                _macros.stop(c);
+                if(_voices[c].type == ChannelTriangle)
+                    static_cast<Apu2A03Triangle*>(_voices[c].channel)->setEnabled(false);
+            }
+            _nexttick = (double)_frame;
+        break;
+        default:
+        break;
+    }
+}
+
+void TrackerStream::startMacros(unsigned int channel)
+{
+    Voice&              voice = _voices[channel];
+    const TrackerPatch* patch = (voice.patch >= 0) ? _song->patch((unsigned int)voice.patch) : NULL;
+
+    voice.bend = 0;
+
+    for(unsigned int m = 0; m < MacroCount; m++)
+        _macros.trigger(channel, (TrackerMacroType)m,
+                        (patch != NULL && patch->macros[m] >= 0) ? &(_song->macro(patch->macros[m])) : NULL);
+}
+
+// Volume macros scale the volume column. The result never rounds down to silence if neither is 0.
+static uint8_t macroVolume(uint8_t volume, int macro)
+{
+    const int scaled = ((int)volume * macro) / 15;
+
+    if(scaled == 0 && volume > 0 && macro > 0)
+        return 1;
+    return (uint8_t)(scaled < 0 ? 0 : (scaled > 15 ? 15 : scaled));
+}
+
+void TrackerStream::applyMacros(unsigned int channel)
+{
+    Voice&      voice = _voices[channel];
+    const int   arp =   _macros.value(channel, MacroPitch);
+
+    voice.bend += _macros.value(channel, MacroFinePitch);
+
+    int note = (int)voice.note + arp;
+    note = (note < 0) ? 0 : (note > WHIMSYNOTE_MACRO(11, 9) ? WHIMSYNOTE_MACRO(11, 9) : note);
+
+    switch(voice.type)
+    {
+        case ChannelSquare:
+        {
+            Apu2A03Square*  sq = static_cast<Apu2A03Square*>(voice.channel);
+
+            sq->setFrequency(Tuning::noteFrequency((unsigned char)note));
+
+            const int period = (int)sq->getPeriod() - voice.bend;
+            sq->setPeriod((uint16_t)(period < 0 ? 0 : (period > 2047 ? 2047 : period)));
+
+            if(_macros.isActive(channel, MacroVolume))
+                sq->setVolume(macroVolume(voice.volume, _macros.value(channel, MacroVolume)));
+            if(_macros.isActive(channel, MacroDuty))
+                sq->setDuty((uint8_t)_macros.value(channel, MacroDuty));
+        }
+        break;
+
+        // A volume macro can only silence the triangle.
+        case ChannelTriangle:
+        {
+            Apu2A03Triangle* tri = static_cast<Apu2A03Triangle*>(voice.channel);
+
+            tri->setFrequency(Tuning::noteFrequency((unsigned char)note));
+
+            const int period = (int)tri->getPeriod() - voice.bend;
+            tri->setPeriod((uint16_t)(period < 0 ? 0 : (period > 2047 ? 2047 : period)));
+
+            if(_macros.isActive(channel, MacroVolume))
+                tri->setEnabled(_macros.value(channel, MacroVolume) > 0);
+        }
+        break;
+
+        // Pitch macros move the noise through its 16 periods. Duty macros set its mode.
+        case ChannelNoise:
+        {
+            Apu2A03Noise*   noi =   static_cast<Apu2A03Noise*>(voice.channel);
+            const int       index = (int)voice.note - arp;
+
+            noi->setPeriodIndex((uint8_t)(index < 0 ? 0 : (index > 15 ? 15 : index)));
+
+            if(_macros.isActive(channel, MacroVolume))
+                noi->setVolume(macroVolume(voice.volume, _macros.value(channel, MacroVolume)));
+            if(_macros.isActive(channel, MacroDuty))
+                noi->setShortMode((_macros.value(channel, MacroDuty) & 1) != 0);
+        }
+        break;
+
+        default:
+        break;
+    }
+}
+
+void TrackerStream::applyRow(unsigned int channel, const TrackerRow& row)
+{
+    Voice&      voice =     _voices[channel];
+    const bool  noteon =    row.has(ColumnNote) && row.note != WHIMSYNOTE_SPECIAL_STOP &&
+                            row.note != WHIMSYNOTE_SPECIAL_RELEASE;
+    const bool  noteoff =   row.has(ColumnNote) && !noteon;
+
+    if(row.has(ColumnPatch))
+        voice.patch = row.values[ColumnPatch];
+
+    if(noteoff && row.note == WHIMSYNOTE_SPECIAL_RELEASE && _macros.isActive(channel))
+        _macros.release(channel);
+    else if(noteoff)
+    {
+        voice.active = false;
+        _macros.stop(channel);
+    }
+
+    switch(voice.type)
+    {
+        case ChannelSquare:
+        {
+            Apu2A03Square* sq = static_cast<Apu2A03Square*>(voice.channel);
+
+            if(noteon)
+            {
+                sq->setFrequency(Tuning::noteFrequency(row.note));
+                voice.note =    row.note;
+                voice.active =  true;
+                startMacros(channel);
+            }
+            if(row.has(ColumnVolume))
+            {
+                voice.volume = (uint8_t)(row.values[ColumnVolume] & 15);
+                sq->setVolume(voice.volume);
+            }
+            if(row.has(ColumnDuty))
+                sq->setDuty((uint8_t)row.values[ColumnDuty]);
+        }
+        break;
+
+        // The triangle has no volume control. Its volume column only turns it on and off.
+        case ChannelTriangle:
+        {
+            Apu2A03Triangle* tri = static_cast<Apu2A03Triangle*>(voice.channel);
+
+            if(noteon)
+            {
+                tri->setFrequency(Tuning::noteFrequency(row.note));
+                voice.note =    row.note;
+                voice.active =  true;
+                startMacros(channel);
+            }
+            if(row.has(ColumnVolume))
+                voice.active = voice.active && row.values[ColumnVolume] > 0;
+            tri->setEnabled(voice.active);
+        }
+        break;
+
+        // Noise has no notes. Its frequency column (15 is the highest pitch) starts it.
+        case ChannelNoise:
+        {
+            Apu2A03Noise* noi = static_cast<Apu2A03Noise*>(voice.channel);
+
+            if(row.has(ColumnFrequency))
+            {
+                voice.note =    (unsigned char)(15 - (row.values[ColumnFrequency] & 15));
+                voice.active =  true;
+                noi->setPeriodIndex(voice.note);
+                startMacros(channel);
+            }
+            if(row.has(ColumnVolume))
+            {
+                voice.volume = (uint8_t)(row.values[ColumnVolume] & 15);
+                noi->setVolume(voice.volume);
+            }
+            if(row.has(ColumnMode))
+                noi->setShortMode(row.values[ColumnMode] != 0);
+        }
+        break;
+
+        // DPCM has no notes either. Every patch written starts its sample.
+        case ChannelDPCM:
+        {
+            Apu2A03DPCM* dpcm = static_cast<Apu2A03DPCM*>(voice.channel);
+
+            if(noteoff)
+                dpcm->stop();
+
+            if(row.has(ColumnPatch) && _samples != NULL)
+            {
+                const TrackerPatch*     patch =     _song->patch((unsigned int)row.values[ColumnPatch]);
+                const DecodedSample*    sample =    (patch != NULL && patch->sample >= 0) ?
+                                                    _samples->sample((unsigned int)patch->sample) : NULL;
+
+                if(sample != NULL)
+                {
+                    dpcm->setSample(sample->data(), sample->size());
+                    dpcm->setRateIndex(patch->rate);
+                    dpcm->setLoop(patch->loop);
+                    dpcm->play();
+                    voice.active = true;
+                }
+            }
+        }
+        break;
+
+        default:
+        break;
+    }
+}
+
+void TrackerStream::processTick()
+{
+    if(_sequencer.rowStarts())
+    {
+        for(unsigned int c = 0; c < _voices.size(); c++)
+        {
+            const TrackerRow* row = _sequencer.row(c);
+            if(row != NULL)
+                applyRow(c, *row);
+        }
+    }
+
+    _macros.advance();
+
+    for(unsigned int c = 0; c < _voices.size(); c++)
+        if(_voices[c].active && _macros.isActive(c))
+            applyMacros(c);
+
+    _sequencer.advance();
+    _nexttick += getSampleRateDouble() / _sequencer.tickRate();
+}
+
+void TrackerStream::setJobPool(JobPool* jobs)
+{
+    _jobs = jobs;
+}
+
+bool TrackerStream::isAudible(const Voice& voice) const
+{
+    // Stopped triangle and DPCM channels keep their level, so they are rendered anyway.
+    return voice.channel != NULL && (voice.active || voice.type == ChannelTriangle || voice.type == ChannelDPCM);
+}
+
+void TrackerStream::renderChannelJob(void* stream, unsigned int channel)
+{
+    TrackerStream*  self =  static_cast<TrackerStream*>(stream);
+    const Voice&    voice = self->_voices[channel];
+
+    self->_rendered[channel] = self->isAudible(voice);
+    if(self->_rendered[channel])
+        voice.channel->render(&(self->_channelmix[channel * TRACKER_MIX_FRAMES]), self->_spanframes);
+}
+
+void TrackerStream::mixChannels(float* mix, unsigned long frames)
+{
+    std::memset(mix, 0, frames * sizeof(float));
+
+    if(_jobs != NULL && _voices.size() > 1)
+    {
+        _spanframes = frames;
+        _jobs->run(renderChannelJob, this, (unsigned int)_voices.size());
+
+        // Summed in the same order as below, so the result doesn't depend on the pool.
+        for(unsigned int c = 0; c < _voices.size(); c++)
+            if(_rendered[c])
+                AudioMixer::accumulate(mix, &(_channelmix[c * TRACKER_MIX_FRAMES]), frames, 1.0f);
+    }
+    else
+    {
+        for(unsigned int c = 0; c < _voices.size(); c++)
+            if(isAudible(_voices[c]))
+                _voices[c].channel->mix(mix, frames);
+    }
+}
+
+void TrackerStream::finishMix(float* mix, float* out, unsigned long frames)
+{
+    for(unsigned long i = 0; i < frames; i++)
+    {
+        _hpout =    _hpcoef * (_hpout + mix[i] - _hpin);
+        _hpin =     mix[i];
+        mix[i] =    _hpout * _gain;
+    }
+
+    Oscillator::spread(mix, out, frames, getChannelAmount());
+}
+
+unsigned long TrackerStream::run(float* out, unsigned long frames, RenderMode mode)
+{
+    const unsigned int  channels =  getChannelAmount();
+    unsigned long       done =      0;
+
+    // Render in spans that never cross a tick.
+    while(done < frames)
+    {
+        // The last tick is played whole; the song ends where the tick after it would start.
+        while((double)_frame >= _nexttick)
+        {
+            if(_sequencer.finished())
+                return done;
+            processTick();
+        }
+
+        unsigned long long stop = (unsigned long long)std::ceil(_nexttick);
+        if(stop > _frame + (frames - done))
+            stop = _frame + (frames - done);
+        if(stop - _frame > TRACKER_MIX_FRAMES)
+            stop = _frame + TRACKER_MIX_FRAMES;
+
+        const unsigned long n = (unsigned long)(stop - _frame);
+
+        switch(mode)
+        {
+            case RenderOutput:
+                mixChannels(&(_mix[0]), n);
+                finishMix(&(_mix[0]), out + done * channels, n);
+            break;
+            case RenderMix:
+                mixChannels(out + done, n);
+            break;
+            case RenderSkip:
+                for(unsigned int c = 0; c < _voices.size(); c++)
+                    if(isAudible(_voices[c]))
+                        _voices[c].channel->skip(n);
+            break;
+        }
+
+        _frame =    stop;
+        done +=     n;
+    }
+
+    return done;
+}
+
+unsigned long TrackerStream::renderMix(float* mix, unsigned long frames)
+{
+    return run(mix, frames, RenderMix);
+}
+
+unsigned long TrackerStream::skip(unsigned long frames)
+{
+    return run(NULL, frames, RenderSkip);
+}
+
+unsigned long TrackerStream::framesToNextTick() const
+{
+    return ((double)_frame >= _nexttick) ? 0 : (unsigned long)((unsigned long long)std::ceil(_nexttick) - _frame);
+}
+
+unsigned long long TrackerStream::framePosition() const
+{
+    return _frame;
+}
+
+TrackerStream::State TrackerStream::saveState() const
+{
+    State state = {_sequencer, _voices, _squares, _triangles, _noises, _dpcms, _macros, _frame, _nexttick};
+    return state;
+}
+
+void TrackerStream::restoreState(const State& state)
+{
+    // Same sizes, so the channel arrays are assigned in place and the voices keep pointing into them.
+    _sequencer =    state.sequencer;
+    _squares =      state.squares;
+    _triangles =    state.triangles;
+    _noises =       state.noises;
+    _dpcms =        state.dpcms;
+    _macros =       state.macros;
+    _frame =        state.frame;
+    _nexttick =     state.nexttick;
+
+    for(unsigned int c = 0; c < _voices.size(); c++)
+    {
+        Apu2A03Channel* channel = _voices[c].channel;
+
+        _voices[c] =            state.voices[c];
+        _voices[c].channel =    channel;
+    }
+}
+
+int TrackerStream::floatOut(float* samples, unsigned long frames)
+{
+    const unsigned long done = run(samples, frames, RenderOutput);
+
+    if(done < frames)
+    {
+        std::memset(samples + done * getChannelAmount(), 0, (frames - done) * getChannelAmount() * sizeof(float));
+        return paComplete;
+    }
+
+    return paContinue;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "../portaudio_engine/floataudiostream.h"
+#include "../portaudio_engine/jobpool.h"
+#include "apu2a03.h"
+#include "samplebank.h"
+#include "trackermacro.h"
+#include "trackersequencer.h"
+#include "tuning.h"
+
+#include <vector>
+
+/**
+ * @brief Plays a compiled TrackerSong on 2A03 APU channels. Ticks land on their exact (fractional) frame, whatever
+ * the callback size is, and rows are applied straight from the compiled arrays: the callback never allocates nor
+ * looks up a string.
+ *
+ * Every song channel gets an APU channel of its type. The mix goes through the 90Hz highpass of the console's output
+ * stage, which removes the DC offset of the unipolar APU levels. DPCM channels play the samples of a SampleBank,
+ * straight from the bank's memory: the patch column picks the patch, and the patch the sample.
+ *
+ * On the other channels, every note starts the macros of the channel's patch. They all step once per tick, in one
+ * TrackerMacroPlayer pass, and only the channels with a macro running get their registers rewritten. A release note
+ * lets them go past their release points; without macros running, it stops the note like a stop note does.
+ */
+class TrackerStream : public FloatAudioStream
+{
+private:
+    struct Voice
+    {
+        TrackerChannelType  type;
+        Apu2A03Channel*     channel;    // Points into one of the channel arrays below. NULL if the type is unknown.
+        bool                active;
+
+        // What the rows set, for the macros to work on.
+        unsigned char       note;       // Period index for the noise.
+        unsigned char       volume;
+        int                 patch;
+        int                 bend;       // Fine pitch macro, accumulated, in timer periods.
+    };
+
+    const TrackerSong*              _song;
+    const SampleBank*               _samples;
+    TrackerSequencer                _sequencer;
+    std::vector<Voice>              _voices;
+    TrackerMacroPlayer              _macros;        // One voice per channel.
+
+    // Allocated once, in the constructor.
+    std::vector<Apu2A03Square>      _squares;
+    std::vector<Apu2A03Triangle>    _triangles;
+    std::vector<Apu2A03Noise>       _noises;
+    std::vector<Apu2A03DPCM>        _dpcms;
+
+    std::vector<float>  _mix;
+
+    // Parallel rendering: every channel renders its span into its own buffer, and they are summed in channel order.
+    JobPool*            _jobs;
+    std::vector<float>  _channelmix;
+    std::vector<char>   _rendered;
+    unsigned long       _spanframes;
+
+    unsigned long long  _frame;         // Frames rendered so far.
+    double              _nexttick;      // Frame where the next tick starts.
+    float               _gain;
+
+    // Output highpass.
+    float               _hpcoef, _hpin, _hpout;
+
+    void    applyRow(unsigned int channel, const TrackerRow& row);
+    void    startMacros(unsigned int channel);
+    void    applyMacros(unsigned int channel);
+    void    processTick();
+    bool    isAudible(const Voice& voice) const;
+    void    mixChannels(float* mix, unsigned long frames);
+
+    enum RenderMode
+    {
+        RenderOutput,   // Highpassed, scaled and spread into interleaved frames.
+        RenderMix,      // Mono sum of the channels, before the highpass.
+        RenderSkip      // Nothing written: channels only skip ahead.
+    };
+
+    unsigned long   run(float* out, unsigned long frames, RenderMode mode);
+
+    static void renderChannelJob(void* stream, unsigned int channel);
+
+protected:
+    void onCommand(const StreamCommand& cmd);
+
+public:
+    enum Parameters
+    {
+        ParamVolume,    // Master gain, float.
+        ParamLoop,      // Loops the song if non-zero, int.
+        ParamPosition   // Restarts playback at a frame, int.
+    };
+
+    /**
+     * @brief Creates a player. The song, and the sample bank if any, must outlive it.
+     * @param samples   Samples for the DPCM channels. Without them, DPCM channels stay silent.
+     */
+    TrackerStream(const TrackerSong& song, const SampleBank* samples = NULL,
+                  unsigned int samplerate = 44100, unsigned int channels = 2);
+
+    const TrackerSequencer&     sequencer() const {return _sequencer;}
+
+    /**
+     * @brief Renders the channels of every span in parallel on a JobPool, or back on the audio thread if NULL. The
+     * output is bit for bit the same either way. Set it while the stream is not playing; the pool must outlive it.
+     */
+    void    setJobPool(JobPool* jobs);
+
+    /**
+     * @brief Everything that changes while playing, but the output filter. Enough to resume a song bit for bit
+     * from where it was saved, on another TrackerStream of the same song (see TrackerExporter).
+     */
+    struct State
+    {
+        TrackerSequencer                sequencer;
+        std::vector<Voice>              voices;
+        std::vector<Apu2A03Square>      squares;
+        std::vector<Apu2A03Triangle>    triangles;
+        std::vector<Apu2A03Noise>       noises;
+        std::vector<Apu2A03DPCM>        dpcms;
+        TrackerMacroPlayer              macros;
+        unsigned long long              frame;
+        double                          nexttick;
+    };
+
+    /**
+     * @brief Copies the playback state. Allocates: not for the audio thread.
+     */
+    State   saveState() const;
+
+    /**
+     * @brief Resumes from a state saved from a stream of the same song and sample bank.
+     */
+    void    restoreState(const State& state);
+
+    /**
+     * @brief Offline rendering. Renders the mono sum of the channels, before the output highpass, or only moves the
+     * channels ahead with no audio at all (much faster). Both stop where the song ends, with the loop disabled.
+     * @return  Frames rendered or skipped. Fewer than `frames` if the song ended.
+     */
+    unsigned long   renderMix(float* mix, unsigned long frames);
+    unsigned long   skip(unsigned long frames);
+
+    /**
+     * @brief Runs the output stage (highpass, volume and channel spread) on a mono mix, in place, and writes the
+     * interleaved result to `out`. renderMix() followed by this gives exactly what floatOut() would.
+     */
+    void            finishMix(float* mix, float* out, unsigned long frames);
+
+    /**
+     * @brief Frames left before the next tick starts. 0 if it's due: the next render call processes it first.
+     */
+    unsigned long       framesToNextTick() const;
+    unsigned long long  framePosition() const;
+
+    bool    changeVolume(float vol){return setParameter(ParamVolume, vol);}
+    bool    setLoop(bool loop){return setParameter(ParamLoop, loop ? 1 : 0);}
+    bool    seekFrame(int frame){return setParameter(ParamPosition, frame);}
+
+    int floatOut(float* samples, unsigned long frames);
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "../whimsycore.h"
+
+#include <cmath>
+
+/**
+ * @brief Pitch of WHIMSYNOTE_MACRO notes, shared by everything that plays them (TrackerStream, VoicePool), so a note
+ * previewed on a voice sounds exactly as the song plays it.
+ */
+class Tuning
+{
+public:
+    /**
+     * @brief Frequency of a WHIMSYNOTE_MACRO note, in equal temperament with A-4 at 440Hz.
+     */
+    static inline float noteFrequency(unsigned char note)
+    {
+        return 440.0f * std::pow(2.0f, ((float)note - (float)WHIMSYNOTE_MACRO(9, 4)) / 12.0f);
+    }
+};
@@ -0,0 +1,325 @@
+#include "voicepool.h"
+#include "apu2a03.h"
+#include "tuning.h"
+#include "../portaudio_engine/oscillator.h"
+
+#include <cmath>
+#include <cstring>
+
+// Frames mixed at once by VoicePoolStream, and the cutoff of its output highpass.
+#define VOICEPOOL_MIX_FRAMES        512
+#define VOICEPOOL_HIGHPASS_HZ       90.0
+#define VOICEPOOL_TWO_PI            6.283185307179586
+
+VoicePool::VoicePool(unsigned int capacity, float samplerate, float release) :
+    _capacity(capacity > 0xFFFF ? 0xFFFF : capacity),
+    _stealmode(StealOldest),
+    _cyclestep(Apu2A03Channel::cycleStep(samplerate)),
+    _fadestep(release > 0.0f ? 1.0f / (release * samplerate) : 1.0f),
+    _note(_capacity, 0),
+    _waveform(_capacity, Pulse),
+    _duty(_capacity, 0),
+    _volume(_capacity, 0),
+    _step(_capacity, 0),
+    _releasing(_capacity, 0),
+    _period(_capacity, 0),
+    _counter(_capacity, 0),
+    _fade(_capacity, 0.0f),
+    _generation(_capacity, 0),
+    _prev(_capacity, -1),
+    _next(_capacity, -1),
+    _free(_capacity, 0),
+    _noteprev(_capacity, -1),
+    _notenext(_capacity, -1)
+{
+    clear();
+}
+
+void VoicePool::setStealMode(StealMode mode)
+{
+    _stealmode = mode;
+}
+
+VoicePool::StealMode VoicePool::stealMode() const
+{
+    return _stealmode;
+}
+
+unsigned int VoicePool::capacity() const
+{
+    return _capacity;
+}
+
+unsigned int VoicePool::activeCount() const
+{
+    return _activecount;
+}
+
+void VoicePool::clear()
+{
+    _head =         -1;
+    _tail =         -1;
+    _activecount =  0;
+
+    // Lowest indices on top of the stack.
+    _freecount = _capacity;
+    for(unsigned int i = 0; i < _capacity; i++)
+    {
+        _free[i] = (uint16_t)(_capacity - 1 - i);
+        _generation[i]++;
+    }
+
+    for(unsigned int n = 0; n < 256; n++)
+        _notevoice[n] = -1;
+}
+
+int VoicePool::indexOf(Handle h) const
+{
+    const uint32_t v = h & 0xFFFF;
+
+    // Every voice that stops gets a new generation, so only the handle of a playing voice matches.
+    if(v >= _capacity || _generation[v] != (uint16_t)(h >> 16))
+        return -1;
+    return (int)v;
+}
+
+void VoicePool::unlink(int v)
+{
+    if(_prev[v] >= 0)
+        _next[_prev[v]] = _next[v];
+    else
+        _head = _next[v];
+
+    if(_next[v] >= 0)
+        _prev[_next[v]] = _prev[v];
+    else
+        _tail = _prev[v];
+
+    if(_noteprev[v] >= 0)
+        _notenext[_noteprev[v]] = _notenext[v];
+
+    if(_notenext[v] >= 0)
+        _noteprev[_notenext[v]] = _noteprev[v];
+    else
+        _notevoice[_note[v]] = _noteprev[v];
+
+    _generation[v]++;
+    _activecount--;
+}
+
+void VoicePool::retire(int v)
+{
+    unlink(v);
+    _free[_freecount++] = (uint16_t)v;
+}
+
+int VoicePool::victim(uint8_t note) const
+{
+    switch(_stealmode)
+    {
+        case StealSameNote:
+            if(_notevoice[note] >= 0)
+                return _notevoice[note];
+        return _head;
+
+        case StealQuietest:
+        {
+            int     best =      _head;
+            float   quietest =  16.0f;
+
+            for(int v = _head; v >= 0; v = _next[v])
+            {
+                const float level = (float)(_waveform[v] == Triangle ? 15 : _volume[v]) * _fade[v];
+
+                if(level < quietest)
+                {
+                    quietest =  level;
+                    best =      v;
+                }
+            }
+            return best;
+        }
+
+        case StealOldest:
+        return _head;
+
+        default:
+        return -1;
+    }
+}
+
+VoicePool::Handle VoicePool::noteOn(uint8_t note, uint8_t volume, Waveform waveform, uint8_t duty)
+{
+    int v;
+
+    if(_freecount == 0)
+    {
+        v = victim(note);
+        if(v < 0)
+            return InvalidHandle;
+        unlink(v);
+    }
+    else
+        v = _free[--_freecount];
+
+    const float frequency = Tuning::noteFrequency(note);
+
+    _note[v] =      note;
+    _waveform[v] =  (uint8_t)waveform;
+    _duty[v] =      duty & 3;
+    _step[v] =      0;
+    _releasing[v] = 0;
+    _fade[v] =      1.0f;
+
+    if(waveform == Triangle)
+    {
+        _volume[v] =    15;
+        _period[v] =    Apu2A03Triangle::stepCycles(Apu2A03Triangle::periodForFrequency(frequency));
+    }
+    else
+    {
+        const uint16_t period = Apu2A03Square::periodForFrequency(frequency);
+
+        // Pulses below period 8 are muted, as on the chip.
+        _volume[v] =    (period < 8) ? 0 : (volume & 15);
+        _period[v] =    Apu2A03Square::stepCycles(period);
+    }
+    _counter[v] = _period[v];
+
+    // Newest at the tail.
+    _prev[v] =  _tail;
+    _next[v] =  -1;
+    if(_tail >= 0)
+        _next[_tail] = v;
+    else
+        _head = v;
+    _tail = v;
+
+    // Newest on its note too.
+    _noteprev[v] =  _notevoice[note];
+    _notenext[v] =  -1;
+    if(_notevoice[note] >= 0)
+        _notenext[_notevoice[note]] = v;
+    _notevoice[note] = v;
+
+    _activecount++;
+
+    return handleOf(v);
+}
+
+void VoicePool::noteOff(Handle voice)
+{
+    const int v = indexOf(voice);
+
+    if(v >= 0)
+        _releasing[v] = 1;
+}
+
+void VoicePool::releaseNote(uint8_t note)
+{
+    for(int v = _notevoice[note]; v >= 0; v = _noteprev[v])
+        _releasing[v] = 1;
+}
+
+bool VoicePool::isPlaying(Handle voice) const
+{
+    return indexOf(voice) >= 0;
+}
+
+void VoicePool::mix(float* out, unsigned long frames)
+{
+    const uint32_t  cyclestep = _cyclestep;
+
+    for(int v = _head; v >= 0; )
+    {
+        const int next = _next[v];
+
+        // A released voice only renders until its fade ends.
+        unsigned long   n =         frames;
+        float           fade =      _fade[v];
+        const float     fadestep =  _releasing[v] ? _fadestep : 0.0f;
+
+        if(_releasing[v] && (float)n * _fadestep >= fade)
+            n = (unsigned long)std::ceil(fade / _fadestep);
+
+        if(_waveform[v] == Triangle)
+            Apu2A03Triangle::mixVoice(out, n, cyclestep, _period[v], APU2A03_TRIANGLE_GAIN / (float)cyclestep,
+                                      _counter[v], _step[v], fade, fadestep);
+        else if(_volume[v] > 0)
+            Apu2A03Square::mixVoice(out, n, cyclestep, _period[v], _duty[v],
+                                    APU2A03_SQUARE_GAIN * (float)_volume[v] / (float)cyclestep, _counter[v], _step[v],
+                                    fade, fadestep);
+        else
+            fade -= fadestep * (float)n;
+
+        _fade[v] = fade;
+
+        if(n < frames || (_releasing[v] && fade <= 0.0f))
+            retire(v);
+
+        v = next;
+    }
+}
+
+// VoicePoolStream
+
+VoicePoolStream::VoicePoolStream(unsigned int capacity, unsigned int samplerate, unsigned int channels) :
+    FloatAudioStream(samplerate, channels),
+    _pool(capacity, (float)samplerate),
+    _mix(VOICEPOOL_MIX_FRAMES),
+    _hpcoef((float)std::exp(-VOICEPOOL_TWO_PI * VOICEPOOL_HIGHPASS_HZ / (double)samplerate)),
+    _hpin(0.0f),
+    _hpout(0.0f)
+{}
+
+void VoicePoolStream::onCommand(const StreamCommand& cmd)
+{
+    const int value = cmd.get<int>();
+
+    switch(cmd.parameter)
+    {
+        case ParamNoteOn:
+            _pool.noteOn((uint8_t)(value & 0xFF), (uint8_t)((value >> 8) & 15), (VoicePool::Waveform)((value >> 14) & 1),
+                         (uint8_t)((value >> 12) & 3));
+        break;
+        case ParamNoteOff:
+            _pool.releaseNote((uint8_t)(value & 0xFF));
+        break;
+        case ParamAllOff:
+            _pool.clear();
+        break;
+        case ParamStealMode:
+            _pool.setStealMode((VoicePool::StealMode)value);
+        break;
+        default:
+        break;
+    }
+}
+
+int VoicePoolStream::floatOut(float* samples, unsigned long frames)
+{
+    const unsigned int  channels =  getChannelAmount();
+    float*              mix =       &(_mix[0]);
+
+    while(frames > 0)
+    {
+        const unsigned long n = (frames > VOICEPOOL_MIX_FRAMES) ? VOICEPOOL_MIX_FRAMES : frames;
+
+        std::memset(mix, 0, n * sizeof(float));
+        _pool.mix(mix, n);
+
+        for(unsigned long i = 0; i < n; i++)
+        {
+            _hpout =    _hpcoef * (_hpout + mix[i] - _hpin);
+            _hpin =     mix[i];
+            mix[i] =    _hpout;
+        }
+
+        Oscillator::spread(mix, samples, n, channels);
+
+        samples +=  n * channels;
+        frames -=   n;
+    }
+
+    return paContinue;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "../portaudio_engine/floataudiostream.h"
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Fixed capacity pool of 2A03-style pulse and triangle voices, for instrument previews and chords.
+ *
+ * All voice state is kept as structure of arrays, sized once in the constructor: starting, stopping and stealing
+ * voices never allocates. Free voices sit in a stack and active ones in a list ordered by age, so noteOn() and
+ * noteOff() are O(1). Only stealing the quietest voice has to look at every active voice.
+ *
+ * Rendering walks the active list and mixes every voice into one block with the render loops of Apu2A03Square and
+ * Apu2A03Triangle (see their mixVoice()), so a voice sounds exactly like the chip's channel; the cost per block grows
+ * linearly with the active voices, and is bounded by the capacity. Released voices fade out linearly and then return
+ * to the pool by themselves.
+ *
+ * Voices are referred to by handles that carry a generation count, so a handle to a voice that was stolen or has
+ * finished is simply ignored. Not thread safe: use it from the audio thread (see VoicePoolStream).
+ */
+class VoicePool
+{
+public:
+    enum StealMode
+    {
+        StealNone,      // noteOn() fails when the pool is full.
+        StealOldest,    // The voice started longest ago.
+        StealQuietest,  // The voice with the lowest volume, counting its release fade.
+        StealSameNote   // A voice already playing the same note, or the oldest one if there's none.
+    };
+
+    enum Waveform
+    {
+        Pulse,
+        Triangle
+    };
+
+    typedef uint32_t    Handle;
+
+    static const Handle InvalidHandle = 0xFFFFFFFFu;
+
+private:
+    unsigned int            _capacity;
+    StealMode               _stealmode;
+    uint32_t                _cyclestep;         // CPU cycles per output sample, 16.16 fixed point.
+    float                   _fadestep;          // Release fade per output sample.
+
+    // Voice state, structure of arrays.
+    std::vector<uint8_t>    _note;
+    std::vector<uint8_t>    _waveform;
+    std::vector<uint8_t>    _duty;
+    std::vector<uint8_t>    _volume;
+    std::vector<uint8_t>    _step;
+    std::vector<uint8_t>    _releasing;
+    std::vector<uint32_t>   _period;            // CPU cycles per sequencer step, see Apu2A03Square::stepCycles().
+    std::vector<uint32_t>   _counter;
+    std::vector<float>      _fade;              // 1.0 until released, then down to 0.0.
+    std::vector<uint16_t>   _generation;
+
+    // Active voices, oldest first, as a doubly linked list.
+    std::vector<int>        _prev, _next;
+    int                     _head, _tail;
+    unsigned int            _activecount;
+
+    // Free voices, as a stack.
+    std::vector<uint16_t>   _free;
+    unsigned int            _freecount;
+
+    // Most recent voice started on every note, or -1. Voices on the same note are linked, newest to oldest, so
+    // when one stops the note falls back to the next one still playing.
+    int                     _notevoice[256];
+    std::vector<int>        _noteprev, _notenext;
+
+    void    unlink(int v);
+    void    retire(int v);
+    int     victim(uint8_t note) const;
+
+    Handle  handleOf(int v) const {return ((uint32_t)_generation[v] << 16) | (uint32_t)v;}
+    int     indexOf(Handle h) const;
+
+public:
+    /**
+     * @brief Creates a pool. Allocates everything it will ever use.
+     * @param capacity      Most voices playing at once. Up to 65535.
+     * @param samplerate    Sample rate of the rendered blocks, in Hz.
+     * @param release       Fade out time of released voices, in seconds.
+     */
+    VoicePool(unsigned int capacity, float samplerate = 44100.0f, float release = 0.05f);
+
+    void        setStealMode(StealMode mode);
+    StealMode   stealMode() const;
+
+    /**
+     * @brief Starts a voice.
+     * @param note      WHIMSYNOTE_MACRO note.
+     * @param volume    0 to 15. Ignored by triangles.
+     * @param duty      Pulse duty, 0 to 3, as in Apu2A03Square.
+     * @return          Handle of the voice, or InvalidHandle if the pool is full and stealing is disabled.
+     */
+    Handle      noteOn(uint8_t note, uint8_t volume = 15, Waveform waveform = Pulse, uint8_t duty = 2);
+
+    /**
+     * @brief Releases a voice, which fades out and then frees itself. Stale handles are ignored.
+     */
+    void        noteOff(Handle voice);
+
+    /**
+     * @brief Releases every voice playing a note. O(voices playing it).
+     */
+    void        releaseNote(uint8_t note);
+
+    /**
+     * @brief Frees every voice at once, with no fade.
+     */
+    void        clear();
+
+    bool        isPlaying(Handle voice) const;
+
+    unsigned int    capacity() const;
+    unsigned int    activeCount() const;
+
+    /**
+     * @brief Mixes every active voice into `out`, adding to what it holds. Mono.
+     */
+    void        mix(float* out, unsigned long frames);
+};
+
+/**
+ * @brief Plays a VoicePool. Notes are started and released from a control thread through the command queue, so
+ * they can be scheduled at exact frames too (see AudioStreamBase::scheduleCommand()).
+ */
+class VoicePoolStream : public FloatAudioStream
+{
+private:
+    VoicePool           _pool;
+    std::vector<float>  _mix;
+    float               _hpcoef, _hpin, _hpout;     // DC blocking highpass, as in TrackerStream.
+
+protected:
+    void onCommand(const StreamCommand& cmd);
+
+public:
+    enum Parameters
+    {
+        ParamNoteOn,        // int: note | volume << 8 | duty << 12 | waveform << 14.
+        ParamNoteOff,       // int: note. Releases every voice playing it.
+        ParamAllOff,
+        ParamStealMode      // int: VoicePool::StealMode.
+    };
+
+    VoicePoolStream(unsigned int capacity, unsigned int samplerate = 44100, unsigned int channels = 2);
+
+    bool    noteOn(uint8_t note, uint8_t volume = 15, VoicePool::Waveform waveform = VoicePool::Pulse, uint8_t duty = 2)
+    {
+        return setParameter(ParamNoteOn, (int)note | ((volume & 15) << 8) | ((duty & 3) << 12) | ((int)waveform << 14));
+    }
+
+    bool    noteOff(uint8_t note){return setParameter(ParamNoteOff, (int)note);}
+    bool    allOff(){return setParameter(ParamAllOff, 0);}
+    bool    setStealMode(VoicePool::StealMode mode){return setParameter(ParamStealMode, (int)mode);}
+
+    int floatOut(float* samples, unsigned long frames);
+};
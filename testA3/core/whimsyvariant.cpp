@@ -1303,7 +1303,9 @@ std::string Variant::toJSON_private(std::string identation, bool blankspaces) co
         else
             rval << identation << "{";
 
-        for(std::map<std::string, Variant>::const_iterator mit = data_._HashTable->_data->begin();;)
+        // An empty hashtable has no first element to print.
+        for(std::map<std::string, Variant>::const_iterator mit = data_._HashTable->_data->begin();
+            mit != data_._HashTable->_data->end();)
         {
             if(blankspaces)
                 rval << identation << "\"" << mit->first << "\": " << mit->second.toJSON_private(identation_sep + identation, blankspaces);
@@ -1317,10 +1319,6 @@ std::string Variant::toJSON_private(std::string identation, bool blankspaces) co
                 if(blankspaces)
                     rval << std::endl;
             }
-            else
-            {
-                break;
-            }
         }
 
         if(blankspaces)
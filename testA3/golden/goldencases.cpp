@@ -0,0 +1,213 @@
+#include "whimsygolden.h"
+#include "../portaudio_engine/offlinerendercontext.h"
+#include "../portaudio_engine/metronometest.h"
+#include "../portaudio_engine/squarewavetest.h"
+#include "../portaudio_engine/resamplerstream.h"
+#include "../portaudio_engine/audiomixer.h"
+#include "../chip_engine/trackerexport.h"
+
+using namespace whimsycore;
+using namespace whimsygolden;
+
+// Songs are read relative to the working directory, testA3's source folder (as testA3 itself does).
+#define GOLDEN_PRESET_FILE      "export_files/nes_2a03.json"
+#define GOLDEN_SONG_SECONDS     10
+
+// export_files/music1.json lasts exactly a second. Players render a last block after the end, which the export doesn't.
+#define GOLDEN_MUSIC1_FRAMES    44100
+
+static void renderOffline(Render& out, AudioStreamBase& astream, unsigned long long frames, unsigned long blocksize = 64)
+{
+    OfflineRenderContext    offctx(blocksize);
+
+    out.samplerate =    astream.getSampleRate();
+    out.channels =      astream.getChannelAmount();
+    out.format =        astream.getSampleFormat() & ~paNonInterleaved;
+
+    offctx.setStream(astream);
+    offctx.render(out.data, frames);
+}
+
+/**
+ * @brief A song of a tracker file and its samples, compiled as testA3 does.
+ */
+struct GoldenSong
+{
+    Variant         file;
+    TrackerSong     song;
+    SampleBank      samples;
+
+    GoldenSong(const char* filepath) :
+        file(TrackerSong::readJSON(filepath))
+    {
+        compile();
+    }
+
+    GoldenSong(const Variant& parsed) :
+        file(parsed)
+    {
+        compile();
+    }
+
+    void compile()
+    {
+        song.compile(file, 0, TrackerSong::readJSON(GOLDEN_PRESET_FILE));
+        samples.load(file);
+    }
+};
+
+/**
+ * @brief One square note, muted after a row, then 14 rows of nothing: 96 ticks of 735 frames. The output highpass
+ * decays all the way to digital silence, where any rounding that depends on block sizes would show.
+ */
+#define GOLDEN_SILENCE_FRAMES   (96 * 735)
+
+static Variant silenceSong()
+{
+    std::string json =  "{\"songs\": [{\"name\": \"Silence\", \"tempo\": 150, \"metadata\": {\"basetempo\": 150, \"divider\": 6},"
+                        " \"map\": {\"frame-cols\": {\"SQ01\": 0}, \"frame\": [[0]]},"
+                        " \"patterns\": {\"pattern-cols\": {\"SQ01\": {\"NOTE\": 0, \"VOL\": 1}},"
+                        " \"SQ01\": [[[\"@A-4\", 15], [null, 0]";
+    Variant     parsed;
+
+    for(unsigned int r = 2; r < 16; r++)
+        json += ", [null]";
+    json += "]]}}]}";
+
+    parsed.parse(json.c_str());
+    return parsed;
+}
+
+static void renderSilence(Render& out, unsigned long blocksize)
+{
+    GoldenSong      gs(silenceSong());
+    TrackerStream   player(gs.song, &gs.samples);
+
+    player.setLoop(false);
+    renderOffline(out, player, GOLDEN_SILENCE_FRAMES, blocksize);
+}
+
+static void renderSong(Render& out, const char* filepath, unsigned long long frames, unsigned long blocksize,
+                       JobPool* jobs)
+{
+    GoldenSong      gs(filepath);
+    TrackerStream   player(gs.song, &gs.samples);
+
+    player.setLoop(false);
+    player.setJobPool(jobs);
+    renderOffline(out, player, frames, blocksize);
+}
+
+WHIMSY_GOLDEN(metronome)
+{
+    MetronomeTest   metronome;
+    renderOffline(out, metronome, 4 * 44100);
+}
+
+// Block boundaries must not be heard.
+WHIMSY_GOLDEN_SAME_AS(metronome_odd_blocks, metronome)
+{
+    MetronomeTest   metronome;
+    renderOffline(out, metronome, 4 * 44100, 333);
+}
+
+WHIMSY_GOLDEN(metronome_scheduled_changes)
+{
+    MetronomeTest   metronome;
+
+    metronome.scheduleParameter(44100, MetronomeTest::ParamBPM, 180.0);
+    metronome.scheduleParameter(2 * 44100 + 17, MetronomeTest::ParamVolume, 0.25f);
+    renderOffline(out, metronome, 4 * 44100, 256);
+}
+
+WHIMSY_GOLDEN(squarewave)
+{
+    SquareWaveTest  sqw(440.0f * 1.26f);
+    renderOffline(out, sqw, 2 * 11050);
+}
+
+WHIMSY_GOLDEN(squarewave_resampled)
+{
+    SquareWaveTest  sqw(440.0f * 1.26f);
+    ResamplerStream resampled(sqw, 44100);
+
+    renderOffline(out, resampled, 2 * 44100);
+}
+
+WHIMSY_GOLDEN(music1_stream)
+{
+    renderSong(out, "export_files/music1.json", GOLDEN_MUSIC1_FRAMES, 64, NULL);
+}
+
+// Channels rendered on a JobPool are summed in the same order.
+WHIMSY_GOLDEN_SAME_AS(music1_stream_job_pool, music1_stream)
+{
+    JobPool jobs;
+    renderSong(out, "export_files/music1.json", GOLDEN_MUSIC1_FRAMES, 441, &jobs);
+}
+
+// The parallel export must be bit for bit the player's output.
+WHIMSY_GOLDEN_SAME_AS(music1_export, music1_stream)
+{
+    GoldenSong          gs("export_files/music1.json");
+    TrackerExporter     exporter(gs.song, &gs.samples);
+    JobPool             jobs;
+    std::vector<float>  interleaved;
+
+    exporter.setJobPool(&jobs);
+    exporter.setCheckpointRows(4);
+
+    const unsigned long long frames = exporter.render(interleaved, GOLDEN_SONG_SECONDS);
+
+    out.samplerate =    44100;
+    out.channels =      2;
+    out.format =        paFloat32;
+    out.data.pushArray(reinterpret_cast<const byte*>(&(interleaved[0])), frames * out.channels * sizeof(float));
+}
+
+WHIMSY_GOLDEN(silence_stream)
+{
+    renderSilence(out, 64);
+}
+
+// Callbacks of a tick's length: spans are cut at other frames than with 64 frame blocks.
+WHIMSY_GOLDEN_SAME_AS(silence_stream_tick_blocks, silence_stream)
+{
+    renderSilence(out, 735);
+}
+
+WHIMSY_GOLDEN_SAME_AS(silence_export, silence_stream)
+{
+    GoldenSong          gs(silenceSong());
+    TrackerExporter     exporter(gs.song, &gs.samples);
+    std::vector<float>  interleaved;
+
+    const unsigned long long frames = exporter.render(interleaved, GOLDEN_SONG_SECONDS);
+
+    out.samplerate =    44100;
+    out.channels =      2;
+    out.format =        paFloat32;
+    out.data.pushArray(reinterpret_cast<const byte*>(&(interleaved[0])), frames * out.channels * sizeof(float));
+}
+
+WHIMSY_GOLDEN(music1_looped)
+{
+    GoldenSong      gs("export_files/music1.json");
+    TrackerStream   player(gs.song, &gs.samples);
+
+    player.setLoop(true);
+    renderOffline(out, player, GOLDEN_SONG_SECONDS * 44100, 64);
+}
+
+WHIMSY_GOLDEN(mixer)
+{
+    GoldenSong      gs("export_files/music1.json");
+    TrackerStream   player(gs.song, &gs.samples);
+    MetronomeTest   metronome;
+    AudioMixer      mixer(44100, 2);
+
+    player.setLoop(false);
+    mixer.addStream(player, 0.7f);
+    mixer.addStream(metronome, 0.5f);
+    renderOffline(out, mixer, 4 * 44100, 100);
+}
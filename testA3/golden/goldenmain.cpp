@@ -0,0 +1,529 @@
+#include "whimsygolden.h"
+#include "../portaudio_engine/offlinerendercontext.h"
+#include "../portaudio_engine/sampleconversion.h"
+#include "../portaudio_engine/rtsafety.h"
+#include "../portaudio_engine/denormals.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+
+using namespace whimsycore;
+using namespace whimsygolden;
+
+// Frames summarized by every point of a channel envelope.
+#define GOLDEN_ENVELOPE_FRAMES  4096
+
+// Largest envelope deviation still accepted when the hashes differ, in full scale units (-80dBFS).
+#define GOLDEN_TOLERANCE        1e-4
+
+#define GOLDEN_DEFAULT_FILE     "golden/goldens.txt"
+
+std::vector<Case>& whimsygolden::registry()
+{
+    static std::vector<Case> cases;
+    return cases;
+}
+
+/**
+ * @brief What is stored of a render: hashes, and a peak/RMS envelope per channel for tolerant comparisons.
+ */
+struct Fingerprint
+{
+    struct Channel
+    {
+        unsigned long long  hash;
+        std::vector<double> rms, peak;
+    };
+
+    unsigned long long      frames;
+    unsigned int            channels;
+    unsigned long long      hash;
+    std::vector<Channel>    perchannel;
+};
+
+// FNV-1a, 64 bits.
+#define GOLDEN_FNV_OFFSET       14695981039346656037ULL
+#define GOLDEN_FNV_PRIME        1099511628211ULL
+
+static void hashBytes(unsigned long long& hash, const byte* data, size_t size)
+{
+    for(size_t i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * GOLDEN_FNV_PRIME;
+}
+
+static Fingerprint fingerprint(const Render& render)
+{
+    const unsigned int  samplebytes =   SampleConversion::bytesPerSample(render.format);
+    const size_t        framebytes =    render.channels * samplebytes;
+    const byte*         data =          render.data.begin();
+    Fingerprint         fp;
+
+    fp.channels =   render.channels;
+    fp.frames =     (framebytes > 0) ? render.data.size() / framebytes : 0;
+    fp.hash =       GOLDEN_FNV_OFFSET;
+    fp.perchannel.resize(render.channels);
+
+    hashBytes(fp.hash, data, (size_t)(fp.frames * framebytes));
+
+    std::vector<float>  block(GOLDEN_ENVELOPE_FRAMES * render.channels);
+
+    for(unsigned int c = 0; c < render.channels; c++)
+        fp.perchannel[c].hash = GOLDEN_FNV_OFFSET;
+
+    for(unsigned long long start = 0; start < fp.frames; start += GOLDEN_ENVELOPE_FRAMES)
+    {
+        const unsigned long long    count = (fp.frames - start < GOLDEN_ENVELOPE_FRAMES) ?
+                                            fp.frames - start : GOLDEN_ENVELOPE_FRAMES;
+        const byte*                 native = data + start * framebytes;
+
+        SampleConversion::toFloat(native, render.format, &(block[0]), (size_t)(count * render.channels));
+
+        for(unsigned int c = 0; c < render.channels; c++)
+        {
+            Fingerprint::Channel&   ch =    fp.perchannel[c];
+            double                  sum =   0.0, peak = 0.0;
+
+            for(unsigned long long f = 0; f < count; f++)
+            {
+                const double x = block[f * render.channels + c];
+
+                sum += x * x;
+                if(std::fabs(x) > peak)
+                    peak = std::fabs(x);
+
+                hashBytes(ch.hash, native + f * framebytes + c * samplebytes, samplebytes);
+            }
+
+            ch.rms.push_back(std::sqrt(sum / count));
+            ch.peak.push_back(peak);
+        }
+    }
+
+    return fp;
+}
+
+/**
+ * @brief Reads goldens.txt. Every case is a `case <name> <frames> <channels> <hash>` line, followed for every channel
+ * by a `channel <index> <hash>` line and two lines, `rms` and `peak`, with one value per envelope block.
+ */
+static std::map<std::string, Fingerprint> readGoldens(const char* filepath)
+{
+    std::map<std::string, Fingerprint>  goldens;
+    std::ifstream                       in(filepath);
+    std::string                         token, name;
+
+    while(in >> token)
+    {
+        if(token[0] == '#')
+        {
+            std::getline(in, token);
+            continue;
+        }
+
+        if(token != "case")
+            throw Exception(NULL, Exception::ParserSyntaxError, "Golden file: expected a case line");
+
+        Fingerprint fp;
+
+        in >> name >> fp.frames >> fp.channels >> std::hex >> fp.hash >> std::dec;
+        fp.perchannel.resize(fp.channels);
+
+        const unsigned long long blocks = (fp.frames + GOLDEN_ENVELOPE_FRAMES - 1) / GOLDEN_ENVELOPE_FRAMES;
+
+        for(unsigned int c = 0; c < fp.channels; c++)
+        {
+            Fingerprint::Channel&   ch = fp.perchannel[c];
+            unsigned int            index;
+
+            in >> token >> index >> std::hex >> ch.hash >> std::dec;
+            ch.rms.resize(blocks);
+            ch.peak.resize(blocks);
+
+            in >> token;
+            for(unsigned long long b = 0; b < blocks; b++)
+                in >> ch.rms[b];
+            in >> token;
+            for(unsigned long long b = 0; b < blocks; b++)
+                in >> ch.peak[b];
+        }
+
+        if(!in)
+            throw Exception(NULL, Exception::ParserSyntaxError, "Golden file: truncated case");
+
+        goldens[name] = fp;
+    }
+
+    return goldens;
+}
+
+static void writeGoldens(const char* filepath, const std::map<std::string, Fingerprint>& goldens)
+{
+    std::FILE* fhandler = std::fopen(filepath, "w");
+    if(!fhandler)
+        throw Exception(NULL, Exception::CouldNotOpenFileForWriting, filepath);
+
+    std::fprintf(fhandler, "# Golden renders of whimsy_golden. Regenerate with `whimsy_golden --update`, only after a\n"
+                           "# change meant to alter the output.\n");
+
+    // Registry order, so diffs of this file stay readable.
+    for(std::vector<Case>::const_iterator it = registry().begin(); it != registry().end(); it++)
+    {
+        std::map<std::string, Fingerprint>::const_iterator found = goldens.find(it->name);
+        if(found == goldens.end())
+            continue;
+
+        const Fingerprint& fp = found->second;
+
+        std::fprintf(fhandler, "case %s %llu %u %016llx\n", it->name, fp.frames, fp.channels, fp.hash);
+
+        for(unsigned int c = 0; c < fp.channels; c++)
+        {
+            const Fingerprint::Channel& ch = fp.perchannel[c];
+
+            std::fprintf(fhandler, "channel %u %016llx\nrms", c, ch.hash);
+            for(size_t b = 0; b < ch.rms.size(); b++)
+                std::fprintf(fhandler, " %.9g", ch.rms[b]);
+            std::fprintf(fhandler, "\npeak");
+            for(size_t b = 0; b < ch.peak.size(); b++)
+                std::fprintf(fhandler, " %.9g", ch.peak[b]);
+            std::fprintf(fhandler, "\n");
+        }
+    }
+
+    std::fclose(fhandler);
+}
+
+static double decibels(double x)
+{
+    return (x > 1e-10) ? 20.0 * std::log10(x) : -200.0;
+}
+
+static double maxOf(const std::vector<double>& v)
+{
+    double m = 0.0;
+
+    for(size_t i = 0; i < v.size(); i++)
+        if(v[i] > m)
+            m = v[i];
+    return m;
+}
+
+static double rmsOf(const std::vector<double>& rms, unsigned long long frames)
+{
+    double sum = 0.0;
+
+    for(size_t b = 0; b < rms.size(); b++)
+    {
+        const unsigned long long count = (b + 1 < rms.size()) ? GOLDEN_ENVELOPE_FRAMES :
+                                         frames - b * GOLDEN_ENVELOPE_FRAMES;
+        sum += rms[b] * rms[b] * count;
+    }
+    return (frames > 0) ? std::sqrt(sum / frames) : 0.0;
+}
+
+/**
+ * @brief Compares a render with its golden and prints a per channel summary if they differ.
+ * @return  true if the envelopes of every channel are within `tolerance`.
+ */
+static bool compare(const Fingerprint& golden, const Fingerprint& fp, unsigned int samplerate, double tolerance)
+{
+    if(golden.frames != fp.frames || golden.channels != fp.channels)
+    {
+        std::printf("    layout differs: %llu frames of %u channels, golden has %llu frames of %u channels\n",
+                    fp.frames, fp.channels, golden.frames, golden.channels);
+        return false;
+    }
+
+    bool within = true;
+
+    for(unsigned int c = 0; c < fp.channels; c++)
+    {
+        const Fingerprint::Channel& g =     golden.perchannel[c];
+        const Fingerprint::Channel& ch =    fp.perchannel[c];
+
+        if(g.hash == ch.hash)
+        {
+            std::printf("    channel %u: identical\n", c);
+            continue;
+        }
+
+        double  deviation = 0.0;
+        size_t  worst = 0, first = ch.rms.size();
+
+        for(size_t b = 0; b < ch.rms.size(); b++)
+        {
+            const double d = std::max(std::fabs(ch.rms[b] - g.rms[b]), std::fabs(ch.peak[b] - g.peak[b]));
+
+            if(d > tolerance && first == ch.rms.size())
+                first = b;
+            if(d > deviation)
+            {
+                deviation = d;
+                worst = b;
+            }
+        }
+
+        std::printf("    channel %u: samples differ. peak %.2f -> %.2f dBFS, rms %.2f -> %.2f dBFS, "
+                    "largest envelope deviation %.3g (%.1f dBFS) at %.3fs",
+                    c, decibels(maxOf(g.peak)), decibels(maxOf(ch.peak)),
+                    decibels(rmsOf(g.rms, golden.frames)), decibels(rmsOf(ch.rms, fp.frames)),
+                    deviation, decibels(deviation), (double)worst * GOLDEN_ENVELOPE_FRAMES / samplerate);
+
+        if(first < ch.rms.size())
+        {
+            std::printf(", beyond tolerance from %.3fs\n", (double)first * GOLDEN_ENVELOPE_FRAMES / samplerate);
+            within = false;
+        }
+        else
+            std::printf(", within tolerance\n");
+    }
+
+    return within;
+}
+
+static void writeWav(const std::string& dir, const char* name, const Render& render)
+{
+    const std::string   filepath =  dir + "/" + name + ".wav";
+    ByteStream          header =    OfflineRenderContext::wavHeader(render.samplerate, render.channels, render.format,
+                                                                    (unsigned long)render.data.size());
+
+    std::FILE* fhandler = std::fopen(filepath.c_str(), "wb");
+    if(!fhandler)
+        throw Exception(NULL, Exception::CouldNotOpenFileForWriting, filepath.c_str());
+
+    std::fwrite(header.lowLevelData(), header.size(), 1, fhandler);
+    if(render.data.size() > 0)
+        std::fwrite(render.data.begin(), render.data.size(), 1, fhandler);
+    std::fclose(fhandler);
+}
+
+static int usage(const char* error)
+{
+    std::printf("%s\n"
+                "Usage: whimsy_golden [--update] [--exact] [--tolerance <x>] [--isa scalar|sse2|avx2] [--wav <dir>]\n"
+                "                     [--goldens <file>] [filter]\n", error);
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    // Only cases whose name contains `filter` are run. --wav writes every render, to listen to what changed.
+    const char*     filter =    "";
+    const char*     goldfile =  GOLDEN_DEFAULT_FILE;
+    std::string     wavdir;
+    bool            update =    false, exact = false;
+    double          tolerance = GOLDEN_TOLERANCE;
+
+    for(int a = 1; a < argc; a++)
+    {
+        const std::string arg = argv[a];
+
+        if(arg == "--update")
+            update = true;
+        else if(arg == "--exact")
+            exact = true;
+        else if(arg == "--tolerance" && a + 1 < argc)
+            tolerance = std::atof(argv[++a]);
+        else if(arg == "--goldens" && a + 1 < argc)
+            goldfile = argv[++a];
+        else if(arg == "--wav" && a + 1 < argc)
+            wavdir = argv[++a];
+        else if(arg == "--isa" && a + 1 < argc)
+        {
+            const std::string isa = argv[++a];
+
+            if(isa != "scalar" && isa != "sse2" && isa != "avx2")
+                return usage(("Unknown instruction set: " + isa).c_str());
+
+            // Conversions are bit exact on every instruction set: the same goldens hold for all of them.
+            SampleConversion::setInstructionSet(isa == "scalar" ? SampleConversion::Scalar :
+                                                isa == "sse2" ? SampleConversion::SSE2 : SampleConversion::AVX2);
+        }
+        else if(arg.compare(0, 2, "--") == 0)
+            return usage(("Unknown option, or missing value: " + arg).c_str());
+        else
+            filter = argv[a];
+    }
+
+    std::map<std::string, Fingerprint> goldens;
+
+    try
+    {
+        goldens = readGoldens(goldfile);
+    }
+    catch(Exception& e)
+    {
+        std::cout << goldfile << ": " << e.what() << std::endl;
+        if(!update)
+            return 1;
+    }
+
+    std::cout << "Sample conversions: " << SampleConversion::instructionSetToString(SampleConversion::instructionSet())
+              << std::endl;
+
+    std::map<std::string, unsigned long long>   rendered;       // Hash of every case rendered in this run.
+    std::set<std::string>                       failed;
+    unsigned int                                run = 0;
+
+    for(std::vector<Case>::const_iterator it = registry().begin(); it != registry().end(); it++)
+    {
+        if(std::strstr(it->name, filter) == NULL)
+            continue;
+
+        Render          render;
+        Fingerprint     fp;
+
+        run++;
+
+        try
+        {
+            it->function(render);
+            fp = fingerprint(render);
+        }
+        catch(Exception& e)
+        {
+            std::printf("%-32s FAILED  %s\n", it->name, e.what());
+            failed.insert(it->name);
+            continue;
+        }
+
+        rendered[it->name] = fp.hash;
+
+        if(!wavdir.empty())
+            writeWav(wavdir, it->name, render);
+
+        std::map<std::string, Fingerprint>::const_iterator found = goldens.find(it->name);
+
+        if(update)
+        {
+            const bool changed = (found == goldens.end() || found->second.hash != fp.hash);
+
+            std::printf("%-32s %s  %016llx\n", it->name, changed ? "updated" : "same   ", fp.hash);
+            goldens[it->name] = fp;
+        }
+        else if(found == goldens.end())
+        {
+            std::printf("%-32s FAILED  no golden render, run with --update\n", it->name);
+            failed.insert(it->name);
+        }
+        else if(found->second.hash == fp.hash)
+            std::printf("%-32s ok      %016llx\n", it->name, fp.hash);
+        else
+        {
+            std::printf("%-32s differs %016llx, golden %016llx\n", it->name, fp.hash, found->second.hash);
+
+            if(!compare(found->second, fp, render.samplerate, tolerance) || exact)
+            {
+                std::printf("%-32s FAILED\n", it->name);
+                failed.insert(it->name);
+            }
+        }
+    }
+
+    // Cases that must give the samples of another one, whatever the goldens say. References left out by the filter
+    // are rendered now.
+    unsigned int diverged = 0;
+
+    for(std::vector<Case>::const_iterator it = registry().begin(); it != registry().end(); it++)
+    {
+        if(it->sameas == NULL || rendered.find(it->name) == rendered.end())
+            continue;
+
+        if(rendered.find(it->sameas) == rendered.end())
+        {
+            for(std::vector<Case>::const_iterator ref = registry().begin(); ref != registry().end(); ref++)
+            {
+                if(std::strcmp(ref->name, it->sameas) != 0)
+                    continue;
+
+                Render render;
+
+                try
+                {
+                    ref->function(render);
+                    rendered[ref->name] = fingerprint(render).hash;
+                }
+                catch(Exception& e)
+                {
+                    std::printf("%-32s FAILED  %s\n", ref->name, e.what());
+                }
+            }
+        }
+
+        std::map<std::string, unsigned long long>::const_iterator reference = rendered.find(it->sameas);
+
+        if(reference == rendered.end())
+        {
+            std::printf("%-32s FAILED  reference case %s could not be rendered\n", it->name, it->sameas);
+            failed.insert(it->name);
+            diverged++;
+        }
+        else if(reference->second != rendered[it->name])
+        {
+            std::printf("%-32s FAILED  samples differ from %s (%016llx, %016llx)\n", it->name, it->sameas,
+                        rendered[it->name], reference->second);
+            failed.insert(it->name);
+            diverged++;
+        }
+    }
+
+    // With WHIMSY_RT_CHECK, the renders are also the real-time safety gate: every allocation, lock or throw made from
+    // a callback fails the run.
+    const bool rtviolations = RealtimeChecker::isCompiledIn() && RealtimeChecker::violationCount() > 0;
+
+    if(RealtimeChecker::isCompiledIn())
+        RealtimeChecker::printReport(stdout);
+
+    // Debug builds also check that every render ran under a DenormalGuard, and that nothing turned flushing off.
+    bool denormalguards = true;
+
+#if !defined(NDEBUG)
+    denormalguards = DenormalGuard::lostCount() == 0 && DenormalGuard::guardCount() > 0;
+    std::printf("Denormal guards: %llu opened, %llu lost\n", DenormalGuard::guardCount(), DenormalGuard::lostCount());
+#endif
+
+    // A filter that matches nothing is a typo, not a pass.
+    if(run == 0)
+    {
+        std::printf("No case matches \"%s\"\n", filter);
+        return 1;
+    }
+
+    if(update)
+    {
+        if(diverged > 0)
+        {
+            std::printf("%u cases differ from the case they must match: goldens not written\n", diverged);
+            return 1;
+        }
+        if(rtviolations)
+        {
+            std::printf("Callbacks broke real-time rules: goldens not written\n");
+            return 1;
+        }
+        if(!denormalguards)
+        {
+            std::printf("Renders ran without denormal flushing: goldens not written\n");
+            return 1;
+        }
+
+        writeGoldens(goldfile, goldens);
+        std::printf("%u golden renders written to %s\n", run, goldfile);
+        return 0;
+    }
+
+    std::printf("%u of %u cases passed\n", run - (unsigned int)failed.size(), run);
+    if(rtviolations)
+        std::printf("FAILED: callbacks broke real-time rules, see the report above\n");
+    if(!denormalguards)
+        std::printf("FAILED: renders ran without denormal flushing\n");
+    return (failed.empty() && !rtviolations && denormalguards) ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "portaudio.h"
+#include "../whimsycore.h"
+
+#include <vector>
+
+/**
+ * Golden render harness for the whimsy_golden target.
+ *
+ * Every case renders a fixed song or test stream through the offline path. The runner fingerprints the output and
+ * compares it with the fingerprints stored in golden/goldens.txt: a hash of the samples, and per channel, a hash and a
+ * coarse peak/RMS envelope. Identical hashes pass. When they differ, the envelopes tell how far the output moved, and a
+ * difference summary is printed for every channel; outputs within the tolerance still pass, unless --exact is given.
+ *
+ * ## How to write a case ##
+ * Use the WHIMSY_GOLDEN macro in any .cpp file of the golden folder, and render into `out`. Cases must give the same
+ * samples on every run: no wall clock, no random seeds, no sound card. After a change that is meant to alter the
+ * output, run `whimsy_golden --update` and commit the new goldens.txt along with it.
+ *
+ * A case declared with WHIMSY_GOLDEN_SAME_AS must give exactly the samples of another case (the same song through
+ * another path, at another block size...). The runner checks it on every run, --update included, so both can't drift
+ * apart even when their goldens are regenerated together.
+ */
+namespace whimsygolden
+{
+
+/**
+ * @brief Output of a case: interleaved samples in the stream's native format.
+ */
+struct Render
+{
+    unsigned int            samplerate;
+    unsigned int            channels;
+    PaSampleFormat          format;
+    whimsycore::ByteStream  data;
+
+    Render() : samplerate(44100), channels(2), format(paFloat32) {}
+};
+
+typedef void (*GoldenFunction)(Render&);
+
+struct Case
+{
+    const char*         name;
+    GoldenFunction      function;
+    const char*         sameas;     // Case whose samples this one must match, or NULL.
+};
+
+/**
+ * @brief List of every registered case.
+ */
+std::vector<Case>& registry();
+
+struct Registrar
+{
+    Registrar(const char* name, GoldenFunction function, const char* sameas = NULL)
+    {
+        Case c = {name, function, sameas};
+        registry().push_back(c);
+    }
+};
+
+}
+
+#define WHIMSY_GOLDEN(NAME) \
+    static void NAME(whimsygolden::Render& out); \
+    static whimsygolden::Registrar NAME##_registrar(#NAME, NAME); \
+    static void NAME(whimsygolden::Render& out)
+
+#define WHIMSY_GOLDEN_SAME_AS(NAME, REFERENCE) \
+    static void NAME(whimsygolden::Render& out); \
+    static whimsygolden::Registrar NAME##_registrar(#NAME, NAME, #REFERENCE); \
+    static void NAME(whimsygolden::Render& out)
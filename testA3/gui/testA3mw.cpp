@@ -1,16 +1,176 @@
 #include "testA3mw.h"
 
-TestA3MW::TestA3MW(QWidget *parent)
+// Lowest level shown by the meters, and how fast a shown peak falls back, per refresh.
+#define METER_FLOOR_DB          -60.0f
+#define METER_PEAK_FALL_DB      1.5f
+#define METER_REFRESH_MS        33
+
+// Frames shown by the scope, and by the waveform view while following.
+#define SCOPE_FRAMES            2048
+#define WAVEFORM_FOLLOW_SECONDS 10.0
+
+TestA3MW::TestA3MW(QWidget *parent) :
+    QWidget(parent),
+    _pactx(NULL),
+    _tap(NULL),
+    _overview(NULL)
 {
     this->setWindowTitle("Metronome with PortAudio and Qt5");
+
+    mainlayout =    new QGridLayout();
+    clipbutton =    new QPushButton("Reset clips");
+    allbutton =     new QPushButton("Whole song");
+    followbutton =  new QPushButton("Follow");
+    metertimer =    new QTimer(this);
+    scopeview =     new WaveformView();
+    waveview =      new WaveformView();
+
+    for(unsigned int r = 0; r <= LEVELMETER_MAX_CHANNELS; r++)
+    {
+        MeterRow& row = _meters[r];
+
+        row.name =      new QLabel((r < LEVELMETER_MAX_CHANNELS) ? QString("Ch %1").arg(r + 1) : QString("Master"));
+        row.peak =      new QProgressBar();
+        row.rms =       new QProgressBar();
+        row.clip =      new QLabel();
+        row.shownpeak = METER_FLOOR_DB;
+
+        // Tenths of dB.
+        row.peak->setRange((int)(METER_FLOOR_DB * 10.0f), 0);
+        row.rms->setRange((int)(METER_FLOOR_DB * 10.0f), 0);
+        row.peak->setTextVisible(false);
+        row.rms->setTextVisible(false);
+
+        mainlayout->addWidget(row.name, r, 0);
+        mainlayout->addWidget(row.peak, r, 1);
+        mainlayout->addWidget(row.rms, r, 2);
+        mainlayout->addWidget(row.clip, r, 3);
+
+        setMeterRow(row, 0.0f, 0.0f, 0);
+    }
+
+    mainlayout->addWidget(clipbutton, LEVELMETER_MAX_CHANNELS + 1, 0, 1, 4);
+    mainlayout->addWidget(scopeview, LEVELMETER_MAX_CHANNELS + 2, 0, 1, 4);
+    mainlayout->addWidget(waveview, LEVELMETER_MAX_CHANNELS + 3, 0, 1, 4);
+    mainlayout->addWidget(allbutton, LEVELMETER_MAX_CHANNELS + 4, 0, 1, 2);
+    mainlayout->addWidget(followbutton, LEVELMETER_MAX_CHANNELS + 4, 2, 1, 2);
+    this->setLayout(mainlayout);
+
+    QObject::connect(metertimer, SIGNAL(timeout()), this, SLOT(updateMeters()));
+    QObject::connect(metertimer, SIGNAL(timeout()), this, SLOT(updateWaveforms()));
+    QObject::connect(clipbutton, SIGNAL(clicked(bool)), this, SLOT(resetClips()));
+    QObject::connect(allbutton, SIGNAL(clicked(bool)), this, SLOT(showWholeWaveform()));
+    QObject::connect(followbutton, SIGNAL(clicked(bool)), this, SLOT(followWaveform()));
+
+    metertimer->start(METER_REFRESH_MS);
 }
 
 
 TestA3MW::~TestA3MW()
 {
+    metertimer->stop();
+    delete mainlayout;
+    delete _overview;
 }
 
 void TestA3MW::setPortAudioContext(ScopedPAContext* pactx)
 {
     _pactx = pactx;
 }
+
+void TestA3MW::setScopeTap(ScopeTapStream* tap)
+{
+    _tap = tap;
+
+    delete _overview;
+    _overview = (tap != NULL) ? new WaveformOverview(tap->getChannelAmount()) : NULL;
+
+    _scopeframes.clear();
+    waveview->setOverview(_overview);
+
+    followWaveform();
+}
+
+void TestA3MW::updateWaveforms()
+{
+    if(_tap == NULL)
+        return;
+
+    const unsigned int  channels =  _tap->getChannelAmount();
+    const size_t        available = _tap->available();
+
+    if(available == 0)
+        return;
+
+    _drained.resize(available * channels);
+    const size_t got = _tap->read(&(_drained[0]), available);
+
+    _overview->append(&(_drained[0]), got);
+
+    // The scope keeps the last SCOPE_FRAMES frames.
+    _scopeframes.insert(_scopeframes.end(), _drained.begin(), _drained.begin() + got * channels);
+    if(_scopeframes.size() > SCOPE_FRAMES * channels)
+        _scopeframes.erase(_scopeframes.begin(), _scopeframes.end() - SCOPE_FRAMES * channels);
+
+    scopeview->setScope(&(_scopeframes[0]), _scopeframes.size() / channels, channels);
+    waveview->update();
+}
+
+void TestA3MW::showWholeWaveform()
+{
+    waveview->showAll();
+}
+
+void TestA3MW::followWaveform()
+{
+    if(_tap != NULL)
+        waveview->follow(WAVEFORM_FOLLOW_SECONDS * _tap->getSampleRateDouble());
+}
+
+void TestA3MW::setMeterRow(MeterRow& row, float peak, float rms, unsigned long long clips)
+{
+    const float peakdb =    LevelMeter::Snapshot::toDecibels(peak);
+    const float rmsdb =     LevelMeter::Snapshot::toDecibels(rms);
+
+    row.shownpeak -= METER_PEAK_FALL_DB;
+    if(peakdb > row.shownpeak)
+        row.shownpeak = peakdb;
+    if(row.shownpeak < METER_FLOOR_DB)
+        row.shownpeak = METER_FLOOR_DB;
+
+    row.peak->setValue((int)(row.shownpeak * 10.0f));
+    row.rms->setValue((int)(((rmsdb > METER_FLOOR_DB) ? rmsdb : METER_FLOOR_DB) * 10.0f));
+    row.peak->setToolTip(QString("Peak %1 dBFS").arg(peakdb, 0, 'f', 1));
+    row.rms->setToolTip(QString("RMS %1 dBFS").arg(rmsdb, 0, 'f', 1));
+
+    row.clip->setText((clips > 0) ? QString("CLIP (%1)").arg(clips) : QString());
+}
+
+void TestA3MW::updateMeters()
+{
+    if(_pactx == NULL)
+        return;
+
+    const LevelMeter::Snapshot levels = _pactx->levels();
+
+    for(unsigned int c = 0; c < LEVELMETER_MAX_CHANNELS; c++)
+    {
+        const bool used = c < levels.channels;
+
+        _meters[c].name->setVisible(used);
+        _meters[c].peak->setVisible(used);
+        _meters[c].rms->setVisible(used);
+        _meters[c].clip->setVisible(used);
+
+        if(used)
+            setMeterRow(_meters[c], levels.peak[c], levels.rms[c], levels.clips[c]);
+    }
+
+    setMeterRow(_meters[LEVELMETER_MAX_CHANNELS], levels.masterPeak, levels.masterRms, levels.masterClips);
+}
+
+void TestA3MW::resetClips()
+{
+    if(_pactx != NULL)
+        _pactx->resetLevels();
+}
@@ -7,8 +7,13 @@
 #include <QDebug>
 #include <QLabel>
 #include <QComboBox>
+#include <QProgressBar>
+#include <QTimer>
 
 #include "../portaudio_engine/scopedPAContext.h"
+#include "../portaudio_engine/scopetapstream.h"
+#include "../portaudio_engine/waveformoverview.h"
+#include "waveformview.h"
 
 
 class TestA3MW : public QWidget
@@ -21,6 +26,42 @@ public:
 
     void setPortAudioContext(ScopedPAContext* pactx);
 
+    /**
+     * @brief Tap whose output the scope and the waveform view show. It must be the stream being played, or be fed
+     * by it. Call it before playing.
+     */
+    void setScopeTap(ScopeTapStream* tap);
+
+public slots:
+    void updateMeters();
+    void updateWaveforms();
+    void resetClips();
+    void showWholeWaveform();
+    void followWaveform();
+
 private:
+    // One row per output channel, and the master row last.
+    struct MeterRow
+    {
+        QLabel*         name;
+        QProgressBar*   peak;
+        QProgressBar*   rms;
+        QLabel*         clip;
+        float           shownpeak;      // dB, falls back slowly so short peaks can be seen.
+    };
+
     ScopedPAContext*    _pactx;
+    ScopeTapStream*     _tap;
+
+    WaveformOverview*   _overview;
+    std::vector<float>  _drained;           // Read from the tap, before going to the overview.
+    std::vector<float>  _scopeframes;       // Last frames read, for the scope.
+
+    MeterRow            _meters[LEVELMETER_MAX_CHANNELS + 1];
+    QGridLayout*        mainlayout;
+    QPushButton*        clipbutton, *allbutton, *followbutton;
+    QTimer*             metertimer;
+    WaveformView*       scopeview, *waveview;
+
+    void    setMeterRow(MeterRow& row, float peak, float rms, unsigned long long clips);
 };
@@ -0,0 +1,120 @@
+#include "waveformview.h"
+
+#include <QPainter>
+
+// Zoom applied by a wheel notch.
+#define WAVEFORM_ZOOM_STEP      1.25
+
+WaveformView::WaveformView(QWidget* parent) :
+    QWidget(parent),
+    _overview(NULL),
+    _begin(0.0),
+    _framespercolumn(1.0),
+    _followframes(0.0),
+    _scopechannels(0)
+{
+    setMinimumHeight(80);
+}
+
+void WaveformView::setOverview(const WaveformOverview* overview)
+{
+    _overview = overview;
+    update();
+}
+
+void WaveformView::setView(double begin, double framespercolumn)
+{
+    _begin =            begin;
+    _framespercolumn =  (framespercolumn > 0.0) ? framespercolumn : 1.0;
+    _followframes =     0.0;
+    update();
+}
+
+void WaveformView::showAll()
+{
+    if(_overview != NULL && width() > 0)
+        setView(0.0, (double)_overview->frames() / width());
+}
+
+void WaveformView::follow(double frames)
+{
+    _followframes = (frames > 0.0) ? frames : 0.0;
+    update();
+}
+
+void WaveformView::setScope(const float* frames, size_t count, unsigned int channels)
+{
+    _scope.assign(frames, frames + count * channels);
+    _scopechannels = channels;
+    update();
+}
+
+void WaveformView::wheelEvent(QWheelEvent* event)
+{
+    const double    zoom =  (event->angleDelta().y() > 0) ? 1.0 / WAVEFORM_ZOOM_STEP : WAVEFORM_ZOOM_STEP;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    const double    x =     event->position().x();
+#else
+    const double    x =     event->posF().x();
+#endif
+
+    // The frame under the pointer stays there.
+    setView(_begin + x * _framespercolumn * (1.0 - zoom), _framespercolumn * zoom);
+    event->accept();
+}
+
+void WaveformView::paintEvent(QPaintEvent* event)
+{
+    QPainter            painter(this);
+    const int           columns =   width();
+    const unsigned int  channels =  !_scope.empty() ? _scopechannels : (_overview != NULL ? _overview->channels() : 0);
+    (void) event;
+
+    painter.fillRect(rect(), Qt::black);
+    if(channels == 0 || columns <= 0)
+        return;
+
+    const double lane = (double)height() / channels;
+
+    painter.setPen(QColor(80, 220, 120));
+
+    if(!_scope.empty())
+    {
+        const size_t frames = _scope.size() / _scopechannels;
+
+        for(unsigned int c = 0; c < channels; c++)
+        {
+            const double    middle =    lane * (c + 0.5);
+            QPointF         previous;
+
+            for(size_t f = 0; f < frames; f++)
+            {
+                const QPointF point((double)f * columns / frames, middle - _scope[f * channels + c] * lane * 0.5);
+
+                if(f > 0)
+                    painter.drawLine(previous, point);
+                previous = point;
+            }
+        }
+        return;
+    }
+
+    if(_followframes > 0.0)
+    {
+        _framespercolumn =  _followframes / columns;
+        _begin =            (double)_overview->frames() - _followframes;
+    }
+
+    _low.resize(columns);
+    _high.resize(columns);
+
+    for(unsigned int c = 0; c < channels; c++)
+    {
+        const double middle = lane * (c + 0.5);
+
+        _overview->summarize(c, _begin, _framespercolumn, columns, &(_low[0]), &(_high[0]));
+
+        for(int x = 0; x < columns; x++)
+            painter.drawLine(QPointF(x, middle - _high[x] * lane * 0.5), QPointF(x, middle - _low[x] * lane * 0.5));
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QWidget>
+#include <QWheelEvent>
+#include <QPaintEvent>
+
+#include <vector>
+
+#include "../portaudio_engine/waveformoverview.h"
+
+/**
+ * @brief Draws a WaveformOverview, one lane per channel, a min/max column per pixel. The mouse wheel zooms around the
+ * pointer. While following, the view keeps showing the end of the waveform as it grows.
+ *
+ * With setScope(), it draws a few raw frames as a line instead, as an oscilloscope.
+ */
+class WaveformView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    WaveformView(QWidget* parent = NULL);
+
+    /**
+     * @brief Waveform to draw. It must outlive the view, or be replaced.
+     */
+    void    setOverview(const WaveformOverview* overview);
+
+    /**
+     * @brief Shows frames from `begin` on, `framespercolumn` frames per pixel. Stops following.
+     */
+    void    setView(double begin, double framespercolumn);
+
+    /**
+     * @brief Shows the whole waveform.
+     */
+    void    showAll();
+
+    /**
+     * @brief Keeps the last `frames` frames in view.
+     */
+    void    follow(double frames);
+
+    /**
+     * @brief Draws these interleaved frames instead of the overview.
+     */
+    void    setScope(const float* frames, size_t count, unsigned int channels);
+
+protected:
+    void    paintEvent(QPaintEvent* event);
+    void    wheelEvent(QWheelEvent* event);
+
+private:
+    const WaveformOverview* _overview;
+    double                  _begin, _framespercolumn;
+    double                  _followframes;          // 0 when not following.
+
+    std::vector<float>      _scope;
+    unsigned int            _scopechannels;
+
+    std::vector<float>      _low, _high;
+};
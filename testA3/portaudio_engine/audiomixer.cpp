@@ -0,0 +1,260 @@
+#include "audiomixer.h"
+#include "sampleconversion.h"
+
+#include <chrono>
+#include <thread>
+#include <cstring>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// How long removeStream() waits for a callback before assuming the mixer is not playing.
+#define AUDIOMIXER_IDLE_TIMEOUT_MS      50
+
+AudioMixer::AudioMixer(unsigned int samplerate, unsigned int channels, unsigned int maxstreams, unsigned long maxframes) :
+    FloatAudioStream(samplerate, channels, paFloat32, maxframes),
+    _slots(maxstreams),
+    _maxframes(maxframes > 0 ? maxframes : 1),
+    _generation(0),
+    _timeinfo(NULL),
+    _statusflags(0)
+{
+    // Big enough for any native format: 4 bytes per sample at most.
+    _nativebuffer.resize(_maxframes * channels * 4);
+    _floatbuffer.resize(_maxframes * channels);
+    _planarbuffer.resize(_maxframes * channels * 4);
+    _planes.resize(channels);
+}
+
+AudioMixer::Slot* AudioMixer::findSlot(const AudioStreamBase* astream)
+{
+    for(size_t i = 0; i < _slots.size(); i++)
+    {
+        if(_slots[i].stream.load(std::memory_order_acquire) == astream)
+            return &(_slots[i]);
+    }
+    return NULL;
+}
+
+void AudioMixer::waitForCallback()
+{
+    // seq_cst, like the slot release before it: see audioOut().
+    const unsigned long generation = _generation.load(std::memory_order_seq_cst);
+
+    if(generation & 1)
+    {
+        while(_generation.load(std::memory_order_seq_cst) == generation)
+            std::this_thread::yield();
+    }
+}
+
+bool AudioMixer::addStream(AudioStreamBase& astream, float gain)
+{
+    if(astream.getSampleRate() != _samplerate || astream.getChannelAmount() != _channels)
+        return false;
+
+    if(SampleConversion::bytesPerSample(astream.getSampleFormat()) == 0 || findSlot(&astream) != NULL)
+        return false;
+
+    Slot* slot = findSlot(NULL);
+    if(slot == NULL)
+        return false;
+
+    // The audio thread doesn't look at empty slots, so we can set them up freely before publishing the stream.
+    slot->currentgain = 0.0f;
+    slot->targetgain.store(gain, std::memory_order_relaxed);
+    slot->removing.store(false, std::memory_order_relaxed);
+    slot->stream.store(&astream, std::memory_order_release);
+
+    return true;
+}
+
+bool AudioMixer::removeStream(AudioStreamBase& astream)
+{
+    Slot* slot = findSlot(&astream);
+    if(slot == NULL)
+        return false;
+
+    slot->removing.store(true, std::memory_order_release);
+
+    // Let a running callback fade the stream out and release the slot by itself.
+    unsigned long   generation =    _generation.load(std::memory_order_acquire);
+    int             idle =          0;
+
+    while(slot->stream.load(std::memory_order_acquire) == &astream && idle < AUDIOMIXER_IDLE_TIMEOUT_MS)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        if(_generation.load(std::memory_order_acquire) == generation)
+            idle++;
+        else
+        {
+            generation =    _generation.load(std::memory_order_acquire);
+            idle =          0;
+        }
+    }
+
+    // Not playing: release it ourselves, then make sure no callback started with it in the meantime.
+    AudioStreamBase* expected = &astream;
+    slot->stream.compare_exchange_strong(expected, NULL, std::memory_order_seq_cst);
+    waitForCallback();
+
+    return true;
+}
+
+bool AudioMixer::setGain(AudioStreamBase& astream, float gain)
+{
+    Slot* slot = findSlot(&astream);
+    if(slot == NULL)
+        return false;
+
+    slot->targetgain.store(gain, std::memory_order_release);
+    return true;
+}
+
+bool AudioMixer::hasStream(const AudioStreamBase& astream)
+{
+    return findSlot(&astream) != NULL;
+}
+
+unsigned int AudioMixer::streamCount()
+{
+    unsigned int count = 0;
+
+    for(size_t i = 0; i < _slots.size(); i++)
+    {
+        if(_slots[i].stream.load(std::memory_order_acquire) != NULL)
+            count++;
+    }
+    return count;
+}
+
+void AudioMixer::mixChunk(float* out, unsigned long frames)
+{
+    const size_t samples = frames * _channels;
+
+    std::memset(out, 0, samples * sizeof(float));
+
+    for(size_t i = 0; i < _slots.size(); i++)
+    {
+        Slot&               slot =      _slots[i];
+        AudioStreamBase*    stream =    slot.stream.load(std::memory_order_seq_cst);
+        int                 result;
+
+        if(stream == NULL)
+            continue;
+
+        const PaSampleFormat    format =    stream->getSampleFormat() & ~paNonInterleaved;
+        void*                   native =    (format == paFloat32) ? (void*)&(_floatbuffer[0]) : (void*)&(_nativebuffer[0]);
+
+        // Float streams render straight into the float buffer. Others go through a conversion.
+        if(stream->isPlanar())
+        {
+            const unsigned int samplebytes = SampleConversion::bytesPerSample(format);
+
+            for(unsigned int c = 0; c < _channels; c++)
+                _planes[c] = &(_planarbuffer[c * _maxframes * samplebytes]);
+
+            result = stream->renderBlock(&(_planes[0]), frames, _timeinfo, _statusflags);
+            SampleConversion::interleave(&(_planes[0]), native, frames, _channels, samplebytes);
+        }
+        else
+            result = stream->renderBlock(native, frames, _timeinfo, _statusflags);
+
+        if(format != paFloat32)
+            SampleConversion::toFloat(&(_nativebuffer[0]), format, &(_floatbuffer[0]), samples);
+
+        const bool  removing =  slot.removing.load(std::memory_order_acquire) || result != paContinue;
+        const float target =    removing ? 0.0f : slot.targetgain.load(std::memory_order_relaxed);
+
+        if(slot.currentgain == target)
+            accumulate(out, &(_floatbuffer[0]), samples, target);
+        else
+            accumulateRamp(out, &(_floatbuffer[0]), frames, _channels, slot.currentgain, target);
+
+        slot.currentgain = target;
+
+        // Faded out, or finished by itself. Release the slot.
+        if(removing)
+            slot.stream.compare_exchange_strong(stream, NULL);
+    }
+}
+
+int AudioMixer::audioOut(void *outputBuffer, unsigned long framesPerBuffer,
+                         const PaStreamCallbackTimeInfo* timeInfo,
+                         PaStreamCallbackFlags statusFlags)
+{
+    int result;
+
+    // Both sides are seq_cst: either removeStream() sees the generation go odd and waits for us, or mixChunk() sees
+    // the slot already released. Acquire/release alone would let both miss each other.
+    _generation.fetch_add(1, std::memory_order_seq_cst);
+
+    _timeinfo =     timeInfo;
+    _statusflags =  statusFlags;
+    result =        FloatAudioStream::audioOut(outputBuffer, framesPerBuffer, timeInfo, statusFlags);
+
+    _generation.fetch_add(1, std::memory_order_seq_cst);
+
+    return result;
+}
+
+int AudioMixer::floatOut(float* samples, unsigned long frames)
+{
+    const PaStreamCallbackTimeInfo* timeinfo =  _timeinfo;
+    PaStreamCallbackTimeInfo        chunktime;
+    unsigned long                   chunk;
+
+    for(unsigned long done = 0; done < frames; done += chunk)
+    {
+        chunk = (frames - done < _maxframes) ? frames - done : _maxframes;
+
+        // Inputs stamp their scheduled commands with this, so later chunks must say they're heard later.
+        if(done > 0 && timeinfo != NULL)
+        {
+            chunktime =                     *timeinfo;
+            chunktime.outputBufferDacTime += (double)done / _samplerated;
+            _timeinfo =                     &chunktime;
+        }
+
+        mixChunk(samples + done * _channels, chunk);
+    }
+
+    _timeinfo = timeinfo;
+    return paContinue;
+}
+
+void AudioMixer::accumulate(float* dest, const float* src, size_t samples, float gain)
+{
+    size_t i = 0;
+
+#if defined(__SSE__)
+    const __m128 vgain = _mm_set1_ps(gain);
+
+    for(; i + 8 <= samples; i += 8)
+    {
+        __m128 a = _mm_add_ps(_mm_loadu_ps(dest + i),     _mm_mul_ps(_mm_loadu_ps(src + i),     vgain));
+        __m128 b = _mm_add_ps(_mm_loadu_ps(dest + i + 4), _mm_mul_ps(_mm_loadu_ps(src + i + 4), vgain));
+        _mm_storeu_ps(dest + i,     a);
+        _mm_storeu_ps(dest + i + 4, b);
+    }
+#endif
+
+    for(; i < samples; i++)
+        dest[i] += src[i] * gain;
+}
+
+void AudioMixer::accumulateRamp(float* dest, const float* src, unsigned long frames, unsigned int channels,
+                                float gainfrom, float gainto)
+{
+    const float step =  (gainto - gainfrom) / (float)frames;
+    float       gain =  gainfrom;
+
+    for(unsigned long f = 0; f < frames; f++)
+    {
+        gain += step;
+        for(unsigned int c = 0; c < channels; c++, dest++, src++)
+            *dest += *src * gain;
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "floataudiostream.h"
+
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief Sums any number of AudioStreams into a single float stream, so all of them can share one device.
+ *
+ * Streams can be added, removed and have their gain changed while the mixer is playing. Every input stream must have
+ * the same sample rate and channel count as the mixer, but may use any sample format; they are converted to float
+ * before being accumulated. Planar (paNonInterleaved) inputs are interleaved first. The mix itself can be presented
+ * to the device in any format, see FloatAudioStream.
+ *
+ * ## Threading ##
+ * addStream(), removeStream() and setGain() may be called from one control thread. The audio callback never allocates
+ * nor waits: all buffers are allocated in the constructor, and slots are published with atomics. Gain changes,
+ * additions and removals are ramped over one block to avoid clicks. removeStream() returns once the audio thread
+ * no longer uses the stream, so it's safe to destroy it afterwards.
+ */
+class AudioMixer : public FloatAudioStream
+{
+private:
+    struct Slot
+    {
+        std::atomic<AudioStreamBase*>   stream;
+        std::atomic<float>              targetgain;
+        std::atomic<bool>               removing;
+
+        // Audio thread only.
+        float                           currentgain;
+
+        Slot() : stream(NULL), targetgain(1.0f), removing(false), currentgain(0.0f) {}
+    };
+
+    std::vector<Slot>           _slots;
+    unsigned long               _maxframes;
+
+    std::vector<unsigned char>  _nativebuffer;
+    std::vector<float>          _floatbuffer;
+
+    // Planar inputs render here, one plane per channel, before being interleaved.
+    std::vector<unsigned char>  _planarbuffer;
+    std::vector<void*>          _planes;
+
+    // Incremented when the callback enters and when it leaves. Odd means the callback is running.
+    std::atomic<unsigned long>  _generation;
+
+    // Callback arguments, forwarded to every input.
+    const PaStreamCallbackTimeInfo* _timeinfo;
+    PaStreamCallbackFlags           _statusflags;
+
+    Slot*   findSlot(const AudioStreamBase* astream);
+    void    waitForCallback();
+    void    mixChunk(float* out, unsigned long frames);
+
+public:
+    /**
+     * @brief Creates a mixer.
+     * @param samplerate    Sample rate of the mixer and all its inputs.
+     * @param channels      Channel count of the mixer and all its inputs.
+     * @param maxstreams    Maximum amount of simultaneous inputs.
+     * @param maxframes     Largest block rendered at once. Bigger callbacks are split in several chunks.
+     */
+    AudioMixer(unsigned int samplerate = 44100, unsigned int channels = 2,
+               unsigned int maxstreams = 16, unsigned long maxframes = 4096);
+
+    /**
+     * @brief Registers a new input. It fades in during the next block.
+     * @return  false if the stream layout doesn't match the mixer's, if it was already added, or if there's no free slot.
+     */
+    bool    addStream(AudioStreamBase& astream, float gain = 1.0f);
+
+    /**
+     * @brief Fades an input out and unregisters it. Blocks until the audio thread has released the stream.
+     * @return  false if the stream was not registered.
+     */
+    bool    removeStream(AudioStreamBase& astream);
+
+    /**
+     * @brief Changes the gain of an input. The change is ramped over the next block.
+     * @return  false if the stream was not registered.
+     */
+    bool    setGain(AudioStreamBase& astream, float gain);
+
+    bool            hasStream(const AudioStreamBase& astream);
+    unsigned int    streamCount();
+
+    int audioOut(void *outputBuffer, unsigned long framesPerBuffer,
+                 const PaStreamCallbackTimeInfo* timeInfo,
+                 PaStreamCallbackFlags statusFlags);
+
+    int floatOut(float* samples, unsigned long frames);
+
+    /**
+     * @brief dest[i] += src[i] * gain, for `samples` samples. Vectorized.
+     */
+    static void accumulate(float* dest, const float* src, size_t samples, float gain);
+
+    /**
+     * @brief Same as accumulate(), but the gain goes linearly from `gainfrom` to `gainto` along `frames` frames.
+     */
+    static void accumulateRamp(float* dest, const float* src, unsigned long frames, unsigned int channels,
+                               float gainfrom, float gainto);
+};
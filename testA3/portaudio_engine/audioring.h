@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief Wait-free single producer, single consumer ring of interleaved float frames. One thread writes, one other
+ * thread reads, in blocks of any size, and neither of them ever blocks or allocates.
+ *
+ * Capacity is rounded up to a power of two frames. Read and write positions are frame counters that never wrap back,
+ * so the fill level is just their difference. As in SPSCQueue, they live in different cache lines.
+ */
+class AudioRing
+{
+private:
+    static const size_t         LINE =  64;
+
+    // Written by the consumer, read by the producer.
+    std::atomic<size_t>         _readpos;
+    char                        _pad0[LINE - sizeof(std::atomic<size_t>)];
+
+    // Written by the producer, read by the consumer.
+    std::atomic<size_t>         _writepos;
+    char                        _pad1[LINE - sizeof(std::atomic<size_t>)];
+
+    std::vector<float>          _samples;
+    size_t                      _capacity;
+    size_t                      _mask;
+    unsigned int                _channels;
+
+public:
+    /**
+     * @brief Creates a ring.
+     * @param frames    Minimum capacity, in frames.
+     * @param channels  Samples per frame.
+     */
+    AudioRing(size_t frames, unsigned int channels) :
+        _readpos(0),
+        _writepos(0),
+        _capacity(1),
+        _channels(channels > 0 ? channels : 1)
+    {
+        while(_capacity < frames)
+            _capacity <<= 1;
+
+        _mask = _capacity - 1;
+        _samples.resize(_capacity * _channels);
+    }
+
+    /**
+     * @brief Producer side. Copies as many frames as fit.
+     * @return  Frames actually written.
+     */
+    size_t write(const float* src, size_t frames)
+    {
+        const size_t writepos = _writepos.load(std::memory_order_relaxed);
+        const size_t space =    _capacity - (writepos - _readpos.load(std::memory_order_acquire));
+
+        if(frames > space)
+            frames = space;
+
+        // Up to the end of the buffer, then the rest from the beginning.
+        const size_t start =    writepos & _mask;
+        const size_t first =    (frames < _capacity - start) ? frames : _capacity - start;
+
+        std::memcpy(&(_samples[start * _channels]), src, first * _channels * sizeof(float));
+        std::memcpy(&(_samples[0]), src + first * _channels, (frames - first) * _channels * sizeof(float));
+
+        _writepos.store(writepos + frames, std::memory_order_release);
+        return frames;
+    }
+
+    /**
+     * @brief Consumer side. Copies as many frames as are available, up to `frames`.
+     * @return  Frames actually read.
+     */
+    size_t read(float* dest, size_t frames)
+    {
+        const size_t readpos =  _readpos.load(std::memory_order_relaxed);
+        const size_t filled =   _writepos.load(std::memory_order_acquire) - readpos;
+
+        if(frames > filled)
+            frames = filled;
+
+        const size_t start =    readpos & _mask;
+        const size_t first =    (frames < _capacity - start) ? frames : _capacity - start;
+
+        std::memcpy(dest, &(_samples[start * _channels]), first * _channels * sizeof(float));
+        std::memcpy(dest + first * _channels, &(_samples[0]), (frames - first) * _channels * sizeof(float));
+
+        _readpos.store(readpos + frames, std::memory_order_release);
+        return frames;
+    }
+
+    /**
+     * @brief Frames ready to be read. Exact only when called from the producer or the consumer thread.
+     */
+    size_t available() const
+    {
+        return _writepos.load(std::memory_order_acquire) - _readpos.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Frames that can be written. Exact only when called from the producer or the consumer thread.
+     */
+    size_t space() const
+    {
+        return _capacity - available();
+    }
+
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    unsigned int channels() const
+    {
+        return _channels;
+    }
+
+    /**
+     * @brief Empties the ring. Neither the producer nor the consumer may be using it meanwhile.
+     */
+    void clear()
+    {
+        _readpos.store(0);
+        _writepos.store(0);
+    }
+};
@@ -1,10 +1,18 @@
 #include "audiostream.h"
 
+#include <cstring>
+
 AudioStreamBase::AudioStreamBase(unsigned int samplerate, unsigned int channels, PaSampleFormat sampleformat, unsigned int buffersize) :
     _samplerate(samplerate),
     _channels(channels),
     _sampleformat(sampleformat),
-    _buffersize(buffersize)
+    _buffersize(buffersize),
+    _events((double)samplerate),
+    _framecount(0),
+    _subplanes(channels),
+    _inputchannels(0),
+    _blockinput(NULL),
+    _input(NULL)
 {
     _sampleratef = (float)_samplerate;
     _samplerated = (double)_samplerate;
@@ -25,6 +33,32 @@ PaSampleFormat AudioStreamBase::getSampleFormat() const
     return _sampleformat;
 }
 
+unsigned int AudioStreamBase::getBufferSize() const
+{
+    return _buffersize;
+}
+
+void AudioStreamBase::setBufferSize(unsigned int buffersize)
+{
+    _buffersize = buffersize;
+}
+
+bool AudioStreamBase::isPlanar() const
+{
+    return (_sampleformat & paNonInterleaved) != 0;
+}
+
+void AudioStreamBase::setInputChannels(unsigned int channels)
+{
+    _inputchannels = channels;
+    _subinputplanes.resize(channels);
+}
+
+unsigned int AudioStreamBase::getInputChannelAmount() const
+{
+    return _inputchannels;
+}
+
 float AudioStreamBase::getSampleRateFloat() const
 {
     return _sampleratef;
@@ -34,3 +68,138 @@ double AudioStreamBase::getSampleRateDouble() const
 {
     return _samplerated;
 }
+
+bool AudioStreamBase::postCommand(const StreamCommand& cmd)
+{
+    return _commands.push(cmd);
+}
+
+bool AudioStreamBase::scheduleCommand(unsigned long long frame, const StreamCommand& cmd)
+{
+    return _events.schedule(frame, cmd);
+}
+
+bool AudioStreamBase::scheduleCommandAt(PaTime time, const StreamCommand& cmd)
+{
+    return _events.schedule(_events.frameAt(time), cmd);
+}
+
+unsigned long long AudioStreamBase::getFrameCount() const
+{
+    return _framecount;
+}
+
+unsigned long long AudioStreamBase::frameAtTime(PaTime time) const
+{
+    return _events.frameAt(time);
+}
+
+void AudioStreamBase::drainCommands()
+{
+    StreamCommand cmd;
+
+    while(_commands.pop(cmd))
+        onCommand(cmd);
+}
+
+int AudioStreamBase::renderBlock(void *outputBuffer, unsigned long framesPerBuffer,
+                                 const PaStreamCallbackTimeInfo* timeInfo,
+                                 PaStreamCallbackFlags statusFlags)
+{
+    PaStreamCallbackTimeInfo    subtime;
+    StreamCommand               cmd;
+    unsigned long long          next;
+    const unsigned long long    end =       _framecount + framesPerBuffer;
+    unsigned long               done =      0, span;
+    int                         result =    paContinue, spanresult;
+
+    drainCommands();
+
+    // Some host APIs leave outputBufferDacTime at 0. Frame time is still better than nothing.
+    if(timeInfo != NULL)
+        subtime = *timeInfo;
+    else
+        memset(&subtime, 0, sizeof(PaStreamCallbackTimeInfo));
+
+    if(subtime.outputBufferDacTime == 0.0)
+        subtime.outputBufferDacTime = (subtime.currentTime != 0.0) ? subtime.currentTime : (double)_framecount / _samplerated;
+
+    const PaTime dactime = subtime.outputBufferDacTime;
+
+    _events.setAnchor(_framecount, dactime);
+    _events.collect();
+
+    while(true)
+    {
+        while(_events.popDue(_framecount, cmd))
+            onCommand(cmd);
+
+        span = framesPerBuffer - done;
+        if(_events.nextFrame(next) && next < end)
+            span = (unsigned long)(next - _framecount);
+
+        _input = inputAt(done);
+
+        if(done == 0)
+            spanresult = audioOut(outputBuffer, span, timeInfo, statusFlags);
+        else
+        {
+            // Later spans start further in the buffer, and are heard later.
+            const size_t offset = done * SampleConversion::bytesPerSample(_sampleformat);
+
+            subtime.outputBufferDacTime = dactime + (double)done / _samplerated;
+
+            if(isPlanar())
+            {
+                for(unsigned int c = 0; c < _channels; c++)
+                    _subplanes[c] = static_cast<unsigned char* const*>(outputBuffer)[c] + offset;
+
+                spanresult = audioOut(&(_subplanes[0]), span, &subtime, statusFlags);
+            }
+            else
+                spanresult = audioOut(static_cast<unsigned char*>(outputBuffer) + offset * _channels, span, &subtime, statusFlags);
+        }
+
+        // As in FloatAudioStream, the whole buffer is rendered even if the stream finishes midway.
+        if(result == paContinue)
+            result = spanresult;
+
+        done +=         span;
+        _framecount +=  span;
+
+        if(done >= framesPerBuffer)
+            break;
+    }
+
+    _input = NULL;
+    return result;
+}
+
+int AudioStreamBase::renderBlock(const void *inputBuffer, void *outputBuffer, unsigned long framesPerBuffer,
+                                 const PaStreamCallbackTimeInfo* timeInfo,
+                                 PaStreamCallbackFlags statusFlags)
+{
+    int result;
+
+    _blockinput =   (_inputchannels > 0) ? inputBuffer : NULL;
+    result =        renderBlock(outputBuffer, framesPerBuffer, timeInfo, statusFlags);
+    _blockinput =   NULL;
+
+    return result;
+}
+
+const void* AudioStreamBase::inputAt(unsigned long frame)
+{
+    if(_blockinput == NULL || frame == 0)
+        return _blockinput;
+
+    const size_t offset = frame * SampleConversion::bytesPerSample(_sampleformat);
+
+    if(!isPlanar())
+        return static_cast<const unsigned char*>(_blockinput) + offset * _inputchannels;
+
+    for(unsigned int c = 0; c < _inputchannels; c++)
+        _subinputplanes[c] = static_cast<const unsigned char* const*>(_blockinput)[c] + offset;
+
+    return &(_subinputplanes[0]);
+}
@@ -1,23 +1,71 @@
 #pragma once
 
 #include "portaudio.h"
+#include "commandqueue.h"
+#include "eventscheduler.h"
+#include "sampleconversion.h"
 #include <iostream>
+#include <vector>
 
 class ScopedPAContext;
+class OfflineRenderContext;
 
 /**
- * Merely a placeholder to allow this template to grab 24-bit samples.
+ * @brief Packed 24-bit sample, laid out as PortAudio expects paInt24 samples: 3 bytes, no padding, little endian.
+ * Converts to and from int, so it can be used as any other sample type.
  */
-#ifndef int24_t
-typedef long int    int24_t;
-#endif
+struct int24_t
+{
+    unsigned char   bytes[3];
+
+    int24_t() {}
+    int24_t(int value) {set(value);}
+
+    inline void set(int value)
+    {
+        bytes[0] = (unsigned char)(value);
+        bytes[1] = (unsigned char)(value >> 8);
+        bytes[2] = (unsigned char)(value >> 16);
+    }
+
+    inline operator int() const
+    {
+        return (int)(((unsigned int)bytes[0] << 8) | ((unsigned int)bytes[1] << 16) | ((unsigned int)bytes[2] << 24)) >> 8;
+    }
+};
+
+static_assert(sizeof(int24_t) == 3, "int24_t must be packed in 3 bytes.");
+
+/**
+ * @brief Float conversions shared by every SampleFormat specialization. They clamp and use SIMD when available.
+ * See SampleConversion.
+ */
+template <typename T, PaSampleFormat F>
+struct SampleFormatConverters
+{
+    /**
+     * @brief Converts `samples` floats into this format, clamping them to the -1.0 .. 1.0 range.
+     */
+    static inline void fromFloat(const float* src, T* dest, size_t samples)
+    {
+        SampleConversion::fromFloat(src, F, dest, samples);
+    }
+
+    /**
+     * @brief Converts `samples` samples in this format into floats.
+     */
+    static inline void toFloat(const T* src, float* dest, size_t samples)
+    {
+        SampleConversion::toFloat(src, F, dest, samples);
+    }
+};
 
 /**
  * @brief Some template black magic to convert native C++ types into PaSampleFormat.
- * I had to do some placeholder for a 24 bit format sample. Use int24_t to define this typing.
+ * Use int24_t for 24 bit samples.
  */
 template <typename T>
-struct SampleFormat
+struct SampleFormat : public SampleFormatConverters<T, paFloat32>
 {
     static constexpr PaSampleFormat format =    paFloat32;
     static constexpr T              MAXVAL =    1.0f;
@@ -28,7 +76,7 @@ struct SampleFormat
 };
 
 template <>
-struct SampleFormat <unsigned char>
+struct SampleFormat <unsigned char> : public SampleFormatConverters<unsigned char, paUInt8>
 {
     static constexpr PaSampleFormat format =    paUInt8;
     static constexpr unsigned char  MAXVAL =    255;
@@ -39,7 +87,7 @@ struct SampleFormat <unsigned char>
 };
 
 template <>
-struct SampleFormat <char>
+struct SampleFormat <char> : public SampleFormatConverters<char, paInt8>
 {
     static constexpr PaSampleFormat format =    paInt8;
     static constexpr char           MAXVAL =    127;
@@ -50,7 +98,7 @@ struct SampleFormat <char>
 };
 
 template <>
-struct SampleFormat <short int>
+struct SampleFormat <short int> : public SampleFormatConverters<short int, paInt16>
 {
     static constexpr PaSampleFormat format =    paInt16;
     static constexpr short int      MAXVAL =    32767;
@@ -61,18 +109,18 @@ struct SampleFormat <short int>
 };
 
 template <>
-struct SampleFormat <int24_t>
+struct SampleFormat <int24_t> : public SampleFormatConverters<int24_t, paInt24>
 {
     static constexpr PaSampleFormat format =    paInt24;
-    static constexpr int24_t        MAXVAL =    8388607;
-    static constexpr int24_t        ZERO =      0;
-    static constexpr int24_t        MINVAL =    -8388608;
+    static constexpr int            MAXVAL =    8388607;
+    static constexpr int            ZERO =      0;
+    static constexpr int            MINVAL =    -8388608;
 
     static constexpr unsigned char  BPS =       3;
 };
 
 template <>
-struct SampleFormat <int>
+struct SampleFormat <int> : public SampleFormatConverters<int, paInt32>
 {
     static constexpr PaSampleFormat format =    paInt32;
     static constexpr int            MAXVAL =    2147483647;
@@ -83,13 +131,68 @@ struct SampleFormat <int>
 };
 
 /**
- * A structure made for easy access to stereo samples.
+ * @brief Channel counts of the usual speaker layouts. Any other count works too, through Frame and framesOut().
+ */
+enum ChannelLayout
+{
+    LayoutMono =        1,
+    LayoutStereo =      2,
+    LayoutQuad =        4,
+    Layout51 =          6,
+    Layout71 =          8
+};
+
+/**
+ * @brief Channel order inside a frame, as WAVE_FORMAT_EXTENSIBLE and most multichannel devices lay them.
+ * Quad is FrontLeft, FrontRight, BackLeft, BackRight. 5.1 is the first six. 7.1 adds SideLeft and SideRight.
+ */
+enum ChannelPosition
+{
+    FrontLeft =         0,
+    FrontRight =        1,
+    FrontCenter =       2,
+    LowFrequency =      3,
+    BackLeft =          4,
+    BackRight =         5,
+    SideLeft =          6,
+    SideRight =         7,
+
+    QuadBackLeft =      2,
+    QuadBackRight =     3
+};
+
+/**
+ * @brief One interleaved frame: a sample for each one of its N channels, laid out as PortAudio expects them.
+ */
+template <typename T, unsigned int N>
+struct Frame
+{
+    T ch[N];
+
+    inline T&       operator[](unsigned int channel)        {return ch[channel];}
+    inline const T& operator[](unsigned int channel) const  {return ch[channel];}
+
+    /**
+     * @brief Sets every channel with the same value.
+     */
+    inline void set(T value)
+    {
+        for(unsigned int i = 0; i < N; i++)
+            ch[i] = value;
+    }
+};
+
+/**
+ * @brief Stereo frames keep their left and right names.
  */
 template <typename T>
-struct StereoSample
+struct Frame <T, 2>
 {
     T left, right;
 
+    inline T&       operator[](unsigned int channel)        {return (&left)[channel];}
+    inline const T& operator[](unsigned int channel) const  {return (&left)[channel];}
+
     /**
      * @brief Sets both left and right samples with the same value.
      * @param value
@@ -100,12 +203,28 @@ struct StereoSample
     }
 };
 
+/**
+ * A structure made for easy access to stereo samples.
+ */
+template <typename T>
+using StereoSample =    Frame<T, LayoutStereo>;
+
+template <typename T>
+using QuadFrame =       Frame<T, LayoutQuad>;
+
+template <typename T>
+using Surround51Frame = Frame<T, Layout51>;
+
+template <typename T>
+using Surround71Frame = Frame<T, Layout71>;
+
 /**
  * @brief Base clase for internal use. Use AudioStream instead!
  */
 class AudioStreamBase
 {
     friend class ScopedPAContext;
+    friend class OfflineRenderContext;
 
 protected:
     unsigned int        _samplerate, _channels;
@@ -115,12 +234,46 @@ protected:
     float               _sampleratef;
     double              _samplerated;
 
+    CommandQueue        _commands;
+    EventScheduler      _events;
+
+    // Frames rendered so far. The clock scheduled commands are keyed by.
+    unsigned long long  _framecount;
+
+    // Channel pointers of planar sub-blocks, see renderBlock().
+    std::vector<void*>  _subplanes;
+
+    // Duplex input: channels asked for, the block given to renderBlock(), and the part of it audioOut is rendering.
+    unsigned int        _inputchannels;
+    const void*         _blockinput;
+    const void*         _input;
+    std::vector<const void*> _subinputplanes;
+
+    const void*     inputAt(unsigned long frame);
+
+    /**
+     * @brief Called from the audio thread, once per queued command, right before audioOut. Reimplement it to apply
+     * parameter changes posted with postCommand() or setParameter().
+     * @param cmd       Command posted by the control thread.
+     */
+    virtual void onCommand(const StreamCommand& cmd) {(void) cmd;}
+
+    /**
+     * @brief Input frames captured along with the output being rendered, for duplex streams. They are the device's own
+     * buffer, not a copy: same sample format and layout as the output (planes, if planar), getInputChannelAmount()
+     * channels, as many frames as audioOut was asked for. NULL if the stream has no input or the device gave none.
+     * Only valid inside audioOut.
+     */
+    const void*     inputBuffer() const {return _input;}
+
 public:
     AudioStreamBase(unsigned int samplerate = 44100,
                 unsigned int channels = 2,
                 PaSampleFormat sampleformat = paFloat32,
                 unsigned int buffersize = 64);
 
+    virtual ~AudioStreamBase() {}
+
     unsigned int    getSampleRate() const;
     float           getSampleRateFloat() const;
     double          getSampleRateDouble() const;
@@ -128,6 +281,96 @@ public:
     unsigned int    getChannelAmount() const;
     PaSampleFormat  getSampleFormat() const;
 
+    /**
+     * @brief Preferred callback block size, in frames. Render contexts use it unless told otherwise; see
+     * ScopedPAContext::LatencyPolicy.
+     */
+    unsigned int    getBufferSize() const;
+    void            setBufferSize(unsigned int buffersize);
+
+    /**
+     * @brief Whether the stream renders one buffer per channel (paNonInterleaved) instead of interleaved frames.
+     */
+    bool            isPlanar() const;
+
+    /**
+     * @brief Asks render contexts for a duplex stream with that many input channels, in the stream's sample format.
+     * 0 (the default) means output only. Call it before the stream is opened.
+     */
+    virtual void    setInputChannels(unsigned int channels);
+    unsigned int    getInputChannelAmount() const;
+
+    /**
+     * @brief Queues a command for the audio thread. Wait-free, so it's safe to call while the stream is playing.
+     * Only one control thread (usually the GUI one) may post commands to a given stream.
+     * @return  false if the queue was full and the command was dropped.
+     */
+    bool            postCommand(const StreamCommand& cmd);
+
+    /**
+     * @brief Convenience method. Queues a typed parameter change. See postCommand().
+     */
+    template<typename T>
+    bool            setParameter(unsigned int parameter, T value)
+    {
+        return postCommand(StreamCommand(parameter, value));
+    }
+
+    /**
+     * @brief Queues a command to be applied exactly at an absolute frame (see getFrameCount()). The block that contains
+     * that frame is split there, so audioOut renders the frames before it, onCommand() applies it, and audioOut
+     * renders the rest. Wait-free; only one control thread may schedule commands to a given stream.
+     * @return  false if the queue was full and the command was dropped.
+     */
+    bool            scheduleCommand(unsigned long long frame, const StreamCommand& cmd);
+
+    /**
+     * @brief Same as scheduleCommand(), stamped in PortAudio stream time (Pa_GetStreamTime(), or the times in
+     * PaStreamCallbackTimeInfo). The command is applied to the frame heard at that time.
+     */
+    bool            scheduleCommandAt(PaTime time, const StreamCommand& cmd);
+
+    /**
+     * @brief Convenience method. Schedules a typed parameter change. See scheduleCommand().
+     */
+    template<typename T>
+    bool            scheduleParameter(unsigned long long frame, unsigned int parameter, T value)
+    {
+        return scheduleCommand(frame, StreamCommand(parameter, value));
+    }
+
+    /**
+     * @brief Frames rendered since the stream was created. Exact from the audio thread only; inside audioOut, it's
+     * the frame the buffer starts at.
+     */
+    unsigned long long  getFrameCount() const;
+
+    /**
+     * @brief Absolute frame heard at `time`, in PortAudio stream time. See scheduleCommandAt().
+     */
+    unsigned long long  frameAtTime(PaTime time) const;
+
+    /**
+     * @brief Applies every queued command through onCommand(). Audio thread only.
+     */
+    void            drainCommands();
+
+    /**
+     * @brief Entry point for render contexts: drains the command queue, then calls audioOut once for every span of
+     * frames between scheduled commands, applying each command at its frame.
+     */
+    int             renderBlock(void *outputBuffer, unsigned long framesPerBuffer,
+                                const PaStreamCallbackTimeInfo* timeInfo,
+                                PaStreamCallbackFlags statusFlags);
+
+    /**
+     * @brief Same as renderBlock(), for duplex streams: `inputBuffer` holds the frames captured along with them, and
+     * audioOut finds its part of it in inputBuffer().
+     */
+    int             renderBlock(const void *inputBuffer, void *outputBuffer, unsigned long framesPerBuffer,
+                                const PaStreamCallbackTimeInfo* timeInfo,
+                                PaStreamCallbackFlags statusFlags);
+
     virtual int audioOut(void *outputBuffer, unsigned long framesPerBuffer,
                        const PaStreamCallbackTimeInfo* timeInfo,
                        PaStreamCallbackFlags statusFlags) = 0;
@@ -136,11 +379,38 @@ public:
 /**
  * @brief Inheritable class to control output to speakers. Template defines the sample format (float or integer),
  * sample rate (in Hz) and amount of channels. Default is floating point samples, 44,100Hz and 2 channels (stereo)
+ *
+ * The buffer layout is resolved at compile time: audioOut() hands framesOut() an array of Frame<T, channels>, and
+ * for mono and stereo streams, framesOut() forwards to monoOut() or stereoOut(). Any channel count is supported;
+ * wider streams (quad, 5.1, 7.1...) reimplement framesOut().
  */
 template<typename T, unsigned int samplerate = 44100, unsigned char channels = 2>
 class AudioStream : public AudioStreamBase
 {
+    static_assert(channels > 0, "An AudioStream needs at least one channel.");
+    static_assert(sizeof(Frame<T, channels>) == sizeof(T) * channels, "Frames must be packed as PortAudio expects.");
+
+private:
+    // Compile time forwarding of framesOut() to the convenience callbacks.
+    inline int layoutOut(Frame<T, 1>* frames, unsigned long length)
+    {
+        return monoOut(frames->ch, length);
+    }
+
+    inline int layoutOut(Frame<T, 2>* frames, unsigned long length)
+    {
+        return stereoOut(frames, length);
+    }
+
+    template<unsigned int N>
+    inline int layoutOut(Frame<T, N>* frames, unsigned long length)
+    {
+        (void) frames; (void) length;
+        return paAbort;
+    }
+
 public:
+    typedef Frame<T, channels>  FrameType;
 
     AudioStream() :
         AudioStreamBase(samplerate, channels, SampleFormat<T>::format, 64)
@@ -150,7 +420,7 @@ public:
     /**
      * @brief Callback method which will be called once this stream is assigned to a PAContext and requests audio data.
      * To use it, make an AudioStream subclass and reimplement audioOut if you need some low level managing. Else, you
-     * might want to reimplement monoOut or stereoOut, which are much easy to handle.
+     * might want to reimplement framesOut, or monoOut or stereoOut, which are much easy to handle.
      *
      * @param outputBuffer      Buffer you will have to fill.
      * @param framesPerBuffer   How many frames (samples) is your buffer.
@@ -164,12 +434,21 @@ public:
                        const PaStreamCallbackTimeInfo* timeInfo,
                        PaStreamCallbackFlags statusFlags)
     {
-        if(channels == 1)
-            return monoOut((T*)outputBuffer, framesPerBuffer);
-        else if(channels == 2)
-            return stereoOut((StereoSample<T>*)outputBuffer, framesPerBuffer);
-        else
-            return paAbort;
+        return framesOut((FrameType*)outputBuffer, framesPerBuffer);
+    }
+
+    /**
+     * @brief Callback method to be reimplemented for any channel count. Mono and stereo streams may reimplement
+     * monoOut or stereoOut instead.
+     * @param frames    Frame array to be filled. Channels are ordered as in ChannelPosition.
+     * @param length    How many frames must be filled.
+     *
+     * @return  Make this function return 0 if you don't want to stop the stream from here. You can return either
+     * paComplete or paAbort otherwise. Consult PortAudio documentation about these.
+     */
+    virtual int framesOut(FrameType* frames, unsigned long length)
+    {
+        return layoutOut(frames, length);
     }
 
     /**
@@ -198,3 +477,39 @@ public:
         return paAbort;
     }
 };
+
+/**
+ * @brief Same as AudioStream, but the device is opened as paNonInterleaved: every channel gets its own contiguous
+ * buffer, so per-channel renderers can write straight into it.
+ */
+template<typename T, unsigned int samplerate = 44100, unsigned char channels = 2>
+class PlanarAudioStream : public AudioStreamBase
+{
+    static_assert(channels > 0, "An AudioStream needs at least one channel.");
+
+public:
+    PlanarAudioStream() :
+        AudioStreamBase(samplerate, channels, SampleFormat<T>::format | paNonInterleaved, 64)
+    {
+    }
+
+    /**
+     * @brief PortAudio passes non interleaved buffers as an array of `channels` pointers.
+     */
+    virtual int audioOut(void *outputBuffer, unsigned long framesPerBuffer,
+                       const PaStreamCallbackTimeInfo* timeInfo,
+                       PaStreamCallbackFlags statusFlags)
+    {
+        return planarOut((T* const*)outputBuffer, framesPerBuffer);
+    }
+
+    /**
+     * @brief Callback method to be reimplemented.
+     * @param planes    One buffer per channel, ordered as in ChannelPosition. Each one `length` samples long.
+     * @param length    How many samples must be filled in every channel.
+     *
+     * @return  Make this function return 0 if you don't want to stop the stream from here. You can return either
+     * paComplete or paAbort otherwise. Consult PortAudio documentation about these.
+     */
+    virtual int planarOut(T* const* planes, unsigned long length) = 0;
+};
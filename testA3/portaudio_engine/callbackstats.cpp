@@ -0,0 +1,189 @@
+#include "callbackstats.h"
+
+#include <cstdio>
+#include <limits>
+
+CallbackStats::CallbackStats()
+{
+    _resetrequested.store(false);
+    clear();
+}
+
+void CallbackStats::clear()
+{
+    for(unsigned int i = 0; i < BucketCount; i++)
+        _buckets[i].store(0, std::memory_order_relaxed);
+
+    _callbacks.store(0, std::memory_order_relaxed);
+    _frames.store(0, std::memory_order_relaxed);
+    _totalns.store(0, std::memory_order_relaxed);
+    _minns.store(std::numeric_limits<unsigned long long>::max(), std::memory_order_relaxed);
+    _maxns.store(0, std::memory_order_relaxed);
+    _budgetns.store(0, std::memory_order_relaxed);
+
+    _outputunderflows.store(0, std::memory_order_relaxed);
+    _outputoverflows.store(0, std::memory_order_relaxed);
+    _inputunderflows.store(0, std::memory_order_relaxed);
+    _inputoverflows.store(0, std::memory_order_relaxed);
+    _primingoutputs.store(0, std::memory_order_relaxed);
+    _deadlinemisses.store(0, std::memory_order_relaxed);
+
+    _cpuload.store(0.0, std::memory_order_relaxed);
+    _cpuloadpeak.store(0.0, std::memory_order_relaxed);
+    _cpuloadsamples.store(0, std::memory_order_relaxed);
+}
+
+unsigned int CallbackStats::bucketIndex(unsigned long long ns)
+{
+    if(ns < SubBuckets)
+        return (unsigned int)ns;
+
+    // Octave given by the most significant bit, then the next SubBucketBits bits pick the sub-bucket.
+    const unsigned int msb =    63 - __builtin_clzll(ns);
+    const unsigned int octave = msb - SubBucketBits + 1;
+
+    if(octave >= Octaves)
+        return BucketCount - 1;
+
+    return octave * SubBuckets + (unsigned int)((ns >> (msb - SubBucketBits)) & (SubBuckets - 1));
+}
+
+unsigned long long CallbackStats::bucketUpperBound(unsigned int index)
+{
+    const unsigned int octave = index / SubBuckets;
+    const unsigned int sub =    index % SubBuckets;
+
+    if(octave == 0)
+        return sub;
+
+    return ((unsigned long long)(SubBuckets + sub + 1) << (octave - 1)) - 1;
+}
+
+void CallbackStats::record(unsigned long long ns, unsigned long frames, double samplerate, PaStreamCallbackFlags statusflags)
+{
+    if(_resetrequested.load(std::memory_order_acquire))
+    {
+        clear();
+        _resetrequested.store(false, std::memory_order_release);
+    }
+
+    const unsigned long long budget = (samplerate > 0.0) ? (unsigned long long)((double)frames * 1e9 / samplerate) : 0;
+
+    bump(_buckets[bucketIndex(ns)]);
+    bump(_callbacks);
+    bump(_frames, frames);
+    bump(_totalns, ns);
+
+    if(ns < _minns.load(std::memory_order_relaxed))
+        _minns.store(ns, std::memory_order_relaxed);
+    if(ns > _maxns.load(std::memory_order_relaxed))
+        _maxns.store(ns, std::memory_order_relaxed);
+
+    _budgetns.store(budget, std::memory_order_relaxed);
+    if(ns > budget)
+        bump(_deadlinemisses);
+
+    if(statusflags & paOutputUnderflow)
+        bump(_outputunderflows);
+    if(statusflags & paOutputOverflow)
+        bump(_outputoverflows);
+    if(statusflags & paInputUnderflow)
+        bump(_inputunderflows);
+    if(statusflags & paInputOverflow)
+        bump(_inputoverflows);
+    if(statusflags & paPrimingOutput)
+        bump(_primingoutputs);
+}
+
+void CallbackStats::recordCpuLoad(double load)
+{
+    _cpuload.store(load, std::memory_order_relaxed);
+    if(load > _cpuloadpeak.load(std::memory_order_relaxed))
+        _cpuloadpeak.store(load, std::memory_order_relaxed);
+
+    _cpuloadsamples.store(_cpuloadsamples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void CallbackStats::reset()
+{
+    _resetrequested.store(true, std::memory_order_release);
+}
+
+CallbackStats::Snapshot CallbackStats::snapshot() const
+{
+    Snapshot            s =         Snapshot();
+    unsigned long long  counts[BucketCount];
+    unsigned long long  total =     0;
+
+    // Cleared, as far as the readers are concerned.
+    if(_resetrequested.load(std::memory_order_acquire))
+        return s;
+
+    // Percentiles come from the histogram itself, so they agree with each other even if a callback lands meanwhile.
+    for(unsigned int i = 0; i < BucketCount; i++)
+    {
+        counts[i] =     _buckets[i].load(std::memory_order_relaxed);
+        total +=        counts[i];
+    }
+
+    const unsigned long long minns =    _minns.load(std::memory_order_relaxed);
+    const unsigned long long maxns =    _maxns.load(std::memory_order_relaxed);
+    const double             ranks[3] = {0.5, 0.99, 0.999};
+    double                   values[3] = {0.0, 0.0, 0.0};
+
+    for(int r = 0; r < 3; r++)
+    {
+        const unsigned long long    target =    (unsigned long long)((double)total * ranks[r] + 0.999999);
+        unsigned long long          seen =      0;
+
+        for(unsigned int i = 0; i < BucketCount && total > 0; i++)
+        {
+            seen += counts[i];
+            if(seen >= target)
+            {
+                // Upper bound of the bucket, but never beyond what was actually measured.
+                unsigned long long bound = bucketUpperBound(i);
+                values[r] = (double)((bound < maxns) ? bound : maxns) * 1e-9;
+                break;
+            }
+        }
+    }
+
+    s.callbacks =           _callbacks.load(std::memory_order_relaxed);
+    s.frames =              _frames.load(std::memory_order_relaxed);
+
+    s.outputUnderflows =    _outputunderflows.load(std::memory_order_relaxed);
+    s.outputOverflows =     _outputoverflows.load(std::memory_order_relaxed);
+    s.inputUnderflows =     _inputunderflows.load(std::memory_order_relaxed);
+    s.inputOverflows =      _inputoverflows.load(std::memory_order_relaxed);
+    s.primingOutputs =      _primingoutputs.load(std::memory_order_relaxed);
+    s.deadlineMisses =      _deadlinemisses.load(std::memory_order_relaxed);
+
+    s.minTime =             (s.callbacks > 0) ? (double)minns * 1e-9 : 0.0;
+    s.maxTime =             (double)maxns * 1e-9;
+    s.meanTime =            (s.callbacks > 0) ? (double)_totalns.load(std::memory_order_relaxed) * 1e-9 / (double)s.callbacks : 0.0;
+    s.p50Time =             values[0];
+    s.p99Time =             values[1];
+    s.p999Time =            values[2];
+
+    s.budget =              (double)_budgetns.load(std::memory_order_relaxed) * 1e-9;
+
+    s.cpuLoad =             _cpuload.load(std::memory_order_relaxed);
+    s.cpuLoadPeak =         _cpuloadpeak.load(std::memory_order_relaxed);
+    s.cpuLoadSamples =      _cpuloadsamples.load(std::memory_order_relaxed);
+
+    return s;
+}
+
+std::string CallbackStats::Snapshot::toString() const
+{
+    char line[512];
+
+    std::snprintf(line, sizeof(line),
+                  "callbacks=%llu frames=%llu budget=%.1fus min=%.1fus mean=%.1fus p50=%.1fus p99=%.1fus p99.9=%.1fus "
+                  "max=%.1fus misses=%llu underflows=%llu overflows=%llu cpuload=%.3f peak=%.3f",
+                  callbacks, frames, budget * 1e6, minTime * 1e6, meanTime * 1e6, p50Time * 1e6, p99Time * 1e6,
+                  p999Time * 1e6, maxTime * 1e6, deadlineMisses, outputUnderflows, outputOverflows, cpuLoad, cpuLoadPeak);
+
+    return std::string(line);
+}
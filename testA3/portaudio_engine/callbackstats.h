@@ -0,0 +1,121 @@
+#pragma once
+
+#include "portaudio.h"
+
+#include <atomic>
+#include <string>
+
+/**
+ * @brief Timing and xrun statistics of an audio callback.
+ *
+ * The audio thread calls record() once per callback with the wall time it took; any other thread may poll snapshot()
+ * at any time, for instance from a QTimer or a log. Recording never allocates, locks nor waits: every counter is a
+ * relaxed atomic, written by the audio thread only.
+ *
+ * Callback times go into a log-linear histogram (16 buckets per power of two, so percentiles are within ~6%) from 1ns
+ * up to half a minute. Every callback is also compared against its deadline, the duration of the block it rendered.
+ */
+class CallbackStats
+{
+public:
+    /**
+     * @brief Consistent-enough copy of the statistics. Times are in seconds.
+     */
+    struct Snapshot
+    {
+        unsigned long long  callbacks;
+        unsigned long long  frames;
+
+        unsigned long long  outputUnderflows;   // paOutputUnderflow: the device played silence.
+        unsigned long long  outputOverflows;    // paOutputOverflow: samples were discarded.
+        unsigned long long  inputUnderflows;
+        unsigned long long  inputOverflows;
+        unsigned long long  primingOutputs;
+        unsigned long long  deadlineMisses;     // Callbacks that took longer than the block they rendered.
+
+        double              minTime;
+        double              maxTime;
+        double              meanTime;
+        double              p50Time;
+        double              p99Time;
+        double              p999Time;
+
+        double              budget;             // Duration of the last block: the callback deadline.
+
+        double              cpuLoad;            // Last Pa_GetStreamCpuLoad sample, from 0.0 to 1.0.
+        double              cpuLoadPeak;
+        unsigned long long  cpuLoadSamples;
+
+        /**
+         * @brief One line summary, meant for logs.
+         */
+        std::string         toString() const;
+    };
+
+    enum
+    {
+        SubBucketBits =     4,
+        SubBuckets =        1 << SubBucketBits,
+        Octaves =           32,
+        BucketCount =       Octaves * SubBuckets
+    };
+
+private:
+    std::atomic<unsigned long long> _buckets[BucketCount];
+
+    std::atomic<unsigned long long> _callbacks;
+    std::atomic<unsigned long long> _frames;
+    std::atomic<unsigned long long> _totalns;
+    std::atomic<unsigned long long> _minns;
+    std::atomic<unsigned long long> _maxns;
+    std::atomic<unsigned long long> _budgetns;
+
+    std::atomic<unsigned long long> _outputunderflows;
+    std::atomic<unsigned long long> _outputoverflows;
+    std::atomic<unsigned long long> _inputunderflows;
+    std::atomic<unsigned long long> _inputoverflows;
+    std::atomic<unsigned long long> _primingoutputs;
+    std::atomic<unsigned long long> _deadlinemisses;
+
+    std::atomic<double>             _cpuload;
+    std::atomic<double>             _cpuloadpeak;
+    std::atomic<unsigned long long> _cpuloadsamples;
+
+    // Set by reset(), honoured by the audio thread on its next record(), so it stays the only writer.
+    std::atomic<bool>               _resetrequested;
+
+    void    clear();
+
+    static unsigned int         bucketIndex(unsigned long long ns);
+    static unsigned long long   bucketUpperBound(unsigned int index);
+
+    inline static void bump(std::atomic<unsigned long long>& counter, unsigned long long amount = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+public:
+    CallbackStats();
+
+    /**
+     * @brief Records a callback. Audio thread only.
+     * @param ns            Wall time spent in the callback, in nanoseconds.
+     * @param frames        Frames rendered by the callback.
+     * @param samplerate    Sample rate of the stream, to compute the deadline.
+     * @param statusflags   Flags PortAudio passed to the callback.
+     */
+    void        record(unsigned long long ns, unsigned long frames, double samplerate, PaStreamCallbackFlags statusflags);
+
+    /**
+     * @brief Records a Pa_GetStreamCpuLoad() sample. Control thread only.
+     */
+    void        recordCpuLoad(double load);
+
+    /**
+     * @brief Clears every statistic. Snapshots are empty from now on; the counters themselves are cleared by the
+     * audio thread, on the next callback.
+     */
+    void        reset();
+
+    Snapshot    snapshot() const;
+};
@@ -0,0 +1,120 @@
+#include "denormals.h"
+
+#include <atomic>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define DENORMALS_SSE       1
+// Flush-to-zero (bit 15) and denormals-are-zero (bit 6) of MXCSR.
+#define DENORMALS_MXCSR     0x8040u
+#elif defined(__aarch64__)
+#define DENORMALS_AARCH64   1
+// Flush-to-zero (bit 24) of FPCR. AArch64 has no separate bit for inputs: FZ flushes both.
+#define DENORMALS_FPCR      (1ull << 24)
+#endif
+
+#if !defined(NDEBUG)
+static std::atomic<unsigned long long> lostguards(0);
+static std::atomic<unsigned long long> openedguards(0);
+#endif
+
+static unsigned long long readMode()
+{
+#if defined(DENORMALS_SSE)
+    return _mm_getcsr();
+#elif defined(DENORMALS_AARCH64)
+    unsigned long long fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    return fpcr;
+#else
+    return 0;
+#endif
+}
+
+static void writeMode(unsigned long long mode)
+{
+#if defined(DENORMALS_SSE)
+    _mm_setcsr((unsigned int)mode);
+#elif defined(DENORMALS_AARCH64)
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(mode));
+#else
+    (void)mode;
+#endif
+}
+
+static unsigned long long flushBits()
+{
+#if defined(DENORMALS_SSE)
+    return DENORMALS_MXCSR;
+#elif defined(DENORMALS_AARCH64)
+    return DENORMALS_FPCR;
+#else
+    return 0;
+#endif
+}
+
+DenormalGuard::DenormalGuard() :
+    _saved(readMode())
+{
+    // Writing the register is much slower than reading it: skip it if the mode is already on, as in nested guards.
+    if((_saved & flushBits()) != flushBits())
+        writeMode(_saved | flushBits());
+
+#if !defined(NDEBUG)
+    openedguards.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+DenormalGuard::~DenormalGuard()
+{
+    const unsigned long long mode = readMode();
+
+#if !defined(NDEBUG)
+    if((mode & flushBits()) != flushBits())
+        lostguards.fetch_add(1, std::memory_order_relaxed);
+#endif
+
+    // Only the flush bits are restored: the sticky exception flags of MXCSR change on almost any float operation, and
+    // comparing the whole register would write it back on nearly every callback.
+    if((mode & flushBits()) != (_saved & flushBits()))
+        writeMode((mode & ~flushBits()) | (_saved & flushBits()));
+}
+
+bool DenormalGuard::isSupported()
+{
+    return flushBits() != 0;
+}
+
+bool DenormalGuard::isFlushing()
+{
+    return isSupported() && (readMode() & flushBits()) == flushBits();
+}
+
+unsigned long long DenormalGuard::lostCount()
+{
+#if !defined(NDEBUG)
+    return lostguards.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+unsigned long long DenormalGuard::guardCount()
+{
+#if !defined(NDEBUG)
+    return openedguards.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+size_t Denormals::count(const float* buffer, size_t samples)
+{
+    size_t denormals = 0;
+
+    for(size_t i = 0; i < samples; i++)
+        if(isDenormal(buffer[i]))
+            denormals++;
+
+    return denormals;
+}
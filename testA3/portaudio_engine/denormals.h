@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief Puts the calling thread's FPU in flush-to-zero / denormals-are-zero mode for its lifetime, and restores the
+ * previous mode when it ends.
+ *
+ * Decaying envelopes and feedback filters (the highpass of TrackerStream, any future reverb) slowly fall into
+ * denormal floats once their input goes silent, and every operation on a denormal can cost a hundred cycles on x86.
+ * In that mode, denormal results and inputs are taken as zero instead: below 1e-38, which nobody can hear.
+ *
+ * ScopedPAContext::apiCallback and OfflineRenderContext open one around every callback, JobPool and RenderAheadStream
+ * workers for their whole life, and TrackerExporter around an export. Guards nest.
+ *
+ * On SSE it sets the FTZ and DAZ bits of MXCSR, on AArch64 the FZ bit of FPCR (which covers both); elsewhere it does
+ * nothing. Debug builds (without NDEBUG) also check, when a guard ends, that the mode is still on: code that clears it
+ * from inside a callback (a plugin, a library resetting the FPU) is counted in lostCount().
+ */
+class DenormalGuard
+{
+private:
+    unsigned long long  _saved;
+
+public:
+    DenormalGuard();
+    ~DenormalGuard();
+
+    /**
+     * @brief Whether flushing can be enabled on this CPU and compiler.
+     */
+    static bool                 isSupported();
+
+    /**
+     * @brief Whether the calling thread currently flushes denormals to zero.
+     */
+    static bool                 isFlushing();
+
+    /**
+     * @brief Guards that found flushing turned off when they ended. Always 0 in release builds.
+     */
+    static unsigned long long   lostCount();
+
+    /**
+     * @brief Guards opened so far. Always 0 in release builds.
+     */
+    static unsigned long long   guardCount();
+};
+
+/**
+ * @brief Anti-denormal helpers for recursive DSP, for when the FPU mode can't be relied on (another host thread, a
+ * platform without FTZ). None of them adds a DC offset to the signal.
+ *
+ * These rely on IEEE float arithmetic: don't build them with -ffast-math, which would fold flush() away.
+ */
+class Denormals
+{
+public:
+    /**
+     * @brief Returns 0 for anything smaller than about 5e-26, and `x` unchanged (to the last bit) from 2^-35 (about
+     * 2.9e-11) up, where the offset is less than half an ulp. Values in between are rounded to multiples of about 1e-25.
+     * Adding then subtracting the same constant leaves no offset behind.
+     *
+     * Since it rounds small values, output that must be bit exact across paths (TrackerExporter and TrackerStream) must
+     * flush at the same frames on all of them: every sample, not every block. Streams rendered under a DenormalGuard
+     * don't need it at all.
+     */
+    static inline float flush(float x)
+    {
+        volatile float offset = 1e-18f;    // Not folded by the compiler.
+        x += offset;
+        x -= offset;
+        return x;
+    }
+
+    static inline bool  isDenormal(float x)
+    {
+        const float a = (x < 0.0f) ? -x : x;
+        return a != 0.0f && a < 1.17549435e-38f;
+    }
+
+    /**
+     * @brief Denormal samples of a buffer. For debugging.
+     */
+    static size_t       count(const float* buffer, size_t samples);
+};
+
+/**
+ * @brief Tiny signal alternating in sign on every sample (a tone at Nyquist, 1e-20 high), to be added inside a feedback
+ * loop so its state never decays into denormals. Averages to exactly 0, so there's no DC for a filter to build up, and
+ * it is far below the last bit of any audible sample.
+ *
+ *     y = a * y + x + antidenormal.next();
+ */
+class AntiDenormal
+{
+private:
+    float   _value;
+
+public:
+    AntiDenormal() : _value(1e-20f) {}
+
+    inline float next()
+    {
+        _value = -_value;
+        return _value;
+    }
+};
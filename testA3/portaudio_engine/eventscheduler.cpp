@@ -0,0 +1,104 @@
+#include "eventscheduler.h"
+
+EventScheduler::EventScheduler(double samplerate) :
+    _pendingcount(0),
+    _anchorseq(0),
+    _anchorframe(0),
+    _anchortime(0.0),
+    _samplerate(samplerate)
+{
+}
+
+bool EventScheduler::schedule(unsigned long long frame, const StreamCommand& cmd)
+{
+    return _queue.push(ScheduledCommand(frame, cmd));
+}
+
+unsigned long long EventScheduler::frameAt(PaTime time) const
+{
+    unsigned int        seq1, seq2;
+    unsigned long long  frame;
+    double              anchortime;
+
+    do
+    {
+        seq1 =          _anchorseq.load(std::memory_order_acquire);
+        frame =         _anchorframe.load(std::memory_order_relaxed);
+        anchortime =    _anchortime.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        seq2 =          _anchorseq.load(std::memory_order_relaxed);
+    }
+    while(seq1 != seq2 || (seq1 & 1));
+
+    // No anchor yet: stream time 0 means nothing, and extrapolating from it could put the command hours away.
+    if(seq1 == 0)
+        return 0;
+
+    const double offset = (time - anchortime) * _samplerate;
+
+    // Rounded to the nearest frame. Times in the past give the anchor itself, which is applied right away.
+    if(offset <= 0.0)
+        return frame;
+    return frame + (unsigned long long)(offset + 0.5);
+}
+
+void EventScheduler::setAnchor(unsigned long long frame, PaTime dactime)
+{
+    const unsigned int seq = _anchorseq.load(std::memory_order_relaxed);
+
+    _anchorseq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    _anchorframe.store(frame, std::memory_order_relaxed);
+    _anchortime.store(dactime, std::memory_order_relaxed);
+
+    _anchorseq.store(seq + 2, std::memory_order_release);
+}
+
+void EventScheduler::collect()
+{
+    ScheduledCommand event;
+
+    while(_pendingcount < Capacity && _queue.pop(event))
+    {
+        // Insertion sort, descending. Equal frames go below the existing ones, so they are popped after them.
+        unsigned int i = _pendingcount;
+
+        while(i > 0 && _pending[i - 1].frame <= event.frame)
+        {
+            _pending[i] = _pending[i - 1];
+            i--;
+        }
+
+        _pending[i] = event;
+        _pendingcount++;
+    }
+}
+
+bool EventScheduler::nextFrame(unsigned long long& frame) const
+{
+    if(_pendingcount == 0)
+        return false;
+
+    frame = _pending[_pendingcount - 1].frame;
+    return true;
+}
+
+bool EventScheduler::popDue(unsigned long long frame, StreamCommand& cmd)
+{
+    if(_pendingcount == 0 || _pending[_pendingcount - 1].frame > frame)
+        return false;
+
+    cmd = _pending[--_pendingcount].command;
+    return true;
+}
+
+unsigned int EventScheduler::pendingCount() const
+{
+    return _pendingcount;
+}
+
+void EventScheduler::setSampleRate(double samplerate)
+{
+    _samplerate = samplerate;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "portaudio.h"
+#include "commandqueue.h"
+
+#include <atomic>
+
+/**
+ * @brief A StreamCommand stamped with the absolute frame it must be applied at.
+ */
+struct ScheduledCommand
+{
+    unsigned long long  frame;
+    StreamCommand       command;
+
+    ScheduledCommand() : frame(0) {}
+    ScheduledCommand(unsigned long long f, const StreamCommand& cmd) : frame(f), command(cmd) {}
+};
+
+/**
+ * @brief Timestamped command queue, from one control thread to the audio thread.
+ *
+ * Commands are keyed by absolute frame: the number of frames the stream had rendered when it must apply them. They
+ * may be scheduled in any order; the audio thread keeps the ones it has received sorted in a fixed size array, so
+ * nothing is allocated. AudioStreamBase::renderBlock() splits every block at the frames where commands are due.
+ *
+ * Producers can also stamp commands with PortAudio time (see Pa_GetStreamTime()): the audio thread publishes, every
+ * block, which frame is heard at which outputBufferDacTime, and frameAt() extrapolates from there.
+ */
+class EventScheduler
+{
+public:
+    enum
+    {
+        Capacity =  256
+    };
+
+private:
+    typedef SPSCQueue<ScheduledCommand, Capacity>   EventQueue;
+
+    EventQueue                          _queue;
+
+    // Audio thread only. Sorted by descending frame, so the next due command is the last one.
+    ScheduledCommand                    _pending[Capacity];
+    unsigned int                        _pendingcount;
+
+    // Time anchor, published by the audio thread with a sequence lock.
+    std::atomic<unsigned int>           _anchorseq;
+    std::atomic<unsigned long long>     _anchorframe;
+    std::atomic<double>                 _anchortime;
+    double                              _samplerate;
+
+public:
+    EventScheduler(double samplerate = 44100.0);
+
+    /**
+     * @brief Control thread. Schedules a command at an absolute frame. Frames already rendered are applied at the
+     * start of the next block.
+     * @return  false if the queue was full and the command was dropped.
+     */
+    bool                schedule(unsigned long long frame, const StreamCommand& cmd);
+
+    /**
+     * @brief Control thread. Absolute frame that will be heard at `time`, in PortAudio stream time. 0 if no block
+     * was rendered yet, so commands scheduled before the stream starts are applied on its first block.
+     */
+    unsigned long long  frameAt(PaTime time) const;
+
+    /**
+     * @brief Audio thread. Publishes that `frame` is heard at `dactime`.
+     */
+    void                setAnchor(unsigned long long frame, PaTime dactime);
+
+    /**
+     * @brief Audio thread. Moves newly scheduled commands into the sorted pending list, as long as there's room.
+     */
+    void                collect();
+
+    /**
+     * @brief Audio thread. Frame of the next pending command.
+     * @return  false if there is none.
+     */
+    bool                nextFrame(unsigned long long& frame) const;
+
+    /**
+     * @brief Audio thread. Pops the next pending command if it's due at or before `frame`. Commands due at the same
+     * frame come out in the order they were scheduled.
+     * @return  false if there is none.
+     */
+    bool                popDue(unsigned long long frame, StreamCommand& cmd);
+
+    /**
+     * @brief Audio thread. Commands received and not yet applied.
+     */
+    unsigned int        pendingCount() const;
+
+    void                setSampleRate(double samplerate);
+};
@@ -0,0 +1,79 @@
+#include "floataudiostream.h"
+
+FloatAudioStream::FloatAudioStream(unsigned int samplerate, unsigned int channels, PaSampleFormat deviceformat,
+                                   unsigned long busframes) :
+    AudioStreamBase(samplerate, channels, paFloat32, 64),
+    _busframes(busframes > 0 ? busframes : 1),
+    _floatinput(NULL)
+{
+    _bus.resize(_busframes * channels);
+    setDeviceFormat(deviceformat);
+}
+
+bool FloatAudioStream::setDeviceFormat(PaSampleFormat deviceformat)
+{
+    // Conversions write interleaved frames: planar buffers would be overrun.
+    if((deviceformat & paNonInterleaved) != 0 || SampleConversion::bytesPerSample(deviceformat) == 0)
+        return false;
+
+    _sampleformat = deviceformat;
+    return true;
+}
+
+void FloatAudioStream::setInputChannels(unsigned int channels)
+{
+    AudioStreamBase::setInputChannels(channels);
+    _inputbus.resize(_busframes * channels);
+}
+
+int FloatAudioStream::audioOut(void *outputBuffer, unsigned long framesPerBuffer,
+                               const PaStreamCallbackTimeInfo* timeInfo,
+                               PaStreamCallbackFlags statusFlags)
+{
+    (void) timeInfo;
+    (void) statusFlags;
+
+    // Float device: no bus needed. Clamp in place, as any other format would be.
+    if(_sampleformat == paFloat32)
+    {
+        float*  out =       static_cast<float*>(outputBuffer);
+        int     result;
+
+        _floatinput =   static_cast<const float*>(inputBuffer());
+        result =        floatOut(out, framesPerBuffer);
+        _floatinput =   NULL;
+
+        SampleConversion::fromFloat(out, paFloat32, out, framesPerBuffer * _channels);
+        return result;
+    }
+
+    unsigned char*      out =           static_cast<unsigned char*>(outputBuffer);
+    const unsigned char* in =           static_cast<const unsigned char*>(inputBuffer());
+    const unsigned int  samplebytes =   SampleConversion::bytesPerSample(_sampleformat);
+    const unsigned int  framebytes =    samplebytes * _channels;
+    unsigned long       chunk;
+    int                 result =        paContinue, chunkresult;
+
+    // The whole buffer is played even if the stream finishes midway, so every chunk is rendered.
+    for(unsigned long done = 0; done < framesPerBuffer; done += chunk)
+    {
+        chunk = (framesPerBuffer - done < _busframes) ? framesPerBuffer - done : _busframes;
+
+        if(in != NULL)
+        {
+            SampleConversion::toFloat(in + done * samplebytes * _inputchannels, _sampleformat, &(_inputbus[0]),
+                                      chunk * _inputchannels);
+            _floatinput = &(_inputbus[0]);
+        }
+
+        chunkresult =   floatOut(&(_bus[0]), chunk);
+        _floatinput =   NULL;
+
+        if(result == paContinue)
+            result = chunkresult;
+
+        SampleConversion::fromFloat(&(_bus[0]), _sampleformat, out + done * framebytes, chunk * _channels);
+    }
+
+    return result;
+}
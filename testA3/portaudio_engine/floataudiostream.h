@@ -0,0 +1,69 @@
+#pragma once
+
+#include "audiostream.h"
+
+#include <vector>
+
+/**
+ * @brief Inheritable class for streams synthesized in float, whatever the device sample format is.
+ *
+ * Reimplement floatOut() and write interleaved float samples, from -1.0 to 1.0. When the device format is paFloat32,
+ * floatOut() writes straight into the device buffer; otherwise it writes into an internal float bus, which is then
+ * converted (and clamped) to the device format with SampleConversion. The bus is allocated once, in the constructor.
+ * Duplex streams read their input from floatIn(), converted the same way.
+ */
+class FloatAudioStream : public AudioStreamBase
+{
+private:
+    std::vector<float>  _bus;
+    unsigned long       _busframes;
+
+    // Duplex input of the chunk floatOut() is rendering. Converted into _inputbus unless the device gives floats.
+    std::vector<float>  _inputbus;
+    const float*        _floatinput;
+
+protected:
+    /**
+     * @brief Input frames captured along with the ones floatOut() is rendering, as interleaved floats,
+     * getInputChannelAmount() channels. On a float device they are the device's own buffer. NULL if there's no input.
+     * Only valid inside floatOut().
+     */
+    const float*        floatIn() const {return _floatinput;}
+
+public:
+    /**
+     * @brief Creates a float stream.
+     * @param samplerate    Sample rate, in Hz.
+     * @param channels      Amount of interleaved channels.
+     * @param deviceformat  Sample format the device will be opened with. See setDeviceFormat().
+     * @param busframes     Size of the float bus, in frames. Bigger callbacks are rendered in several chunks.
+     */
+    FloatAudioStream(unsigned int samplerate = 44100, unsigned int channels = 2,
+                     PaSampleFormat deviceformat = paFloat32, unsigned long busframes = 4096);
+
+    /**
+     * @brief Changes the sample format presented to the device. Call it before the stream is opened.
+     * @return  false if the format is not supported, in which case the previous one is kept. Formats are interleaved
+     * only: paNonInterleaved is rejected.
+     */
+    bool    setDeviceFormat(PaSampleFormat deviceformat);
+
+    /**
+     * @brief See AudioStreamBase::setInputChannels(). Also sizes the bus input is converted into.
+     */
+    void    setInputChannels(unsigned int channels);
+
+    /**
+     * @brief Callback method to be reimplemented. Fill `frames` frames of interleaved float samples.
+     * @param samples   Sample array to be filled. `frames * getChannelAmount()` floats long.
+     * @param frames    How many frames must be filled.
+     *
+     * @return  Make this function return 0 if you don't want to stop the stream from here. You can return either
+     * paComplete or paAbort otherwise. Consult PortAudio documentation about these.
+     */
+    virtual int floatOut(float* samples, unsigned long frames) = 0;
+
+    int audioOut(void *outputBuffer, unsigned long framesPerBuffer,
+                 const PaStreamCallbackTimeInfo* timeInfo,
+                 PaStreamCallbackFlags statusFlags);
+};
@@ -0,0 +1,168 @@
+#include "inputrecorder.h"
+#include "offlinerendercontext.h"
+#include "sampleconversion.h"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace whimsycore;
+
+// Frames converted at once by the spooler, and how long it sleeps when the ring is empty.
+#define RECORDER_CHUNK_FRAMES   4096
+#define RECORDER_SLEEP_MS       5
+
+InputRecorder::InputRecorder(unsigned int channels, unsigned int samplerate, PaSampleFormat format, double ringseconds) :
+    _channels(channels > 0 ? channels : 1),
+    _samplerate(samplerate),
+    _format(format & ~paNonInterleaved),
+    _ring((size_t)((ringseconds > 0.0 ? ringseconds : 2.0) * samplerate) + 1, channels > 0 ? channels : 1),
+    _recording(false),
+    _running(false),
+    _writing(false),
+    _frames(0),
+    _overruns(0)
+{
+    // WAV 8-bit samples are unsigned, which SampleConversion doesn't write: those fall back to 16 bits.
+    if(_format != paInt24 && _format != paInt32 && _format != paFloat32)
+        _format = paInt16;
+
+    _chunk.resize(RECORDER_CHUNK_FRAMES * _channels);
+    _converted.resize(_chunk.size() * SampleConversion::bytesPerSample(_format));
+}
+
+InputRecorder::~InputRecorder()
+{
+    stop();
+}
+
+bool InputRecorder::start()
+{
+    if(_running.load())
+        return false;
+
+    // Neither side uses the ring now: the audio thread only writes while recording.
+    _ring.clear();
+    _data.clear();
+    _frames.store(0);
+    _overruns.store(0);
+
+    _running.store(true);
+    _spooler = std::thread(&InputRecorder::spoolerLoop, this);
+    _recording.store(true, std::memory_order_release);
+
+    return true;
+}
+
+void InputRecorder::stop()
+{
+    if(!_running.load())
+        return;
+
+    // Both sides are seq_cst: either write() sees the flag down, or this loop sees _writing up.
+    _recording.store(false, std::memory_order_seq_cst);
+
+    // A callback that saw the flag up may still be copying.
+    while(_writing.load(std::memory_order_seq_cst))
+        std::this_thread::yield();
+
+    _running.store(false);
+    _spooler.join();
+}
+
+bool InputRecorder::isRecording() const
+{
+    return _recording.load();
+}
+
+void InputRecorder::write(const float* frames, unsigned long count)
+{
+    _writing.store(true, std::memory_order_seq_cst);
+
+    if(_recording.load(std::memory_order_seq_cst) && frames != NULL)
+    {
+        const size_t written = _ring.write(frames, count);
+
+        _frames.fetch_add(written, std::memory_order_relaxed);
+        if(written < count)
+            _overruns.fetch_add(count - written, std::memory_order_relaxed);
+    }
+
+    _writing.store(false, std::memory_order_release);
+}
+
+size_t InputRecorder::spool()
+{
+    const size_t frames = _ring.read(&(_chunk[0]), RECORDER_CHUNK_FRAMES);
+
+    if(frames == 0)
+        return 0;
+
+    if(_format == paFloat32)
+        _data.pushArray(reinterpret_cast<const byte*>(&(_chunk[0])), frames * _channels * sizeof(float));
+    else
+    {
+        SampleConversion::fromFloat(&(_chunk[0]), _format, &(_converted[0]), frames * _channels);
+        _data.pushArray(&(_converted[0]), frames * _channels * SampleConversion::bytesPerSample(_format));
+    }
+
+    return frames;
+}
+
+void InputRecorder::spoolerLoop()
+{
+    while(_running.load())
+    {
+        if(spool() == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(RECORDER_SLEEP_MS));
+    }
+
+    // Whatever was written before stop().
+    while(spool() > 0)
+        ;
+}
+
+const ByteStream& InputRecorder::data() const
+{
+    return _data;
+}
+
+unsigned long long InputRecorder::writeWav(const char* filepath) const
+{
+    ByteStream header = OfflineRenderContext::wavHeader(_samplerate, _channels, _format, (unsigned long)_data.size());
+
+    std::FILE* fhandler = std::fopen(filepath, "wb");
+    if(!fhandler)
+        throw Exception(NULL, Exception::CouldNotOpenFileForWriting, filepath);
+
+    std::fwrite(header.lowLevelData(), header.size(), 1, fhandler);
+    if(_data.size() > 0)
+        std::fwrite(_data.begin(), _data.size(), 1, fhandler);
+    std::fclose(fhandler);
+
+    return _data.size() / (_channels * SampleConversion::bytesPerSample(_format));
+}
+
+unsigned long long InputRecorder::framesRecorded() const
+{
+    return _frames.load(std::memory_order_relaxed);
+}
+
+unsigned long long InputRecorder::overruns() const
+{
+    return _overruns.load(std::memory_order_relaxed);
+}
+
+unsigned int InputRecorder::getChannelAmount() const
+{
+    return _channels;
+}
+
+unsigned int InputRecorder::getSampleRate() const
+{
+    return _samplerate;
+}
+
+PaSampleFormat InputRecorder::getSampleFormat() const
+{
+    return _format;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "portaudio.h"
+#include "../whimsycore.h"
+#include "audioring.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Records captured input into a ByteStream, without the audio thread ever waiting on the disk or the heap.
+ *
+ * The audio thread hands its input to write(), which only copies it into an AudioRing. A spooler thread, started by
+ * start(), drains the ring every few milliseconds, converts the frames to the recording's sample format and appends
+ * them to the ByteStream. If the spooler falls more than the ring's length behind, frames are dropped and counted as
+ * overruns. After stop(), data() holds the whole take, in the recording's sample format, ready for writeWav().
+ *
+ *     InputRecorder   take(1, 44100);
+ *     monitor.setRecorder(&take);
+ *     take.start();
+ *     ...
+ *     take.stop();
+ *     take.writeWav("take.wav");
+ */
+class InputRecorder
+{
+private:
+    unsigned int                    _channels;
+    unsigned int                    _samplerate;
+    PaSampleFormat                  _format;
+
+    AudioRing                       _ring;
+    whimsycore::ByteStream          _data;
+
+    // Spooler thread only.
+    std::vector<float>              _chunk;
+    std::vector<unsigned char>      _converted;
+
+    std::thread                     _spooler;
+    std::atomic<bool>               _recording;
+    std::atomic<bool>               _running;
+    std::atomic<bool>               _writing;       // The audio thread is inside write().
+
+    std::atomic<unsigned long long> _frames;
+    std::atomic<unsigned long long> _overruns;
+
+    size_t  spool();
+    void    spoolerLoop();
+
+public:
+    /**
+     * @param channels      Interleaved channels handed to write().
+     * @param samplerate    Sample rate of the input, for the WAV header.
+     * @param format        Format the take is stored in: paInt16, paInt24, paInt32 or paFloat32.
+     * @param ringseconds   How long the spooler may stall before frames are lost.
+     */
+    InputRecorder(unsigned int channels, unsigned int samplerate, PaSampleFormat format = paInt16,
+                  double ringseconds = 2.0);
+    ~InputRecorder();
+
+    /**
+     * @brief Forgets the previous take and starts recording a new one.
+     * @return  false if already recording.
+     */
+    bool            start();
+
+    /**
+     * @brief Stops recording, and returns once every frame written so far is in data().
+     */
+    void            stop();
+
+    bool            isRecording() const;
+
+    /**
+     * @brief Audio thread side. Copies interleaved float frames into the take, if recording. Never blocks.
+     *
+     * stop() only waits for a write() that is running. Before destroying the recorder, detach it from the audio thread
+     * (MonitorStream::setRecorder(NULL)) and let a callback go by, so no write() can start on a dead object.
+     */
+    void            write(const float* frames, unsigned long count);
+
+    /**
+     * @brief The take, in the recording's format. Only meaningful while not recording.
+     */
+    const whimsycore::ByteStream&   data() const;
+
+    /**
+     * @brief Writes the take as a WAV file. Throws a whimsycore::Exception if it can't be written.
+     * @return  Frames written.
+     */
+    unsigned long long  writeWav(const char* filepath) const;
+
+    unsigned long long  framesRecorded() const;
+
+    /**
+     * @brief Frames lost because the spooler fell behind.
+     */
+    unsigned long long  overruns() const;
+
+    unsigned int    getChannelAmount() const;
+    unsigned int    getSampleRate() const;
+    PaSampleFormat  getSampleFormat() const;
+};
@@ -0,0 +1,193 @@
+#include "jobpool.h"
+#include "rtsafety.h"
+#include "denormals.h"
+
+#include <chrono>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JOBPOOL_PAUSE()     _mm_pause()
+#else
+#define JOBPOOL_PAUSE()
+#endif
+
+// Pauses spun before a waiting worker parks, and the longest it stays parked before looking again. The timeout only
+// matters if a wakeup is lost, as run() notifies without the mutex.
+#define JOBPOOL_SPINS       2000
+#define JOBPOOL_PARK_MS     10
+
+// Pauses the caller spins waiting for the workers' last jobs before it yields between checks.
+#define JOBPOOL_WAIT_SPINS  4000
+
+static inline uint64_t packRange(uint32_t begin, uint32_t end)
+{
+    return ((uint64_t)begin << 32) | end;
+}
+
+JobPool::JobPool(unsigned int workers) :
+    _participants(0),
+    _batch(0),
+    _done(0),
+    _running(true),
+    _parked(0),
+    _job(NULL),
+    _context(NULL),
+    _realtime(false)
+{
+    if(workers == 0)
+    {
+        const unsigned int hardware = std::thread::hardware_concurrency();
+        workers = (hardware > 1) ? hardware - 1 : 0;
+    }
+
+    _participants = workers + 1;
+    _queues.reset(new Queue[_participants]);
+
+    for(unsigned int w = 1; w <= workers; w++)
+        _threads.push_back(std::thread(&JobPool::workerLoop, this, w));
+}
+
+JobPool::~JobPool()
+{
+    _running.store(false);
+    _wakeup.notify_all();
+
+    for(size_t t = 0; t < _threads.size(); t++)
+        _threads[t].join();
+}
+
+unsigned int JobPool::concurrency() const
+{
+    return _participants;
+}
+
+bool JobPool::pop(unsigned int queue, unsigned int& index)
+{
+    std::atomic<uint64_t>&  range = _queues[queue].range;
+    uint64_t                r =     range.load();
+
+    while((uint32_t)(r >> 32) < (uint32_t)r)
+    {
+        if(range.compare_exchange_weak(r, r + ((uint64_t)1 << 32)))
+        {
+            index = (uint32_t)(r >> 32);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobPool::steal(unsigned int thief, unsigned int& index)
+{
+    for(unsigned int i = 1; i < _participants; i++)
+    {
+        std::atomic<uint64_t>&  range = _queues[(thief + i) % _participants].range;
+        uint64_t                r =     range.load();
+
+        while((uint32_t)(r >> 32) < (uint32_t)r)
+        {
+            if(range.compare_exchange_weak(r, r - 1))
+            {
+                index = (uint32_t)r - 1;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void JobPool::work(unsigned int queue)
+{
+    unsigned int index;
+
+    // The job is read after taking an index, whose range was published after it.
+    while(pop(queue, index) || steal(queue, index))
+    {
+        _job(_context, index);
+        _done.fetch_add(1);
+    }
+}
+
+void JobPool::workerLoop(unsigned int queue)
+{
+    // Workers only ever render.
+    DenormalGuard       denormalguard;
+    unsigned long       seen =  _batch.load();
+
+    while(_running.load(std::memory_order_relaxed))
+    {
+        const unsigned long batch = _batch.load();
+
+        if(batch != seen)
+        {
+            seen = batch;
+
+            // Jobs of an audio callback are checked as part of it.
+            if(_realtime)
+            {
+                RealtimeScope rtscope;
+                work(queue);
+            }
+            else
+                work(queue);
+
+            continue;
+        }
+
+        for(unsigned int s = 0; s < JOBPOOL_SPINS && _batch.load(std::memory_order_relaxed) == seen; s++)
+            JOBPOOL_PAUSE();
+
+        if(_batch.load(std::memory_order_relaxed) != seen)
+            continue;
+
+        // Counted before the batch is checked again: run() either sees us parked or we see its batch.
+        std::unique_lock<std::mutex> lock(_parkmutex);
+
+        _parked.fetch_add(1);
+        if(_batch.load() == seen && _running.load())
+            _wakeup.wait_for(lock, std::chrono::milliseconds(JOBPOOL_PARK_MS));
+        _parked.fetch_sub(1);
+    }
+}
+
+void JobPool::run(Job job, void* context, unsigned int count)
+{
+    if(count == 0)
+        return;
+
+    if(_participants == 1 || count == 1)
+    {
+        for(unsigned int i = 0; i < count; i++)
+            job(context, i);
+        return;
+    }
+
+    _job =      job;
+    _context =  context;
+    _realtime = RealtimeChecker::inside();
+    _done.store(0);
+
+    for(unsigned int p = 0; p < _participants; p++)
+    {
+        const uint32_t begin =  (uint32_t)((uint64_t)count * p / _participants);
+        const uint32_t end =    (uint32_t)((uint64_t)count * (p + 1) / _participants);
+
+        _queues[p].range.store(packRange(begin, end));
+    }
+
+    _batch.fetch_add(1);
+    if(_parked.load() > 0)
+        _wakeup.notify_all();
+
+    // Takes our range, then whatever the workers haven't started.
+    work(0);
+
+    // Whatever is left is being run by a worker.
+    for(unsigned int s = 0; _done.load() < count; s++)
+    {
+        if(s < JOBPOOL_WAIT_SPINS)
+            JOBPOOL_PAUSE();
+        else
+            std::this_thread::yield();
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Persistent worker threads that split a batch of independent jobs with the calling thread, such as the
+ * channels of a block, and return once all of them are done.
+ *
+ * run() deals the job indices out in contiguous ranges, one per thread, the caller included. Every thread takes jobs
+ * from the front of its own range and, once it's empty, steals from the back of the others', so a slow job doesn't
+ * hold the rest back. Ranges are single atomic words updated with compare-and-swap: nothing on the way allocates nor
+ * locks a mutex.
+ *
+ * Between batches the workers spin for a few microseconds, then park on a condition variable, so they don't burn the
+ * CPU between audio callbacks. run() only wakes them if some are parked, without locking anything. The caller starts
+ * on its own range right away and steals the ranges of the workers that aren't up yet, so a late wakeup costs
+ * parallelism, never a deadline; it only waits for jobs a worker has already started.
+ *
+ *     JobPool jobs(3);
+ *     song.setJobPool(&jobs);    // Before playing.
+ *
+ * run() is not reentrant: call it from one thread at a time, usually the audio thread.
+ */
+class JobPool
+{
+public:
+    typedef void (*Job)(void* context, unsigned int index);
+
+private:
+    // Jobs still to take by one thread: begin in the high half, end in the low half. Padded to a cache line.
+    struct Queue
+    {
+        std::atomic<uint64_t>   range;
+        char                    padding[64 - sizeof(std::atomic<uint64_t>)];
+
+        Queue() : range(0) {}
+    };
+
+    std::vector<std::thread>    _threads;
+    std::unique_ptr<Queue[]>    _queues;            // Queue 0 is the caller's.
+    unsigned int                _participants;
+
+    std::atomic<unsigned long>  _batch;             // Incremented for every batch.
+    std::atomic<unsigned int>   _done;
+    std::atomic<bool>           _running;
+
+    // Parked workers wait on _wakeup. Only they lock the mutex; run() just notifies.
+    std::mutex                  _parkmutex;
+    std::condition_variable     _wakeup;
+    std::atomic<unsigned int>   _parked;
+
+    // Batch being run. Written before the ranges are published.
+    Job                         _job;
+    void*                       _context;
+    bool                        _realtime;          // Issued from inside a RealtimeScope.
+
+    bool    pop(unsigned int queue, unsigned int& index);
+    bool    steal(unsigned int thief, unsigned int& index);
+    void    work(unsigned int queue);
+    void    workerLoop(unsigned int queue);
+
+public:
+    /**
+     * @brief Starts the workers.
+     * @param workers   Threads besides the caller. 0 uses one less than the hardware threads.
+     */
+    JobPool(unsigned int workers = 0);
+
+    /**
+     * @brief Stops and joins the workers.
+     */
+    ~JobPool();
+
+    /**
+     * @brief Runs job(context, i) for every i below `count`, on the workers and the calling thread, and returns once
+     * all of them have finished. Single batches of one job run straight on the caller.
+     */
+    void    run(Job job, void* context, unsigned int count);
+
+    /**
+     * @brief Threads sharing the jobs, the caller included.
+     */
+    unsigned int    concurrency() const;
+};
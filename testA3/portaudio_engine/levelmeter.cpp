@@ -0,0 +1,292 @@
+#include "levelmeter.h"
+#include "sampleconversion.h"
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Magnitude from which a sample is counted as clipped: full scale, for 16 bit and wider formats.
+#define LEVELMETER_CLIP_LEVEL       0.99996f
+
+// Samples summed in float before being added to the window in double. Also the size of the conversion buffer.
+#define LEVELMETER_CHUNK            256
+
+#define LEVELMETER_DEFAULT_WINDOW   0.05
+
+LevelMeter::LevelMeter() :
+    _channels(0),
+    _windowframes(1),
+    _samplerate(44100.0),
+    _integrationtime(LEVELMETER_DEFAULT_WINDOW),
+    _windows(0)
+{
+    _sequence.store(0);
+    _resetrequested.store(false);
+
+    for(unsigned int c = 0; c < LEVELMETER_MAX_CHANNELS; c++)
+    {
+        _clips[c] = 0;
+        _pubpeak[c].store(0.0f);
+        _pubrms[c].store(0.0f);
+        _pubclips[c].store(0);
+    }
+
+    _pubchannels.store(0);
+    _pubwindows.store(0);
+
+    clearWindow();
+    configure(0, _samplerate);
+}
+
+void LevelMeter::configure(unsigned int channels, double samplerate)
+{
+    _channels =     channels;
+    _samplerate =   (samplerate > 0.0) ? samplerate : 44100.0;
+
+    setIntegrationTime(_integrationtime);
+    clearWindow();
+}
+
+void LevelMeter::setIntegrationTime(double seconds)
+{
+    _integrationtime =  (seconds > 0.0) ? seconds : LEVELMETER_DEFAULT_WINDOW;
+    _windowframes =     (unsigned long)(_integrationtime * _samplerate);
+
+    if(_windowframes == 0)
+        _windowframes = 1;
+}
+
+void LevelMeter::clearWindow()
+{
+    for(unsigned int c = 0; c < LEVELMETER_MAX_CHANNELS; c++)
+    {
+        _peak[c] =          0.0f;
+        _sumsquares[c] =    0.0;
+    }
+    _frames = 0;
+}
+
+void LevelMeter::publish()
+{
+    const unsigned int  sequence =  _sequence.load(std::memory_order_relaxed);
+    const unsigned int  channels =  (_channels < LEVELMETER_MAX_CHANNELS) ? _channels : LEVELMETER_MAX_CHANNELS;
+
+    _sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for(unsigned int c = 0; c < channels; c++)
+    {
+        _pubpeak[c].store(_peak[c], std::memory_order_relaxed);
+        _pubrms[c].store((_frames > 0) ? (float)std::sqrt(_sumsquares[c] / _frames) : 0.0f, std::memory_order_relaxed);
+        _pubclips[c].store(_clips[c], std::memory_order_relaxed);
+    }
+    _pubchannels.store(channels, std::memory_order_relaxed);
+    _pubwindows.store(_windows, std::memory_order_relaxed);
+
+    _sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void LevelMeter::accumulate(const float* buffer, unsigned long frames, unsigned int stride, unsigned int firstchannel,
+                            unsigned int channels)
+{
+    const unsigned long samples =   frames * stride;
+    unsigned long       i =         0;
+
+#if defined(__SSE2__)
+    // Every lane sees the same channel all along when the buffer has 1, 2 or 4 channels.
+    if(channels == stride && (stride == 1 || stride == 2 || stride == 4))
+    {
+        const __m128    signmask =  _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        const __m128    cliplevel = _mm_set1_ps(LEVELMETER_CLIP_LEVEL);
+
+        while(i + 4 <= samples)
+        {
+            const unsigned long end =       (samples - i > LEVELMETER_CHUNK) ? i + LEVELMETER_CHUNK : samples;
+            __m128              peak =      _mm_setzero_ps();
+            __m128              squares =   _mm_setzero_ps();
+            __m128i             clips =     _mm_setzero_si128();
+
+            for(; i + 4 <= end; i += 4)
+            {
+                const __m128 x =    _mm_loadu_ps(buffer + i);
+                const __m128 mag =  _mm_and_ps(x, signmask);
+
+                peak =      _mm_max_ps(peak, mag);
+                squares =   _mm_add_ps(squares, _mm_mul_ps(x, x));
+                clips =     _mm_sub_epi32(clips, _mm_castps_si128(_mm_cmpge_ps(mag, cliplevel)));
+            }
+
+            float           lanepeak[4], lanesquares[4];
+            int             laneclips[4];
+
+            _mm_storeu_ps(lanepeak, peak);
+            _mm_storeu_ps(lanesquares, squares);
+            _mm_storeu_si128((__m128i*)laneclips, clips);
+
+            for(unsigned int l = 0; l < 4; l++)
+            {
+                const unsigned int c = firstchannel + l % stride;
+
+                if(lanepeak[l] > _peak[c])
+                    _peak[c] = lanepeak[l];
+                _sumsquares[c] +=   lanesquares[l];
+                _clips[c] +=        (unsigned int)laneclips[l];
+            }
+        }
+    }
+#endif
+
+    // What's left, or everything if the layout doesn't fit the vectors.
+    for(; i < samples; i++)
+    {
+        const unsigned int channel = (unsigned int)(i % stride);
+
+        if(channel >= channels)
+            continue;
+
+        const unsigned int  c =     firstchannel + channel;
+        const float         x =     buffer[i];
+        const float         mag =   std::fabs(x);
+
+        if(mag > _peak[c])
+            _peak[c] = mag;
+        _sumsquares[c] += x * x;
+        if(mag >= LEVELMETER_CLIP_LEVEL)
+            _clips[c]++;
+    }
+}
+
+void LevelMeter::processFloat(const float* buffer, unsigned long frames)
+{
+    process(buffer, frames, paFloat32);
+}
+
+void LevelMeter::process(const void* buffer, unsigned long frames, PaSampleFormat sampleformat)
+{
+    if(_resetrequested.load(std::memory_order_acquire))
+    {
+        for(unsigned int c = 0; c < LEVELMETER_MAX_CHANNELS; c++)
+            _clips[c] = 0;
+        clearWindow();
+
+        _windows = 0;
+        publish();
+
+        _resetrequested.store(false, std::memory_order_release);
+    }
+
+    const PaSampleFormat    format =        sampleformat & ~paNonInterleaved;
+    const bool              planar =        (sampleformat & paNonInterleaved) != 0;
+    const unsigned int      samplebytes =   SampleConversion::bytesPerSample(format);
+    const unsigned int      metered =       (_channels < LEVELMETER_MAX_CHANNELS) ? _channels : LEVELMETER_MAX_CHANNELS;
+
+    if(buffer == NULL || samplebytes == 0 || _channels == 0 || _channels > LEVELMETER_CHUNK)
+        return;
+
+    if(planar)
+    {
+        for(unsigned int c = 0; c < metered; c++)
+        {
+            const void* plane = static_cast<const void* const*>(buffer)[c];
+
+            if(format == paFloat32)
+            {
+                accumulate(static_cast<const float*>(plane), frames, 1, c, 1);
+                continue;
+            }
+
+            float converted[LEVELMETER_CHUNK];
+
+            for(unsigned long f = 0; f < frames; f += LEVELMETER_CHUNK)
+            {
+                const unsigned long chunk = (frames - f < LEVELMETER_CHUNK) ? frames - f : LEVELMETER_CHUNK;
+
+                SampleConversion::toFloat(static_cast<const unsigned char*>(plane) + f * samplebytes, format,
+                                          converted, chunk);
+                accumulate(converted, chunk, 1, c, 1);
+            }
+        }
+    }
+    else if(format == paFloat32)
+        accumulate(static_cast<const float*>(buffer), frames, _channels, 0, metered);
+    else
+    {
+        const unsigned long chunkframes = LEVELMETER_CHUNK / _channels;
+        float               converted[LEVELMETER_CHUNK];
+
+        for(unsigned long f = 0; f < frames; f += chunkframes)
+        {
+            const unsigned long chunk = (frames - f < chunkframes) ? frames - f : chunkframes;
+
+            SampleConversion::toFloat(static_cast<const unsigned char*>(buffer) + f * samplebytes * _channels, format,
+                                      converted, chunk * _channels);
+            accumulate(converted, chunk, _channels, 0, metered);
+        }
+    }
+
+    _frames += frames;
+    if(_frames >= _windowframes)
+    {
+        _windows++;
+        publish();
+        clearWindow();
+    }
+}
+
+void LevelMeter::reset()
+{
+    _resetrequested.store(true, std::memory_order_release);
+}
+
+LevelMeter::Snapshot LevelMeter::snapshot() const
+{
+    Snapshot        snap;
+    unsigned int    before, after;
+
+    do
+    {
+        before = _sequence.load(std::memory_order_acquire);
+
+        snap.channels = _pubchannels.load(std::memory_order_relaxed);
+        if(snap.channels > LEVELMETER_MAX_CHANNELS)
+            snap.channels = LEVELMETER_MAX_CHANNELS;
+
+        for(unsigned int c = 0; c < LEVELMETER_MAX_CHANNELS; c++)
+        {
+            snap.peak[c] =  _pubpeak[c].load(std::memory_order_relaxed);
+            snap.rms[c] =   _pubrms[c].load(std::memory_order_relaxed);
+            snap.clips[c] = _pubclips[c].load(std::memory_order_relaxed);
+        }
+        snap.windows = _pubwindows.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = _sequence.load(std::memory_order_relaxed);
+    }
+    while((before & 1) != 0 || before != after);
+
+    double squares = 0.0;
+
+    snap.masterPeak =   0.0f;
+    snap.masterClips =  0;
+
+    for(unsigned int c = 0; c < snap.channels; c++)
+    {
+        if(snap.peak[c] > snap.masterPeak)
+            snap.masterPeak = snap.peak[c];
+        squares +=          (double)snap.rms[c] * snap.rms[c];
+        snap.masterClips += snap.clips[c];
+    }
+    snap.masterRms = (snap.channels > 0) ? (float)std::sqrt(squares / snap.channels) : 0.0f;
+
+    return snap;
+}
+
+float LevelMeter::Snapshot::toDecibels(float level)
+{
+    if(level <= 1e-6f)
+        return -120.0f;
+
+    return 20.0f * std::log10(level);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "portaudio.h"
+
+#include <atomic>
+
+// Channels metered. Further channels of a buffer are ignored.
+#define LEVELMETER_MAX_CHANNELS     8
+
+/**
+ * @brief Peak, RMS and clip meters of an audio buffer, per channel and for all of them, meant for the GUI.
+ *
+ * The audio thread calls process() on every buffer it outputs. Levels are integrated over a window (50ms by default)
+ * and, once it's complete, published as a whole through a seqlock: snapshot() may be called from any other thread,
+ * for instance a QTimer, and never sees half a window. The audio thread never waits for it; a snapshot taken while
+ * a window is being published is simply retried.
+ *
+ * Levels are computed with SSE2, four samples at a time, and cost a few nanoseconds per 64 frame block. Formats other
+ * than paFloat32 are converted to float in small chunks on the stack first. A sample clips if its magnitude reaches
+ * LEVELMETER_CLIP_LEVEL, which full scale integer samples do too.
+ */
+class LevelMeter
+{
+public:
+    struct Snapshot
+    {
+        unsigned int        channels;
+
+        float               peak[LEVELMETER_MAX_CHANNELS];      // Linear, highest magnitude in the window.
+        float               rms[LEVELMETER_MAX_CHANNELS];       // Linear.
+        unsigned long long  clips[LEVELMETER_MAX_CHANNELS];     // Clipped samples since the last reset().
+
+        float               masterPeak;
+        float               masterRms;
+        unsigned long long  masterClips;
+
+        unsigned long long  windows;                            // Windows published since the last reset().
+
+        /**
+         * @brief Converts a linear level to dBFS. Silence gives -120 dB.
+         */
+        static float        toDecibels(float level);
+    };
+
+private:
+    unsigned int                    _channels;
+    unsigned long                   _windowframes;
+    double                          _samplerate, _integrationtime;
+
+    // Window being integrated. Audio thread only.
+    float                           _peak[LEVELMETER_MAX_CHANNELS];
+    double                          _sumsquares[LEVELMETER_MAX_CHANNELS];
+    unsigned long long              _clips[LEVELMETER_MAX_CHANNELS];
+    unsigned long                   _frames;
+    unsigned long long              _windows;
+
+    // Last complete window. Odd sequence numbers mean it's being written.
+    std::atomic<unsigned int>       _sequence;
+    std::atomic<unsigned int>       _pubchannels;
+    std::atomic<float>              _pubpeak[LEVELMETER_MAX_CHANNELS];
+    std::atomic<float>              _pubrms[LEVELMETER_MAX_CHANNELS];
+    std::atomic<unsigned long long> _pubclips[LEVELMETER_MAX_CHANNELS];
+    std::atomic<unsigned long long> _pubwindows;
+
+    // Set by reset(), honoured by the audio thread on its next process(), so it stays the only writer.
+    std::atomic<bool>               _resetrequested;
+
+    void    clearWindow();
+    void    publish();
+    void    accumulate(const float* buffer, unsigned long frames, unsigned int stride, unsigned int firstchannel,
+                       unsigned int channels);
+
+public:
+    LevelMeter();
+
+    /**
+     * @brief Sets the layout of the buffers to come. Not thread safe: call it before the stream starts.
+     */
+    void        configure(unsigned int channels, double samplerate);
+
+    /**
+     * @brief Length of the windows levels are integrated over. Not thread safe, as configure().
+     */
+    void        setIntegrationTime(double seconds);
+
+    /**
+     * @brief Meters a buffer. Audio thread only.
+     * @param buffer        Interleaved buffer, or `channels` planes if `sampleformat` has the paNonInterleaved flag.
+     * @param sampleformat  Format of the samples. Unsupported formats are ignored.
+     */
+    void        process(const void* buffer, unsigned long frames, PaSampleFormat sampleformat);
+
+    /**
+     * @brief Meters an interleaved float buffer. Audio thread only.
+     */
+    void        processFloat(const float* buffer, unsigned long frames);
+
+    /**
+     * @brief Clears the levels and the clip counters. Done by the audio thread, on its next process().
+     */
+    void        reset();
+
+    /**
+     * @brief Levels of the last complete window. Never blocks the audio thread.
+     */
+    Snapshot    snapshot() const;
+};
@@ -0,0 +1,79 @@
+#include "metronometest.h"
+
+#include <cmath>
+#include <cstring>
+
+#define METRONOME_CLICK_HZ      500.0f
+#define METRONOME_CLICK_SECONDS 0.02
+
+MetronomeTest::MetronomeTest() :
+    FloatAudioStream(44100, 2),
+    osc(44100.0f, Oscillator::Square, METRONOME_CLICK_HZ),
+    mono(1024),
+    frame(0),
+    beatstart(0),
+    nextbeat(0.0),
+    bpm(120.0),
+    volume(0.5f)
+{}
+
+void MetronomeTest::onCommand(const StreamCommand& cmd)
+{
+    switch(cmd.parameter)
+    {
+        case ParamBPM:
+            bpm =       cmd.get<double>();
+        break;
+        case ParamVolume:
+            volume =    cmd.get<float>();
+        break;
+        default:
+        break;
+    }
+}
+
+int MetronomeTest::floatOut(float* samples, unsigned long frames)
+{
+    const unsigned int          channels =  getChannelAmount();
+    const unsigned long long    duration =  (unsigned long long)(getSampleRateFloat() * METRONOME_CLICK_SECONDS);
+    const unsigned long long    end =       frame + frames;
+
+    osc.setAmplitude(volume);
+
+    // Render in segments that are either all click or all silence.
+    while(frame < end)
+    {
+        if((double)frame >= nextbeat)
+        {
+            beatstart = frame;
+            nextbeat += (double)getSampleRateFloat() * 60.0 / (bpm > 0.0 ? bpm : 1.0);
+            osc.reset();
+        }
+
+        const unsigned long long    next =      (unsigned long long)std::ceil(nextbeat);
+        const unsigned long long    clickend =  beatstart + duration;
+        unsigned long long          stop;
+        float*                      out =       samples + (frame - (end - frames)) * channels;
+
+        if(frame < clickend)
+        {
+            stop = (clickend < end) ? clickend : end;
+            if(stop > next)
+                stop = next;
+            if(stop - frame > mono.size())
+                stop = frame + mono.size();
+
+            osc.render(&(mono[0]), (unsigned long)(stop - frame));
+            Oscillator::spread(&(mono[0]), out, (unsigned long)(stop - frame), channels);
+        }
+        else
+        {
+            stop = (next < end) ? next : end;
+            std::memset(out, 0, (size_t)(stop - frame) * channels * sizeof(float));
+        }
+
+        frame = stop;
+    }
+
+    return 0;
+}
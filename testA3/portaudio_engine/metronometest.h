@@ -0,0 +1,43 @@
+#pragma once
+
+#include "floataudiostream.h"
+#include "oscillator.h"
+
+#include <vector>
+
+/**
+ * @brief Metronome click generator. BPM and volume can be changed from any single control thread while playing,
+ * since changes travel to the audio thread through the stream's command queue.
+ *
+ * Clicks are 20ms of band-limited 500Hz square wave. Beat positions are kept in fractional frames, so the tempo
+ * doesn't drift whatever the BPM is.
+ */
+class MetronomeTest : public FloatAudioStream
+{
+private:
+    Oscillator          osc;
+    std::vector<float>  mono;
+
+    unsigned long long  frame;      // Frames rendered so far.
+    unsigned long long  beatstart;  // Frame where the last click started.
+    double              nextbeat;   // Frame where the next click starts.
+    double              bpm;
+    float               volume;
+
+protected:
+    void onCommand(const StreamCommand& cmd);
+
+public:
+    enum Parameters
+    {
+        ParamBPM,
+        ParamVolume
+    };
+
+    MetronomeTest();
+
+    bool changeBPM(double _bpm){return setParameter(ParamBPM, _bpm);}
+    bool changeVolume(float _vol){return setParameter(ParamVolume, _vol);}
+
+    int floatOut(float* samples, unsigned long frames);
+};
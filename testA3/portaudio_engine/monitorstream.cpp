@@ -0,0 +1,70 @@
+#include "monitorstream.h"
+
+#include <cstring>
+
+MonitorStream::MonitorStream(unsigned int samplerate, unsigned int channels, unsigned int inputchannels,
+                             PaSampleFormat deviceformat) :
+    FloatAudioStream(samplerate, channels, deviceformat),
+    _recorder(NULL),
+    _gain(1.0f),
+    _currentgain(1.0f),
+    _monitoring(true)
+{
+    setInputChannels(inputchannels > 0 ? inputchannels : 1);
+}
+
+bool MonitorStream::setRecorder(InputRecorder* recorder)
+{
+    if(recorder != NULL && recorder->getChannelAmount() != _inputchannels)
+        return false;
+
+    _recorder.store(recorder, std::memory_order_release);
+    return true;
+}
+
+void MonitorStream::onCommand(const StreamCommand& cmd)
+{
+    switch(cmd.parameter)
+    {
+        case ParamGain:
+            _gain = cmd.get<float>();
+        break;
+        case ParamMonitoring:
+            _monitoring = cmd.get<bool>();
+        break;
+        default:
+        break;
+    }
+}
+
+int MonitorStream::floatOut(float* samples, unsigned long frames)
+{
+    const float*    in =        floatIn();
+    InputRecorder*  recorder =  _recorder.load(std::memory_order_acquire);
+    const float     target =    _monitoring ? _gain : 0.0f;
+
+    if(recorder != NULL)
+        recorder->write(in, frames);
+
+    if(in == NULL || (target == 0.0f && _currentgain == 0.0f))
+    {
+        std::memset(samples, 0, frames * _channels * sizeof(float));
+        _currentgain = target;
+        return paContinue;
+    }
+
+    // Gain changes are ramped over the block, so they don't click.
+    const float step = (target - _currentgain) / (float)frames;
+    float       gain = _currentgain;
+
+    for(unsigned long f = 0; f < frames; f++)
+    {
+        gain += step;
+
+        for(unsigned int c = 0; c < _channels; c++)
+            samples[f * _channels + c] = in[f * _inputchannels + c % _inputchannels] * gain;
+    }
+
+    _currentgain = target;
+    return paContinue;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "floataudiostream.h"
+#include "inputrecorder.h"
+
+#include <atomic>
+
+/**
+ * @brief Duplex stream that plays its input back, for monitoring an instrument while it's being sampled, and hands it
+ * to an InputRecorder.
+ *
+ * On a float device the input is read straight from PortAudio's buffer and written straight into the output one, so
+ * a monitored frame is only ever copied once; other formats go through FloatAudioStream's buses. Input channels are
+ * spread over the output ones: a mono input is heard on both sides of a stereo output.
+ *
+ *     MonitorStream   monitor(44100, 2, 1);
+ *     InputRecorder   take(1, 44100);
+ *
+ *     monitor.setRecorder(&take);
+ *     pactx.setLatencyPolicy(ScopedPAContext::LatencyPolicy::lowestStable());
+ *     pactx.setStream(monitor);
+ *     pactx.startStream();
+ *     take.start();
+ */
+class MonitorStream : public FloatAudioStream
+{
+private:
+    std::atomic<InputRecorder*> _recorder;
+
+    float                       _gain, _currentgain;
+    bool                        _monitoring;
+
+protected:
+    void onCommand(const StreamCommand& cmd);
+
+public:
+    enum Parameters
+    {
+        ParamGain,          // float, linear. Ramped over a block.
+        ParamMonitoring     // bool. false records without playing anything back.
+    };
+
+    /**
+     * @param inputchannels Channels captured from the input device.
+     */
+    MonitorStream(unsigned int samplerate = 44100, unsigned int channels = 2, unsigned int inputchannels = 1,
+                  PaSampleFormat deviceformat = paFloat32);
+
+    /**
+     * @brief Recorder the input goes to, or NULL for none. Safe to call while playing.
+     *
+     * The callback may still be holding the previous recorder when this returns: keep it alive until the stream is
+     * stopped, or until the callback that was running has returned (a couple of block lengths later).
+     * @return  false if the recorder doesn't have as many channels as the input.
+     */
+    bool    setRecorder(InputRecorder* recorder);
+
+    bool    setGain(float gain){return setParameter(ParamGain, gain);}
+    bool    setMonitoring(bool monitoring){return setParameter(ParamMonitoring, monitoring);}
+
+    int floatOut(float* samples, unsigned long frames);
+};
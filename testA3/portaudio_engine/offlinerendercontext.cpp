@@ -0,0 +1,224 @@
+#include "offlinerendercontext.h"
+#include "sampleconversion.h"
+#include "rtsafety.h"
+#include "denormals.h"
+
+#include <chrono>
+
+using namespace whimsycore;
+
+// Frames rendered per fwrite call in renderToWav.
+#define OFFLINE_WAV_CHUNK_FRAMES    8192
+
+OfflineRenderContext::OfflineRenderContext(unsigned long blocksize) :
+    _as(NULL),
+    _blocksize(blocksize > 0 ? blocksize : 1),
+    _framesrendered(0),
+    _rendertime(0.0)
+{
+    memset(&_timeinfo, 0, sizeof(PaStreamCallbackTimeInfo));
+}
+
+void OfflineRenderContext::setStream(AudioStreamBase& astream)
+{
+    _as =               &astream;
+    _framesrendered =   0;
+    _rendertime =       0.0;
+
+    memset(&_timeinfo, 0, sizeof(PaStreamCallbackTimeInfo));
+}
+
+void OfflineRenderContext::setBlockSize(unsigned long blocksize)
+{
+    _blocksize =    (blocksize > 0) ? blocksize : 1;
+}
+
+unsigned long OfflineRenderContext::getBlockSize() const
+{
+    return _blocksize;
+}
+
+unsigned long long OfflineRenderContext::renderBlocks(byte* dest, unsigned long long frames, bool& finished)
+{
+    const unsigned int  samplebytes =   SampleConversion::bytesPerSample(_as->_sampleformat);
+    const unsigned int  framebytes =    samplebytes * _as->_channels;
+    const bool          planar =        _as->isPlanar();
+    unsigned long long  done =          0;
+    unsigned long       block;
+    int                 result;
+
+    if(planar)
+    {
+        _planar.resize((size_t)_blocksize * framebytes);
+        _planes.resize(_as->_channels);
+
+        for(unsigned int c = 0; c < _as->_channels; c++)
+            _planes[c] = &(_planar[(size_t)c * _blocksize * samplebytes]);
+    }
+
+    // This thread is the audio thread until the render ends.
+    DenormalGuard denormalguard;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    while(done < frames && !finished)
+    {
+        RealtimeScope rtscope;
+
+        block = (frames - done < _blocksize) ? (unsigned long)(frames - done) : _blocksize;
+
+        _timeinfo.currentTime =         (double)_framesrendered / _as->_samplerated;
+        _timeinfo.outputBufferDacTime = _timeinfo.currentTime;
+
+        if(planar)
+        {
+            result = _as->renderBlock(&(_planes[0]), block, &_timeinfo, 0);
+            SampleConversion::interleave(&(_planes[0]), dest + done * framebytes, block, _as->_channels, samplebytes);
+        }
+        else
+            result = _as->renderBlock(dest + done * framebytes, block, &_timeinfo, 0);
+
+        // As in PortAudio, the block that returns paComplete is still part of the output.
+        if(result != paContinue)
+            finished = true;
+
+        done +=             block;
+        _framesrendered +=  block;
+    }
+
+    _rendertime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return done;
+}
+
+unsigned long long OfflineRenderContext::render(ByteStream& dest, unsigned long long frames)
+{
+    if(_as == NULL || frames == 0)
+        return 0;
+
+    const unsigned int  framebytes =    SampleConversion::bytesPerSample(_as->_sampleformat) * _as->_channels;
+    if(framebytes == 0)
+        throw Exception(NULL, Exception::InvalidConversion, "Sample format not supported by the offline renderer.");
+
+    const size_t        offset =        dest.size();
+    bool                finished =      false;
+    unsigned long long  done;
+
+    dest.resize(offset + frames * framebytes);
+    done = renderBlocks(dest.lowLevelData() + offset, frames, finished);
+    dest.resize(offset + done * framebytes);
+
+    return done;
+}
+
+unsigned long long OfflineRenderContext::renderToWav(const char* filepath, unsigned long long frames)
+{
+    if(_as == NULL)
+        return 0;
+
+    const unsigned int  samplebytes =   SampleConversion::bytesPerSample(_as->_sampleformat);
+    const unsigned int  framebytes =    samplebytes * _as->_channels;
+    if(framebytes == 0)
+        throw Exception(NULL, Exception::InvalidConversion, "Sample format not supported by the offline renderer.");
+
+    std::FILE* fhandler = std::fopen(filepath, "wb");
+    if(!fhandler)
+        throw Exception(NULL, Exception::CouldNotOpenFileForWriting, filepath);
+
+    // Placeholder header. Sizes are patched once we know how many frames were actually rendered.
+    ByteStream          header =        wavHeader(_as->_samplerate, _as->_channels, _as->_sampleformat, 0);
+    std::fwrite(header.lowLevelData(), header.size(), 1, fhandler);
+
+    unsigned long long  chunkframes =   (OFFLINE_WAV_CHUNK_FRAMES / _blocksize + 1) * _blocksize;
+    unsigned long long  done =          0, block;
+    bool                finished =      false;
+    ByteStream          chunk;
+
+    chunk.resize(chunkframes * framebytes);
+
+    while(done < frames && !finished)
+    {
+        block = renderBlocks(chunk.lowLevelData(), (frames - done < chunkframes) ? frames - done : chunkframes, finished);
+
+        // WAV 8-bit samples are unsigned.
+        if((_as->_sampleformat & ~paNonInterleaved) == paInt8)
+        {
+            for(size_t i = 0; i < block * framebytes; i++)
+                chunk[i] ^= 0x80;
+        }
+
+        std::fwrite(chunk.lowLevelData(), block * framebytes, 1, fhandler);
+        done += block;
+    }
+
+    header = wavHeader(_as->_samplerate, _as->_channels, _as->_sampleformat, done * framebytes);
+    std::rewind(fhandler);
+    std::fwrite(header.lowLevelData(), header.size(), 1, fhandler);
+    std::fclose(fhandler);
+
+    return done;
+}
+
+unsigned long long OfflineRenderContext::framesRendered() const
+{
+    return _framesrendered;
+}
+
+double OfflineRenderContext::renderTime() const
+{
+    return _rendertime;
+}
+
+double OfflineRenderContext::framesPerSecond() const
+{
+    if(_rendertime <= 0.0)
+        return 0.0;
+
+    return (double)_framesrendered / _rendertime;
+}
+
+double OfflineRenderContext::realtimeFactor() const
+{
+    if(_as == NULL)
+        return 0.0;
+
+    return framesPerSecond() / _as->_samplerated;
+}
+
+ByteStream OfflineRenderContext::wavHeader(unsigned int samplerate, unsigned int channels, PaSampleFormat sampleformat,
+                                           unsigned long datasize)
+{
+    ByteStream          header;
+    const bool          isfloat =       ((sampleformat & ~paNonInterleaved) == paFloat32);
+    const unsigned int  samplebytes =   SampleConversion::bytesPerSample(sampleformat);
+    const unsigned int  fmtsize =       isfloat ? 18 : 16;
+
+    // RIFF chunk. Float WAVs carry an extra "fact" chunk.
+    header.addItems("RIFF");
+    header.addIntLittleEndian(4 + (8 + fmtsize) + (isfloat ? 12 : 0) + 8 + datasize);
+    header.addItems("WAVE");
+
+    // Format chunk. 1 = Integer PCM, 3 = IEEE float.
+    header.addItems("fmt ");
+    header.addIntLittleEndian(fmtsize);
+    header.addWordLittleEndian(isfloat ? 3 : 1);
+    header.addWordLittleEndian(channels);
+    header.addIntLittleEndian(samplerate);
+    header.addIntLittleEndian(samplerate * channels * samplebytes);
+    header.addWordLittleEndian(channels * samplebytes);
+    header.addWordLittleEndian(samplebytes * 8);
+
+    if(isfloat)
+    {
+        header.addWordLittleEndian(0);
+        header.addItems("fact");
+        header.addIntLittleEndian(4);
+        header.addIntLittleEndian((channels * samplebytes > 0) ? datasize / (channels * samplebytes) : 0);
+    }
+
+    // Data chunk header. Samples follow.
+    header.addItems("data");
+    header.addIntLittleEndian(datasize);
+
+    return header;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "portaudio.h"
+#include "../whimsycore.h"
+#include "audiostream.h"
+
+#include <cstdio>
+#include <vector>
+
+/**
+ * @brief Renders an AudioStreamBase without touching any sound card. It calls AudioStreamBase::audioOut in a tight loop,
+ * as fast as the CPU allows, and stores the result into a ByteStream or a WAV file.
+ *
+ * It is the counterpart of ScopedPAContext for batch exporting and for deterministic benchmarking: the stream receives
+ * exactly the same callbacks it would receive from PortAudio, with a fixed block size chosen by the caller and a
+ * PaStreamCallbackTimeInfo that counts the rendered frames.
+ *
+ * Output is always interleaved. Planar (paNonInterleaved) streams render into per channel buffers, which are then
+ * interleaved.
+ */
+class OfflineRenderContext
+{
+private:
+    AudioStreamBase*            _as;
+    unsigned long               _blocksize;
+
+    unsigned long long          _framesrendered;
+    double                      _rendertime;
+
+    PaStreamCallbackTimeInfo    _timeinfo;
+
+    // Per channel buffers for planar streams, one block long.
+    std::vector<unsigned char>  _planar;
+    std::vector<void*>          _planes;
+
+    unsigned long long renderBlocks(byte* dest, unsigned long long frames, bool& finished);
+
+public:
+    /**
+     * @brief Creates an offline context.
+     * @param blocksize     How many frames will be requested to the stream in every audioOut call.
+     */
+    OfflineRenderContext(unsigned long blocksize = 64);
+
+    /**
+     * @brief Assigns the stream to be rendered and rewinds the time counters.
+     * @param astream   Any AudioStreamBase derived stream.
+     */
+    void    setStream(AudioStreamBase& astream);
+
+    void            setBlockSize(unsigned long blocksize);
+    unsigned long   getBlockSize() const;
+
+    /**
+     * @brief Renders `frames` frames and appends them at the end of `dest`, in the stream's native sample format.
+     * Rendering stops earlier if the stream returns paComplete or paAbort.
+     * @param dest      ByteStream that will receive the raw samples.
+     * @param frames    How many frames should be rendered.
+     * @return          Amount of frames actually rendered.
+     */
+    unsigned long long  render(whimsycore::ByteStream& dest, unsigned long long frames);
+
+    /**
+     * @brief Renders `frames` frames into a WAV file. Samples are written in chunks, so the file can be arbitrarily long.
+     * @param filepath  Path of the WAV file you want to write to.
+     * @param frames    How many frames should be rendered.
+     * @return          Amount of frames actually rendered.
+     */
+    unsigned long long  renderToWav(const char* filepath, unsigned long long frames);
+
+    /**
+     * @brief Frames rendered since the last setStream() call.
+     */
+    unsigned long long  framesRendered() const;
+
+    /**
+     * @brief Seconds spent inside audioOut since the last setStream() call.
+     */
+    double              renderTime() const;
+
+    /**
+     * @brief Rendering speed, in frames per second of wall time.
+     */
+    double              framesPerSecond() const;
+
+    /**
+     * @brief How many times faster than realtime the stream is being rendered.
+     */
+    double              realtimeFactor() const;
+
+    /**
+     * @brief Builds a RIFF/WAVE header for the given stream layout.
+     * @param datasize  Size in bytes of the sample data following the header.
+     */
+    static whimsycore::ByteStream wavHeader(unsigned int samplerate, unsigned int channels, PaSampleFormat sampleformat,
+                                            unsigned long datasize);
+};
@@ -0,0 +1,373 @@
+#include "oscillator.h"
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define OSCILLATOR_SSE2     1
+#else
+#define OSCILLATOR_SSE2     0
+#endif
+
+// Fixed point phase to float: the top 24 bits are exactly representable.
+#define PHASE_TO_FLOAT(P)   ((float)((P) >> 8) * (1.0f / 16777216.0f))
+#define PHASE_ONE           4294967296.0
+#define NOISE_SEED          0x2A03u
+
+// *********************************************************************************
+// Band-limiting residuals. `t` is the phase, from 0 to 1, and `dt` the phase increment per sample.
+// Scalar and SSE2 versions do the very same operations, so both paths render the same samples.
+
+/**
+ * @brief Polynomial approximation of the band-limited step residual. Add it at every upward unit step of the waveform.
+ */
+static inline float polyBlep(float t, float dt, float invdt)
+{
+    float x;
+
+    if(t < dt)
+    {
+        x = t * invdt;
+        return x + x - x * x - 1.0f;
+    }
+    else if(t > 1.0f - dt)
+    {
+        x = (t - 1.0f) * invdt;
+        return x * x + x + x + 1.0f;
+    }
+    return 0.0f;
+}
+
+/**
+ * @brief Integrated polyBlep: band-limited ramp residual, for corners (slope changes) of the waveform.
+ */
+static inline float polyBlamp(float t, float dt, float invdt)
+{
+    float x;
+
+    if(t < dt)
+    {
+        x = t * invdt - 1.0f;
+        return -(1.0f / 3.0f) * x * x * x;
+    }
+    else if(t > 1.0f - dt)
+    {
+        x = (t - 1.0f) * invdt + 1.0f;
+        return (1.0f / 3.0f) * x * x * x;
+    }
+    return 0.0f;
+}
+
+#if OSCILLATOR_SSE2
+
+static inline __m128 phaseToFloat4(__m128i p)
+{
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(p, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+}
+
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 polyBlep4(__m128 t, __m128 dt, __m128 invdt)
+{
+    const __m128 one =  _mm_set1_ps(1.0f);
+
+    __m128 low =    _mm_cmplt_ps(t, dt);
+    __m128 high =   _mm_cmpgt_ps(t, _mm_sub_ps(one, dt));
+
+    __m128 x1 =     _mm_mul_ps(t, invdt);
+    __m128 r1 =     _mm_sub_ps(_mm_sub_ps(_mm_add_ps(x1, x1), _mm_mul_ps(x1, x1)), one);
+
+    __m128 x2 =     _mm_mul_ps(_mm_sub_ps(t, one), invdt);
+    __m128 r2 =     _mm_add_ps(_mm_add_ps(_mm_mul_ps(x2, x2), _mm_add_ps(x2, x2)), one);
+
+    return _mm_or_ps(_mm_and_ps(low, r1), _mm_and_ps(high, r2));
+}
+
+static inline __m128 polyBlamp4(__m128 t, __m128 dt, __m128 invdt)
+{
+    const __m128 one =      _mm_set1_ps(1.0f);
+    const __m128 third =    _mm_set1_ps(1.0f / 3.0f);
+
+    __m128 low =    _mm_cmplt_ps(t, dt);
+    __m128 high =   _mm_cmpgt_ps(t, _mm_sub_ps(one, dt));
+
+    __m128 x1 =     _mm_sub_ps(_mm_mul_ps(t, invdt), one);
+    __m128 r1 =     _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(third, _mm_mul_ps(x1, _mm_mul_ps(x1, x1))));
+
+    __m128 x2 =     _mm_add_ps(_mm_mul_ps(_mm_sub_ps(t, one), invdt), one);
+    __m128 r2 =     _mm_mul_ps(third, _mm_mul_ps(x2, _mm_mul_ps(x2, x2)));
+
+    return _mm_or_ps(_mm_and_ps(low, r1), _mm_and_ps(high, r2));
+}
+
+static inline __m128i phaseRamp4(uint32_t phase, uint32_t increment)
+{
+    return _mm_setr_epi32((int)phase, (int)(phase + increment), (int)(phase + 2 * increment), (int)(phase + 3 * increment));
+}
+
+#endif
+
+// *********************************************************************************
+
+Oscillator::Oscillator(float samplerate, Waveform waveform, float frequency) :
+    _waveform(waveform),
+    _samplerate(samplerate),
+    _frequency(frequency),
+    _duty(0.5f),
+    _amplitude(1.0f),
+    _phase(0),
+    _increment(0)
+{
+    setFrequency(frequency);
+    reset();
+}
+
+void Oscillator::setWaveform(Waveform waveform)
+{
+    _waveform = waveform;
+}
+
+Oscillator::Waveform Oscillator::getWaveform() const
+{
+    return _waveform;
+}
+
+void Oscillator::setFrequency(float frequency)
+{
+    double increment = (double)frequency / (double)_samplerate * PHASE_ONE;
+
+    // PolyBLEP needs less than half a cycle per sample.
+    if(increment < 0.0)
+        increment = 0.0;
+    else if(increment > PHASE_ONE * 0.5 - 1.0)
+        increment = PHASE_ONE * 0.5 - 1.0;
+
+    _frequency =    frequency;
+    _increment =    (uint32_t)(increment + 0.5);
+}
+
+float Oscillator::getFrequency() const
+{
+    return _frequency;
+}
+
+void Oscillator::setDuty(float duty)
+{
+    _duty = (duty < 0.0f) ? 0.0f : ((duty > 1.0f) ? 1.0f : duty);
+}
+
+float Oscillator::getDuty() const
+{
+    return _duty;
+}
+
+void Oscillator::setAmplitude(float amplitude)
+{
+    _amplitude = amplitude;
+}
+
+float Oscillator::getAmplitude() const
+{
+    return _amplitude;
+}
+
+void Oscillator::setSampleRate(float samplerate)
+{
+    _samplerate = samplerate;
+    setFrequency(_frequency);
+}
+
+void Oscillator::reset(float phase)
+{
+    _phase = (uint32_t)((double)(phase - std::floor(phase)) * PHASE_ONE);
+
+    // Four independent xorshift generators, one per SIMD lane.
+    for(int i = 0; i < 4; i++)
+        _noise[i] = NOISE_SEED * (i + 1);
+}
+
+void Oscillator::render(float* out, unsigned long frames)
+{
+    switch(_waveform)
+    {
+        case Square:    renderSquare(out, frames);      break;
+        case Triangle:  renderTriangle(out, frames);    break;
+        case Saw:       renderSaw(out, frames);         break;
+        case Noise:     renderNoise(out, frames);       break;
+    }
+}
+
+void Oscillator::renderSquare(float* out, unsigned long frames)
+{
+    const uint32_t  dutyphase = (uint32_t)((double)_duty * (PHASE_ONE - 1.0));
+    const float     duty =      PHASE_TO_FLOAT(dutyphase);
+    const float     dt =        (float)_increment * (float)(1.0 / PHASE_ONE);
+    const float     invdt =     (dt > 0.0f) ? 1.0f / dt : 0.0f;
+    unsigned long   i =         0;
+
+#if OSCILLATOR_SSE2
+    const __m128    vdt =       _mm_set1_ps(dt);
+    const __m128    vinvdt =    _mm_set1_ps(invdt);
+    const __m128    vduty =     _mm_set1_ps(duty);
+    const __m128    vamp =      _mm_set1_ps(_amplitude);
+    const __m128    one =       _mm_set1_ps(1.0f);
+    const __m128i   vdutyph =   _mm_set1_epi32((int)dutyphase);
+    const __m128i   step =      _mm_set1_epi32((int)(_increment * 4));
+    __m128i         phase =     phaseRamp4(_phase, _increment);
+
+    for(; i + 4 <= frames; i += 4)
+    {
+        __m128 t =      phaseToFloat4(phase);
+        __m128 t2 =     phaseToFloat4(_mm_sub_epi32(phase, vdutyph));
+        __m128 naive =  select4(_mm_cmplt_ps(t, vduty), one, _mm_sub_ps(_mm_setzero_ps(), one));
+        __m128 y =      _mm_sub_ps(_mm_add_ps(naive, polyBlep4(t, vdt, vinvdt)), polyBlep4(t2, vdt, vinvdt));
+
+        _mm_storeu_ps(out + i, _mm_mul_ps(y, vamp));
+        phase = _mm_add_epi32(phase, step);
+    }
+    _phase += (uint32_t)(_increment * i);
+#endif
+
+    for(; i < frames; i++, _phase += _increment)
+    {
+        float t =   PHASE_TO_FLOAT(_phase);
+        float t2 =  PHASE_TO_FLOAT(_phase - dutyphase);
+        float y =   ((t < duty) ? 1.0f : -1.0f) + polyBlep(t, dt, invdt) - polyBlep(t2, dt, invdt);
+
+        out[i] = y * _amplitude;
+    }
+}
+
+void Oscillator::renderTriangle(float* out, unsigned long frames)
+{
+    // The naive triangle changes its slope by 8 per cycle at each corner, that's 8 * dt per sample. polyBlamp() is the
+    // residual of a slope change of 2 (it integrates polyBlep(), made for steps of 2), hence 4 * dt.
+    const float     dt =        (float)_increment * (float)(1.0 / PHASE_ONE);
+    const float     invdt =     (dt > 0.0f) ? 1.0f / dt : 0.0f;
+    const float     corner =    4.0f * dt;
+    unsigned long   i =         0;
+
+#if OSCILLATOR_SSE2
+    const __m128    vdt =       _mm_set1_ps(dt);
+    const __m128    vinvdt =    _mm_set1_ps(invdt);
+    const __m128    vcorner =   _mm_set1_ps(corner);
+    const __m128    vamp =      _mm_set1_ps(_amplitude);
+    const __m128    one =       _mm_set1_ps(1.0f);
+    const __m128    half =      _mm_set1_ps(0.5f);
+    const __m128    four =      _mm_set1_ps(4.0f);
+    const __m128    absmask =   _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128i   halfph =    _mm_set1_epi32((int)0x80000000u);
+    const __m128i   step =      _mm_set1_epi32((int)(_increment * 4));
+    __m128i         phase =     phaseRamp4(_phase, _increment);
+
+    for(; i + 4 <= frames; i += 4)
+    {
+        __m128 t =      phaseToFloat4(phase);
+        __m128 t2 =     phaseToFloat4(_mm_add_epi32(phase, halfph));
+        __m128 naive =  _mm_sub_ps(one, _mm_mul_ps(four, _mm_and_ps(_mm_sub_ps(t, half), absmask)));
+        __m128 blamp =  _mm_sub_ps(polyBlamp4(t, vdt, vinvdt), polyBlamp4(t2, vdt, vinvdt));
+        __m128 y =      _mm_add_ps(naive, _mm_mul_ps(vcorner, blamp));
+
+        _mm_storeu_ps(out + i, _mm_mul_ps(y, vamp));
+        phase = _mm_add_epi32(phase, step);
+    }
+    _phase += (uint32_t)(_increment * i);
+#endif
+
+    for(; i < frames; i++, _phase += _increment)
+    {
+        float t =   PHASE_TO_FLOAT(_phase);
+        float t2 =  PHASE_TO_FLOAT(_phase + 0x80000000u);
+        float y =   1.0f - 4.0f * std::fabs(t - 0.5f) + corner * (polyBlamp(t, dt, invdt) - polyBlamp(t2, dt, invdt));
+
+        out[i] = y * _amplitude;
+    }
+}
+
+void Oscillator::renderSaw(float* out, unsigned long frames)
+{
+    const float     dt =        (float)_increment * (float)(1.0 / PHASE_ONE);
+    const float     invdt =     (dt > 0.0f) ? 1.0f / dt : 0.0f;
+    unsigned long   i =         0;
+
+#if OSCILLATOR_SSE2
+    const __m128    vdt =       _mm_set1_ps(dt);
+    const __m128    vinvdt =    _mm_set1_ps(invdt);
+    const __m128    vamp =      _mm_set1_ps(_amplitude);
+    const __m128    one =       _mm_set1_ps(1.0f);
+    const __m128i   step =      _mm_set1_epi32((int)(_increment * 4));
+    __m128i         phase =     phaseRamp4(_phase, _increment);
+
+    for(; i + 4 <= frames; i += 4)
+    {
+        __m128 t =      phaseToFloat4(phase);
+        __m128 y =      _mm_sub_ps(_mm_sub_ps(_mm_add_ps(t, t), one), polyBlep4(t, vdt, vinvdt));
+
+        _mm_storeu_ps(out + i, _mm_mul_ps(y, vamp));
+        phase = _mm_add_epi32(phase, step);
+    }
+    _phase += (uint32_t)(_increment * i);
+#endif
+
+    for(; i < frames; i++, _phase += _increment)
+    {
+        float t =   PHASE_TO_FLOAT(_phase);
+        out[i] =    (t + t - 1.0f - polyBlep(t, dt, invdt)) * _amplitude;
+    }
+}
+
+void Oscillator::renderNoise(float* out, unsigned long frames)
+{
+    // Sample n always comes from generator n % 4, whatever the block sizes are. `_phase` counts samples here.
+    const float     scale =     _amplitude * (1.0f / 2147483648.0f);
+    unsigned long   i =         0;
+    uint32_t        x;
+
+    for(; i < frames && (_phase & 3) != 0; i++, _phase++)
+    {
+        x = _noise[_phase & 3];
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        _noise[_phase & 3] = x;
+        out[i] = (float)(int32_t)x * scale;
+    }
+
+#if OSCILLATOR_SSE2
+    __m128i         state =     _mm_loadu_si128((const __m128i*)_noise);
+    const __m128    vscale =    _mm_set1_ps(scale);
+
+    for(; i + 4 <= frames; i += 4, _phase += 4)
+    {
+        state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+        state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+        state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(state), vscale));
+    }
+    _mm_storeu_si128((__m128i*)_noise, state);
+#endif
+
+    for(; i < frames; i++, _phase++)
+    {
+        x = _noise[_phase & 3];
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        _noise[_phase & 3] = x;
+        out[i] = (float)(int32_t)x * scale;
+    }
+}
+
+void Oscillator::spread(const float* mono, float* interleaved, unsigned long frames, unsigned int channels)
+{
+    if(channels == 2)
+    {
+        for(unsigned long i = 0; i < frames; i++, interleaved += 2)
+            interleaved[0] = interleaved[1] = mono[i];
+    }
+    else
+    {
+        for(unsigned long i = 0; i < frames; i++)
+            for(unsigned int c = 0; c < channels; c++)
+                *(interleaved++) = mono[i];
+    }
+}
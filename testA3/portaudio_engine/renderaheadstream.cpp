@@ -0,0 +1,218 @@
+#include "renderaheadstream.h"
+#include "denormals.h"
+
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+// The worker adapts the headroom once per this many seconds of rendered audio.
+#define RENDERAHEAD_ADAPT_SECONDS   1.0
+
+RenderAheadStream::RenderAheadStream(AudioStreamBase& source, unsigned long blockframes,
+                                     unsigned int headroom, unsigned int maxheadroom) :
+    FloatAudioStream(source.getSampleRate(), source.getChannelAmount(), source.getSampleFormat() & ~paNonInterleaved),
+    _source(&source),
+    _blockframes(blockframes > 0 ? blockframes : 1),
+    _minheadroom(1),
+    _maxheadroom(maxheadroom > 0 ? maxheadroom : 1),
+    _headroom(1),
+    _adaptive(true),
+    _ring((size_t)(_maxheadroom + 1) * _blockframes, source.getChannelAmount()),
+    _rendered(0),
+    _adaptunderruns(0),
+    _adaptframes(0),
+    _running(false),
+    _sourcefinished(false),
+    _underruns(0),
+    _lowwater(std::numeric_limits<size_t>::max())
+{
+    const unsigned int samplebytes = SampleConversion::bytesPerSample(source.getSampleFormat());
+
+    _nativebuffer.resize(_blockframes * _channels * (samplebytes > 0 ? samplebytes : 4));
+    _floatbuffer.resize(_blockframes * _channels);
+    _planarbuffer.resize(_nativebuffer.size());
+    _planes.resize(_channels);
+
+    for(unsigned int c = 0; c < _channels; c++)
+        _planes[c] = &(_planarbuffer[c * _blockframes * samplebytes]);
+
+    memset(&_timeinfo, 0, sizeof(PaStreamCallbackTimeInfo));
+    setHeadroom(headroom);
+}
+
+RenderAheadStream::~RenderAheadStream()
+{
+    stop();
+}
+
+bool RenderAheadStream::start(bool prefill)
+{
+    if(_running.load())
+        return false;
+
+    _running.store(true);
+    _worker = std::thread(&RenderAheadStream::workerLoop, this);
+
+    if(prefill)
+    {
+        while(_ring.available() < (size_t)headroom() * _blockframes && !_sourcefinished.load())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void RenderAheadStream::stop()
+{
+    if(!_running.load())
+        return;
+
+    _running.store(false);
+    _worker.join();
+
+    _ring.clear();
+    _sourcefinished.store(false);
+}
+
+bool RenderAheadStream::isRunning() const
+{
+    return _running.load();
+}
+
+void RenderAheadStream::setAdaptive(bool adaptive)
+{
+    _adaptive.store(adaptive);
+}
+
+bool RenderAheadStream::isAdaptive() const
+{
+    return _adaptive.load();
+}
+
+void RenderAheadStream::setHeadroom(unsigned int blocks)
+{
+    if(blocks < _minheadroom)
+        blocks = _minheadroom;
+    else if(blocks > _maxheadroom)
+        blocks = _maxheadroom;
+
+    _headroom.store(blocks);
+}
+
+unsigned int RenderAheadStream::headroom() const
+{
+    return _headroom.load();
+}
+
+size_t RenderAheadStream::fillLevel() const
+{
+    return _ring.available();
+}
+
+double RenderAheadStream::fillRatio() const
+{
+    return (double)fillLevel() / (double)((size_t)headroom() * _blockframes);
+}
+
+double RenderAheadStream::latency() const
+{
+    return (double)((size_t)headroom() * _blockframes) / _samplerated;
+}
+
+unsigned long long RenderAheadStream::underruns() const
+{
+    return _underruns.load(std::memory_order_relaxed);
+}
+
+void RenderAheadStream::renderSourceBlock()
+{
+    const PaSampleFormat    format =    _source->getSampleFormat() & ~paNonInterleaved;
+    void*                   native =    (format == paFloat32) ? (void*)&(_floatbuffer[0]) : (void*)&(_nativebuffer[0]);
+    int                     result;
+
+    _timeinfo.currentTime =         (double)_rendered / _samplerated;
+    _timeinfo.outputBufferDacTime = _timeinfo.currentTime;
+
+    if(_source->isPlanar())
+    {
+        result = _source->renderBlock(&(_planes[0]), _blockframes, &_timeinfo, 0);
+        SampleConversion::interleave(&(_planes[0]), native, _blockframes, _channels,
+                                     SampleConversion::bytesPerSample(format));
+    }
+    else
+        result = _source->renderBlock(native, _blockframes, &_timeinfo, 0);
+
+    if(format != paFloat32)
+        SampleConversion::toFloat(&(_nativebuffer[0]), format, &(_floatbuffer[0]), _blockframes * _channels);
+
+    // As in PortAudio, the block that returns paComplete is still played.
+    _ring.write(&(_floatbuffer[0]), _blockframes);
+    _rendered +=        _blockframes;
+    _adaptframes +=     _blockframes;
+
+    if(result != paContinue)
+        _sourcefinished.store(true, std::memory_order_release);
+}
+
+void RenderAheadStream::adaptHeadroom()
+{
+    if(_adaptframes < (unsigned long long)(RENDERAHEAD_ADAPT_SECONDS * _samplerated))
+        return;
+
+    const unsigned long long    underruns = _underruns.load(std::memory_order_relaxed);
+    const size_t                lowwater =  _lowwater.exchange(std::numeric_limits<size_t>::max(), std::memory_order_relaxed);
+
+    if(_adaptive.load(std::memory_order_relaxed))
+    {
+        if(underruns != _adaptunderruns)
+            setHeadroom(headroom() + 1);
+        else if(lowwater != std::numeric_limits<size_t>::max() && lowwater > 2 * _blockframes)
+            setHeadroom(headroom() - 1);
+    }
+
+    _adaptunderruns =   underruns;
+    _adaptframes =      0;
+}
+
+void RenderAheadStream::workerLoop()
+{
+    // Half a block between checks keeps the ring topped up without spinning.
+    const std::chrono::microseconds nap((long long)(_blockframes * 500000.0 / _samplerated) + 1);
+    DenormalGuard                   denormalguard;
+
+    while(_running.load(std::memory_order_acquire))
+    {
+        const size_t target = (size_t)headroom() * _blockframes;
+
+        if(!_sourcefinished.load(std::memory_order_relaxed) && _ring.available() < target && _ring.space() >= _blockframes)
+        {
+            renderSourceBlock();
+            adaptHeadroom();
+        }
+        else
+            std::this_thread::sleep_for(nap);
+    }
+}
+
+int RenderAheadStream::floatOut(float* samples, unsigned long frames)
+{
+    const size_t read = _ring.read(samples, frames);
+
+    if(read < frames)
+    {
+        std::memset(samples + read * _channels, 0, (frames - read) * _channels * sizeof(float));
+
+        if(_sourcefinished.load(std::memory_order_acquire))
+            return paComplete;
+
+        _underruns.store(_underruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // The worker resets _lowwater concurrently: a plain store could undo its reset with a stale minimum.
+    const size_t    fill =      _ring.available();
+    size_t          lowwater =  _lowwater.load(std::memory_order_relaxed);
+
+    while(fill < lowwater && !_lowwater.compare_exchange_weak(lowwater, fill, std::memory_order_relaxed))
+        ;
+
+    return paContinue;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "floataudiostream.h"
+#include "audioring.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Decouples synthesis from the audio callback. A dedicated thread renders the source stream some blocks ahead
+ * into an AudioRing, and the callback only copies from the ring and converts to the device format.
+ *
+ * An expensive block (a pattern change, envelopes being recomputed...) then eats into the headroom instead of causing
+ * an xrun, at the cost of `headroom * blockframes` frames of extra latency. Commands posted to the source are applied
+ * by the render thread, so they are heard that much later too.
+ *
+ * With adaptive headroom, the render thread grows the headroom by one block after every second that had an underrun,
+ * and shrinks it by one block after a second whose lowest fill level stayed above two blocks.
+ *
+ * Wrap the source and play the wrapper instead:
+ *
+ *     RenderAheadStream ahead(song);
+ *     ahead.start();
+ *     pactx.setStream(ahead);
+ *     pactx.startStream();
+ */
+class RenderAheadStream : public FloatAudioStream
+{
+private:
+    AudioStreamBase*            _source;
+    unsigned long               _blockframes;
+    unsigned int                _minheadroom, _maxheadroom;
+
+    std::atomic<unsigned int>   _headroom;
+    std::atomic<bool>           _adaptive;
+
+    AudioRing                   _ring;
+
+    // Render thread only.
+    std::vector<unsigned char>  _nativebuffer;
+    std::vector<float>          _floatbuffer;
+    std::vector<unsigned char>  _planarbuffer;
+    std::vector<void*>          _planes;
+    PaStreamCallbackTimeInfo    _timeinfo;
+    unsigned long long          _rendered;
+    unsigned long long          _adaptunderruns;
+    unsigned long long          _adaptframes;
+
+    std::thread                 _worker;
+    std::atomic<bool>           _running;
+    std::atomic<bool>           _sourcefinished;
+
+    // Written by the callback.
+    std::atomic<unsigned long long> _underruns;
+    std::atomic<size_t>         _lowwater;
+
+    void    workerLoop();
+    void    renderSourceBlock();
+    void    adaptHeadroom();
+
+public:
+    /**
+     * @brief Wraps a stream. Sample rate and channels are the source's; the device format is the source's too, but may
+     * be changed with setDeviceFormat().
+     * @param source        Stream rendered by the worker thread. Must outlive this object.
+     * @param blockframes   Frames rendered by the worker at once.
+     * @param headroom      How many blocks the worker keeps ready.
+     * @param maxheadroom   Upper limit for the adaptive headroom. The ring is sized for it.
+     */
+    RenderAheadStream(AudioStreamBase& source, unsigned long blockframes = 256,
+                      unsigned int headroom = 4, unsigned int maxheadroom = 32);
+
+    ~RenderAheadStream();
+
+    /**
+     * @brief Starts the render thread.
+     * @param prefill   Waits until the ring holds the whole headroom, so playback starts with no underrun.
+     * @return          false if it was already running.
+     */
+    bool    start(bool prefill = true);
+
+    /**
+     * @brief Stops the render thread and empties the ring. Stop the PortAudio stream first.
+     */
+    void    stop();
+
+    bool    isRunning() const;
+
+    /**
+     * @brief Enables or disables the adaptive headroom. Enabled by default.
+     */
+    void    setAdaptive(bool adaptive);
+    bool    isAdaptive() const;
+
+    /**
+     * @brief Sets the amount of blocks rendered ahead, clamped between 1 and the maximum headroom.
+     */
+    void            setHeadroom(unsigned int blocks);
+    unsigned int    headroom() const;
+
+    /**
+     * @brief Frames currently waiting in the ring.
+     */
+    size_t          fillLevel() const;
+
+    /**
+     * @brief Fill level relative to the headroom. 1.0 means the worker is fully ahead.
+     */
+    double          fillRatio() const;
+
+    /**
+     * @brief Extra latency added by the headroom, in seconds.
+     */
+    double          latency() const;
+
+    /**
+     * @brief Callbacks that found fewer frames in the ring than they needed. The missing frames are played as silence.
+     */
+    unsigned long long  underruns() const;
+
+    int floatOut(float* samples, unsigned long frames);
+};
@@ -0,0 +1,303 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define RESAMPLER_SSE2      1
+#else
+#define RESAMPLER_SSE2      0
+#endif
+
+#define RESAMPLER_FRAC_ONE  4294967296.0
+#define RESAMPLER_MAX_TAPS  512
+#define RESAMPLER_PI        3.14159265358979323846
+
+// Per quality: taps (at ratios up to 1:1), tabulated phases, Kaiser beta and cutoff relative to the lower Nyquist.
+static const unsigned int   quality_taps[4] =   {8, 16, 32, 64};
+static const unsigned int   quality_phases[4] = {64, 128, 256, 256};
+static const double         quality_beta[4] =   {4.0, 6.0, 8.0, 10.0};
+static const double         quality_cutoff[4] = {0.80, 0.88, 0.92, 0.95};
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+static double besselI0(double x)
+{
+    double sum = 1.0, term = 1.0;
+
+    for(int k = 1; k < 32; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/**
+ * @brief Dot products of `samples` with two adjacent filter rows, interpolated by `w`. `taps` is a multiple of 4.
+ */
+static inline float interpolatedDot(const float* samples, const float* row0, const float* row1, unsigned int taps, float w)
+{
+#if RESAMPLER_SSE2
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+
+    for(unsigned int j = 0; j < taps; j += 4)
+    {
+        const __m128 x = _mm_loadu_ps(samples + j);
+
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(x, _mm_load_ps(row0 + j)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(x, _mm_load_ps(row1 + j)));
+    }
+
+    // acc0 + w * (acc1 - acc0), then the horizontal sum.
+    __m128 acc = _mm_add_ps(acc0, _mm_mul_ps(_mm_set1_ps(w), _mm_sub_ps(acc1, acc0)));
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#else
+    float acc0 = 0.0f, acc1 = 0.0f;
+
+    for(unsigned int j = 0; j < taps; j++)
+    {
+        acc0 += samples[j] * row0[j];
+        acc1 += samples[j] * row1[j];
+    }
+    return acc0 + w * (acc1 - acc0);
+#endif
+}
+
+Resampler::Resampler(unsigned int channels, double inrate, double outrate, Quality quality, size_t maxblock) :
+    _channels(channels > 0 ? channels : 1),
+    _quality(quality),
+    _taps(0),
+    _phases(quality_phases[quality]),
+    _inrate(inrate),
+    _outrate(outrate),
+    _table(NULL),
+    _capacity(maxblock + RESAMPLER_MAX_TAPS * 2),
+    _filled(0),
+    _pos(0),
+    _frac(0),
+    _step(0),
+    _stepdelta(0),
+    _steptarget(0),
+    _glideframes(0)
+{
+    _history.resize(_capacity * _channels);
+    setRates(inrate, outrate);
+    reset();
+}
+
+void Resampler::buildTable()
+{
+    const double ratio =    _outrate / _inrate;
+    const double cutoff =   ((ratio < 1.0) ? ratio : 1.0) * quality_cutoff[_quality];
+
+    // Downsampling widens the impulse response in input frames, so the filter gets longer to keep its quality.
+    unsigned int taps = quality_taps[_quality];
+    if(ratio < 1.0)
+        taps = ((unsigned int)std::ceil(taps / ratio) + 3) & ~3u;
+    if(taps > RESAMPLER_MAX_TAPS)
+        taps = RESAMPLER_MAX_TAPS;
+
+    _taps = taps;
+
+    const double half = (double)_taps / 2.0;
+    const double beta = quality_beta[_quality];
+    const double norm = besselI0(beta);
+
+    _tablestorage.assign((size_t)(_phases + 1) * _taps + 4, 0.0f);
+    _table = (float*)(((uintptr_t)&(_tablestorage[0]) + 15) & ~(uintptr_t)15);
+
+    for(unsigned int r = 0; r <= _phases; r++)
+    {
+        float*          row =   _table + (size_t)r * _taps;
+        const double    p =     (double)r / (double)_phases;
+        double          sum =   0.0;
+
+        for(unsigned int j = 0; j < _taps; j++)
+        {
+            const double x =    (double)j - (half - 1.0) - p;
+            const double u =    x / half;
+            double       h =    0.0;
+
+            if(u > -1.0 && u < 1.0)
+            {
+                const double arg =  RESAMPLER_PI * cutoff * x;
+                const double sinc = (x == 0.0) ? 1.0 : std::sin(arg) / arg;
+
+                h = cutoff * sinc * besselI0(beta * std::sqrt(1.0 - u * u)) / norm;
+            }
+
+            row[j] =    (float)h;
+            sum +=      h;
+        }
+
+        // Unity gain at DC for every phase, so interpolating between phases doesn't ripple.
+        for(unsigned int j = 0; j < _taps && sum != 0.0; j++)
+            row[j] = (float)(row[j] / sum);
+    }
+}
+
+void Resampler::setRates(double inrate, double outrate)
+{
+    const unsigned int oldtaps = _taps;
+
+    _inrate =       inrate;
+    _outrate =      outrate;
+    _step =         (uint64_t)(inrate / outrate * RESAMPLER_FRAC_ONE + 0.5);
+    _steptarget =   _step;
+    _glideframes =  0;
+
+    buildTable();
+
+    // Keep the filter centered on the same input frame when its length changes.
+    if(oldtaps != 0 && oldtaps != _taps)
+    {
+        const long shift = (long)(oldtaps / 2) - (long)(_taps / 2);
+
+        if(shift >= 0 || (size_t)(-shift) <= _pos)
+            _pos += shift;
+        else
+            _pos = 0;
+    }
+}
+
+void Resampler::glideTo(double inrate, unsigned long frames)
+{
+    _steptarget = (uint64_t)(inrate / _outrate * RESAMPLER_FRAC_ONE + 0.5);
+    _inrate =     inrate;
+
+    if(frames == 0)
+    {
+        _step =         _steptarget;
+        _glideframes =  0;
+        return;
+    }
+
+    _stepdelta =    ((int64_t)_steptarget - (int64_t)_step) / (int64_t)frames;
+    _glideframes =  frames;
+}
+
+double Resampler::inputRate() const
+{
+    return _inrate;
+}
+
+double Resampler::outputRate() const
+{
+    return _outrate;
+}
+
+Resampler::Quality Resampler::quality() const
+{
+    return _quality;
+}
+
+unsigned int Resampler::taps() const
+{
+    return _taps;
+}
+
+void Resampler::reset()
+{
+    std::fill(_history.begin(), _history.end(), 0.0f);
+
+    _filled =       _taps / 2 - 1;
+    _pos =          0;
+    _frac =         0;
+    _step =         _steptarget;
+    _glideframes =  0;
+}
+
+void Resampler::compact()
+{
+    if(_pos == 0)
+        return;
+
+    // A step longer than the filter (glideTo() far above the rate the filter was built for) can move _pos past the
+    // input written so far. Nothing is kept then, and the frames still to skip are skipped as they come.
+    if(_pos >= _filled)
+    {
+        _pos -=     _filled;
+        _filled =   0;
+        return;
+    }
+
+    const size_t keep = _filled - _pos;
+
+    for(unsigned int c = 0; c < _channels; c++)
+    {
+        float* plane = &(_history[c * _capacity]);
+        std::memmove(plane, plane + _pos, keep * sizeof(float));
+    }
+
+    _filled =   keep;
+    _pos =      0;
+}
+
+size_t Resampler::write(const float* interleaved, size_t frames)
+{
+    if(_filled + frames > _capacity)
+        compact();
+
+    if(_filled + frames > _capacity)
+        frames = _capacity - _filled;
+
+    for(unsigned int c = 0; c < _channels; c++)
+    {
+        float*          plane = &(_history[c * _capacity + _filled]);
+        const float*    src =   interleaved + c;
+
+        for(size_t i = 0; i < frames; i++, src += _channels)
+            plane[i] = *src;
+    }
+
+    _filled += frames;
+    return frames;
+}
+
+size_t Resampler::read(float* interleaved, size_t frames)
+{
+    const float     phasescale =    (float)(1.0 / RESAMPLER_FRAC_ONE);
+    size_t          n =             0;
+
+    while(n < frames && _pos + _taps <= _filled)
+    {
+        const uint64_t      p =     (uint64_t)_frac * _phases;
+        const float*        row0 =  _table + (size_t)(p >> 32) * _taps;
+        const float*        row1 =  row0 + _taps;
+        const float         w =     (float)(uint32_t)p * phasescale;
+
+        for(unsigned int c = 0; c < _channels; c++)
+            interleaved[n * _channels + c] = interpolatedDot(&(_history[c * _capacity + _pos]), row0, row1, _taps, w);
+
+        const uint64_t acc = (uint64_t)_frac + _step;
+        _pos +=     (size_t)(acc >> 32);
+        _frac =     (uint32_t)acc;
+
+        if(_glideframes > 0 && --_glideframes == 0)
+            _step = _steptarget;
+        else if(_glideframes > 0)
+            _step = (uint64_t)((int64_t)_step + _stepdelta);
+
+        n++;
+    }
+
+    return n;
+}
+
+size_t Resampler::inputNeeded(size_t frames) const
+{
+    if(frames == 0)
+        return 0;
+
+    // While gliding, assume the faster of both steps.
+    const uint64_t  step =  (_steptarget > _step) ? _steptarget : _step;
+    const uint64_t  last =  ((uint64_t)_frac + (uint64_t)(frames - 1) * step) >> 32;
+    const size_t    need =  _pos + (size_t)last + _taps;
+
+    return (need > _filled) ? need - _filled : 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Streaming polyphase resampler for interleaved float audio, at any ratio.
+ *
+ * The filter is a Kaiser-windowed sinc, tabulated at a number of phases between two input samples; every output
+ * sample interpolates linearly between the two nearest phases, so any ratio works with no extra table. The cutoff is
+ * set below the lower of the two Nyquist frequencies, so downsampling doesn't alias. Dot products run 4 taps at a time
+ * with SSE2 when available.
+ *
+ * The read position is kept in 32.32 fixed point and the input history survives rate changes, so glideTo() can bend
+ * the ratio while audio is flowing without a discontinuity. Write input with write(), pull output with read(); both
+ * work on whatever amounts are available, and neither allocates. Only setRates() and the constructor allocate.
+ *
+ * Not thread safe: use it from one thread at a time.
+ */
+class Resampler
+{
+public:
+    enum Quality
+    {
+        Fast,       // 8 taps. Cheap, some rolloff below 18kHz at 44.1kHz.
+        Medium,     // 16 taps.
+        High,       // 32 taps.
+        Best        // 64 taps. Transparent.
+    };
+
+private:
+    unsigned int        _channels;
+    Quality             _quality;
+    unsigned int        _taps, _phases;
+
+    double              _inrate, _outrate;
+
+    // (_phases + 1) rows of _taps coefficients, 16 byte aligned.
+    std::vector<float>  _tablestorage;
+    float*              _table;
+
+    // Planar input history. Every channel holds _capacity frames.
+    std::vector<float>  _history;
+    size_t              _capacity;
+    size_t              _filled;        // Frames written.
+    size_t              _pos;           // First frame under the filter for the next output frame.
+    uint32_t            _frac;          // Fraction of a frame past _pos, 0.32 fixed point.
+
+    uint64_t            _step;          // Input frames per output frame, 32.32 fixed point.
+    int64_t             _stepdelta;     // Added to _step every output frame while gliding.
+    uint64_t            _steptarget;
+    unsigned long       _glideframes;
+
+    void    buildTable();
+    void    compact();
+
+public:
+    /**
+     * @brief Creates a resampler.
+     * @param channels      Interleaved channels.
+     * @param inrate        Input sample rate, in Hz.
+     * @param outrate       Output sample rate, in Hz.
+     * @param quality       See Resampler::Quality.
+     * @param maxblock      Most input frames that will be written at once. write() accepts less otherwise.
+     */
+    Resampler(unsigned int channels, double inrate, double outrate, Quality quality = High, size_t maxblock = 4096);
+
+    /**
+     * @brief Changes both rates and redesigns the filter. Allocates. The input history is kept.
+     */
+    void    setRates(double inrate, double outrate);
+
+    /**
+     * @brief Bends the input rate to `inrate` linearly along `frames` output frames, keeping the filter. Real-time
+     * safe. The cutoff stays the one set by setRates(), so going much above that input rate may alias a bit.
+     */
+    void    glideTo(double inrate, unsigned long frames);
+
+    double  inputRate() const;
+    double  outputRate() const;
+    Quality quality() const;
+
+    /**
+     * @brief Filter length, in input frames. The resampler delays its input by half of it.
+     */
+    unsigned int    taps() const;
+
+    /**
+     * @brief Appends interleaved input frames.
+     * @return  Frames taken. Fewer than `frames` if the history is full; read() some output first.
+     */
+    size_t  write(const float* interleaved, size_t frames);
+
+    /**
+     * @brief Produces up to `frames` interleaved output frames from the input written so far.
+     * @return  Frames produced.
+     */
+    size_t  read(float* interleaved, size_t frames);
+
+    /**
+     * @brief Input frames that must still be written before read() can produce `frames` frames.
+     */
+    size_t  inputNeeded(size_t frames) const;
+
+    /**
+     * @brief Forgets all input, as if the resampler was just created. The history starts filled with silence, so the
+     * first output frames don't wait for the filter delay.
+     */
+    void    reset();
+};
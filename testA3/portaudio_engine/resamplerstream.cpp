@@ -0,0 +1,93 @@
+#include "resamplerstream.h"
+
+#include <cstring>
+
+// Length of the glide applied when the source rate changes.
+#define RESAMPLER_GLIDE_SECONDS     0.01
+
+ResamplerStream::ResamplerStream(AudioStreamBase& source, unsigned int samplerate, Resampler::Quality quality,
+                                 unsigned long blockframes) :
+    FloatAudioStream(samplerate, source.getChannelAmount(), source.getSampleFormat() & ~paNonInterleaved),
+    _source(&source),
+    _resampler(source.getChannelAmount(), source.getSampleRateDouble(), samplerate, quality, blockframes),
+    _blockframes(blockframes > 0 ? blockframes : 1),
+    _rendered(0),
+    _sourcefinished(false)
+{
+    const unsigned int samplebytes = SampleConversion::bytesPerSample(source.getSampleFormat());
+
+    _nativebuffer.resize(_blockframes * _channels * (samplebytes > 0 ? samplebytes : 4));
+    _floatbuffer.resize(_blockframes * _channels);
+    _planarbuffer.resize(_nativebuffer.size());
+    _planes.resize(_channels);
+
+    for(unsigned int c = 0; c < _channels; c++)
+        _planes[c] = &(_planarbuffer[c * _blockframes * samplebytes]);
+
+    memset(&_timeinfo, 0, sizeof(PaStreamCallbackTimeInfo));
+}
+
+void ResamplerStream::onCommand(const StreamCommand& cmd)
+{
+    switch(cmd.parameter)
+    {
+        case ParamSourceRate:
+            if(cmd.get<double>() > 0.0)
+                _resampler.glideTo(cmd.get<double>(), (unsigned long)(RESAMPLER_GLIDE_SECONDS * _samplerated));
+        break;
+        default:
+        break;
+    }
+}
+
+bool ResamplerStream::renderSourceBlock()
+{
+    const PaSampleFormat    format =    _source->getSampleFormat() & ~paNonInterleaved;
+    void*                   native =    (format == paFloat32) ? (void*)&(_floatbuffer[0]) : (void*)&(_nativebuffer[0]);
+    int                     result;
+
+    _timeinfo.currentTime =         (double)_rendered / _resampler.inputRate();
+    _timeinfo.outputBufferDacTime = _timeinfo.currentTime;
+
+    if(_source->isPlanar())
+    {
+        result = _source->renderBlock(&(_planes[0]), _blockframes, &_timeinfo, 0);
+        SampleConversion::interleave(&(_planes[0]), native, _blockframes, _channels,
+                                     SampleConversion::bytesPerSample(format));
+    }
+    else
+        result = _source->renderBlock(native, _blockframes, &_timeinfo, 0);
+
+    if(format != paFloat32)
+        SampleConversion::toFloat(&(_nativebuffer[0]), format, &(_floatbuffer[0]), _blockframes * _channels);
+
+    _resampler.write(&(_floatbuffer[0]), _blockframes);
+    _rendered += _blockframes;
+
+    return result == paContinue;
+}
+
+int ResamplerStream::floatOut(float* samples, unsigned long frames)
+{
+    unsigned long done = 0;
+
+    while(true)
+    {
+        done += (unsigned long)_resampler.read(samples + done * _channels, frames - done);
+        if(done == frames)
+            return paContinue;
+
+        // The source ended: one block of silence flushes what was still inside the filter.
+        if(_sourcefinished)
+        {
+            std::memset(&(_floatbuffer[0]), 0, _floatbuffer.size() * sizeof(float));
+            _resampler.write(&(_floatbuffer[0]), _blockframes);
+
+            done += (unsigned long)_resampler.read(samples + done * _channels, frames - done);
+            std::memset(samples + done * _channels, 0, (frames - done) * _channels * sizeof(float));
+            return paComplete;
+        }
+
+        _sourcefinished = !renderSourceBlock();
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "floataudiostream.h"
+#include "resampler.h"
+
+#include <vector>
+
+/**
+ * @brief Plays a stream at another sample rate. The source is rendered in blocks of its own rate, as many as the
+ * Resampler needs for each callback, so a chip running at 11025Hz or 44100Hz can feed a 48kHz or 96kHz device.
+ *
+ * The source's rate may be changed while playing with changeSourceRate(): the resampler glides to it over a few
+ * milliseconds, keeping its history, so the change doesn't click. That also works as a smooth pitch bend.
+ *
+ *     SquareWaveTest   sqw;
+ *     ResamplerStream  at48k(sqw, 48000);
+ *     pactx.setStream(at48k);
+ */
+class ResamplerStream : public FloatAudioStream
+{
+private:
+    AudioStreamBase*            _source;
+    Resampler                   _resampler;
+    unsigned long               _blockframes;
+
+    std::vector<unsigned char>  _nativebuffer;
+    std::vector<float>          _floatbuffer;
+    std::vector<unsigned char>  _planarbuffer;
+    std::vector<void*>          _planes;
+    PaStreamCallbackTimeInfo    _timeinfo;
+    unsigned long long          _rendered;
+    bool                        _sourcefinished;
+
+    bool    renderSourceBlock();
+
+protected:
+    void onCommand(const StreamCommand& cmd);
+
+public:
+    enum Parameters
+    {
+        ParamSourceRate     // Source sample rate, double. Glides over 10ms.
+    };
+
+    /**
+     * @brief Wraps a stream. Channels are the source's.
+     * @param source        Stream to resample. Must outlive this object.
+     * @param samplerate    Output sample rate, in Hz.
+     * @param quality       See Resampler::Quality.
+     * @param blockframes   Frames the source renders at once.
+     */
+    ResamplerStream(AudioStreamBase& source, unsigned int samplerate, Resampler::Quality quality = Resampler::High,
+                    unsigned long blockframes = 256);
+
+    bool    changeSourceRate(double samplerate){return setParameter(ParamSourceRate, samplerate);}
+
+    const Resampler&    resampler() const {return _resampler;}
+
+    int floatOut(float* samples, unsigned long frames);
+};
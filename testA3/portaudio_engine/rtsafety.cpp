@@ -0,0 +1,348 @@
+#include "rtsafety.h"
+
+#include <cstdlib>
+
+#if defined(WHIMSY_RT_CHECK)
+
+#include <atomic>
+#include <new>
+
+#if defined(__GLIBC__)
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <unistd.h>
+#define RTCHECK_GLIBC   1
+#else
+#define RTCHECK_GLIBC   0
+#endif
+
+// Violations kept with their call stack, and frames kept per stack.
+#define RTCHECK_MAX_VIOLATIONS  64
+#define RTCHECK_MAX_FRAMES      32
+
+struct ViolationRecord
+{
+    std::atomic<bool>       ready;
+    RealtimeChecker::Kind   kind;
+    int                     depth;
+    void*                   frames[RTCHECK_MAX_FRAMES];
+};
+
+// Zero initialized before anything runs, so the interposed functions can use them at any time.
+static ViolationRecord                  rt_violations[RTCHECK_MAX_VIOLATIONS];
+static std::atomic<unsigned long long>  rt_total(0);
+static std::atomic<unsigned long long>  rt_counts[RealtimeChecker::KindCount];
+static std::atomic<bool>                rt_abort(false);
+
+static thread_local int                 rt_depth = 0;
+static thread_local bool                rt_handling = false;
+
+#if RTCHECK_GLIBC
+// backtrace() loads libgcc the first time it's called, which allocates. Do it before any callback runs.
+static struct BacktracePrimer
+{
+    BacktracePrimer()
+    {
+        void* frame;
+        backtrace(&frame, 1);
+    }
+} rt_primer;
+#endif
+
+bool RealtimeChecker::isCompiledIn()
+{
+    return true;
+}
+
+bool RealtimeChecker::inside()
+{
+    return rt_depth > 0;
+}
+
+void RealtimeChecker::enter()
+{
+    rt_depth++;
+}
+
+void RealtimeChecker::leave()
+{
+    rt_depth--;
+}
+
+void RealtimeChecker::flag(Kind kind)
+{
+    if(rt_depth <= 0 || rt_handling)
+        return;
+
+    // Whatever the recording itself calls is not reported.
+    rt_handling = true;
+
+    rt_counts[kind].fetch_add(1, std::memory_order_relaxed);
+
+    const unsigned long long index = rt_total.fetch_add(1);
+    if(index < RTCHECK_MAX_VIOLATIONS)
+    {
+        ViolationRecord& record = rt_violations[index];
+
+        record.kind =   kind;
+#if RTCHECK_GLIBC
+        record.depth =  backtrace(record.frames, RTCHECK_MAX_FRAMES);
+#else
+        record.depth =  0;
+#endif
+        record.ready.store(true, std::memory_order_release);
+    }
+
+    if(rt_abort.load(std::memory_order_relaxed))
+        std::abort();
+
+    rt_handling = false;
+}
+
+void RealtimeChecker::setAbortOnViolation(bool abort)
+{
+    rt_abort.store(abort);
+}
+
+unsigned long long RealtimeChecker::violationCount()
+{
+    return rt_total.load();
+}
+
+unsigned long long RealtimeChecker::violationCount(Kind kind)
+{
+    return rt_counts[kind].load();
+}
+
+void RealtimeChecker::printReport(std::FILE* file)
+{
+    const unsigned long long total = rt_total.load();
+
+    std::fprintf(file, "Real-time violations: %llu (%llu allocations, %llu deallocations, %llu locks, %llu exceptions)\n",
+                 total, violationCount(Allocation), violationCount(Deallocation), violationCount(Lock),
+                 violationCount(Exception));
+
+    for(unsigned long long i = 0; i < total && i < RTCHECK_MAX_VIOLATIONS; i++)
+    {
+        const ViolationRecord& record = rt_violations[i];
+
+        if(!record.ready.load(std::memory_order_acquire))
+            continue;
+
+        std::fprintf(file, "#%llu %s\n", i, kindToString(record.kind));
+        std::fflush(file);
+
+#if RTCHECK_GLIBC
+        // Skips flag() and the interposed function.
+        if(record.depth > 2)
+            backtrace_symbols_fd((void* const*)record.frames + 2, record.depth - 2, fileno(file));
+#endif
+    }
+
+    if(total > RTCHECK_MAX_VIOLATIONS)
+        std::fprintf(file, "(%llu more not recorded)\n", total - RTCHECK_MAX_VIOLATIONS);
+}
+
+void RealtimeChecker::reset()
+{
+    for(unsigned int i = 0; i < RTCHECK_MAX_VIOLATIONS; i++)
+        rt_violations[i].ready.store(false);
+    for(unsigned int k = 0; k < KindCount; k++)
+        rt_counts[k].store(0);
+
+    rt_total.store(0);
+}
+
+// Interposition
+
+#if RTCHECK_GLIBC
+
+extern "C"
+{
+    void*   __libc_malloc(size_t size);
+    void*   __libc_calloc(size_t count, size_t size);
+    void*   __libc_realloc(void* ptr, size_t size);
+    void*   __libc_memalign(size_t alignment, size_t size);
+    void    __libc_free(void* ptr);
+
+    void* malloc(size_t size)
+    {
+        RealtimeChecker::flag(RealtimeChecker::Allocation);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        RealtimeChecker::flag(RealtimeChecker::Allocation);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        RealtimeChecker::flag(RealtimeChecker::Allocation);
+        return __libc_realloc(ptr, size);
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        RealtimeChecker::flag(RealtimeChecker::Allocation);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        RealtimeChecker::flag(RealtimeChecker::Allocation);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** ptr, size_t alignment, size_t size)
+    {
+        RealtimeChecker::flag(RealtimeChecker::Allocation);
+
+        void* p = __libc_memalign(alignment, size);
+        if(p == NULL)
+            return 12;  // ENOMEM
+
+        *ptr = p;
+        return 0;
+    }
+
+    void free(void* ptr)
+    {
+        if(ptr != NULL)
+            RealtimeChecker::flag(RealtimeChecker::Deallocation);
+        __libc_free(ptr);
+    }
+
+    // The real functions are looked up on first use. A plain pointer, not a function static: initializing those
+    // may lock a mutex itself.
+    typedef int     (*MutexLockFunction)(pthread_mutex_t*);
+    typedef void*   (*AllocateExceptionFunction)(size_t);
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        static std::atomic<MutexLockFunction> real(NULL);
+
+        if(real.load(std::memory_order_relaxed) == NULL)
+            real.store((MutexLockFunction)dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+
+        RealtimeChecker::flag(RealtimeChecker::Lock);
+        return real.load(std::memory_order_relaxed)(mutex);
+    }
+
+    void* __cxa_allocate_exception(size_t size) throw()
+    {
+        static std::atomic<AllocateExceptionFunction> real(NULL);
+
+        if(real.load(std::memory_order_relaxed) == NULL)
+            real.store((AllocateExceptionFunction)dlsym(RTLD_NEXT, "__cxa_allocate_exception"));
+
+        RealtimeChecker::flag(RealtimeChecker::Exception);
+        return real.load(std::memory_order_relaxed)(size);
+    }
+}
+
+#else
+
+// Without glibc, only what goes through the global operator new and delete is seen.
+void* operator new(size_t size)
+{
+    RealtimeChecker::flag(RealtimeChecker::Allocation);
+
+    void* p = std::malloc(size ? size : 1);
+    if(p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    RealtimeChecker::flag(RealtimeChecker::Allocation);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) noexcept
+{
+    return operator new(size, nothrow);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if(ptr != NULL)
+        RealtimeChecker::flag(RealtimeChecker::Deallocation);
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+#endif
+
+#else
+
+bool RealtimeChecker::isCompiledIn()
+{
+    return false;
+}
+
+bool RealtimeChecker::inside()
+{
+    return false;
+}
+
+void RealtimeChecker::enter()
+{}
+
+void RealtimeChecker::leave()
+{}
+
+void RealtimeChecker::flag(Kind kind)
+{
+    (void) kind;
+}
+
+void RealtimeChecker::setAbortOnViolation(bool abort)
+{
+    (void) abort;
+}
+
+unsigned long long RealtimeChecker::violationCount()
+{
+    return 0;
+}
+
+unsigned long long RealtimeChecker::violationCount(Kind kind)
+{
+    (void) kind;
+    return 0;
+}
+
+void RealtimeChecker::printReport(std::FILE* file)
+{
+    std::fprintf(file, "Real-time checks are not compiled in. Build with WHIMSY_RT_CHECK.\n");
+}
+
+void RealtimeChecker::reset()
+{}
+
+#endif
+
+const char* RealtimeChecker::kindToString(Kind kind)
+{
+    switch(kind)
+    {
+        case Allocation:    return "allocation";
+        case Deallocation:  return "deallocation";
+        case Lock:          return "lock";
+        case Exception:     return "exception";
+        default:            return "unknown";
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <cstdio>
+
+/**
+ * @brief Debug checker for code running inside audio callbacks: it flags every heap allocation or release, mutex lock
+ * and thrown exception made from a callback, with the call stack that made it.
+ *
+ * Only compiled in when WHIMSY_RT_CHECK is defined (the WHIMSY_RT_CHECK CMake option). Then:
+ *   - ScopedPAContext::apiCallback and OfflineRenderContext wrap every callback in a RealtimeScope, which raises a
+ *     thread local flag. JobPool workers raise it too while running a batch issued from inside a scope.
+ *   - malloc, calloc, realloc, free and the aligned allocators are interposed (on glibc; elsewhere, the global
+ *     operator new and delete are replaced), as are pthread_mutex_lock (std::mutex and condition variable waits
+ *     go through it) and __cxa_allocate_exception, which every throw goes through.
+ *   - Each call made while the flag is up is recorded, with its backtrace, in a fixed table; the first
+ *     RTCHECK_MAX_VIOLATIONS are kept, the rest only counted. Recording never allocates.
+ * Print what was caught with printReport() from any other thread, or abort on the spot to get a core dump. testA3
+ * prints the report when it exits, and whimsy_golden also fails if any callback of its renders was caught.
+ *
+ * Without WHIMSY_RT_CHECK, RealtimeScope is empty and the checker reports nothing.
+ */
+class RealtimeChecker
+{
+public:
+    enum Kind
+    {
+        Allocation,
+        Deallocation,
+        Lock,
+        Exception,
+
+        KindCount
+    };
+
+    /**
+     * @brief Whether the checker was compiled in.
+     */
+    static bool                 isCompiledIn();
+
+    /**
+     * @brief Whether the calling thread is inside a RealtimeScope.
+     */
+    static bool                 inside();
+
+    static void                 enter();
+    static void                 leave();
+
+    /**
+     * @brief Records a violation if the calling thread is inside a scope. Called by the interposed functions.
+     */
+    static void                 flag(Kind kind);
+
+    /**
+     * @brief Aborts the program at the first violation, so a debugger or a core dump shows the whole state.
+     */
+    static void                 setAbortOnViolation(bool abort);
+
+    static unsigned long long   violationCount();
+    static unsigned long long   violationCount(Kind kind);
+
+    /**
+     * @brief Writes every recorded violation and its call stack. Not for the audio thread.
+     */
+    static void                 printReport(std::FILE* file = stderr);
+
+    /**
+     * @brief Forgets the recorded violations.
+     */
+    static void                 reset();
+
+    static const char*          kindToString(Kind kind);
+};
+
+/**
+ * @brief Marks the code run during its lifetime as real-time. Scopes nest.
+ */
+class RealtimeScope
+{
+public:
+#if defined(WHIMSY_RT_CHECK)
+    RealtimeScope() {RealtimeChecker::enter();}
+    ~RealtimeScope() {RealtimeChecker::leave();}
+#else
+    RealtimeScope() {}
+#endif
+};
@@ -0,0 +1,751 @@
+#include "sampleconversion.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define SAMPLECONVERSION_X86    1
+#include <immintrin.h>
+#else
+#define SAMPLECONVERSION_X86    0
+#endif
+
+// Upper clamp values: the biggest float that still fits once scaled by 2^(bits-1).
+#define SC_MAX_FLOAT32      1.0f
+#define SC_MAX_INT32        0.99999994f             // 1 - 2^-24. 1 - 2^-31 is not representable.
+#define SC_MAX_INT24        0.99999988079071044921875f  // 1 - 2^-23
+#define SC_MAX_INT16        0.999969482421875f      // 1 - 2^-15
+#define SC_MAX_INT8         0.9921875f              // 1 - 2^-7
+
+#define SC_SCALE_INT32      2147483648.0f
+#define SC_SCALE_INT24      8388608.0f
+#define SC_SCALE_INT16      32768.0f
+#define SC_SCALE_INT8       128.0f
+
+typedef void (*ToFloatKernel)(const void* src, float* dest, size_t samples);
+typedef void (*FromFloatKernel)(const float* src, void* dest, size_t samples);
+
+// Index of every supported format in the kernel tables.
+enum FormatIndex
+{
+    FI_Float32,
+    FI_Int32,
+    FI_Int24,
+    FI_Int16,
+    FI_Int8,
+    FI_UInt8,
+    FI_Count
+};
+
+struct KernelTable
+{
+    ToFloatKernel       toFloat[FI_Count];
+    FromFloatKernel     fromFloat[FI_Count];
+};
+
+static int formatIndex(PaSampleFormat sampleformat)
+{
+    switch(sampleformat & ~paNonInterleaved)
+    {
+        case paFloat32: return FI_Float32;
+        case paInt32:   return FI_Int32;
+        case paInt24:   return FI_Int24;
+        case paInt16:   return FI_Int16;
+        case paInt8:    return FI_Int8;
+        case paUInt8:   return FI_UInt8;
+        default:        return -1;
+    }
+}
+
+// *********************************************************************************
+// Scalar kernels. Clamping is written so NaN ends up at the upper bound, exactly like minps/maxps do.
+
+static inline float clampSample(float x, float hi)
+{
+    x = (x < hi) ? x : hi;
+    return (x > -1.0f) ? x : -1.0f;
+}
+
+static inline int quantize(float x, float hi, float scale)
+{
+    return (int)lrintf(clampSample(x, hi) * scale);
+}
+
+static void scalarFloat32FromFloat(const float* src, void* dest, size_t samples)
+{
+    float* out = static_cast<float*>(dest);
+    for(size_t i = 0; i < samples; i++)
+        out[i] = clampSample(src[i], SC_MAX_FLOAT32);
+}
+
+static void scalarInt32FromFloat(const float* src, void* dest, size_t samples)
+{
+    int* out = static_cast<int*>(dest);
+    for(size_t i = 0; i < samples; i++)
+        out[i] = quantize(src[i], SC_MAX_INT32, SC_SCALE_INT32);
+}
+
+static void scalarInt24FromFloat(const float* src, void* dest, size_t samples)
+{
+    unsigned char* out = static_cast<unsigned char*>(dest);
+    for(size_t i = 0; i < samples; i++, out += 3)
+    {
+        int v = quantize(src[i], SC_MAX_INT24, SC_SCALE_INT24);
+        out[0] = (unsigned char)(v);
+        out[1] = (unsigned char)(v >> 8);
+        out[2] = (unsigned char)(v >> 16);
+    }
+}
+
+static void scalarInt16FromFloat(const float* src, void* dest, size_t samples)
+{
+    short int* out = static_cast<short int*>(dest);
+    for(size_t i = 0; i < samples; i++)
+        out[i] = (short int)quantize(src[i], SC_MAX_INT16, SC_SCALE_INT16);
+}
+
+static void scalarInt8FromFloat(const float* src, void* dest, size_t samples)
+{
+    signed char* out = static_cast<signed char*>(dest);
+    for(size_t i = 0; i < samples; i++)
+        out[i] = (signed char)quantize(src[i], SC_MAX_INT8, SC_SCALE_INT8);
+}
+
+static void scalarUInt8FromFloat(const float* src, void* dest, size_t samples)
+{
+    unsigned char* out = static_cast<unsigned char*>(dest);
+    for(size_t i = 0; i < samples; i++)
+        out[i] = (unsigned char)(quantize(src[i], SC_MAX_INT8, SC_SCALE_INT8) + 128);
+}
+
+static void scalarFloat32ToFloat(const void* src, float* dest, size_t samples)
+{
+    std::memcpy(dest, src, samples * sizeof(float));
+}
+
+static void scalarInt32ToFloat(const void* src, float* dest, size_t samples)
+{
+    const int* in = static_cast<const int*>(src);
+    for(size_t i = 0; i < samples; i++)
+        dest[i] = (float)in[i] * (1.0f / SC_SCALE_INT32);
+}
+
+static void scalarInt24ToFloat(const void* src, float* dest, size_t samples)
+{
+    const unsigned char* in = static_cast<const unsigned char*>(src);
+    for(size_t i = 0; i < samples; i++, in += 3)
+        dest[i] = (float)((int)(((unsigned int)in[0] << 8) | ((unsigned int)in[1] << 16) | ((unsigned int)in[2] << 24)) >> 8)
+                  * (1.0f / SC_SCALE_INT24);
+}
+
+static void scalarInt16ToFloat(const void* src, float* dest, size_t samples)
+{
+    const short int* in = static_cast<const short int*>(src);
+    for(size_t i = 0; i < samples; i++)
+        dest[i] = (float)in[i] * (1.0f / SC_SCALE_INT16);
+}
+
+static void scalarInt8ToFloat(const void* src, float* dest, size_t samples)
+{
+    const signed char* in = static_cast<const signed char*>(src);
+    for(size_t i = 0; i < samples; i++)
+        dest[i] = (float)in[i] * (1.0f / SC_SCALE_INT8);
+}
+
+static void scalarUInt8ToFloat(const void* src, float* dest, size_t samples)
+{
+    const unsigned char* in = static_cast<const unsigned char*>(src);
+    for(size_t i = 0; i < samples; i++)
+        dest[i] = (float)((int)in[i] - 128) * (1.0f / SC_SCALE_INT8);
+}
+
+static const KernelTable scalarKernels =
+{
+    {scalarFloat32ToFloat, scalarInt32ToFloat, scalarInt24ToFloat, scalarInt16ToFloat, scalarInt8ToFloat, scalarUInt8ToFloat},
+    {scalarFloat32FromFloat, scalarInt32FromFloat, scalarInt24FromFloat, scalarInt16FromFloat, scalarInt8FromFloat, scalarUInt8FromFloat}
+};
+
+#if SAMPLECONVERSION_X86
+
+// *********************************************************************************
+// SSE2 kernels. Vector loops handle the bulk, the scalar kernels handle the remainder.
+
+static inline __m128i sse2Quantize(const float* src, __m128 hi, __m128 lo, __m128 scale)
+{
+    return _mm_cvtps_epi32(_mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(src), hi), lo), scale));
+}
+
+static void sse2Float32FromFloat(const float* src, void* dest, size_t samples)
+{
+    float*          out =   static_cast<float*>(dest);
+    const __m128    hi =    _mm_set1_ps(SC_MAX_FLOAT32);
+    const __m128    lo =    _mm_set1_ps(-1.0f);
+    size_t          i =     0;
+
+    for(; i + 4 <= samples; i += 4)
+        _mm_storeu_ps(out + i, _mm_max_ps(_mm_min_ps(_mm_loadu_ps(src + i), hi), lo));
+
+    scalarFloat32FromFloat(src + i, out + i, samples - i);
+}
+
+static void sse2Int32FromFloat(const float* src, void* dest, size_t samples)
+{
+    int*            out =   static_cast<int*>(dest);
+    const __m128    hi =    _mm_set1_ps(SC_MAX_INT32);
+    const __m128    lo =    _mm_set1_ps(-1.0f);
+    const __m128    scale = _mm_set1_ps(SC_SCALE_INT32);
+    size_t          i =     0;
+
+    for(; i + 4 <= samples; i += 4)
+        _mm_storeu_si128((__m128i*)(out + i), sse2Quantize(src + i, hi, lo, scale));
+
+    scalarInt32FromFloat(src + i, out + i, samples - i);
+}
+
+static void sse2Int24FromFloat(const float* src, void* dest, size_t samples)
+{
+    unsigned char*  out =   static_cast<unsigned char*>(dest);
+    const __m128    hi =    _mm_set1_ps(SC_MAX_INT24);
+    const __m128    lo =    _mm_set1_ps(-1.0f);
+    const __m128    scale = _mm_set1_ps(SC_SCALE_INT24);
+    int             v[4];
+    size_t          i =     0;
+
+    // SSE2 has no byte shuffle, so the packing to 3 bytes is done in scalar code.
+    for(; i + 4 <= samples; i += 4, out += 12)
+    {
+        _mm_storeu_si128((__m128i*)v, sse2Quantize(src + i, hi, lo, scale));
+        for(int j = 0; j < 4; j++)
+        {
+            out[j * 3 + 0] = (unsigned char)(v[j]);
+            out[j * 3 + 1] = (unsigned char)(v[j] >> 8);
+            out[j * 3 + 2] = (unsigned char)(v[j] >> 16);
+        }
+    }
+
+    scalarInt24FromFloat(src + i, out, samples - i);
+}
+
+static void sse2Int16FromFloat(const float* src, void* dest, size_t samples)
+{
+    short int*      out =   static_cast<short int*>(dest);
+    const __m128    hi =    _mm_set1_ps(SC_MAX_INT16);
+    const __m128    lo =    _mm_set1_ps(-1.0f);
+    const __m128    scale = _mm_set1_ps(SC_SCALE_INT16);
+    size_t          i =     0;
+
+    for(; i + 8 <= samples; i += 8)
+    {
+        __m128i a = sse2Quantize(src + i, hi, lo, scale);
+        __m128i b = sse2Quantize(src + i + 4, hi, lo, scale);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(a, b));
+    }
+
+    scalarInt16FromFloat(src + i, out + i, samples - i);
+}
+
+static inline __m128i sse2Int8Pack(const float* src)
+{
+    const __m128    hi =    _mm_set1_ps(SC_MAX_INT8);
+    const __m128    lo =    _mm_set1_ps(-1.0f);
+    const __m128    scale = _mm_set1_ps(SC_SCALE_INT8);
+
+    __m128i a = sse2Quantize(src, hi, lo, scale);
+    __m128i b = sse2Quantize(src + 4, hi, lo, scale);
+    __m128i c = sse2Quantize(src + 8, hi, lo, scale);
+    __m128i d = sse2Quantize(src + 12, hi, lo, scale);
+
+    return _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+}
+
+static void sse2Int8FromFloat(const float* src, void* dest, size_t samples)
+{
+    signed char*    out =   static_cast<signed char*>(dest);
+    size_t          i =     0;
+
+    for(; i + 16 <= samples; i += 16)
+        _mm_storeu_si128((__m128i*)(out + i), sse2Int8Pack(src + i));
+
+    scalarInt8FromFloat(src + i, out + i, samples - i);
+}
+
+static void sse2UInt8FromFloat(const float* src, void* dest, size_t samples)
+{
+    unsigned char*  out =   static_cast<unsigned char*>(dest);
+    const __m128i   bias =  _mm_set1_epi8((char)0x80);
+    size_t          i =     0;
+
+    // Adding 128 to a signed byte is the same as flipping its sign bit.
+    for(; i + 16 <= samples; i += 16)
+        _mm_storeu_si128((__m128i*)(out + i), _mm_xor_si128(sse2Int8Pack(src + i), bias));
+
+    scalarUInt8FromFloat(src + i, out + i, samples - i);
+}
+
+static void sse2Int32ToFloat(const void* src, float* dest, size_t samples)
+{
+    const int*      in =    static_cast<const int*>(src);
+    const __m128    scale = _mm_set1_ps(1.0f / SC_SCALE_INT32);
+    size_t          i =     0;
+
+    for(; i + 4 <= samples; i += 4)
+        _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(in + i))), scale));
+
+    scalarInt32ToFloat(in + i, dest + i, samples - i);
+}
+
+static void sse2Int16ToFloat(const void* src, float* dest, size_t samples)
+{
+    const short int*    in =    static_cast<const short int*>(src);
+    const __m128        scale = _mm_set1_ps(1.0f / SC_SCALE_INT16);
+    size_t              i =     0;
+
+    for(; i + 8 <= samples; i += 8)
+    {
+        __m128i v =     _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i lo =    _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi =    _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dest + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+
+    scalarInt16ToFloat(in + i, dest + i, samples - i);
+}
+
+static void sse2Int24ToFloat(const void* src, float* dest, size_t samples)
+{
+    const unsigned char*    in =    static_cast<const unsigned char*>(src);
+    const __m128            scale = _mm_set1_ps(1.0f / SC_SCALE_INT24);
+    size_t                  i =     0;
+
+    // 4 samples are 12 bytes, but 16 are loaded: the loop stops while the 4 extra are still inside the buffer. Without
+    // a byte shuffle, every sample is shifted down to its own low dword, then moved to the top 3 bytes and back down
+    // with an arithmetic shift, which sign extends it and drops the next sample's byte.
+    for(; i + 6 <= samples; i += 4)
+    {
+        const __m128i v =   _mm_loadu_si128((const __m128i*)(in + 3 * i));
+        const __m128i s01 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+        const __m128i s23 = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+        const __m128i d =   _mm_srai_epi32(_mm_slli_epi32(_mm_unpacklo_epi64(s01, s23), 8), 8);
+
+        _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(d), scale));
+    }
+
+    scalarInt24ToFloat(in + 3 * i, dest + i, samples - i);
+}
+
+static inline void sse2Int8BlockToFloat(__m128i v, float* dest)
+{
+    const __m128    scale = _mm_set1_ps(1.0f / SC_SCALE_INT8);
+
+    __m128i w0 =    _mm_unpacklo_epi8(v, v);
+    __m128i w1 =    _mm_unpackhi_epi8(v, v);
+    __m128i d0 =    _mm_srai_epi32(_mm_unpacklo_epi16(w0, w0), 24);
+    __m128i d1 =    _mm_srai_epi32(_mm_unpackhi_epi16(w0, w0), 24);
+    __m128i d2 =    _mm_srai_epi32(_mm_unpacklo_epi16(w1, w1), 24);
+    __m128i d3 =    _mm_srai_epi32(_mm_unpackhi_epi16(w1, w1), 24);
+
+    _mm_storeu_ps(dest,      _mm_mul_ps(_mm_cvtepi32_ps(d0), scale));
+    _mm_storeu_ps(dest + 4,  _mm_mul_ps(_mm_cvtepi32_ps(d1), scale));
+    _mm_storeu_ps(dest + 8,  _mm_mul_ps(_mm_cvtepi32_ps(d2), scale));
+    _mm_storeu_ps(dest + 12, _mm_mul_ps(_mm_cvtepi32_ps(d3), scale));
+}
+
+static void sse2Int8ToFloat(const void* src, float* dest, size_t samples)
+{
+    const signed char*  in =    static_cast<const signed char*>(src);
+    size_t              i =     0;
+
+    for(; i + 16 <= samples; i += 16)
+        sse2Int8BlockToFloat(_mm_loadu_si128((const __m128i*)(in + i)), dest + i);
+
+    scalarInt8ToFloat(in + i, dest + i, samples - i);
+}
+
+static void sse2UInt8ToFloat(const void* src, float* dest, size_t samples)
+{
+    const unsigned char*    in =    static_cast<const unsigned char*>(src);
+    const __m128i           bias =  _mm_set1_epi8((char)0x80);
+    size_t                  i =     0;
+
+    for(; i + 16 <= samples; i += 16)
+        sse2Int8BlockToFloat(_mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i)), bias), dest + i);
+
+    scalarUInt8ToFloat(in + i, dest + i, samples - i);
+}
+
+static const KernelTable sse2Kernels =
+{
+    {scalarFloat32ToFloat, sse2Int32ToFloat, sse2Int24ToFloat, sse2Int16ToFloat, sse2Int8ToFloat, sse2UInt8ToFloat},
+    {sse2Float32FromFloat, sse2Int32FromFloat, sse2Int24FromFloat, sse2Int16FromFloat, sse2Int8FromFloat, sse2UInt8FromFloat}
+};
+
+// *********************************************************************************
+// AVX2 kernels. Compiled for AVX2 through function attributes, so the rest of the engine doesn't need -mavx2.
+
+#define SC_AVX2 __attribute__((target("avx2")))
+
+SC_AVX2 static inline __m256i avx2Quantize(const float* src, __m256 hi, __m256 lo, __m256 scale)
+{
+    return _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(src), hi), lo), scale));
+}
+
+SC_AVX2 static void avx2Float32FromFloat(const float* src, void* dest, size_t samples)
+{
+    float*          out =   static_cast<float*>(dest);
+    const __m256    hi =    _mm256_set1_ps(SC_MAX_FLOAT32);
+    const __m256    lo =    _mm256_set1_ps(-1.0f);
+    size_t          i =     0;
+
+    for(; i + 8 <= samples; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(src + i), hi), lo));
+
+    sse2Float32FromFloat(src + i, out + i, samples - i);
+}
+
+SC_AVX2 static void avx2Int32FromFloat(const float* src, void* dest, size_t samples)
+{
+    int*            out =   static_cast<int*>(dest);
+    const __m256    hi =    _mm256_set1_ps(SC_MAX_INT32);
+    const __m256    lo =    _mm256_set1_ps(-1.0f);
+    const __m256    scale = _mm256_set1_ps(SC_SCALE_INT32);
+    size_t          i =     0;
+
+    for(; i + 8 <= samples; i += 8)
+        _mm256_storeu_si256((__m256i*)(out + i), avx2Quantize(src + i, hi, lo, scale));
+
+    sse2Int32FromFloat(src + i, out + i, samples - i);
+}
+
+SC_AVX2 static void avx2Int24FromFloat(const float* src, void* dest, size_t samples)
+{
+    unsigned char*  out =   static_cast<unsigned char*>(dest);
+    const __m256    hi =    _mm256_set1_ps(SC_MAX_INT24);
+    const __m256    lo =    _mm256_set1_ps(-1.0f);
+    const __m256    scale = _mm256_set1_ps(SC_SCALE_INT24);
+
+    // Drops the high byte of every 32-bit lane, leaving 12 packed bytes at the bottom of each 128-bit half.
+    const __m256i   pack =  _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                             0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    unsigned char   packed[32];
+    size_t          i =     0;
+
+    for(; i + 8 <= samples; i += 8, out += 24)
+    {
+        _mm256_storeu_si256((__m256i*)packed, _mm256_shuffle_epi8(avx2Quantize(src + i, hi, lo, scale), pack));
+        std::memcpy(out, packed, 12);
+        std::memcpy(out + 12, packed + 16, 12);
+    }
+
+    scalarInt24FromFloat(src + i, out, samples - i);
+}
+
+SC_AVX2 static void avx2Int16FromFloat(const float* src, void* dest, size_t samples)
+{
+    short int*      out =   static_cast<short int*>(dest);
+    const __m256    hi =    _mm256_set1_ps(SC_MAX_INT16);
+    const __m256    lo =    _mm256_set1_ps(-1.0f);
+    const __m256    scale = _mm256_set1_ps(SC_SCALE_INT16);
+    size_t          i =     0;
+
+    // packs works inside each 128-bit half, hence the final permutation.
+    for(; i + 16 <= samples; i += 16)
+    {
+        __m256i a = avx2Quantize(src + i, hi, lo, scale);
+        __m256i b = avx2Quantize(src + i + 8, hi, lo, scale);
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+    }
+
+    sse2Int16FromFloat(src + i, out + i, samples - i);
+}
+
+SC_AVX2 static inline __m256i avx2Int8Pack(const float* src)
+{
+    const __m256    hi =    _mm256_set1_ps(SC_MAX_INT8);
+    const __m256    lo =    _mm256_set1_ps(-1.0f);
+    const __m256    scale = _mm256_set1_ps(SC_SCALE_INT8);
+
+    __m256i a = avx2Quantize(src, hi, lo, scale);
+    __m256i b = avx2Quantize(src + 8, hi, lo, scale);
+    __m256i c = avx2Quantize(src + 16, hi, lo, scale);
+    __m256i d = avx2Quantize(src + 24, hi, lo, scale);
+
+    __m256i packed = _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+    return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+SC_AVX2 static void avx2Int8FromFloat(const float* src, void* dest, size_t samples)
+{
+    signed char*    out =   static_cast<signed char*>(dest);
+    size_t          i =     0;
+
+    for(; i + 32 <= samples; i += 32)
+        _mm256_storeu_si256((__m256i*)(out + i), avx2Int8Pack(src + i));
+
+    sse2Int8FromFloat(src + i, out + i, samples - i);
+}
+
+SC_AVX2 static void avx2UInt8FromFloat(const float* src, void* dest, size_t samples)
+{
+    unsigned char*  out =   static_cast<unsigned char*>(dest);
+    const __m256i   bias =  _mm256_set1_epi8((char)0x80);
+    size_t          i =     0;
+
+    for(; i + 32 <= samples; i += 32)
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_xor_si256(avx2Int8Pack(src + i), bias));
+
+    sse2UInt8FromFloat(src + i, out + i, samples - i);
+}
+
+SC_AVX2 static void avx2Int32ToFloat(const void* src, float* dest, size_t samples)
+{
+    const int*      in =    static_cast<const int*>(src);
+    const __m256    scale = _mm256_set1_ps(1.0f / SC_SCALE_INT32);
+    size_t          i =     0;
+
+    for(; i + 8 <= samples; i += 8)
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(in + i))), scale));
+
+    sse2Int32ToFloat(in + i, dest + i, samples - i);
+}
+
+SC_AVX2 static void avx2Int16ToFloat(const void* src, float* dest, size_t samples)
+{
+    const short int*    in =    static_cast<const short int*>(src);
+    const __m256        scale = _mm256_set1_ps(1.0f / SC_SCALE_INT16);
+    size_t              i =     0;
+
+    for(; i + 8 <= samples; i += 8)
+    {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    scalarInt16ToFloat(in + i, dest + i, samples - i);
+}
+
+SC_AVX2 static void avx2Int24ToFloat(const void* src, float* dest, size_t samples)
+{
+    const unsigned char*    in =    static_cast<const unsigned char*>(src);
+    const __m256            scale = _mm256_set1_ps(1.0f / SC_SCALE_INT24);
+    size_t                  i =     0;
+
+    // Each 128-bit half gets 4 samples (12 of its 16 bytes), shuffled to the top 3 bytes of their dwords; the
+    // arithmetic shift then sign extends them. The second half is loaded 12 bytes in, so the loop stops 4 bytes early.
+    const __m256i           spread = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                                      -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+    for(; i + 10 <= samples; i += 8)
+    {
+        const __m128i lo =  _mm_loadu_si128((const __m128i*)(in + 3 * i));
+        const __m128i hi =  _mm_loadu_si128((const __m128i*)(in + 3 * i + 12));
+        const __m256i v =   _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        const __m256i d =   _mm256_srai_epi32(_mm256_shuffle_epi8(v, spread), 8);
+
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(d), scale));
+    }
+
+    sse2Int24ToFloat(in + 3 * i, dest + i, samples - i);
+}
+
+SC_AVX2 static void avx2Int8ToFloat(const void* src, float* dest, size_t samples)
+{
+    const signed char*  in =    static_cast<const signed char*>(src);
+    const __m256        scale = _mm256_set1_ps(1.0f / SC_SCALE_INT8);
+    size_t              i =     0;
+
+    for(; i + 8 <= samples; i += 8)
+    {
+        __m256i v = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(in + i)));
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    scalarInt8ToFloat(in + i, dest + i, samples - i);
+}
+
+SC_AVX2 static void avx2UInt8ToFloat(const void* src, float* dest, size_t samples)
+{
+    const unsigned char*    in =    static_cast<const unsigned char*>(src);
+    const __m256            scale = _mm256_set1_ps(1.0f / SC_SCALE_INT8);
+    const __m256i           bias =  _mm256_set1_epi32(128);
+    size_t                  i =     0;
+
+    for(; i + 8 <= samples; i += 8)
+    {
+        __m256i v = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + i))), bias);
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    scalarUInt8ToFloat(in + i, dest + i, samples - i);
+}
+
+static const KernelTable avx2Kernels =
+{
+    {scalarFloat32ToFloat, avx2Int32ToFloat, avx2Int24ToFloat, avx2Int16ToFloat, avx2Int8ToFloat, avx2UInt8ToFloat},
+    {avx2Float32FromFloat, avx2Int32FromFloat, avx2Int24FromFloat, avx2Int16FromFloat, avx2Int8FromFloat, avx2UInt8FromFloat}
+};
+
+#endif // SAMPLECONVERSION_X86
+
+// *********************************************************************************
+// Dispatch.
+
+static const KernelTable* kernelsFor(SampleConversion::InstructionSet iset)
+{
+#if SAMPLECONVERSION_X86
+    if(iset == SampleConversion::AVX2)
+        return &avx2Kernels;
+    else if(iset == SampleConversion::SSE2)
+        return &sse2Kernels;
+#endif
+    (void) iset;
+    return &scalarKernels;
+}
+
+static SampleConversion::InstructionSet& activeInstructionSet()
+{
+    static SampleConversion::InstructionSet iset = SampleConversion::bestInstructionSet();
+    return iset;
+}
+
+static const KernelTable*& activeKernels()
+{
+    static const KernelTable* kernels = kernelsFor(activeInstructionSet());
+    return kernels;
+}
+
+SampleConversion::InstructionSet SampleConversion::bestInstructionSet()
+{
+#if SAMPLECONVERSION_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return AVX2;
+    return SSE2;
+#else
+    return Scalar;
+#endif
+}
+
+SampleConversion::InstructionSet SampleConversion::instructionSet()
+{
+    return activeInstructionSet();
+}
+
+SampleConversion::InstructionSet SampleConversion::setInstructionSet(InstructionSet iset)
+{
+    InstructionSet best = bestInstructionSet();
+
+    activeInstructionSet() =    (iset > best) ? best : iset;
+    activeKernels() =           kernelsFor(activeInstructionSet());
+
+    return activeInstructionSet();
+}
+
+const char* SampleConversion::instructionSetToString(InstructionSet iset)
+{
+    switch(iset)
+    {
+        case AVX2:  return "AVX2";
+        case SSE2:  return "SSE2";
+        default:    return "Scalar";
+    }
+}
+
+unsigned int SampleConversion::bytesPerSample(PaSampleFormat sampleformat)
+{
+    switch(sampleformat & ~paNonInterleaved)
+    {
+        case paFloat32:
+        case paInt32:
+            return 4;
+        case paInt24:
+            return 3;
+        case paInt16:
+            return 2;
+        case paInt8:
+        case paUInt8:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+bool SampleConversion::toFloat(const void* src, PaSampleFormat sampleformat, float* dest, size_t samples)
+{
+    int fi = formatIndex(sampleformat);
+    if(fi < 0)
+        return false;
+
+    activeKernels()->toFloat[fi](src, dest, samples);
+    return true;
+}
+
+bool SampleConversion::fromFloat(const float* src, PaSampleFormat sampleformat, void* dest, size_t samples)
+{
+    int fi = formatIndex(sampleformat);
+    if(fi < 0)
+        return false;
+
+    activeKernels()->fromFloat[fi](src, dest, samples);
+    return true;
+}
+
+// Interleaving only moves samples around, so they are handled as opaque fixed size words.
+template<typename W>
+static void interleaveWords(const void* const* planes, void* dest, size_t frames, unsigned int channels)
+{
+    W* out = (W*)dest;
+
+    for(unsigned int c = 0; c < channels; c++)
+    {
+        const W* in = (const W*)planes[c];
+
+        for(size_t i = 0; i < frames; i++)
+            out[i * channels + c] = in[i];
+    }
+}
+
+template<typename W>
+static void deinterleaveWords(const void* src, void* const* planes, size_t frames, unsigned int channels)
+{
+    const W* in = (const W*)src;
+
+    for(unsigned int c = 0; c < channels; c++)
+    {
+        W* out = (W*)planes[c];
+
+        for(size_t i = 0; i < frames; i++)
+            out[i] = in[i * channels + c];
+    }
+}
+
+struct Word24
+{
+    unsigned char bytes[3];
+};
+
+void SampleConversion::interleave(const void* const* planes, void* dest, size_t frames, unsigned int channels,
+                                  unsigned int samplebytes)
+{
+    switch(samplebytes)
+    {
+        case 1: interleaveWords<unsigned char>(planes, dest, frames, channels);    break;
+        case 2: interleaveWords<unsigned short>(planes, dest, frames, channels);   break;
+        case 3: interleaveWords<Word24>(planes, dest, frames, channels);           break;
+        case 4: interleaveWords<unsigned int>(planes, dest, frames, channels);     break;
+        default: break;
+    }
+}
+
+void SampleConversion::deinterleave(const void* src, void* const* planes, size_t frames, unsigned int channels,
+                                    unsigned int samplebytes)
+{
+    switch(samplebytes)
+    {
+        case 1: deinterleaveWords<unsigned char>(src, planes, frames, channels);   break;
+        case 2: deinterleaveWords<unsigned short>(src, planes, frames, channels);  break;
+        case 3: deinterleaveWords<Word24>(src, planes, frames, channels);          break;
+        case 4: deinterleaveWords<unsigned int>(src, planes, frames, channels);    break;
+        default: break;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "portaudio.h"
+#include <cstddef>
+
+/**
+ * @brief Conversions between PortAudio sample formats and the engine's internal float samples, which range from -1.0 to 1.0.
+ *
+ * Every conversion has a scalar, an SSE2 and an AVX2 version. The best one supported by the running CPU is picked the
+ * first time a conversion is requested; setInstructionSet() can force a lower one, for benchmarking or testing.
+ * All versions give bit-exact results: floats are clamped, scaled and rounded to nearest the same way.
+ *
+ * Float to integer conversions clamp to the format's range, so a hot synthesizer can't wrap around. Integers are
+ * scaled by 2^(bits-1), the biggest positive value being 1.0 - 2^-(bits-1) (or the float just below 1.0, for paInt32).
+ */
+class SampleConversion
+{
+public:
+    enum InstructionSet
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    /**
+     * @brief Size in bytes of a single sample of a PaSampleFormat, as PortAudio lays it in an interleaved buffer.
+     * @return          0 if the format is not supported.
+     */
+    static unsigned int bytesPerSample(PaSampleFormat sampleformat);
+
+    /**
+     * @brief Converts `samples` interleaved samples in `sampleformat` into floats.
+     * @param src           Source buffer, laid out as PortAudio lays interleaved buffers (paInt24 is packed, 3 bytes).
+     * @param sampleformat  Source format.
+     * @param dest          Float buffer with room for `samples` elements.
+     * @param samples       Amount of samples (frames * channels).
+     * @return              false if the format is not supported.
+     */
+    static bool toFloat(const void* src, PaSampleFormat sampleformat, float* dest, size_t samples);
+
+    /**
+     * @brief Converts `samples` floats into `sampleformat`, clamping them to the -1.0 .. 1.0 range.
+     * @param src           Float buffer.
+     * @param sampleformat  Destination format.
+     * @param dest          Destination buffer, laid out as PortAudio expects it.
+     * @param samples       Amount of samples (frames * channels).
+     * @return              false if the format is not supported.
+     */
+    static bool fromFloat(const float* src, PaSampleFormat sampleformat, void* dest, size_t samples);
+
+    /**
+     * @brief Gathers one buffer per channel (a paNonInterleaved layout) into an interleaved buffer. Formats are kept.
+     * @param planes        `channels` buffers, `frames` samples each.
+     * @param dest          Interleaved buffer with room for `frames * channels` samples.
+     * @param samplebytes   Size of a sample, see bytesPerSample().
+     */
+    static void interleave(const void* const* planes, void* dest, size_t frames, unsigned int channels,
+                           unsigned int samplebytes);
+
+    /**
+     * @brief Inverse of interleave(): scatters an interleaved buffer into one buffer per channel.
+     */
+    static void deinterleave(const void* src, void* const* planes, size_t frames, unsigned int channels,
+                             unsigned int samplebytes);
+
+    /**
+     * @brief Instruction set used by the conversions.
+     */
+    static InstructionSet instructionSet();
+
+    /**
+     * @brief Best instruction set the running CPU supports.
+     */
+    static InstructionSet bestInstructionSet();
+
+    /**
+     * @brief Forces an instruction set. Asking for one the CPU doesn't support selects the best supported one.
+     * Not thread safe: call it before any stream starts.
+     * @return              The instruction set actually selected.
+     */
+    static InstructionSet setInstructionSet(InstructionSet iset);
+
+    static const char*  instructionSetToString(InstructionSet iset);
+};
@@ -1,6 +1,114 @@
 #include "scopedPAContext.h"
+#include "rtsafety.h"
+#include "denormals.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Block sizes tried by the LowestStable and TargetLatency policies, in frames.
+static const unsigned long  LATENCY_CANDIDATES[] =      {16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192};
+static const int            LATENCY_CANDIDATE_COUNT =   sizeof(LATENCY_CANDIDATES) / sizeof(LATENCY_CANDIDATES[0]);
+
+// *********************************************************************************
+
+ScopedPAContext::LatencyPolicy ScopedPAContext::LatencyPolicy::streamBufferSize()
+{
+    return LatencyPolicy();
+}
+
+ScopedPAContext::LatencyPolicy ScopedPAContext::LatencyPolicy::fixedBlock(unsigned long blocksize)
+{
+    LatencyPolicy policy;
+
+    policy.mode =       FixedBlock;
+    policy.blocksize =  blocksize;
+    return policy;
+}
+
+ScopedPAContext::LatencyPolicy ScopedPAContext::LatencyPolicy::lowestStable(unsigned long minblocksize,
+                                                                            unsigned long maxblocksize,
+                                                                            unsigned int probetime)
+{
+    LatencyPolicy policy;
+
+    policy.mode =           LowestStable;
+    policy.blocksize =      minblocksize;
+    policy.maxblocksize =   (maxblocksize >= minblocksize) ? maxblocksize : minblocksize;
+    policy.probetime =      probetime;
+    return policy;
+}
+
+ScopedPAContext::LatencyPolicy ScopedPAContext::LatencyPolicy::targetLatency(double milliseconds)
+{
+    LatencyPolicy policy;
+
+    policy.mode =       TargetLatency;
+    policy.target =     milliseconds / 1000.0;
+    return policy;
+}
+
+ScopedPAContext::LatencyPolicy ScopedPAContext::LatencyPolicy::fromString(const std::string& policy)
+{
+    const size_t        colon = policy.find(':');
+    const std::string   name =  policy.substr(0, colon);
+    const char*         args =  (colon != std::string::npos) ? policy.c_str() + colon + 1 : "";
+
+    if(name == "block" && std::strtoul(args, NULL, 10) > 0)
+        return fixedBlock(std::strtoul(args, NULL, 10));
+
+    if(name == "target" && std::strtod(args, NULL) > 0.0)
+        return targetLatency(std::strtod(args, NULL));
+
+    if(name == "lowest")
+    {
+        char*           end;
+        unsigned long   minblock =  std::strtoul(args, &end, 10);
+        unsigned long   maxblock =  (*end == ':') ? std::strtoul(end + 1, NULL, 10) : 0;
+
+        return lowestStable(minblock > 0 ? minblock : 32, maxblock > 0 ? maxblock : 2048);
+    }
+
+    return streamBufferSize();
+}
+
+std::string ScopedPAContext::LatencyPolicy::toString() const
+{
+    char text[64];
+
+    switch(mode)
+    {
+        case FixedBlock:
+            std::snprintf(text, sizeof(text), "block:%lu", blocksize);
+        break;
+        case LowestStable:
+            std::snprintf(text, sizeof(text), "lowest:%lu:%lu", blocksize, maxblocksize);
+        break;
+        case TargetLatency:
+            std::snprintf(text, sizeof(text), "target:%g", target * 1000.0);
+        break;
+        default:
+            std::snprintf(text, sizeof(text), "stream");
+        break;
+    }
+    return std::string(text);
+}
+
+std::string ScopedPAContext::LatencyReport::toString() const
+{
+    char text[160];
+
+    std::snprintf(text, sizeof(text), "blocksize=%lu suggested=%.2fms output=%.2fms input=%.2fms samplerate=%g probes=%u%s",
+                  blocksize, suggestedLatency * 1e3, outputLatency * 1e3, inputLatency * 1e3, sampleRate, probes,
+                  stable ? " stable" : "");
+    return std::string(text);
+}
+
+// *********************************************************************************
 
 ScopedPAContext::ScopedPAContext() :
+    _probing(false),
     _result(Pa_Initialize())
 {
     // Inits PortAudio
@@ -18,8 +126,20 @@ ScopedPAContext::ScopedPAContext() :
     _strpars.hostApiSpecificStreamInfo =    NULL;
     _strpars.suggestedLatency =             Pa_GetDeviceInfo(_outputdev)->defaultLowOutputLatency;
 
+    // The input device is only needed by duplex streams, so there may be none.
+    _inputdev =                             Pa_GetDefaultInputDevice();
+
+    memset(&_inpars, 0, sizeof(PaStreamParameters));
+    _inpars.device =                        _inputdev;
+    _inpars.hostApiSpecificStreamInfo =     NULL;
+
     _isplaying =                            false;
     _stream =                               NULL;
+    _as =                                   NULL;
+    _mixer =                                NULL;
+
+    if(std::getenv("WHIMSY_LATENCY") != NULL)
+        _policy = LatencyPolicy::fromString(std::getenv("WHIMSY_LATENCY"));
 }
 
 ScopedPAContext::~ScopedPAContext()
@@ -29,6 +149,8 @@ ScopedPAContext::~ScopedPAContext()
     {
         Pa_Terminate();
     }
+
+    delete _mixer;
 }
 
 PaError ScopedPAContext::result() const
@@ -36,21 +158,246 @@ PaError ScopedPAContext::result() const
     return _result;
 }
 
-void ScopedPAContext::setStream(AudioStreamBase& astream)
+bool ScopedPAContext::setStream(AudioStreamBase& astream)
 {
+    // apiCallback reads _as: the running stream must be gone before it changes.
+    if(_stream != NULL)
+    {
+        stopStream();
+        closeStream();
+    }
+
     _as = &astream;
 
     _strpars.channelCount =     _as->_channels;
     _strpars.sampleFormat =     _as->_sampleformat;
 
-    if(_stream != NULL)
+    _inpars.channelCount =      _as->_inputchannels;
+    _inpars.sampleFormat =      _as->_sampleformat;
+
+    return negotiateStream();
+}
+
+bool ScopedPAContext::setInputDevice(PaDeviceIndex device)
+{
+    const PaDeviceInfo* info = (device >= 0 && device < Pa_GetDeviceCount()) ? Pa_GetDeviceInfo(device) : NULL;
+
+    if(info == NULL || info->maxInputChannels <= 0)
+        return false;
+
+    _inputdev =         device;
+    _inpars.device =    device;
+    return true;
+}
+
+PaDeviceIndex ScopedPAContext::inputDevice() const
+{
+    return _inputdev;
+}
+
+void ScopedPAContext::setLatencyPolicy(const LatencyPolicy& policy)
+{
+    _policy = policy;
+}
+
+ScopedPAContext::LatencyPolicy ScopedPAContext::latencyPolicy() const
+{
+    return _policy;
+}
+
+ScopedPAContext::LatencyReport ScopedPAContext::latencyReport() const
+{
+    return _report;
+}
+
+PaTime ScopedPAContext::streamTime() const
+{
+    return (_stream != NULL) ? Pa_GetStreamTime(_stream) : 0.0;
+}
+
+bool ScopedPAContext::openStream(unsigned long blocksize, double suggestedlatency)
+{
+    const bool duplex = _as->_inputchannels > 0;
+
+    _strpars.suggestedLatency = suggestedlatency;
+    _inpars.suggestedLatency =  suggestedlatency;
+    _report.probes++;
+
+    if(duplex && _inputdev == paNoDevice)
+        return false;
+
+    if(Pa_IsFormatSupported(duplex ? &_inpars : NULL, &_strpars, _as->_samplerated) != paFormatIsSupported)
+        return false;
+
+    if(Pa_OpenStream(&_stream, duplex ? &_inpars : NULL, &_strpars, _as->_samplerated, blocksize,
+                     paClipOff, ScopedPAContext::apiCallback, this) != paNoError)
     {
-        stopStream();
-        closeStream();
+        _stream = NULL;
+        return false;
+    }
+
+    const PaStreamInfo* info =  Pa_GetStreamInfo(_stream);
+
+    _report.blocksize =         blocksize;
+    _report.suggestedLatency =  suggestedlatency;
+    _report.outputLatency =     (info != NULL) ? info->outputLatency : 0.0;
+    _report.inputLatency =      (info != NULL && duplex) ? info->inputLatency : 0.0;
+    _report.sampleRate =        (info != NULL) ? info->sampleRate : _as->_samplerated;
+    _report.stable =            false;
+
+    _stats.reset();
+    _meter.configure(_as->_channels, _report.sampleRate);
+    return true;
+}
+
+bool ScopedPAContext::probeStream(unsigned int milliseconds)
+{
+    CallbackStats::Snapshot snapshot;
+
+    _stats.reset();
+    _probing.store(true);
+
+    if(Pa_StartStream(_stream) != paNoError)
+    {
+        _probing.store(false);
+        return false;
     }
 
-    Pa_OpenStream(&_stream, NULL, &_strpars, (double)_as->_samplerate, paFramesPerBufferUnspecified,
-                  paClipOff, ScopedPAContext::apiCallback, _as);
+    Pa_Sleep(milliseconds);
+    Pa_StopStream(_stream);
+
+    _probing.store(false);
+    snapshot = _stats.snapshot();
+    _stats.reset();
+
+    return snapshot.callbacks > 0 && snapshot.outputUnderflows == 0 && snapshot.deadlineMisses == 0;
+}
+
+bool ScopedPAContext::negotiateStream()
+{
+    const double        lowlatency =    Pa_GetDeviceInfo(_outputdev)->defaultLowOutputLatency;
+    const double        samplerate =    _as->_samplerated;
+    unsigned long       block;
+
+    _report = LatencyReport();
+
+    switch(_policy.mode)
+    {
+        case LatencyPolicy::FixedBlock:
+            if(openStream(_policy.blocksize, lowlatency))
+                return true;
+        break;
+
+        case LatencyPolicy::TargetLatency:
+            // Biggest block that still fits twice in the target. The smallest candidate is tried anyway.
+            for(int i = LATENCY_CANDIDATE_COUNT - 1; i >= 0; i--)
+            {
+                block = LATENCY_CANDIDATES[i];
+                if((2.0 * block <= _policy.target * samplerate || i == 0) && openStream(block, _policy.target))
+                    return true;
+            }
+        break;
+
+        case LatencyPolicy::LowestStable:
+            for(int i = 0; i < LATENCY_CANDIDATE_COUNT; i++)
+            {
+                block = LATENCY_CANDIDATES[i];
+                if(block < _policy.blocksize || block > _policy.maxblocksize)
+                    continue;
+
+                if(!openStream(block, 2.0 * block / samplerate))
+                    continue;
+
+                if(probeStream(_policy.probetime))
+                {
+                    _report.stable = true;
+                    return true;
+                }
+                closeStream();
+            }
+
+            // Nothing played cleanly. The biggest block is the safest bet.
+            if(openStream(_policy.maxblocksize, 2.0 * _policy.maxblocksize / samplerate))
+                return true;
+        break;
+
+        default:
+            if(openStream(_as->_buffersize, lowlatency))
+                return true;
+        break;
+    }
+
+    // Last resort: let PortAudio choose.
+    return openStream(paFramesPerBufferUnspecified, lowlatency);
+}
+
+bool ScopedPAContext::addStream(AudioStreamBase& astream, float gain)
+{
+    if(_mixer == NULL)
+    {
+        AudioStreamBase*    previous =  _as;
+        bool                wasplaying = _isplaying;
+
+        _mixer = new AudioMixer(astream.getSampleRate(), astream.getChannelAmount());
+
+        // A previous stream the mixer can't take keeps playing alone, rather than being silently dropped.
+        if(previous != NULL && !_mixer->addStream(*previous))
+        {
+            delete _mixer;
+            _mixer = NULL;
+            return false;
+        }
+
+        setStream(*_mixer);
+        if(wasplaying)
+            startStream();
+    }
+
+    return _mixer->addStream(astream, gain);
+}
+
+bool ScopedPAContext::removeStream(AudioStreamBase& astream)
+{
+    if(_mixer == NULL)
+        return false;
+
+    return _mixer->removeStream(astream);
+}
+
+bool ScopedPAContext::setStreamGain(AudioStreamBase& astream, float gain)
+{
+    if(_mixer == NULL)
+        return false;
+
+    return _mixer->setGain(astream, gain);
+}
+
+AudioMixer* ScopedPAContext::mixer()
+{
+    return _mixer;
+}
+
+CallbackStats::Snapshot ScopedPAContext::callbackStats()
+{
+    if(_stream != NULL && _isplaying)
+        _stats.recordCpuLoad(Pa_GetStreamCpuLoad(_stream));
+
+    return _stats.snapshot();
+}
+
+void ScopedPAContext::resetCallbackStats()
+{
+    _stats.reset();
+}
+
+LevelMeter::Snapshot ScopedPAContext::levels() const
+{
+    return _meter.snapshot();
+}
+
+void ScopedPAContext::resetLevels()
+{
+    _meter.reset();
 }
 
 bool ScopedPAContext::startStream(unsigned int timeout_ms)
@@ -59,6 +406,7 @@ bool ScopedPAContext::startStream(unsigned int timeout_ms)
         return false;
 
     PaError err =   Pa_StartStream(_stream);
+    _isplaying =    (err == paNoError);
     if(timeout_ms != 0)
         Pa_Sleep(timeout_ms);
 
@@ -71,6 +419,7 @@ bool ScopedPAContext::stopStream()
         return false;
 
     PaError err =   Pa_StopStream( _stream );
+    _isplaying =    false;
 
     return (err == paNoError);
 }
@@ -88,9 +437,41 @@ bool ScopedPAContext::closeStream()
 
 int ScopedPAContext::apiCallback(const void *inputBuffer, void *outputBuffer, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void *userData)
 {
-    AudioStreamBase* current_stream = static_cast<AudioStreamBase*>(userData);
-    (void) inputBuffer;
+    RealtimeScope       rtscope;
+    DenormalGuard       denormalguard;
+    ScopedPAContext*    context =           static_cast<ScopedPAContext*>(userData);
+    AudioStreamBase*    current_stream =    context->_as;
+    int                 result;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Latency probes only judge the device: the stream isn't rendered, so the song doesn't start until it's really
+    // played. Silence is written instead.
+    if(context->_probing.load(std::memory_order_relaxed))
+    {
+        const PaSampleFormat    format =        current_stream->_sampleformat & ~paNonInterleaved;
+        const size_t            planebytes =    framesPerBuffer * SampleConversion::bytesPerSample(format);
+        const int               zero =          (format == paUInt8) ? SampleFormat<unsigned char>::ZERO : 0;
+
+        if(current_stream->isPlanar())
+        {
+            for(unsigned int c = 0; c < current_stream->_channels; c++)
+                memset(static_cast<void**>(outputBuffer)[c], zero, planebytes);
+        }
+        else
+            memset(outputBuffer, zero, planebytes * current_stream->_channels);
+
+        result = paContinue;
+    }
+    // inputBuffer is NULL unless the stream is duplex.
+    else
+        result = current_stream->renderBlock(inputBuffer, outputBuffer, framesPerBuffer, timeInfo, statusFlags);
+
+    context->_meter.process(outputBuffer, framesPerBuffer, current_stream->_sampleformat);
+
+    context->_stats.record((unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start).count(),
+                           framesPerBuffer, current_stream->_samplerated, statusFlags);
 
-    // Cast this ScopedPAContext._as as the userData used here.
-    return(current_stream->audioOut(outputBuffer, framesPerBuffer, timeInfo, statusFlags));
+    return result;
 }
@@ -3,17 +3,97 @@
 #include "portaudio.h"
 #include "../whimsycore.h"
 #include "audiostream.h"
+#include "audiomixer.h"
+#include "callbackstats.h"
+#include "levelmeter.h"
+
+#include <atomic>
+#include <string>
 
 class ScopedPAContext
 {
+public:
+    /**
+     * @brief How setStream() picks the callback block size and the latency PortAudio is asked for.
+     *
+     * It may also be given through the WHIMSY_LATENCY environment variable, so it can be tuned per machine without
+     * recompiling. See fromString().
+     */
+    struct LatencyPolicy
+    {
+        enum Mode
+        {
+            StreamBufferSize,   // The stream's own AudioStreamBase::getBufferSize(), with the device's low latency.
+            FixedBlock,         // A given block size, with the device's low latency.
+            LowestStable,       // Probes block sizes from `blocksize` up to `maxblocksize`; keeps the first one with no xrun.
+            TargetLatency       // The biggest block size that fits (twice) in `target` seconds, asking for that latency.
+        };
+
+        Mode            mode;
+        unsigned long   blocksize;
+        unsigned long   maxblocksize;
+        double          target;         // Seconds, for TargetLatency.
+        unsigned int    probetime;      // Milliseconds every LowestStable candidate plays silence before being judged.
+
+        LatencyPolicy() :
+            mode(StreamBufferSize), blocksize(0), maxblocksize(0), target(0.0), probetime(0) {}
+
+        static LatencyPolicy    streamBufferSize();
+        static LatencyPolicy    fixedBlock(unsigned long blocksize);
+        static LatencyPolicy    lowestStable(unsigned long minblocksize = 32, unsigned long maxblocksize = 2048,
+                                             unsigned int probetime = 300);
+        static LatencyPolicy    targetLatency(double milliseconds);
+
+        /**
+         * @brief Parses "stream", "block:<frames>", "lowest", "lowest:<min frames>:<max frames>" or "target:<ms>".
+         * Anything else gives the default policy, streamBufferSize().
+         */
+        static LatencyPolicy    fromString(const std::string& policy);
+        std::string             toString() const;
+    };
+
+    /**
+     * @brief What setStream() ended up opening.
+     */
+    struct LatencyReport
+    {
+        unsigned long   blocksize;          // Frames per callback. 0 is paFramesPerBufferUnspecified.
+        double          suggestedLatency;   // Seconds asked to PortAudio.
+        double          outputLatency;      // Seconds, as reported by Pa_GetStreamInfo().
+        double          inputLatency;       // Same, for duplex streams. Monitoring delay is input plus output.
+        double          sampleRate;         // As reported by Pa_GetStreamInfo().
+        unsigned int    probes;             // Configurations tried.
+        bool            stable;             // The configuration played a LowestStable probe without any xrun.
+
+        LatencyReport() :
+            blocksize(0), suggestedLatency(0.0), outputLatency(0.0), inputLatency(0.0), sampleRate(0.0), probes(0),
+            stable(false) {}
+
+        std::string     toString() const;
+    };
+
 private:
-    PaDeviceIndex       _outputdev;
-    PaStreamParameters  _strpars;
-    AudioStreamBase*  _as;
+    PaDeviceIndex       _outputdev, _inputdev;
+    PaStreamParameters  _strpars, _inpars;
+    AudioStreamBase*    _as;
+    AudioMixer*         _mixer;
     PaStream*           _stream;
 
     bool                _isplaying;
 
+    CallbackStats       _stats;
+    LevelMeter          _meter;
+
+    LatencyPolicy       _policy;
+    LatencyReport       _report;
+
+    // While probing, the callback plays silence without rendering the stream.
+    std::atomic<bool>   _probing;
+
+    bool    openStream(unsigned long blocksize, double suggestedlatency);
+    bool    probeStream(unsigned int milliseconds);
+    bool    negotiateStream();
+
     PaError             _result;
 
     static int apiCallback(const void *inputBuffer, void *outputBuffer, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void *userData);
@@ -22,11 +102,96 @@ public:
     ScopedPAContext();
     ~ScopedPAContext();
 
-    void    setStream(AudioStreamBase& astream);
+    /**
+     * @brief Opens the output device for a stream, choosing the block size and latency as the latency policy says.
+     * With LowestStable, the candidates are probed with silence: the stream is only rendered from startStream() on, so
+     * nothing of it is lost.
+     *
+     * If the stream has input channels (see AudioStreamBase::setInputChannels()), the input device is opened along,
+     * in the same sample format and with the same latency, and the stream gets the captured frames on every callback.
+     * @return  false if no configuration could be opened.
+     */
+    bool    setStream(AudioStreamBase& astream);
+
+    /**
+     * @brief Device duplex streams capture from. The default input device unless told otherwise. Applies the next
+     * time a stream is set.
+     * @return  false if there's no such input device.
+     */
+    bool    setInputDevice(PaDeviceIndex device);
+    PaDeviceIndex   inputDevice() const;
+
+    /**
+     * @brief Sets the latency policy. It applies the next time a stream is set; call setStream() again to apply it
+     * to the current one.
+     */
+    void            setLatencyPolicy(const LatencyPolicy& policy);
+    LatencyPolicy   latencyPolicy() const;
+
+    /**
+     * @brief Current time of the opened stream (Pa_GetStreamTime()), or 0 if there's none. Use it to stamp commands
+     * with AudioStreamBase::scheduleCommandAt(): `now + latencyReport().outputLatency` is the earliest time that
+     * can still be heard on time.
+     */
+    PaTime          streamTime() const;
+
+    /**
+     * @brief Configuration and actual latency of the opened stream.
+     */
+    LatencyReport   latencyReport() const;
+
     bool    startStream(unsigned int timeout_ms = 0);
     bool    stopStream();
     bool    closeStream();
 
+    /**
+     * @brief Adds a stream to this context's mixer, so it plays along with the others already added. The first call
+     * opens the device with the mixer (using this stream's sample rate and channel count); the following ones don't
+     * touch the device at all, so there's no glitch. A stream previously set with setStream() becomes the mixer's
+     * first input.
+     * @return  false if the mixer rejected the stream. See AudioMixer::addStream(). On the first call, also false
+     * (without opening anything) if the stream previously set doesn't match the new one's rate and channels: it keeps
+     * playing alone.
+     */
+    bool    addStream(AudioStreamBase& astream, float gain = 1.0f);
+
+    /**
+     * @brief Removes a stream from the mixer while playing. See AudioMixer::removeStream().
+     */
+    bool    removeStream(AudioStreamBase& astream);
+
+    /**
+     * @brief Changes the gain of a stream in the mixer. See AudioMixer::setGain().
+     */
+    bool    setStreamGain(AudioStreamBase& astream, float gain);
+
+    /**
+     * @brief Mixer used by addStream(), or NULL if addStream() was never called.
+     */
+    AudioMixer* mixer();
+
+    /**
+     * @brief Callback timing and xrun statistics since the stream was opened. Takes a Pa_GetStreamCpuLoad() sample
+     * too, so poll it regularly (from a QTimer, for instance) to follow the CPU load. Safe to call while playing.
+     */
+    CallbackStats::Snapshot callbackStats();
+
+    /**
+     * @brief Clears the callback statistics, for instance after changing the buffer size.
+     */
+    void    resetCallbackStats();
+
+    /**
+     * @brief Peak, RMS and clip levels of what was last played, per output channel. Meant to be polled from a QTimer:
+     * it never blocks the audio thread.
+     */
+    LevelMeter::Snapshot    levels() const;
+
+    /**
+     * @brief Clears the levels and the clip counters.
+     */
+    void    resetLevels();
+
     PaError result() const;
 
 };
@@ -0,0 +1,90 @@
+#include "scopetapstream.h"
+
+ScopeTapStream::ScopeTapStream(AudioStreamBase& source, double seconds, unsigned long maxframes) :
+    FloatAudioStream(source.getSampleRate(), source.getChannelAmount(), source.getSampleFormat() & ~paNonInterleaved),
+    _source(&source),
+    _maxframes(maxframes > 0 ? maxframes : 1),
+    _ring((size_t)((seconds > 0.0 ? seconds : 1.0) * source.getSampleRateDouble()) + 1, source.getChannelAmount()),
+    _dropped(0),
+    _timeinfo(NULL),
+    _statusflags(0)
+{
+    const unsigned int samplebytes = SampleConversion::bytesPerSample(source.getSampleFormat());
+
+    _nativebuffer.resize(_maxframes * _channels * (samplebytes > 0 ? samplebytes : 4));
+    _planarbuffer.resize(_nativebuffer.size());
+    _planes.resize(_channels);
+
+    for(unsigned int c = 0; c < _channels; c++)
+        _planes[c] = &(_planarbuffer[c * _maxframes * samplebytes]);
+}
+
+size_t ScopeTapStream::read(float* dest, size_t frames)
+{
+    return _ring.read(dest, frames);
+}
+
+size_t ScopeTapStream::available() const
+{
+    return _ring.available();
+}
+
+unsigned long long ScopeTapStream::dropped() const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+int ScopeTapStream::audioOut(void *outputBuffer, unsigned long framesPerBuffer,
+                             const PaStreamCallbackTimeInfo* timeInfo,
+                             PaStreamCallbackFlags statusFlags)
+{
+    _timeinfo =     timeInfo;
+    _statusflags =  statusFlags;
+
+    return FloatAudioStream::audioOut(outputBuffer, framesPerBuffer, timeInfo, statusFlags);
+}
+
+int ScopeTapStream::floatOut(float* samples, unsigned long frames)
+{
+    const PaStreamCallbackTimeInfo* timeinfo =  _timeinfo;
+    const PaSampleFormat            format =    _source->getSampleFormat() & ~paNonInterleaved;
+    const unsigned int              samplebytes = SampleConversion::bytesPerSample(format);
+    PaStreamCallbackTimeInfo        chunktime;
+    unsigned long                   chunk;
+    int                             result =    paContinue, chunkresult;
+
+    for(unsigned long done = 0; done < frames; done += chunk)
+    {
+        float*  out =       samples + done * _channels;
+        void*   native =    (format == paFloat32) ? (void*)out : (void*)&(_nativebuffer[0]);
+
+        chunk = (frames - done < _maxframes) ? frames - done : _maxframes;
+
+        // As in AudioMixer, later chunks are heard later.
+        if(done > 0 && _timeinfo != NULL)
+        {
+            chunktime =                     *_timeinfo;
+            chunktime.outputBufferDacTime += (double)done / _samplerated;
+            timeinfo =                      &chunktime;
+        }
+
+        if(_source->isPlanar())
+        {
+            chunkresult = _source->renderBlock(&(_planes[0]), chunk, timeinfo, _statusflags);
+            SampleConversion::interleave(&(_planes[0]), native, chunk, _channels, samplebytes);
+        }
+        else
+            chunkresult = _source->renderBlock(native, chunk, timeinfo, _statusflags);
+
+        if(format != paFloat32)
+            SampleConversion::toFloat(native, format, out, chunk * _channels);
+
+        _dropped.fetch_add(chunk - _ring.write(out, chunk), std::memory_order_relaxed);
+
+        // The whole buffer is still rendered, as in FloatAudioStream.
+        if(result == paContinue)
+            result = chunkresult;
+    }
+
+    return result;
+}
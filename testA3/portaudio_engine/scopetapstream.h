@@ -0,0 +1,69 @@
+#pragma once
+
+#include "floataudiostream.h"
+#include "audioring.h"
+
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief Plays a stream unchanged, and copies everything it plays into an AudioRing another thread can read, for an
+ * oscilloscope or a waveform view.
+ *
+ * The audio thread never waits on the reader: frames that don't fit in the ring are dropped and counted, so a GUI
+ * that stalls just misses part of the signal. The reader drains the ring with read(), usually into a
+ * WaveformOverview, from a QTimer.
+ *
+ *     ScopeTapStream  tap(song);
+ *     pactx.setStream(tap);
+ *     ...
+ *     size_t got = tap.read(buffer, frames);     // GUI thread.
+ */
+class ScopeTapStream : public FloatAudioStream
+{
+private:
+    AudioStreamBase*                _source;
+    unsigned long                   _maxframes;
+
+    AudioRing                       _ring;
+    std::atomic<unsigned long long> _dropped;
+
+    std::vector<unsigned char>      _nativebuffer;
+    std::vector<unsigned char>      _planarbuffer;
+    std::vector<void*>              _planes;
+
+    // Callback being rendered, passed on to the source.
+    const PaStreamCallbackTimeInfo* _timeinfo;
+    PaStreamCallbackFlags           _statusflags;
+
+public:
+    /**
+     * @brief Wraps a stream. Channels and sample rate are the source's.
+     * @param source        Stream to tap. Must outlive this object.
+     * @param seconds       Capacity of the ring: how long the reader may go without reading before frames drop.
+     * @param maxframes     Frames the source renders at once.
+     */
+    ScopeTapStream(AudioStreamBase& source, double seconds = 1.0, unsigned long maxframes = 1024);
+
+    /**
+     * @brief Reader side. Copies up to `frames` interleaved frames, the oldest first.
+     * @return  Frames actually read.
+     */
+    size_t              read(float* dest, size_t frames);
+
+    /**
+     * @brief Frames waiting to be read.
+     */
+    size_t              available() const;
+
+    /**
+     * @brief Frames the ring had no room for, since the tap was created.
+     */
+    unsigned long long  dropped() const;
+
+    int audioOut(void *outputBuffer, unsigned long framesPerBuffer,
+                 const PaStreamCallbackTimeInfo* timeInfo,
+                 PaStreamCallbackFlags statusFlags);
+
+    int floatOut(float* samples, unsigned long frames);
+};
@@ -1,32 +1,39 @@
 #pragma once
 
-#include "audiostream.h"
+#include "floataudiostream.h"
+#include "oscillator.h"
 
-class SquareWaveTest : public AudioStream<char, 11050, 2>
+#include <vector>
+
+/**
+ * @brief Band-limited square wave, synthesized in float and presented to the device as 8-bit samples.
+ */
+class SquareWaveTest : public FloatAudioStream
 {
 private:
-    unsigned long int t;
-    unsigned long int period;
+    Oscillator          osc;
+    std::vector<float>  mono;
 
 public:
     SquareWaveTest(float freq) :
-        t(0), period(11050/freq)
-    {}
+        FloatAudioStream(11050, 2, paInt8),
+        osc(11050.0f, Oscillator::Square, freq),
+        mono(1024)
+    {
+        // Same loudness as the former 8-bit loop, which wrote +-40.
+        osc.setAmplitude(40.0f / 128.0f);
+    }
 
-    int stereoOut(StereoSample<char> *samples, unsigned long length)
+    int floatOut(float* samples, unsigned long frames)
     {
-        for(unsigned int i = 0; i < length; i++,
-            t++)
+        unsigned long chunk;
+
+        for(unsigned long done = 0; done < frames; done += chunk)
         {
-            if(t < period/2)
-                samples[i].set(40);
-            else if(t < period)
-                samples[i].set(-40);
-            else
-            {
-                t = 0;
-                samples[i].set(40);
-            }
+            chunk = (frames - done < mono.size()) ? frames - done : mono.size();
+
+            osc.render(&(mono[0]), chunk);
+            Oscillator::spread(&(mono[0]), samples + done * getChannelAmount(), chunk, getChannelAmount());
         }
         return 0;
     }
@@ -0,0 +1,220 @@
+#include "waveformoverview.h"
+
+#include <cfloat>
+#include <cmath>
+
+WaveformOverview::WaveformOverview(unsigned int channels, size_t basebucket, size_t factor, bool keepsamples) :
+    _channels(channels > 0 ? channels : 1),
+    _basebucket(basebucket > 0 ? basebucket : 1),
+    _factor(factor > 1 ? factor : 2),
+    _keepsamples(keepsamples),
+    _frames(0)
+{
+    clear();
+}
+
+void WaveformOverview::clear()
+{
+    _levels.clear();
+    _samples.clear();
+
+    // There can't be more levels than bits in a frame count. Levels are then never moved, nor references to them lost.
+    _levels.reserve(sizeof(size_t) * 8);
+    _frames = 0;
+
+    // Level 0 always exists; the others show up as they fill.
+    Level base;
+
+    base.partial.assign(_channels * 2, 0.0f);
+    base.partialcount = 0;
+    base.bucketframes = _basebucket;
+
+    _levels.push_back(base);
+}
+
+size_t WaveformOverview::frames() const
+{
+    return _frames;
+}
+
+unsigned int WaveformOverview::channels() const
+{
+    return _channels;
+}
+
+size_t WaveformOverview::levelCount() const
+{
+    return _levels.size();
+}
+
+void WaveformOverview::merge(float* into, const float* from, unsigned int channels)
+{
+    for(unsigned int c = 0; c < channels; c++)
+    {
+        if(from[2 * c] < into[2 * c])
+            into[2 * c] = from[2 * c];
+        if(from[2 * c + 1] > into[2 * c + 1])
+            into[2 * c + 1] = from[2 * c + 1];
+    }
+}
+
+void WaveformOverview::foldInto(size_t level, const float* bucket)
+{
+    if(level == _levels.size())
+    {
+        Level above;
+
+        above.partialcount =    0;
+        above.bucketframes =    _levels[level - 1].bucketframes * _factor;
+        above.partial.assign(_channels * 2, 0.0f);
+
+        _levels.push_back(above);
+    }
+
+    Level& l = _levels[level];
+
+    if(l.partialcount == 0)
+        l.partial.assign(bucket, bucket + _channels * 2);
+    else
+        merge(&(l.partial[0]), bucket, _channels);
+
+    if(++l.partialcount < _factor)
+        return;
+
+    l.buckets.insert(l.buckets.end(), l.partial.begin(), l.partial.end());
+    l.partialcount = 0;
+
+    foldInto(level + 1, &(l.buckets[l.buckets.size() - _channels * 2]));
+}
+
+void WaveformOverview::append(const float* frames, size_t count)
+{
+    Level& base = _levels[0];
+
+    if(_keepsamples)
+        _samples.insert(_samples.end(), frames, frames + count * _channels);
+
+    for(size_t f = 0; f < count; f++)
+    {
+        const float* frame = frames + f * _channels;
+
+        if(base.partialcount == 0)
+        {
+            for(unsigned int c = 0; c < _channels; c++)
+            {
+                base.partial[2 * c] =       frame[c];
+                base.partial[2 * c + 1] =   frame[c];
+            }
+        }
+        else
+        {
+            for(unsigned int c = 0; c < _channels; c++)
+            {
+                if(frame[c] < base.partial[2 * c])
+                    base.partial[2 * c] = frame[c];
+                if(frame[c] > base.partial[2 * c + 1])
+                    base.partial[2 * c + 1] = frame[c];
+            }
+        }
+
+        if(++base.partialcount == _basebucket)
+        {
+            base.buckets.insert(base.buckets.end(), base.partial.begin(), base.partial.end());
+            base.partialcount = 0;
+
+            foldInto(1, &(base.buckets[base.buckets.size() - _channels * 2]));
+        }
+    }
+
+    _frames += count;
+}
+
+void WaveformOverview::scan(size_t level, unsigned int channel, size_t begin, size_t end, float& low, float& high) const
+{
+    const Level&    l =         _levels[level];
+    const size_t    complete =  l.buckets.size() / (_channels * 2);
+    const size_t    first =     begin / l.bucketframes;
+    const size_t    last =      (end + l.bucketframes - 1) / l.bucketframes;
+
+    for(size_t b = first; b < last && b < complete; b++)
+    {
+        const float* bucket = &(l.buckets[(b * _channels + channel) * 2]);
+
+        if(bucket[0] < low)
+            low = bucket[0];
+        if(bucket[1] > high)
+            high = bucket[1];
+    }
+
+    if(last <= complete)
+        return;
+
+    // The end of the range is not summarized at this level yet: the level below has it.
+    const size_t tail = (begin > complete * l.bucketframes) ? begin : complete * l.bucketframes;
+
+    if(level > 0)
+        scan(level - 1, channel, tail, end, low, high);
+    else if(l.partialcount > 0)
+    {
+        if(l.partial[2 * channel] < low)
+            low = l.partial[2 * channel];
+        if(l.partial[2 * channel + 1] > high)
+            high = l.partial[2 * channel + 1];
+    }
+}
+
+void WaveformOverview::summarize(unsigned int channel, double begin, double framespercolumn, unsigned int columns,
+                                 float* low, float* high) const
+{
+    size_t level = 0;
+
+    if(framespercolumn <= 0.0)
+        framespercolumn = 1.0;
+
+    // Coarsest level whose buckets are no longer than a column.
+    while(level + 1 < _levels.size() && (double)_levels[level + 1].bucketframes <= framespercolumn)
+        level++;
+
+    for(unsigned int col = 0; col < columns; col++)
+    {
+        const double    from =  begin + col * framespercolumn;
+        const double    to =    from + framespercolumn;
+
+        low[col] =  0.0f;
+        high[col] = 0.0f;
+
+        if(channel >= _channels || to <= 0.0 || from >= (double)_frames)
+            continue;
+
+        size_t  first = (from > 0.0) ? (size_t)from : 0;
+        size_t  last =  (size_t)std::ceil(to);
+
+        if(last > _frames)
+            last = _frames;
+        if(last <= first)
+            last = first + 1;
+
+        float   lo = FLT_MAX, hi = -FLT_MAX;
+
+        if(_keepsamples && framespercolumn < (double)_basebucket)
+        {
+            for(size_t f = first; f < last; f++)
+            {
+                const float x = _samples[f * _channels + channel];
+
+                if(x < lo)
+                    lo = x;
+                if(x > hi)
+                    hi = x;
+            }
+        }
+        else
+            scan(level, channel, first, last, lo, hi);
+
+        if(lo <= hi)
+        {
+            low[col] =  lo;
+            high[col] = hi;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Min/max summaries of a long waveform at several zoom levels, so a view can draw minutes of audio from a few
+ * thousand precomputed values instead of millions of samples.
+ *
+ * Level 0 keeps the lowest and highest sample of every `basebucket` frames, per channel. Every level above keeps
+ * those of `factor` buckets of the level below, up to the first level still filling its first bucket. Summaries are
+ * built as frames are appended, a ScopeTapStream being drained or a whole offline render alike, and a query reads from
+ * the coarsest level whose buckets still fit in a column: it never touches more than about `factor` buckets per
+ * column, whatever the zoom. A ten minute stereo song takes about 9MB of summaries with the defaults.
+ *
+ * The samples themselves may be kept too, for views zoomed in below `basebucket` frames per column.
+ *
+ * Not thread safe: feed and query it from the GUI thread.
+ */
+class WaveformOverview
+{
+private:
+    // Interleaved [bucket][channel][min, max].
+    struct Level
+    {
+        std::vector<float>  buckets;
+        std::vector<float>  partial;        // Bucket being filled, same layout.
+        size_t              partialcount;   // Buckets (or frames, on level 0) of the level below in it.
+        size_t              bucketframes;
+    };
+
+    unsigned int        _channels;
+    size_t              _basebucket, _factor;
+    bool                _keepsamples;
+
+    std::vector<Level>  _levels;
+    std::vector<float>  _samples;
+    size_t              _frames;
+
+    void    foldInto(size_t level, const float* bucket);
+    void    scan(size_t level, unsigned int channel, size_t begin, size_t end, float& low, float& high) const;
+
+    static void merge(float* into, const float* from, unsigned int channels);
+
+public:
+    /**
+     * @param channels      Interleaved channels of the frames appended.
+     * @param basebucket    Frames summarized by a level 0 bucket.
+     * @param factor        Buckets of a level summarized by a bucket of the level above. At least 2.
+     * @param keepsamples   Keep the samples too. Costs `channels` floats per frame.
+     */
+    WaveformOverview(unsigned int channels, size_t basebucket = 64, size_t factor = 4, bool keepsamples = false);
+
+    /**
+     * @brief Appends interleaved frames at the end of the waveform.
+     */
+    void        append(const float* frames, size_t count);
+
+    /**
+     * @brief Forgets the whole waveform.
+     */
+    void        clear();
+
+    size_t      frames() const;
+    unsigned int channels() const;
+
+    /**
+     * @brief Complete levels, the coarsest last.
+     */
+    size_t      levelCount() const;
+
+    /**
+     * @brief Lowest and highest sample of one channel in every column of a view.
+     * @param begin         First frame shown. May be fractional when zoomed in.
+     * @param framespercolumn  Frames every column covers.
+     * @param columns       Columns to fill. Those past the end of the waveform get 0.
+     * @param low, high     `columns` floats each.
+     */
+    void        summarize(unsigned int channel, double begin, double framespercolumn, unsigned int columns,
+                          float* low, float* high) const;
+};
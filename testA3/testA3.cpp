@@ -3,13 +3,30 @@
 
 #include "gui/testA3mw.h"
 #include "portaudio_engine/scopedPAContext.h"
+#include "portaudio_engine/offlinerendercontext.h"
+#include "portaudio_engine/rtsafety.h"
 #include "portaudio_engine/squarewavetest.h"
+#include "chip_engine/trackerexport.h"
 #include "whimsycore.h"
 
 using namespace whimsycore;
 
+/**
+ * @brief Prints what the real-time checker caught when main() returns, whichever way it does. Only with WHIMSY_RT_CHECK.
+ */
+struct RealtimeReportAtExit
+{
+    ~RealtimeReportAtExit()
+    {
+        if(RealtimeChecker::isCompiledIn())
+            RealtimeChecker::printReport();
+    }
+};
+
 int main(int argc, char** argv)
 {
+    RealtimeReportAtExit    rtreport;
+
     /*QApplication        testa3_app(argc, argv);
     TestA3MW            testwidget;
 
@@ -20,11 +37,59 @@ int main(int argc, char** argv)
 
     return testa3_app.exec();*/
 
-    ScopedPAContext     pactx;
+    // testA3 <song.json> [file.wav]: Plays the first song of a tracker file (up to 10 seconds), or renders it to a WAV file.
+    if(argc > 1 && std::string(argv[1]).find(".json") != std::string::npos)
+    {
+        const Variant       file =  TrackerSong::readJSON(argv[1]);
+        TrackerSong         song;
+        SampleBank          samples;
+
+        song.compile(file, 0, TrackerSong::readJSON("export_files/nes_2a03.json"));
+        samples.load(file);
+
+        TrackerStream       player(song, &samples);
+        player.setLoop(false);
+
+        if(argc > 2)
+        {
+            JobPool             jobs;
+            TrackerExporter     exporter(song, &samples);
+
+            exporter.setJobPool(&jobs);
+            exporter.renderToWav(argv[2], 600.0);
+            return 0;
+        }
+
+        ScopedPAContext     pactx;
+
+        pactx.setStream(player);
+        pactx.startStream(10000);
+        return 0;
+    }
+
     SquareWaveTest      sqw(440.0f * 1.26f);
 
+    // testA3 <file.wav>: Renders 2 seconds to a WAV file, no sound card needed.
+    if(argc > 1)
+    {
+        OfflineRenderContext    offctx(64);
+
+        offctx.setStream(sqw);
+        offctx.renderToWav(argv[1], 2 * sqw.getSampleRate());
+
+        std::cout << offctx.framesRendered() << " frames rendered at " << offctx.framesPerSecond() << " frames/s ("
+                  << offctx.realtimeFactor() << "x realtime)" << std::endl;
+        return 0;
+    }
+
+    ScopedPAContext     pactx;
+
     pactx.setStream(sqw);
+    std::cout << pactx.latencyReport().toString() << std::endl;
+
     pactx.startStream(2000);
 
+    std::cout << pactx.callbackStats().toString() << std::endl;
+
     return 0;
 }